@@ -31,23 +31,76 @@ namespace android {
 typedef Parcel::WritableBlob WritableBlob;
 typedef Parcel::ReadableBlob ReadableBlob;
 
+/**
+ * Open-addressed hash table with linear probing. The slot count is a power of
+ * two and at least twice the entry count, so every probe ends at a free slot.
+ */
+struct CameraMetadata::TagIndex {
+    struct Slot {
+        uint32_t tag;
+        uint32_t index;
+    };
+
+    static const uint32_t kFree = 0xFFFFFFFF;
+    static const size_t kMinSlots = 16;
+
+    size_t mask;
+    Slot slots[1];
+
+    static size_t hash(uint32_t tag) {
+        // Tags are (section << 16) | index, with small indices; fold the
+        // section into the bits the mask keeps.
+        return tag ^ (tag >> 11);
+    }
+
+    // Returns false if the table is too full to take the entry
+    bool add(uint32_t tag, size_t index) {
+        if ((index + 1) * 2 > mask + 1) {
+            return false;
+        }
+        for (size_t i = hash(tag) & mask; ; i = (i + 1) & mask) {
+            if (slots[i].index == kFree) {
+                slots[i].tag = tag;
+                slots[i].index = index;
+                return true;
+            }
+            if (slots[i].tag == tag) {
+                // Keep the first entry, as find_camera_metadata_entry does
+                return true;
+            }
+        }
+    }
+
+    ssize_t find(uint32_t tag) const {
+        for (size_t i = hash(tag) & mask; slots[i].index != kFree;
+                i = (i + 1) & mask) {
+            if (slots[i].tag == tag) {
+                return slots[i].index;
+            }
+        }
+        return NAME_NOT_FOUND;
+    }
+};
+
 CameraMetadata::CameraMetadata() :
-        mBuffer(NULL), mLocked(false) {
+        mBuffer(NULL), mLocked(false),
+        mTagIndex(NULL), mLookupsSinceChange(0) {
 }
 
 CameraMetadata::CameraMetadata(size_t entryCapacity, size_t dataCapacity) :
-        mLocked(false)
+        mLocked(false), mTagIndex(NULL), mLookupsSinceChange(0)
 {
     mBuffer = allocate_camera_metadata(entryCapacity, dataCapacity);
 }
 
 CameraMetadata::CameraMetadata(const CameraMetadata &other) :
-        mLocked(false) {
+        mLocked(false), mTagIndex(NULL), mLookupsSinceChange(0) {
     mBuffer = clone_camera_metadata(other.mBuffer);
 }
 
 CameraMetadata::CameraMetadata(camera_metadata_t *buffer) :
-        mBuffer(NULL), mLocked(false) {
+        mBuffer(NULL), mLocked(false),
+        mTagIndex(NULL), mLookupsSinceChange(0) {
     acquire(buffer);
 }
 
@@ -100,6 +153,7 @@ camera_metadata_t* CameraMetadata::release() {
     }
     camera_metadata_t *released = mBuffer;
     mBuffer = NULL;
+    invalidateTagIndex();
     return released;
 }
 
@@ -112,6 +166,27 @@ void CameraMetadata::clear() {
         free_camera_metadata(mBuffer);
         mBuffer = NULL;
     }
+    invalidateTagIndex();
+}
+
+void CameraMetadata::clearEntries() {
+    if (mLocked) {
+        ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
+        return;
+    }
+    if (mBuffer) {
+        size_t entryCapacity = get_camera_metadata_entry_capacity(mBuffer);
+        size_t dataCapacity = get_camera_metadata_data_capacity(mBuffer);
+        camera_metadata_t *buffer = place_camera_metadata(mBuffer,
+                get_camera_metadata_size(mBuffer), entryCapacity, dataCapacity);
+        if (buffer == NULL) {
+            ALOGE("%s: Unable to reset metadata buffer", __FUNCTION__);
+            clear();
+            return;
+        }
+        mBuffer = buffer;
+        invalidateTagIndex();
+    }
 }
 
 void CameraMetadata::acquire(camera_metadata_t *buffer) {
@@ -148,6 +223,8 @@ status_t CameraMetadata::append(const camera_metadata_t* other) {
     size_t extraData = get_camera_metadata_data_count(other);
     resizeIfNeeded(extraEntries, extraData);
 
+    // Appended entries may repeat tags already present
+    invalidateTagIndex();
     return append_camera_metadata(mBuffer, other);
 }
 
@@ -165,9 +242,30 @@ status_t CameraMetadata::sort() {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return INVALID_OPERATION;
     }
+    // Only a reordering moves entries out from under the tag index
+    if (!isSorted()) {
+        invalidateTagIndex();
+    }
     return sort_camera_metadata(mBuffer);
 }
 
+bool CameraMetadata::isSorted() const {
+    if (mBuffer == NULL) {
+        return true;
+    }
+    size_t entryCount = get_camera_metadata_entry_count(mBuffer);
+    uint32_t prevTag = 0;
+    for (size_t i = 0; i < entryCount; i++) {
+        camera_metadata_ro_entry_t entry;
+        get_camera_metadata_ro_entry(mBuffer, i, &entry);
+        if (i > 0 && entry.tag <= prevTag) {
+            return false;
+        }
+        prevTag = entry.tag;
+    }
+    return true;
+}
+
 status_t CameraMetadata::checkType(uint32_t tag, uint8_t expectedType) {
     int tagType = get_camera_metadata_tag_type(tag);
     if ( CC_UNLIKELY(tagType == -1)) {
@@ -292,17 +390,25 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
     size_t data_size = calculate_camera_metadata_entry_data_size(type,
             data_count);
 
-    res = resizeIfNeeded(1, data_size);
+    // Overwriting an existing entry never needs room for another one, so
+    // only grow the entry capacity when adding a tag. Resizing keeps the
+    // entries in order, so the index found here stays valid.
+    ssize_t index = findIndex(tag);
+    bool found = index >= 0;
+
+    res = resizeIfNeeded(found ? 0 : 1, data_size);
 
     if (res == OK) {
-        camera_metadata_entry_t entry;
-        res = find_camera_metadata_entry(mBuffer, tag, &entry);
-        if (res == NAME_NOT_FOUND) {
+        if (!found) {
             res = add_camera_metadata_entry(mBuffer,
                     tag, data, data_count);
-        } else if (res == OK) {
+            if (res == OK) {
+                addToTagIndex(tag,
+                        get_camera_metadata_entry_count(mBuffer) - 1);
+            }
+        } else {
             res = update_camera_metadata_entry(mBuffer,
-                    entry.index, data, data_count, NULL);
+                    index, data, data_count, NULL);
         }
     }
 
@@ -324,8 +430,7 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
 }
 
 bool CameraMetadata::exists(uint32_t tag) const {
-    camera_metadata_ro_entry entry;
-    return find_camera_metadata_ro_entry(mBuffer, tag, &entry) == 0;
+    return findIndex(tag) >= 0;
 }
 
 camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
@@ -336,7 +441,9 @@ camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
         entry.count = 0;
         return entry;
     }
-    res = find_camera_metadata_entry(mBuffer, tag, &entry);
+    ssize_t index = findIndex(tag);
+    res = (index >= 0) ?
+            get_camera_metadata_entry(mBuffer, index, &entry) : NAME_NOT_FOUND;
     if (CC_UNLIKELY( res != OK )) {
         entry.count = 0;
         entry.data.u8 = NULL;
@@ -347,7 +454,10 @@ camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
 camera_metadata_ro_entry_t CameraMetadata::find(uint32_t tag) const {
     status_t res;
     camera_metadata_ro_entry entry;
-    res = find_camera_metadata_ro_entry(mBuffer, tag, &entry);
+    ssize_t index = findIndex(tag);
+    res = (index >= 0) ?
+            get_camera_metadata_ro_entry(mBuffer, index, &entry) :
+            NAME_NOT_FOUND;
     if (CC_UNLIKELY( res != OK )) {
         entry.count = 0;
         entry.data.u8 = NULL;
@@ -356,23 +466,18 @@ camera_metadata_ro_entry_t CameraMetadata::find(uint32_t tag) const {
 }
 
 status_t CameraMetadata::erase(uint32_t tag) {
-    camera_metadata_entry_t entry;
     status_t res;
     if (mLocked) {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return INVALID_OPERATION;
     }
-    res = find_camera_metadata_entry(mBuffer, tag, &entry);
-    if (res == NAME_NOT_FOUND) {
+    ssize_t index = findIndex(tag);
+    if (index < 0) {
         return OK;
-    } else if (res != OK) {
-        ALOGE("%s: Error looking for entry %s.%s (%x): %s %d",
-                __FUNCTION__,
-                get_camera_metadata_section_name(tag),
-                get_camera_metadata_tag_name(tag), tag, strerror(-res), res);
-        return res;
     }
-    res = delete_camera_metadata_entry(mBuffer, entry.index);
+    // Deleting shifts every later entry down
+    invalidateTagIndex();
+    res = delete_camera_metadata_entry(mBuffer, index);
     if (res != OK) {
         ALOGE("%s: Error deleting entry %s.%s (%x): %s %d",
                 __FUNCTION__,
@@ -382,6 +487,72 @@ status_t CameraMetadata::erase(uint32_t tag) {
     return res;
 }
 
+ssize_t CameraMetadata::findIndex(uint32_t tag) const {
+    if (mBuffer == NULL) {
+        return NAME_NOT_FOUND;
+    }
+
+    const TagIndex *tagIndex = mTagIndex;
+    if (tagIndex == NULL &&
+            __sync_add_and_fetch(&mLookupsSinceChange, 1) >=
+                    kTagIndexMinLookups) {
+        TagIndex *newIndex = buildTagIndex();
+        if (newIndex != NULL &&
+                !__sync_bool_compare_and_swap(&mTagIndex,
+                        (TagIndex*)NULL, newIndex)) {
+            // Another reader published one first
+            free(newIndex);
+        }
+        tagIndex = mTagIndex;
+    }
+
+    if (tagIndex != NULL) {
+        return tagIndex->find(tag);
+    }
+
+    camera_metadata_ro_entry_t entry;
+    if (find_camera_metadata_ro_entry(mBuffer, tag, &entry) != OK) {
+        return NAME_NOT_FOUND;
+    }
+    return entry.index;
+}
+
+CameraMetadata::TagIndex *CameraMetadata::buildTagIndex() const {
+    size_t entryCount = get_camera_metadata_entry_count(mBuffer);
+    size_t slotCount = TagIndex::kMinSlots;
+    while (slotCount < entryCount * 2) {
+        slotCount *= 2;
+    }
+
+    TagIndex *tagIndex = static_cast<TagIndex*>(malloc(sizeof(TagIndex) +
+            (slotCount - 1) * sizeof(TagIndex::Slot)));
+    if (tagIndex == NULL) {
+        return NULL;
+    }
+    tagIndex->mask = slotCount - 1;
+    memset(tagIndex->slots, 0xFF, slotCount * sizeof(TagIndex::Slot));
+
+    for (size_t i = 0; i < entryCount; i++) {
+        camera_metadata_ro_entry_t entry;
+        get_camera_metadata_ro_entry(mBuffer, i, &entry);
+        tagIndex->add(entry.tag, i);
+    }
+    return tagIndex;
+}
+
+void CameraMetadata::addToTagIndex(uint32_t tag, size_t index) {
+    if (mTagIndex != NULL && !mTagIndex->add(tag, index)) {
+        // Out of room; rebuild at the right size once lookups resume
+        invalidateTagIndex();
+    }
+}
+
+void CameraMetadata::invalidateTagIndex() {
+    free(mTagIndex);
+    mTagIndex = NULL;
+    mLookupsSinceChange = 0;
+}
+
 void CameraMetadata::dump(int fd, int verbosity, int indentation) const {
     dump_indented_camera_metadata(mBuffer, fd, verbosity, indentation);
 }
@@ -668,6 +839,14 @@ void CameraMetadata::swap(CameraMetadata& other) {
 
     other.mBuffer = thisBuf;
     mBuffer = otherBuf;
+
+    // The tag indices describe the buffers, so they move with them
+    TagIndex* thisIndex = mTagIndex;
+    int32_t thisLookups = mLookupsSinceChange;
+    mTagIndex = other.mTagIndex;
+    mLookupsSinceChange = other.mLookupsSinceChange;
+    other.mTagIndex = thisIndex;
+    other.mLookupsSinceChange = thisLookups;
 }
 
 }; // namespace android
@@ -17,6 +17,7 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
 	main.cpp \
+	CameraMetadataTests.cpp \
 	ProCameraTests.cpp \
 	VendorTagDescriptorTests.cpp
 
@@ -53,3 +54,25 @@ LOCAL_MODULE:= camera_client_test
 LOCAL_MODULE_TAGS := tests
 
 include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	CameraMetadataBenchmark.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libutils \
+	liblog \
+	libcamera_metadata \
+	libcamera_client
+
+LOCAL_C_INCLUDES += \
+	system/media/camera/include \
+	frameworks/av/include/camera
+
+LOCAL_CFLAGS += -Wall -Wextra
+
+LOCAL_MODULE:= camera_metadata_benchmark
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "CameraMetadataBenchmark"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <camera/CameraMetadata.h>
+#include <system/camera_metadata.h>
+#include <utils/Timers.h>
+
+// Looks up and overwrites every tag of a typical preview request and of a
+// typical capture result, in the order the HAL fills them in, and reports the
+// cost per tag of the plain camera_metadata search on an unsorted and on a
+// sorted buffer against CameraMetadata with its tag index.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n <passes over each buffer>]\n", me);
+
+    exit(1);
+}
+
+namespace android {
+
+// What a HAL template and Parameters::updateRequest put in a preview request
+static const uint32_t kRequestTags[] = {
+    ANDROID_COLOR_CORRECTION_MODE,
+    ANDROID_COLOR_CORRECTION_ABERRATION_MODE,
+    ANDROID_CONTROL_AE_ANTIBANDING_MODE,
+    ANDROID_CONTROL_AE_EXPOSURE_COMPENSATION,
+    ANDROID_CONTROL_AE_LOCK,
+    ANDROID_CONTROL_AE_MODE,
+    ANDROID_CONTROL_AE_REGIONS,
+    ANDROID_CONTROL_AE_TARGET_FPS_RANGE,
+    ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER,
+    ANDROID_CONTROL_AF_MODE,
+    ANDROID_CONTROL_AF_REGIONS,
+    ANDROID_CONTROL_AF_TRIGGER,
+    ANDROID_CONTROL_AWB_LOCK,
+    ANDROID_CONTROL_AWB_MODE,
+    ANDROID_CONTROL_AWB_REGIONS,
+    ANDROID_CONTROL_CAPTURE_INTENT,
+    ANDROID_CONTROL_EFFECT_MODE,
+    ANDROID_CONTROL_MODE,
+    ANDROID_CONTROL_SCENE_MODE,
+    ANDROID_CONTROL_VIDEO_STABILIZATION_MODE,
+    ANDROID_EDGE_MODE,
+    ANDROID_FLASH_MODE,
+    ANDROID_HOT_PIXEL_MODE,
+    ANDROID_JPEG_GPS_COORDINATES,
+    ANDROID_JPEG_ORIENTATION,
+    ANDROID_JPEG_QUALITY,
+    ANDROID_JPEG_THUMBNAIL_QUALITY,
+    ANDROID_JPEG_THUMBNAIL_SIZE,
+    ANDROID_LENS_APERTURE,
+    ANDROID_LENS_FILTER_DENSITY,
+    ANDROID_LENS_FOCAL_LENGTH,
+    ANDROID_LENS_FOCUS_DISTANCE,
+    ANDROID_LENS_OPTICAL_STABILIZATION_MODE,
+    ANDROID_NOISE_REDUCTION_MODE,
+    ANDROID_REQUEST_ID,
+    ANDROID_REQUEST_OUTPUT_STREAMS,
+    ANDROID_SCALER_CROP_REGION,
+    ANDROID_SENSOR_EXPOSURE_TIME,
+    ANDROID_SENSOR_FRAME_DURATION,
+    ANDROID_SENSOR_SENSITIVITY,
+    ANDROID_SHADING_MODE,
+    ANDROID_STATISTICS_FACE_DETECT_MODE,
+    ANDROID_STATISTICS_LENS_SHADING_MAP_MODE,
+    ANDROID_TONEMAP_MODE,
+};
+
+// What a HAL adds to the request settings in a full capture result
+static const uint32_t kResultTags[] = {
+    ANDROID_BLACK_LEVEL_LOCK,
+    ANDROID_COLOR_CORRECTION_GAINS,
+    ANDROID_COLOR_CORRECTION_TRANSFORM,
+    ANDROID_CONTROL_AE_STATE,
+    ANDROID_CONTROL_AF_STATE,
+    ANDROID_CONTROL_AWB_STATE,
+    ANDROID_FLASH_STATE,
+    ANDROID_LENS_FOCUS_RANGE,
+    ANDROID_LENS_STATE,
+    ANDROID_REQUEST_FRAME_COUNT,
+    ANDROID_REQUEST_PIPELINE_DEPTH,
+    ANDROID_SENSOR_GREEN_SPLIT,
+    ANDROID_SENSOR_NEUTRAL_COLOR_POINT,
+    ANDROID_SENSOR_ROLLING_SHUTTER_SKEW,
+    ANDROID_SENSOR_TEST_PATTERN_MODE,
+    ANDROID_SENSOR_TIMESTAMP,
+    ANDROID_STATISTICS_FACE_IDS,
+    ANDROID_STATISTICS_FACE_LANDMARKS,
+    ANDROID_STATISTICS_FACE_RECTANGLES,
+    ANDROID_STATISTICS_FACE_SCORES,
+    ANDROID_STATISTICS_HOT_PIXEL_MAP_MODE,
+    ANDROID_STATISTICS_SCENE_FLICKER,
+    ANDROID_SYNC_FRAME_NUMBER,
+};
+
+static const size_t kNumRequestTags =
+        sizeof(kRequestTags) / sizeof(kRequestTags[0]);
+static const size_t kNumResultTags =
+        sizeof(kResultTags) / sizeof(kResultTags[0]);
+
+// Enough zeroed storage for one value of any metadata type
+static const int64_t kZeroes[2] = { 0, 0 };
+
+// Builds a buffer with a single value for each tag, added in the given order
+// so that the buffer is unsorted like the ones HALs hand back.
+static camera_metadata_t *buildMetadata(const Vector<uint32_t> &tags) {
+    camera_metadata_t *buffer = allocate_camera_metadata(tags.size(),
+            tags.size() * sizeof(kZeroes));
+    for (size_t i = 0; i < tags.size(); i++) {
+        if (add_camera_metadata_entry(buffer, tags[i], kZeroes, 1) != OK) {
+            fprintf(stderr, "unable to add tag %s.%s\n",
+                    get_camera_metadata_section_name(tags[i]),
+                    get_camera_metadata_tag_name(tags[i]));
+            exit(1);
+        }
+    }
+    return buffer;
+}
+
+static void printTime(const char *name, nsecs_t elapsedNs, size_t operations) {
+    printf("\t%-32s %6.1f ns/tag\n", name, (double)elapsedNs / operations);
+}
+
+static void runBenchmark(const char *name, const Vector<uint32_t> &tags,
+        size_t passes) {
+    size_t operations = passes * tags.size();
+    // Keeps the compiler from dropping the lookups
+    volatile size_t checksum = 0;
+
+    printf("%s, %zu tags:\n", name, tags.size());
+
+    camera_metadata_t *unsorted = buildMetadata(tags);
+    nsecs_t startNs = systemTime();
+    for (size_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < tags.size(); i++) {
+            camera_metadata_ro_entry_t entry;
+            if (find_camera_metadata_ro_entry(unsorted, tags[i], &entry) == OK) {
+                checksum += entry.count;
+            }
+        }
+    }
+    printTime("find, unsorted buffer", systemTime() - startNs, operations);
+
+    camera_metadata_t *sorted = clone_camera_metadata(unsorted);
+    sort_camera_metadata(sorted);
+    startNs = systemTime();
+    for (size_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < tags.size(); i++) {
+            camera_metadata_ro_entry_t entry;
+            if (find_camera_metadata_ro_entry(sorted, tags[i], &entry) == OK) {
+                checksum += entry.count;
+            }
+        }
+    }
+    printTime("find, sorted buffer", systemTime() - startNs, operations);
+    free_camera_metadata(sorted);
+
+    const CameraMetadata indexed(clone_camera_metadata(unsorted));
+    startNs = systemTime();
+    for (size_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < tags.size(); i++) {
+            checksum += indexed.find(tags[i]).count;
+        }
+    }
+    printTime("CameraMetadata::find", systemTime() - startNs, operations);
+
+    startNs = systemTime();
+    for (size_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < tags.size(); i++) {
+            camera_metadata_entry_t entry;
+            if (find_camera_metadata_entry(unsorted, tags[i], &entry) == OK) {
+                update_camera_metadata_entry(unsorted, entry.index, kZeroes, 1,
+                        NULL);
+                checksum++;
+            }
+        }
+    }
+    printTime("find and update, unsorted buffer", systemTime() - startNs,
+            operations);
+
+    // Goes through updateImpl() like Parameters::updateRequest does; the
+    // typed overload is picked by the tag type.
+    CameraMetadata updated(unsorted);
+    const int64_t i64 = 0;
+    const int32_t i32 = 0;
+    const uint8_t u8 = 0;
+    const float f = 0;
+    const double d = 0;
+    const camera_metadata_rational_t r = { 0, 1 };
+    startNs = systemTime();
+    for (size_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < tags.size(); i++) {
+            uint32_t tag = tags[i];
+            switch (get_camera_metadata_tag_type(tag)) {
+                case TYPE_BYTE:     updated.update(tag, &u8, 1);  break;
+                case TYPE_INT32:    updated.update(tag, &i32, 1); break;
+                case TYPE_FLOAT:    updated.update(tag, &f, 1);   break;
+                case TYPE_INT64:    updated.update(tag, &i64, 1); break;
+                case TYPE_DOUBLE:   updated.update(tag, &d, 1);   break;
+                case TYPE_RATIONAL: updated.update(tag, &r, 1);   break;
+            }
+        }
+    }
+    printTime("CameraMetadata::update", systemTime() - startNs, operations);
+
+    ALOGV("checksum %zu", (size_t)checksum);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    int passes = 100000;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:")) >= 0) {
+        switch (res) {
+            case 'n':
+                passes = atoi(optarg);
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (passes <= 0) {
+        usage(me);
+    }
+
+    Vector<uint32_t> tags;
+    tags.appendArray(kRequestTags, kNumRequestTags);
+    runBenchmark("Preview request", tags, passes);
+
+    tags.appendArray(kResultTags, kNumResultTags);
+    runBenchmark("Capture result", tags, passes);
+
+    return 0;
+}
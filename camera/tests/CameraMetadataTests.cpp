@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "CameraMetadataTests"
+
+#include <camera/CameraMetadata.h>
+#include <system/camera_metadata.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+using namespace android;
+
+// Enough lookups for CameraMetadata to switch to its tag index
+static const int kManyLookups = 16;
+
+static const uint32_t kTags[] = {
+    ANDROID_SENSOR_SENSITIVITY,
+    ANDROID_REQUEST_ID,
+    ANDROID_CONTROL_AE_EXPOSURE_COMPENSATION,
+    ANDROID_JPEG_ORIENTATION,
+    ANDROID_REQUEST_FRAME_COUNT,
+    ANDROID_CONTROL_AF_TRIGGER_ID,
+};
+
+#define ARRAY_SIZE(a)      (sizeof(a) / sizeof((a)[0]))
+
+static int32_t ValueOf(const CameraMetadata& metadata, uint32_t tag) {
+    camera_metadata_ro_entry_t entry = metadata.find(tag);
+    return entry.count > 0 ? entry.data.i32[0] : -1;
+}
+
+// Look every tag up often enough for the index to be built, checking the
+// values against the expected ones (-1 for a missing tag)
+static void ExpectValues(const CameraMetadata& metadata,
+        const int32_t* values) {
+    for (int pass = 0; pass < kManyLookups; ++pass) {
+        for (size_t i = 0; i < ARRAY_SIZE(kTags); ++i) {
+            EXPECT_EQ(values[i], ValueOf(metadata, kTags[i]));
+            EXPECT_EQ(values[i] != -1, metadata.exists(kTags[i]));
+        }
+    }
+}
+
+static void FillTags(CameraMetadata* metadata, int32_t* values) {
+    for (size_t i = 0; i < ARRAY_SIZE(kTags); ++i) {
+        values[i] = 100 + i;
+        ASSERT_EQ(OK, metadata->update(kTags[i], &values[i], 1));
+    }
+}
+
+TEST(CameraMetadataTest, FindAfterUpdate) {
+    CameraMetadata metadata;
+    int32_t values[ARRAY_SIZE(kTags)];
+    FillTags(&metadata, values);
+    ExpectValues(metadata, values);
+
+    // Overwrites and additions keep the index in step
+    values[2] = 7;
+    ASSERT_EQ(OK, metadata.update(kTags[2], &values[2], 1));
+    uint8_t lensFacing = ANDROID_LENS_FACING_BACK;
+    ASSERT_EQ(OK, metadata.update(ANDROID_LENS_FACING, &lensFacing, 1));
+    ExpectValues(metadata, values);
+    EXPECT_TRUE(metadata.exists(ANDROID_LENS_FACING));
+}
+
+TEST(CameraMetadataTest, FindAfterErase) {
+    CameraMetadata metadata;
+    int32_t values[ARRAY_SIZE(kTags)];
+    FillTags(&metadata, values);
+    ExpectValues(metadata, values);
+
+    // Erasing moves the later entries down
+    ASSERT_EQ(OK, metadata.erase(kTags[1]));
+    values[1] = -1;
+    ExpectValues(metadata, values);
+
+    ASSERT_EQ(OK, metadata.erase(kTags[0]));
+    values[0] = -1;
+    ExpectValues(metadata, values);
+
+    values[1] = 42;
+    ASSERT_EQ(OK, metadata.update(kTags[1], &values[1], 1));
+    ExpectValues(metadata, values);
+}
+
+TEST(CameraMetadataTest, FindAfterSortAndAppend) {
+    CameraMetadata metadata;
+    int32_t values[ARRAY_SIZE(kTags)];
+    FillTags(&metadata, values);
+    ExpectValues(metadata, values);
+
+    ASSERT_EQ(OK, metadata.sort());
+    ExpectValues(metadata, values);
+
+    // A repeated tag is found at its first entry
+    CameraMetadata other;
+    int32_t appended[2] = { 1, 2 };
+    ASSERT_EQ(OK, other.update(ANDROID_SENSOR_SENSITIVITY, &appended[0], 1));
+    ASSERT_EQ(OK, other.update(ANDROID_SCALER_CROP_REGION, appended, 2));
+    ASSERT_EQ(OK, metadata.append(other));
+    ExpectValues(metadata, values);
+    EXPECT_EQ(1, ValueOf(metadata, ANDROID_SCALER_CROP_REGION));
+}
+
+TEST(CameraMetadataTest, FindAfterSwapAndClear) {
+    CameraMetadata metadata;
+    int32_t values[ARRAY_SIZE(kTags)];
+    FillTags(&metadata, values);
+    ExpectValues(metadata, values);
+
+    CameraMetadata other;
+    int32_t none[ARRAY_SIZE(kTags)];
+    for (size_t i = 0; i < ARRAY_SIZE(kTags); ++i) {
+        none[i] = -1;
+    }
+    ExpectValues(other, none);
+
+    metadata.swap(other);
+    ExpectValues(metadata, none);
+    ExpectValues(other, values);
+
+    other.clearEntries();
+    ExpectValues(other, none);
+
+    FillTags(&other, values);
+    metadata = other;
+    ExpectValues(metadata, values);
+
+    metadata.clear();
+    ExpectValues(metadata, none);
+}
@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "codecbench"
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include <binder/ProcessState.h>
+#include <media/ICrypto.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaErrors.h>
+#include <gui/Surface.h>
+
+// Pushes small buffers through a software codec as fast as it can, polling
+// with a timeout of 0 the way NuPlayer and most applications do, and reports
+// the throughput with and without MediaCodec's fast dequeue path, and with
+// the batched queue/dequeue calls.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-c <component name>]\n"
+                    "\t\t[-n <number of buffers>]\n"
+                    "\t\t[-s <buffer size>]\n"
+                    "\t\t[-r <number of runs per mode>]\n"
+                    "\t\t[-b <buffers per batch>]\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct BenchResult {
+    int64_t mNumBuffers;
+    int64_t mNumPolls;
+    int64_t mElapsedTimeUs;
+};
+
+static status_t runBenchmark(
+        const sp<ALooper> &looper,
+        const char *componentName,
+        bool useFastDequeue,
+        size_t batchSize,
+        int64_t numBuffers,
+        size_t bufferSize,
+        BenchResult *result) {
+    MediaCodec::SetUseFastDequeue(useFastDequeue);
+
+    sp<MediaCodec> codec = MediaCodec::CreateByComponentName(looper, componentName);
+    if (codec == NULL) {
+        fprintf(stderr, "unable to instantiate %s\n", componentName);
+        return UNKNOWN_ERROR;
+    }
+
+    sp<AMessage> format = new AMessage;
+    format->setString("mime", "audio/raw");
+    format->setInt32("channel-count", 2);
+    format->setInt32("sample-rate", 48000);
+
+    status_t err = codec->configure(format, NULL /* surface */, NULL /* crypto */, 0);
+    if (err == OK) {
+        err = codec->start();
+    }
+
+    Vector<sp<ABuffer> > inBuffers;
+    if (err == OK) {
+        err = codec->getInputBuffers(&inBuffers);
+    }
+
+    if (err != OK) {
+        fprintf(stderr, "unable to start %s (err=%d)\n", componentName, err);
+        codec->release();
+        return err;
+    }
+
+    int64_t numQueued = 0;
+    result->mNumBuffers = 0;
+    result->mNumPolls = 0;
+
+    int64_t startTimeUs = ALooper::GetNowUs();
+
+    Vector<size_t> indices;
+    Vector<MediaCodec::BufferDescriptor> buffers;
+    indices.resize(batchSize);
+    buffers.resize(batchSize);
+
+    bool sawOutputEOS = false;
+    while (err == OK && batchSize > 1 && !sawOutputEOS) {
+        size_t count;
+
+        if (numQueued < numBuffers) {
+            size_t maxCount = batchSize;
+            if ((int64_t)maxCount > numBuffers - numQueued) {
+                maxCount = numBuffers - numQueued;
+            }
+
+            ++result->mNumPolls;
+            if (codec->dequeueInputBuffers(
+                        indices.editArray(), maxCount, &count, 0ll) == OK) {
+                for (size_t i = 0; i < count; ++i) {
+                    const sp<ABuffer> &buffer = inBuffers.itemAt(indices[i]);
+
+                    ++numQueued;
+                    MediaCodec::BufferDescriptor &desc = buffers.editItemAt(i);
+                    desc.mIndex = indices[i];
+                    desc.mOffset = 0;
+                    desc.mSize = bufferSize < buffer->capacity() ? bufferSize : buffer->capacity();
+                    desc.mTimeUs = numQueued * 1000ll;
+                    desc.mFlags = numQueued == numBuffers ? MediaCodec::BUFFER_FLAG_EOS : 0;
+                }
+
+                size_t numDone;
+                err = codec->queueInputBuffers(buffers.array(), count, &numDone);
+            }
+        }
+
+        ++result->mNumPolls;
+        status_t res = codec->dequeueOutputBuffers(
+                buffers.editArray(), batchSize, &count, 0ll);
+
+        if (res == OK) {
+            for (size_t i = 0; i < count; ++i) {
+                indices.editItemAt(i) = buffers[i].mIndex;
+                if (buffers[i].mFlags & MediaCodec::BUFFER_FLAG_EOS) {
+                    sawOutputEOS = true;
+                }
+            }
+            result->mNumBuffers += count;
+
+            size_t numDone;
+            err = codec->releaseOutputBuffers(
+                    indices.array(), count, false /* render */, &numDone);
+        } else if (res != -EAGAIN
+                && res != INFO_FORMAT_CHANGED
+                && res != INFO_OUTPUT_BUFFERS_CHANGED) {
+            err = res;
+        }
+    }
+
+    while (err == OK && !sawOutputEOS) {
+        size_t index;
+
+        if (numQueued < numBuffers) {
+            ++result->mNumPolls;
+            if (codec->dequeueInputBuffer(&index, 0ll) == OK) {
+                const sp<ABuffer> &buffer = inBuffers.itemAt(index);
+                size_t size = bufferSize < buffer->capacity() ? bufferSize : buffer->capacity();
+
+                ++numQueued;
+                err = codec->queueInputBuffer(
+                        index, 0 /* offset */, size, numQueued * 1000ll,
+                        numQueued == numBuffers ? MediaCodec::BUFFER_FLAG_EOS : 0);
+            }
+        }
+
+        size_t offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+        ++result->mNumPolls;
+        status_t res = codec->dequeueOutputBuffer(
+                &index, &offset, &size, &timeUs, &flags, 0ll);
+
+        if (res == OK) {
+            ++result->mNumBuffers;
+            sawOutputEOS = (flags & MediaCodec::BUFFER_FLAG_EOS) != 0;
+            err = codec->releaseOutputBuffer(index);
+        } else if (res != -EAGAIN
+                && res != INFO_FORMAT_CHANGED
+                && res != INFO_OUTPUT_BUFFERS_CHANGED) {
+            err = res;
+        }
+    }
+
+    result->mElapsedTimeUs = ALooper::GetNowUs() - startTimeUs;
+
+    codec->release();
+
+    if (err != OK) {
+        fprintf(stderr, "%s failed (err=%d)\n", componentName, err);
+    }
+
+    return err;
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    const char *componentName = "OMX.google.raw.decoder";
+    int numBuffers = 100000;
+    int bufferSize = 256;
+    int numRuns = 3;
+    int batchSize = 8;
+
+    int res;
+    while ((res = getopt(argc, argv, "hc:n:s:r:b:")) >= 0) {
+        switch (res) {
+            case 'c':
+                componentName = optarg;
+                break;
+
+            case 'n':
+                numBuffers = atoi(optarg);
+                break;
+
+            case 's':
+                bufferSize = atoi(optarg);
+                break;
+
+            case 'r':
+                numRuns = atoi(optarg);
+                break;
+
+            case 'b':
+                batchSize = atoi(optarg);
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (numBuffers <= 0 || bufferSize <= 0 || numRuns <= 0 || batchSize <= 1) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("codecbench");
+    looper->start();
+
+    printf("%s, %d buffers of %d bytes, %d runs per mode, batches of %d\n",
+           componentName, numBuffers, bufferSize, numRuns, batchSize);
+
+    static const char *kModeNames[] = { "looper", "fast", "batch" };
+    static const size_t kNumModes = sizeof(kModeNames) / sizeof(kModeNames[0]);
+    double buffersPerSec[kNumModes] = { 0.0, 0.0, 0.0 };
+
+    for (int run = 0; run < numRuns; ++run) {
+        for (size_t mode = 0; mode < kNumModes; ++mode) {
+            BenchResult result;
+            if (runBenchmark(looper, componentName, mode > 0 /* useFastDequeue */,
+                        mode == 2 ? batchSize : 1, numBuffers,
+                        bufferSize, &result) != OK) {
+                looper->stop();
+                return 1;
+            }
+
+            double rate = result.mNumBuffers * 1E6 / result.mElapsedTimeUs;
+            printf("%-8s run %d: %" PRId64 " buffers in %.2f secs, %.0f buffers/sec, "
+                   "%.2f polls/buffer\n",
+                   kModeNames[mode], run,
+                   result.mNumBuffers, result.mElapsedTimeUs / 1E6, rate,
+                   (double)result.mNumPolls / result.mNumBuffers);
+
+            buffersPerSec[mode] += rate / numRuns;
+        }
+    }
+
+    for (size_t mode = 0; mode < kNumModes; ++mode) {
+        printf("average %-8s %.0f buffers/sec (%.2fx)\n",
+               kModeNames[mode], buffersPerSec[mode],
+               buffersPerSec[0] > 0 ? buffersPerSec[mode] / buffersPerSec[0] : 0.0);
+    }
+
+    looper->stop();
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "codecstartup"
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include <binder/ProcessState.h>
+#include <media/ICrypto.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <gui/Surface.h>
+
+// Measures how long it takes to get a codec from creation to started, the
+// way a playlist style application does for every item, with and without
+// the codec pool.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-m <mime type>]\n"
+                    "\t\t[-e(ncoder)]\n"
+                    "\t\t[-n <number of codecs per mode>]\n"
+                    "\t\t[-t <pool ttl in ms>]\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+static status_t startAndRelease(
+        const sp<ALooper> &looper,
+        const char *mime,
+        bool encoder,
+        int64_t *startupTimeUs) {
+    int64_t startTimeUs = ALooper::GetNowUs();
+
+    sp<MediaCodec> codec = MediaCodec::CreateByType(looper, mime, encoder);
+    if (codec == NULL) {
+        fprintf(stderr, "unable to instantiate a %s for %s\n",
+                encoder ? "encoder" : "decoder", mime);
+        return UNKNOWN_ERROR;
+    }
+
+    sp<AMessage> format = new AMessage;
+    format->setString("mime", mime);
+
+    if (!strncasecmp(mime, "video/", 6)) {
+        format->setInt32("width", 1280);
+        format->setInt32("height", 720);
+
+        if (encoder) {
+            format->setInt32("color-format", 21);  // YUV420SemiPlanar
+            format->setInt32("bitrate", 4000000);
+            format->setFloat("frame-rate", 30.0f);
+            format->setInt32("i-frame-interval", 1);
+        }
+    } else {
+        format->setInt32("channel-count", 2);
+        format->setInt32("sample-rate", 44100);
+
+        if (encoder) {
+            format->setInt32("bitrate", 128000);
+        }
+    }
+
+    status_t err = codec->configure(
+            format, NULL /* surface */, NULL /* crypto */,
+            encoder ? MediaCodec::CONFIGURE_FLAG_ENCODE : 0);
+
+    if (err == OK) {
+        err = codec->start();
+    }
+
+    *startupTimeUs = ALooper::GetNowUs() - startTimeUs;
+
+    codec->release();
+
+    if (err != OK) {
+        fprintf(stderr, "unable to start the codec (err=%d)\n", err);
+    }
+
+    return err;
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    const char *mime = "audio/mp4a-latm";
+    bool encoder = false;
+    int numCodecs = 20;
+    int ttlMs = 2000;
+
+    int res;
+    while ((res = getopt(argc, argv, "hm:en:t:")) >= 0) {
+        switch (res) {
+            case 'm':
+                mime = optarg;
+                break;
+
+            case 'e':
+                encoder = true;
+                break;
+
+            case 'n':
+                numCodecs = atoi(optarg);
+                break;
+
+            case 't':
+                ttlMs = atoi(optarg);
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (numCodecs <= 0 || ttlMs <= 0) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("codecstartup");
+    looper->start();
+
+    printf("%s %s, %d codecs per mode\n",
+           mime, encoder ? "encoder" : "decoder", numCodecs);
+
+    for (int pooled = 0; pooled < 2; ++pooled) {
+        MediaCodec::SetCodecPoolTTL(pooled ? ttlMs * 1000ll : 0ll);
+
+        int64_t totalTimeUs = 0ll;
+        int64_t minTimeUs = -1ll;
+        int64_t maxTimeUs = 0ll;
+
+        for (int i = 0; i < numCodecs; ++i) {
+            int64_t startupTimeUs;
+            if (startAndRelease(looper, mime, encoder, &startupTimeUs) != OK) {
+                looper->stop();
+                return 1;
+            }
+
+            totalTimeUs += startupTimeUs;
+            if (minTimeUs < 0ll || startupTimeUs < minTimeUs) {
+                minTimeUs = startupTimeUs;
+            }
+            if (startupTimeUs > maxTimeUs) {
+                maxTimeUs = startupTimeUs;
+            }
+        }
+
+        printf("%-8s avg %.2f ms, min %.2f ms, max %.2f ms\n",
+               pooled ? "pooled" : "cold",
+               totalTimeUs / 1E3 / numCodecs, minTimeUs / 1E3, maxTimeUs / 1E3);
+    }
+
+    MediaCodec::SetCodecPoolTTL(0ll);
+
+    looper->stop();
+
+    return 0;
+}
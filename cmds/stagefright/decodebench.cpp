@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "decodebench"
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include <binder/ProcessState.h>
+#include <media/ICrypto.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <gui/Surface.h>
+#include <utils/KeyedVector.h>
+
+// Decodes the video track of each input file as fast as the decoder goes,
+// once per thread count with the decoder running synchronously and once
+// asynchronously, and reports the frame rate and how long frames take from
+// being queued to coming out of the decoder. Meant for 1080p and 4K HEVC
+// streams and the software HEVC decoder, but takes any video decoder.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-c <decoder component name>]\n"
+                    "\t\t[-t <thread counts, comma separated>]\n"
+                    "\t\t[-n <max number of frames>]\n"
+                    "\t\tfile...\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct BenchResult {
+    int64_t mElapsedTimeUs;
+    Vector<int64_t> mLatenciesUs;
+};
+
+static status_t readStream(
+        const char *path,
+        size_t maxFrames,
+        sp<AMessage> *format,
+        Vector<sp<ABuffer> > *accessUnits) {
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    if (extractor->setDataSource(NULL /* httpService */, path) != OK) {
+        fprintf(stderr, "unable to instantiate extractor for %s\n", path);
+        return UNKNOWN_ERROR;
+    }
+
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        status_t err = extractor->getTrackFormat(i, format);
+        CHECK_EQ(err, (status_t)OK);
+
+        AString mime;
+        CHECK((*format)->findString("mime", &mime));
+
+        if (!strncasecmp(mime.c_str(), "video/", 6)) {
+            err = extractor->selectTrack(i);
+            CHECK_EQ(err, (status_t)OK);
+            break;
+        }
+
+        *format = NULL;
+    }
+
+    if (*format == NULL) {
+        fprintf(stderr, "%s has no video track\n", path);
+        return UNKNOWN_ERROR;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(8 * 1024 * 1024);
+
+    int64_t timeUs;
+    while (accessUnits->size() < maxFrames
+            && extractor->getSampleTime(&timeUs) == OK) {
+        status_t err = extractor->readSampleData(buffer);
+        CHECK_EQ(err, (status_t)OK);
+
+        sp<ABuffer> accessUnit = new ABuffer(buffer->size());
+        memcpy(accessUnit->data(), buffer->data(), buffer->size());
+        accessUnit->meta()->setInt64("timeUs", timeUs);
+        accessUnits->push(accessUnit);
+
+        extractor->advance();
+    }
+
+    return OK;
+}
+
+static status_t runBenchmark(
+        const sp<ALooper> &looper,
+        const char *componentName,
+        const sp<AMessage> &streamFormat,
+        const Vector<sp<ABuffer> > &accessUnits,
+        int32_t threadCount,
+        bool asyncDecode,
+        BenchResult *result) {
+    static const int64_t kTimeoutUs = 5000ll;
+
+    AString mime;
+    CHECK(streamFormat->findString("mime", &mime));
+
+    sp<MediaCodec> codec;
+    if (componentName != NULL) {
+        codec = MediaCodec::CreateByComponentName(looper, componentName);
+    } else {
+        codec = MediaCodec::CreateByType(looper, mime.c_str(), false /* encoder */);
+    }
+
+    if (codec == NULL) {
+        fprintf(stderr, "unable to instantiate a decoder for %s\n", mime.c_str());
+        return UNKNOWN_ERROR;
+    }
+
+    sp<AMessage> format = streamFormat->dup();
+    format->setInt32("thread-count", threadCount);
+    format->setInt32("async-decode", asyncDecode);
+
+    status_t err = codec->configure(
+            format, NULL /* surface */, NULL /* crypto */, 0 /* flags */);
+
+    if (err == OK) {
+        err = codec->start();
+    }
+
+    Vector<sp<ABuffer> > inBuffers;
+    if (err == OK) {
+        err = codec->getInputBuffers(&inBuffers);
+    }
+
+    if (err != OK) {
+        fprintf(stderr, "unable to start the decoder (err=%d)\n", err);
+        codec->release();
+        return err;
+    }
+
+    KeyedVector<int64_t, int64_t> queueTimeUsByTimeUs;
+
+    size_t numQueued = 0;
+    bool sawOutputEOS = false;
+    int64_t startTimeUs = ALooper::GetNowUs();
+
+    while (err == OK && !sawOutputEOS) {
+        size_t index;
+
+        while (numQueued <= accessUnits.size()
+                && codec->dequeueInputBuffer(&index, 0ll) == OK) {
+            const sp<ABuffer> &buffer = inBuffers.itemAt(index);
+            size_t size = 0;
+            int64_t timeUs = 0ll;
+            uint32_t flags = MediaCodec::BUFFER_FLAG_EOS;
+
+            if (numQueued < accessUnits.size()) {
+                const sp<ABuffer> &accessUnit = accessUnits.itemAt(numQueued);
+                CHECK_LE(accessUnit->size(), buffer->capacity());
+
+                size = accessUnit->size();
+                memcpy(buffer->data(), accessUnit->data(), size);
+                CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
+                flags = 0;
+
+                queueTimeUsByTimeUs.add(timeUs, ALooper::GetNowUs());
+            }
+
+            err = codec->queueInputBuffer(index, 0 /* offset */, size, timeUs, flags);
+            ++numQueued;
+
+            if (err != OK) {
+                break;
+            }
+        }
+
+        size_t offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+        status_t res = codec->dequeueOutputBuffer(
+                &index, &offset, &size, &timeUs, &flags, kTimeoutUs);
+
+        if (res == OK) {
+            ssize_t queueIndex = queueTimeUsByTimeUs.indexOfKey(timeUs);
+            if (queueIndex >= 0 && size > 0) {
+                result->mLatenciesUs.push(
+                        ALooper::GetNowUs() - queueTimeUsByTimeUs.valueAt(queueIndex));
+                queueTimeUsByTimeUs.removeItemsAt(queueIndex);
+            }
+
+            sawOutputEOS = (flags & MediaCodec::BUFFER_FLAG_EOS) != 0;
+            err = codec->releaseOutputBuffer(index);
+        } else if (res != -EAGAIN
+                && res != INFO_FORMAT_CHANGED
+                && res != INFO_OUTPUT_BUFFERS_CHANGED) {
+            err = res;
+        }
+    }
+
+    result->mElapsedTimeUs = ALooper::GetNowUs() - startTimeUs;
+
+    codec->release();
+
+    if (err != OK) {
+        fprintf(stderr, "decoding failed (err=%d)\n", err);
+    }
+
+    return err;
+}
+
+static int compareLatencies(const int64_t *a, const int64_t *b) {
+    return *a < *b ? -1 : (*a > *b ? 1 : 0);
+}
+
+static void printResult(int32_t threadCount, bool asyncDecode, BenchResult *result) {
+    Vector<int64_t> &latenciesUs = result->mLatenciesUs;
+    size_t n = latenciesUs.size();
+
+    if (n == 0) {
+        printf("%d thread(s) %-5s no frames decoded\n",
+               threadCount, asyncDecode ? "async" : "sync");
+        return;
+    }
+
+    latenciesUs.sort(compareLatencies);
+
+    int64_t totalUs = 0ll;
+    for (size_t i = 0; i < n; ++i) {
+        totalUs += latenciesUs.itemAt(i);
+    }
+
+    printf("%d thread(s) %-5s %zu frames, %.2f fps, latency avg %.2f ms, "
+           "median %.2f ms, 95%% %.2f ms, max %.2f ms\n",
+           threadCount, asyncDecode ? "async" : "sync",
+           n, n * 1E6 / result->mElapsedTimeUs,
+           totalUs / 1E3 / n,
+           latenciesUs.itemAt(n / 2) / 1E3,
+           latenciesUs.itemAt(n * 95 / 100) / 1E3,
+           latenciesUs.itemAt(n - 1) / 1E3);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    const char *componentName = NULL;
+    const char *threadCountList = "1,2,4";
+    int maxFrames = 600;
+
+    int res;
+    while ((res = getopt(argc, argv, "hc:t:n:")) >= 0) {
+        switch (res) {
+            case 'c':
+                componentName = optarg;
+                break;
+
+            case 't':
+                threadCountList = optarg;
+                break;
+
+            case 'n':
+                maxFrames = atoi(optarg);
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    Vector<int32_t> threadCounts;
+    for (const char *s = threadCountList; *s != '\0';) {
+        char *end;
+        long threadCount = strtol(s, &end, 10);
+        if (end == s || threadCount <= 0 || (*end != ',' && *end != '\0')) {
+            usage(me);
+        }
+        threadCounts.push(threadCount);
+        s = (*end == ',') ? end + 1 : end;
+    }
+
+    if (argc < 1 || threadCounts.isEmpty() || maxFrames <= 0) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("decodebench");
+    looper->start();
+
+    for (int i = 0; i < argc; ++i) {
+        sp<AMessage> format;
+        Vector<sp<ABuffer> > accessUnits;
+        if (readStream(argv[i], maxFrames, &format, &accessUnits) != OK) {
+            looper->stop();
+            return 1;
+        }
+
+        AString mime;
+        int32_t width = 0, height = 0;
+        CHECK(format->findString("mime", &mime));
+        format->findInt32("width", &width);
+        format->findInt32("height", &height);
+
+        printf("%s: %s %dx%d, %zu frames\n",
+               argv[i], mime.c_str(), width, height, accessUnits.size());
+
+        for (size_t j = 0; j < threadCounts.size(); ++j) {
+            for (int asyncDecode = 0; asyncDecode < 2; ++asyncDecode) {
+                BenchResult result;
+                if (runBenchmark(looper, componentName, format, accessUnits,
+                            threadCounts[j], asyncDecode, &result) != OK) {
+                    looper->stop();
+                    return 1;
+                }
+
+                printResult(threadCounts[j], asyncDecode, &result);
+            }
+        }
+    }
+
+    looper->stop();
+
+    return 0;
+}
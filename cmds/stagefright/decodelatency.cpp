@@ -0,0 +1,475 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "decodelatency"
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include <binder/ProcessState.h>
+#include <media/ICrypto.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <gui/Surface.h>
+#include <utils/KeyedVector.h>
+
+// Feeds a video stream to a decoder at its real time rate, the way a wifi
+// display sink or a video call does, and reports how long each frame takes
+// from being queued to coming out of the decoder, with and without the
+// "low-latency" configure key. Without an input file, frames are made up
+// and encoded with the software AVC encoder first.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-i <input file>]\n"
+                    "\t\t[-c <decoder component name>]\n"
+                    "\t\t[-w <width>] [-h <height>]\n"
+                    "\t\t[-n <number of frames>]\n"
+                    "\t\t[-r <frame rate>]\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+static status_t readStream(
+        const char *path,
+        size_t numFrames,
+        sp<AMessage> *format,
+        Vector<sp<ABuffer> > *accessUnits) {
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    if (extractor->setDataSource(NULL /* httpService */, path) != OK) {
+        fprintf(stderr, "unable to instantiate extractor for %s\n", path);
+        return UNKNOWN_ERROR;
+    }
+
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        status_t err = extractor->getTrackFormat(i, format);
+        CHECK_EQ(err, (status_t)OK);
+
+        AString mime;
+        CHECK((*format)->findString("mime", &mime));
+
+        if (!strncasecmp(mime.c_str(), "video/", 6)) {
+            err = extractor->selectTrack(i);
+            CHECK_EQ(err, (status_t)OK);
+            break;
+        }
+
+        *format = NULL;
+    }
+
+    if (*format == NULL) {
+        fprintf(stderr, "%s has no video track\n", path);
+        return UNKNOWN_ERROR;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(4 * 1024 * 1024);
+
+    int64_t timeUs;
+    while (accessUnits->size() < numFrames
+            && extractor->getSampleTime(&timeUs) == OK) {
+        status_t err = extractor->readSampleData(buffer);
+        CHECK_EQ(err, (status_t)OK);
+
+        sp<ABuffer> accessUnit = new ABuffer(buffer->size());
+        memcpy(accessUnit->data(), buffer->data(), buffer->size());
+        accessUnit->meta()->setInt64("timeUs", timeUs);
+        accessUnits->push(accessUnit);
+
+        extractor->advance();
+    }
+
+    return OK;
+}
+
+static status_t encodeStream(
+        const sp<ALooper> &looper,
+        int32_t width,
+        int32_t height,
+        int32_t frameRate,
+        size_t numFrames,
+        sp<AMessage> *format,
+        Vector<sp<ABuffer> > *accessUnits) {
+    static const int64_t kTimeoutUs = 10000ll;
+
+    sp<MediaCodec> encoder = MediaCodec::CreateByType(
+            looper, MEDIA_MIMETYPE_VIDEO_AVC, true /* encoder */);
+    if (encoder == NULL) {
+        fprintf(stderr, "unable to instantiate an avc encoder\n");
+        return UNKNOWN_ERROR;
+    }
+
+    sp<AMessage> encoderFormat = new AMessage;
+    encoderFormat->setString("mime", MEDIA_MIMETYPE_VIDEO_AVC);
+    encoderFormat->setInt32("width", width);
+    encoderFormat->setInt32("height", height);
+    encoderFormat->setInt32("color-format", 19);  // YUV420Planar
+    encoderFormat->setInt32("bitrate", width * height * 4);
+    encoderFormat->setFloat("frame-rate", frameRate);
+    encoderFormat->setInt32("i-frame-interval", 1);
+
+    status_t err = encoder->configure(
+            encoderFormat, NULL /* surface */, NULL /* crypto */,
+            MediaCodec::CONFIGURE_FLAG_ENCODE);
+
+    if (err == OK) {
+        err = encoder->start();
+    }
+
+    Vector<sp<ABuffer> > inBuffers;
+    Vector<sp<ABuffer> > outBuffers;
+    if (err == OK) {
+        err = encoder->getInputBuffers(&inBuffers);
+    }
+    if (err == OK) {
+        err = encoder->getOutputBuffers(&outBuffers);
+    }
+
+    size_t numQueued = 0;
+    bool sawOutputEOS = false;
+    while (err == OK && !sawOutputEOS) {
+        size_t index;
+
+        if (numQueued <= numFrames
+                && encoder->dequeueInputBuffer(&index, kTimeoutUs) == OK) {
+            const sp<ABuffer> &buffer = inBuffers.itemAt(index);
+            size_t size = width * height * 3 / 2;
+            uint32_t flags = 0;
+
+            if (numQueued == numFrames) {
+                size = 0;
+                flags = MediaCodec::BUFFER_FLAG_EOS;
+            } else {
+                CHECK_LE(size, buffer->capacity());
+
+                // A diagonal ramp that moves a little every frame.
+                uint8_t *dst = buffer->data();
+                for (int32_t y = 0; y < height; ++y) {
+                    for (int32_t x = 0; x < width; ++x) {
+                        *dst++ = (uint8_t)(x + y + numQueued * 4);
+                    }
+                }
+                memset(dst, 128, width * height / 2);
+            }
+
+            err = encoder->queueInputBuffer(
+                    index, 0 /* offset */, size,
+                    numQueued * 1000000ll / frameRate, flags);
+            ++numQueued;
+        }
+
+        size_t offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+        status_t res = encoder->dequeueOutputBuffer(
+                &index, &offset, &size, &timeUs, &flags, kTimeoutUs);
+
+        if (res == OK) {
+            if (size > 0) {
+                sp<ABuffer> accessUnit = new ABuffer(size);
+                memcpy(accessUnit->data(),
+                       outBuffers.itemAt(index)->base() + offset, size);
+                accessUnit->meta()->setInt64("timeUs", timeUs);
+                if (flags & MediaCodec::BUFFER_FLAG_CODECCONFIG) {
+                    accessUnit->meta()->setInt32("csd", true);
+                }
+                accessUnits->push(accessUnit);
+            }
+
+            sawOutputEOS = (flags & MediaCodec::BUFFER_FLAG_EOS) != 0;
+            err = encoder->releaseOutputBuffer(index);
+        } else if (res == INFO_OUTPUT_BUFFERS_CHANGED) {
+            err = encoder->getOutputBuffers(&outBuffers);
+        } else if (res != -EAGAIN && res != INFO_FORMAT_CHANGED) {
+            err = res;
+        }
+    }
+
+    encoder->release();
+
+    if (err != OK) {
+        fprintf(stderr, "encoding failed (err=%d)\n", err);
+        return err;
+    }
+
+    *format = new AMessage;
+    (*format)->setString("mime", MEDIA_MIMETYPE_VIDEO_AVC);
+    (*format)->setInt32("width", width);
+    (*format)->setInt32("height", height);
+
+    return OK;
+}
+
+static status_t measureLatency(
+        const sp<ALooper> &looper,
+        const char *componentName,
+        const sp<AMessage> &streamFormat,
+        const Vector<sp<ABuffer> > &accessUnits,
+        int64_t frameDurationUs,
+        bool lowLatency,
+        Vector<int64_t> *latenciesUs) {
+    AString mime;
+    CHECK(streamFormat->findString("mime", &mime));
+
+    sp<MediaCodec> codec;
+    if (componentName != NULL) {
+        codec = MediaCodec::CreateByComponentName(looper, componentName);
+    } else {
+        codec = MediaCodec::CreateByType(looper, mime.c_str(), false /* encoder */);
+    }
+
+    if (codec == NULL) {
+        fprintf(stderr, "unable to instantiate a decoder for %s\n", mime.c_str());
+        return UNKNOWN_ERROR;
+    }
+
+    sp<AMessage> format = streamFormat->dup();
+    if (lowLatency) {
+        format->setInt32("low-latency", true);
+    }
+
+    status_t err = codec->configure(
+            format, NULL /* surface */, NULL /* crypto */, 0 /* flags */);
+
+    if (err == OK) {
+        err = codec->start();
+    }
+
+    Vector<sp<ABuffer> > inBuffers;
+    if (err == OK) {
+        err = codec->getInputBuffers(&inBuffers);
+    }
+
+    if (err != OK) {
+        fprintf(stderr, "unable to start the decoder (err=%d)\n", err);
+        codec->release();
+        return err;
+    }
+
+    KeyedVector<int64_t, int64_t> queueTimeUsByTimeUs;
+
+    size_t numQueued = 0;
+    bool sawOutputEOS = false;
+    int64_t startTimeUs = ALooper::GetNowUs();
+    int64_t nextQueueTimeUs = startTimeUs;
+
+    while (err == OK && !sawOutputEOS) {
+        int64_t nowUs = ALooper::GetNowUs();
+        size_t index;
+
+        // Codec specific data isn't paced, it is part of the first frame.
+        while (numQueued <= accessUnits.size() && nowUs >= nextQueueTimeUs) {
+            if (codec->dequeueInputBuffer(&index, 0ll) != OK) {
+                break;
+            }
+
+            const sp<ABuffer> &buffer = inBuffers.itemAt(index);
+            size_t size = 0;
+            int64_t timeUs = 0ll;
+            uint32_t flags = MediaCodec::BUFFER_FLAG_EOS;
+
+            if (numQueued < accessUnits.size()) {
+                const sp<ABuffer> &accessUnit = accessUnits.itemAt(numQueued);
+                CHECK_LE(accessUnit->size(), buffer->capacity());
+
+                size = accessUnit->size();
+                memcpy(buffer->data(), accessUnit->data(), size);
+                CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
+
+                int32_t csd;
+                if (accessUnit->meta()->findInt32("csd", &csd) && csd) {
+                    flags = MediaCodec::BUFFER_FLAG_CODECCONFIG;
+                } else {
+                    flags = 0;
+                    queueTimeUsByTimeUs.add(timeUs, nowUs);
+                    nextQueueTimeUs += frameDurationUs;
+                }
+            }
+
+            err = codec->queueInputBuffer(index, 0 /* offset */, size, timeUs, flags);
+            ++numQueued;
+
+            if (err != OK) {
+                break;
+            }
+        }
+
+        int64_t timeoutUs = nextQueueTimeUs - ALooper::GetNowUs();
+        if (timeoutUs < 0ll || numQueued > accessUnits.size()) {
+            timeoutUs = numQueued > accessUnits.size() ? 10000ll : 0ll;
+        }
+
+        size_t offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+        status_t res = codec->dequeueOutputBuffer(
+                &index, &offset, &size, &timeUs, &flags, timeoutUs);
+
+        if (res == OK) {
+            nowUs = ALooper::GetNowUs();
+
+            ssize_t queueIndex = queueTimeUsByTimeUs.indexOfKey(timeUs);
+            if (queueIndex >= 0 && size > 0) {
+                latenciesUs->push(nowUs - queueTimeUsByTimeUs.valueAt(queueIndex));
+                queueTimeUsByTimeUs.removeItemsAt(queueIndex);
+            }
+
+            sawOutputEOS = (flags & MediaCodec::BUFFER_FLAG_EOS) != 0;
+            err = codec->releaseOutputBuffer(index);
+        } else if (res != -EAGAIN
+                && res != INFO_FORMAT_CHANGED
+                && res != INFO_OUTPUT_BUFFERS_CHANGED) {
+            err = res;
+        }
+    }
+
+    codec->release();
+
+    if (err != OK) {
+        fprintf(stderr, "decoding failed (err=%d)\n", err);
+    }
+
+    return err;
+}
+
+static int compareLatencies(const int64_t *a, const int64_t *b) {
+    return *a < *b ? -1 : (*a > *b ? 1 : 0);
+}
+
+static void printLatencies(const char *mode, Vector<int64_t> *latenciesUs) {
+    if (latenciesUs->isEmpty()) {
+        printf("%-12s no frames decoded\n", mode);
+        return;
+    }
+
+    latenciesUs->sort(compareLatencies);
+
+    size_t n = latenciesUs->size();
+    int64_t totalUs = 0ll;
+    for (size_t i = 0; i < n; ++i) {
+        totalUs += latenciesUs->itemAt(i);
+    }
+
+    printf("%-12s %zu frames, avg %.2f ms, median %.2f ms, "
+           "95%% %.2f ms, max %.2f ms\n",
+           mode, n, totalUs / 1E3 / n,
+           latenciesUs->itemAt(n / 2) / 1E3,
+           latenciesUs->itemAt(n * 95 / 100) / 1E3,
+           latenciesUs->itemAt(n - 1) / 1E3);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    const char *path = NULL;
+    const char *componentName = NULL;
+    int width = 640;
+    int height = 480;
+    int numFrames = 300;
+    int frameRate = 30;
+
+    int res;
+    while ((res = getopt(argc, argv, "?i:c:w:h:n:r:")) >= 0) {
+        switch (res) {
+            case 'i':
+                path = optarg;
+                break;
+
+            case 'c':
+                componentName = optarg;
+                break;
+
+            case 'w':
+                width = atoi(optarg);
+                break;
+
+            case 'h':
+                height = atoi(optarg);
+                break;
+
+            case 'n':
+                numFrames = atoi(optarg);
+                break;
+
+            case 'r':
+                frameRate = atoi(optarg);
+                break;
+
+            case '?':
+            default:
+                usage(me);
+        }
+    }
+
+    if (width <= 0 || height <= 0 || (width & 1) || (height & 1)
+            || numFrames <= 0 || frameRate <= 0) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("decodelatency");
+    looper->start();
+
+    sp<AMessage> format;
+    Vector<sp<ABuffer> > accessUnits;
+
+    status_t err;
+    if (path != NULL) {
+        err = readStream(path, numFrames, &format, &accessUnits);
+    } else {
+        err = encodeStream(
+                looper, width, height, frameRate, numFrames, &format, &accessUnits);
+    }
+
+    if (err != OK) {
+        looper->stop();
+        return 1;
+    }
+
+    AString mime;
+    CHECK(format->findString("mime", &mime));
+    printf("%s, %zu access units at %d fps\n",
+           mime.c_str(), accessUnits.size(), frameRate);
+
+    for (int lowLatency = 0; lowLatency < 2; ++lowLatency) {
+        Vector<int64_t> latenciesUs;
+        if (measureLatency(
+                    looper, componentName, format, accessUnits,
+                    1000000ll / frameRate, lowLatency, &latenciesUs) != OK) {
+            looper->stop();
+            return 1;
+        }
+
+        printLatencies(lowLatency ? "low-latency" : "default", &latenciesUs);
+    }
+
+    looper->stop();
+
+    return 0;
+}
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "netsession"
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include <arpa/inet.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/ANetworkSession.h>
+#include <utils/Vector.h>
+
+// Loopback benchmark for ANetworkSession: opens a number of UDP session
+// pairs and TCP datagram connections, sends timestamped datagrams over all
+// of them and reports the achieved throughput and delivery latency.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-u <number of UDP sessions>]\n"
+                    "\t\t[-t <number of TCP datagram sessions>]\n"
+                    "\t\t[-n <number of rounds>]\n"
+                    "\t\t[-s <datagram size>]\n"
+                    "\t\t[-p <first local port>]\n"
+                    "\t\t[-B] send and receive one datagram per system call\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct BenchReceiver : public AHandler {
+    BenchReceiver();
+
+    void waitForConnections(size_t count);
+
+    // Waits until "count" datagrams have arrived or "timeoutUs" elapsed.
+    size_t waitForDatagrams(size_t count, int64_t timeoutUs);
+
+    void getLatencies(Vector<int64_t> *latenciesUs);
+
+    enum {
+        kWhatNetworkNotify,
+    };
+
+protected:
+    virtual ~BenchReceiver() {}
+
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+
+    size_t mNumConnected;
+    size_t mNumReceived;
+    Vector<int64_t> mLatenciesUs;
+
+    DISALLOW_EVIL_CONSTRUCTORS(BenchReceiver);
+};
+
+BenchReceiver::BenchReceiver()
+    : mNumConnected(0),
+      mNumReceived(0) {
+}
+
+void BenchReceiver::waitForConnections(size_t count) {
+    Mutex::Autolock autoLock(mLock);
+    while (mNumConnected < count) {
+        mCondition.wait(mLock);
+    }
+}
+
+size_t BenchReceiver::waitForDatagrams(size_t count, int64_t timeoutUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    int64_t deadlineUs = ALooper::GetNowUs() + timeoutUs;
+    while (mNumReceived < count) {
+        int64_t nowUs = ALooper::GetNowUs();
+        if (nowUs >= deadlineUs) {
+            break;
+        }
+
+        mCondition.waitRelative(mLock, (deadlineUs - nowUs) * 1000ll);
+    }
+
+    return mNumReceived;
+}
+
+void BenchReceiver::getLatencies(Vector<int64_t> *latenciesUs) {
+    Mutex::Autolock autoLock(mLock);
+    *latenciesUs = mLatenciesUs;
+}
+
+void BenchReceiver::onMessageReceived(const sp<AMessage> &msg) {
+    CHECK_EQ(msg->what(), (uint32_t)kWhatNetworkNotify);
+
+    int32_t reason;
+    CHECK(msg->findInt32("reason", &reason));
+
+    Mutex::Autolock autoLock(mLock);
+
+    switch (reason) {
+        case ANetworkSession::kWhatConnected:
+        {
+            ++mNumConnected;
+            mCondition.signal();
+            break;
+        }
+
+        case ANetworkSession::kWhatDatagram:
+        {
+            sp<ABuffer> data;
+            CHECK(msg->findBuffer("data", &data));
+
+            int64_t arrivalTimeUs;
+            CHECK(data->meta()->findInt64("arrivalTimeUs", &arrivalTimeUs));
+
+            int64_t sendTimeUs;
+            CHECK_GE(data->size(), sizeof(sendTimeUs));
+            memcpy(&sendTimeUs, data->data(), sizeof(sendTimeUs));
+
+            mLatenciesUs.push(arrivalTimeUs - sendTimeUs);
+
+            ++mNumReceived;
+            mCondition.signal();
+            break;
+        }
+
+        case ANetworkSession::kWhatError:
+        {
+            int32_t sessionID, err;
+            CHECK(msg->findInt32("sessionID", &sessionID));
+            CHECK(msg->findInt32("err", &err));
+
+            ALOGE("session %d encountered error %d", sessionID, err);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+}  // namespace android
+
+static int compareLatencies(const int64_t *a, const int64_t *b) {
+    return (*a < *b) ? -1 : (*a > *b) ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    int numUDPSessions = 200;
+    int numTCPSessions = 100;
+    int numRounds = 100;
+    int datagramSize = 1316;  // 7 TS packets
+    int firstPort = 20000;
+    bool useBatchedIO = true;
+
+    int res;
+    while ((res = getopt(argc, argv, "hu:t:n:s:p:B")) >= 0) {
+        switch (res) {
+            case 'u':
+                numUDPSessions = atoi(optarg);
+                break;
+
+            case 't':
+                numTCPSessions = atoi(optarg);
+                break;
+
+            case 'n':
+                numRounds = atoi(optarg);
+                break;
+
+            case 's':
+                datagramSize = atoi(optarg);
+                break;
+
+            case 'p':
+                firstPort = atoi(optarg);
+                break;
+
+            case 'B':
+                useBatchedIO = false;
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (numUDPSessions < 0 || numTCPSessions < 0 || numRounds <= 0
+            || datagramSize < (int)sizeof(int64_t) || datagramSize > 1500) {
+        usage(me);
+    }
+
+    ANetworkSession::SetUseBatchedDatagramIO(useBatchedIO);
+
+    sp<ANetworkSession> senderSession = new ANetworkSession;
+    sp<ANetworkSession> receiverSession = new ANetworkSession;
+    CHECK_EQ(senderSession->start(), (status_t)OK);
+    CHECK_EQ(receiverSession->start(), (status_t)OK);
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("netsession");
+    looper->start();
+
+    sp<BenchReceiver> receiver = new BenchReceiver;
+    looper->registerHandler(receiver);
+
+    sp<AMessage> notify =
+        new AMessage(BenchReceiver::kWhatNetworkNotify, receiver->id());
+
+    Vector<int32_t> senderIDs;
+
+    for (int i = 0; i < numUDPSessions; ++i) {
+        int32_t sessionID;
+        CHECK_EQ(receiverSession->createUDPSession(
+                    firstPort + i, notify, &sessionID),
+                 (status_t)OK);
+
+        CHECK_EQ(senderSession->createUDPSession(
+                    0 /* localPort */, "127.0.0.1", firstPort + i, notify,
+                    &sessionID),
+                 (status_t)OK);
+
+        senderIDs.push(sessionID);
+    }
+
+    if (numTCPSessions > 0) {
+        struct in_addr addr;
+        addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        unsigned port = firstPort + numUDPSessions;
+
+        int32_t serverID;
+        CHECK_EQ(receiverSession->createTCPDatagramSession(
+                    addr, port, notify, &serverID),
+                 (status_t)OK);
+
+        for (int i = 0; i < numTCPSessions; ++i) {
+            int32_t sessionID;
+            CHECK_EQ(senderSession->createTCPDatagramSession(
+                        0 /* localPort */, "127.0.0.1", port, notify,
+                        &sessionID),
+                     (status_t)OK);
+
+            senderIDs.push(sessionID);
+        }
+
+        receiver->waitForConnections(numTCPSessions);
+    }
+
+    printf("%zu sessions (%d UDP, %d TCP), %d byte datagrams, %s I/O\n",
+           senderIDs.size(), numUDPSessions, numTCPSessions, datagramSize,
+           useBatchedIO ? "batched" : "unbatched");
+
+    uint8_t *datagram = new uint8_t[datagramSize];
+    memset(datagram, 0, datagramSize);
+
+    size_t numSent = 0;
+    size_t numReceived = 0;
+    int64_t startTimeUs = ALooper::GetNowUs();
+
+    for (int round = 0; round < numRounds; ++round) {
+        for (size_t i = 0; i < senderIDs.size(); ++i) {
+            int64_t nowUs = ALooper::GetNowUs();
+            memcpy(datagram, &nowUs, sizeof(nowUs));
+
+            status_t err = senderSession->sendRequest(
+                    senderIDs.itemAt(i), datagram, datagramSize);
+
+            if (err == OK) {
+                ++numSent;
+            }
+        }
+
+        // Let each round drain so that lost datagrams don't skew latency.
+        numReceived = receiver->waitForDatagrams(numSent, 100000ll);
+    }
+
+    int64_t elapsedTimeUs = ALooper::GetNowUs() - startTimeUs;
+
+    delete[] datagram;
+    datagram = NULL;
+
+    Vector<int64_t> latenciesUs;
+    receiver->getLatencies(&latenciesUs);
+    latenciesUs.sort(compareLatencies);
+
+    printf("sent %zu, received %zu datagrams in %.2f secs\n",
+           numSent, numReceived, elapsedTimeUs / 1E6);
+
+    printf("%.0f datagrams/sec, %.2f MB/sec\n",
+           numReceived * 1E6 / elapsedTimeUs,
+           (double)numReceived * datagramSize / elapsedTimeUs);
+
+    if (!latenciesUs.isEmpty()) {
+        size_t n = latenciesUs.size();
+        printf("latency (us): min %" PRId64 ", median %" PRId64
+               ", 99th %" PRId64 ", max %" PRId64 "\n",
+               latenciesUs.itemAt(0),
+               latenciesUs.itemAt(n / 2),
+               latenciesUs.itemAt(n * 99 / 100),
+               latenciesUs.itemAt(n - 1));
+    }
+
+    looper->unregisterHandler(receiver->id());
+    looper->stop();
+
+    senderSession->stop();
+    receiverSession->stop();
+
+    return 0;
+}
@@ -80,6 +80,12 @@ class CameraMetadata {
      */
     void clear();
 
+    /**
+     * Remove all entries but keep the storage, so that the buffer can be
+     * filled again without reallocating
+     */
+    void clearEntries();
+
     /**
      * Acquire a raw metadata buffer from the caller. After this call,
      * the caller no longer owns the raw buffer, and must not free or manipulate it.
@@ -210,6 +216,46 @@ class CameraMetadata {
     camera_metadata_t *mBuffer;
     bool               mLocked;
 
+    /**
+     * Side table from tag to entry index, so that finding a tag doesn't scan
+     * the buffer. Built on demand once the buffer has been searched
+     * kTagIndexMinLookups times since its entries last moved, and dropped
+     * whenever entries are removed, reordered or replaced wholesale. Const
+     * lookups may build it, so it is published atomically to keep concurrent
+     * readers of a shared object safe.
+     */
+    struct TagIndex;
+    mutable TagIndex  *mTagIndex;
+    mutable int32_t    mLookupsSinceChange;
+
+    static const int32_t kTagIndexMinLookups = 4;
+
+    /**
+     * Index of the first entry with the given tag, or NAME_NOT_FOUND
+     */
+    ssize_t findIndex(uint32_t tag) const;
+
+    /**
+     * Allocate a tag index for the current contents of the buffer
+     */
+    TagIndex *buildTagIndex() const;
+
+    /**
+     * Record a newly added last entry in the tag index, if there is one
+     */
+    void addToTagIndex(uint32_t tag, size_t index);
+
+    /**
+     * Drop the tag index after entries were removed, moved or replaced
+     */
+    void invalidateTagIndex();
+
+    /**
+     * Check if the entries are already in strictly increasing tag order, in
+     * which case sorting does not move any of them
+     */
+    bool isSorted() const;
+
     /**
      * Check if tag has a given type
      */
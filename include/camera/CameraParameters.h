@@ -535,6 +535,14 @@ public:
     // Example values: "lowlight,hdr".
     static const char KEY_LIGHTFX[];
 
+    // Whether a light special effect capture delivers every image of its
+    // burst. Example value: "true" or "false". Default value is "false":
+    // takePicture() gets a single jpeg callback, as without KEY_LIGHTFX. If
+    // "true", each image goes to the jpeg callback as it is ready and the
+    // capture ends with the last one; the camera stays in still capture
+    // until then, so startPreview() must wait for that last callback.
+    static const char KEY_LIGHTFX_ALL_IMAGES[];
+
     // Value for KEY_ZOOM_SUPPORTED or KEY_SMOOTH_ZOOM_SUPPORTED.
     static const char TRUE[];
     static const char FALSE[];
@@ -104,7 +104,7 @@ private:
     MediaCodecInfo(AString name, bool encoder, const char *mime);
     void addQuirk(const char *name);
     status_t addMime(const char *mime);
-    status_t initializeCapabilities(const CodecCapabilities &caps);
+    status_t initializeCapabilities(const char *mime, const CodecCapabilities &caps);
     void addDetail(const AString &key, const AString &value);
     void addFeature(const AString &key, int32_t value);
     void addFeature(const AString &key, const char *value);
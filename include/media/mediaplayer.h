@@ -162,7 +162,22 @@ enum media_parameter_keys {
     KEY_PARAMETER_PLAYBACK_RATE_PERMILLE = 1300,                // set only
 
     // Set a Parcel containing the value of a parcelled Java AudioAttribute instance
-    KEY_PARAMETER_AUDIO_ATTRIBUTES = 1400                       // set only
+    KEY_PARAMETER_AUDIO_ATTRIBUTES = 1400,                      // set only
+
+    // How subsequent seekTo() calls pick the frame to resume at, saved as int32_t:
+    // 0 previous sync frame (default), 2 closest sync frame, 3 exact frame.
+    KEY_PARAMETER_SEEK_MODE = 1500,                             // set only
+
+    // Return a Parcel describing playback quality since start:
+    //   int64_t video frames queued to the decoder, int64_t of those dropped before decoding,
+    //   int64_t video frames rendered, int64_t video frames dropped for being late,
+    //   int32_t audio sink underruns,
+    //   int32_t N, followed by N pairs of the exclusive upper bound of an A/V offset bucket
+    //     in ms as int32_t (0x7fffffff for the last one) and the int64_t number of rendered
+    //     video frames that were shown that far from the audio clock (positive is late),
+    //   int32_t M, followed by M tracks of String16 mime, int64_t frames decoded and
+    //     int64_t average and maximum decode latency in us.
+    KEY_PARAMETER_PLAYBACK_STATS = 1600                         // get only
 };
 
 // Keep INVOKE_ID_* in sync with MediaPlayer.java.
@@ -220,6 +220,12 @@ private:
 
     bool mTunneled;
 
+    // Video decoding for interactive streams, see configureCodec().
+    bool mLowLatency;
+    // nBufferCountActual of each port before low latency mode trimmed it,
+    // 0 if untouched. Put back once the component is configured without.
+    OMX_U32 mUntrimmedBufferCount[2];
+
     status_t setCyclicIntraMacroblockRefresh(const sp<AMessage> &msg, int32_t mode);
     status_t allocateBuffersOnPort(OMX_U32 portIndex);
     status_t freeBuffersOnPort(OMX_U32 portIndex);
@@ -294,6 +300,10 @@ private:
             OMX_U32 portIndex, int32_t sampleRate, int32_t numChannels);
 
     status_t setMinBufferSize(OMX_U32 portIndex, size_t size);
+    status_t setMinBufferCount(OMX_PARAM_PORTDEFINITIONTYPE *def);
+    status_t restoreBufferCount(OMX_PARAM_PORTDEFINITIONTYPE *def);
+    status_t setBooleanExtension(const char *name, bool enable);
+    status_t setU32Extension(const char *name, OMX_U32 value);
 
     status_t setupMPEG4EncoderParameters(const sp<AMessage> &msg);
     status_t setupH263EncoderParameters(const sp<AMessage> &msg);
@@ -60,6 +60,27 @@ struct MediaCodec : public AHandler {
     static sp<MediaCodec> CreateByComponentName(
             const sp<ALooper> &looper, const char *name, status_t *err = NULL);
 
+    // Whether codecs created from now on hand out available buffers to
+    // dequeueInputBuffer/dequeueOutputBuffer without a round trip to their
+    // looper. Enabled by default, mostly for benchmarking.
+    static void SetUseFastDequeue(bool use);
+
+    // Keep the components of released codecs allocated for up to |ttlUs|
+    // and hand them to the next codec created for the same component, or
+    // for a type they support. 0 disables pooling and frees pooled codecs.
+    // Defaults to the "media.stagefright.codec-pool-ms" property.
+    static void SetCodecPoolTTL(int64_t ttlUs);
+
+    // One buffer of a batched queue or dequeue call. Input buffers being
+    // dequeued only fill in mIndex.
+    struct BufferDescriptor {
+        size_t mIndex;
+        size_t mOffset;
+        size_t mSize;
+        int64_t mTimeUs;
+        uint32_t mFlags;
+    };
+
     status_t configure(
             const sp<AMessage> &format,
             const sp<Surface> &nativeWindow,
@@ -120,6 +141,28 @@ struct MediaCodec : public AHandler {
     status_t renderOutputBufferAndRelease(size_t index);
     status_t releaseOutputBuffer(size_t index);
 
+    // Batched variants of the calls above, each costing at most one round
+    // trip to the looper. queueInputBuffers and releaseOutputBuffers stop at
+    // the first buffer that fails and return its error, |*numDone| is the
+    // number of buffers handled before that. The dequeue variants wait up to
+    // |timeoutUs| for the first buffer and then return whatever else is
+    // available right away, at most |maxCount| in total, or the same error
+    // and INFO_ codes as their single buffer counterparts if they return none.
+    status_t queueInputBuffers(
+            const BufferDescriptor *buffers, size_t count, size_t *numDone,
+            AString *errorDetailMsg = NULL);
+
+    status_t dequeueInputBuffers(
+            size_t *indices, size_t maxCount, size_t *count,
+            int64_t timeoutUs = 0ll);
+
+    status_t dequeueOutputBuffers(
+            BufferDescriptor *buffers, size_t maxCount, size_t *count,
+            int64_t timeoutUs = 0ll);
+
+    status_t releaseOutputBuffers(
+            const size_t *indices, size_t count, bool render, size_t *numDone);
+
     status_t signalEndOfInputStream();
 
     status_t getOutputFormat(sp<AMessage> *format) const;
@@ -176,8 +219,10 @@ private:
         kWhatRelease                        = 'rele',
         kWhatDequeueInputBuffer             = 'deqI',
         kWhatQueueInputBuffer               = 'queI',
+        kWhatQueueInputBuffers              = 'qeIs',
         kWhatDequeueOutputBuffer            = 'deqO',
         kWhatReleaseOutputBuffer            = 'relO',
+        kWhatReleaseOutputBuffers           = 'rlOs',
         kWhatSignalEndOfInputStream         = 'eois',
         kWhatGetBuffers                     = 'getB',
         kWhatFlush                          = 'flus',
@@ -206,6 +251,7 @@ private:
         kFlagGatherCodecSpecificData    = 512,
         kFlagIsAsync                    = 1024,
         kFlagIsComponentAllocated       = 2048,
+        kFlagReturnToPool               = 4096,
     };
 
     struct BufferInfo {
@@ -217,6 +263,8 @@ private:
         bool mOwnedByClient;
     };
 
+    struct FastDequeueRing;
+
     State mState;
     sp<ALooper> mLooper;
     sp<ALooper> mCodecLooper;
@@ -248,6 +296,15 @@ private:
     List<size_t> mAvailPortBuffers[2];
     Vector<BufferInfo> mPortBuffers[2];
 
+    // In synchronous mode available buffers are dequeued on the looper as
+    // they come in and published to a lock-free single producer/single
+    // consumer ring, which the client's dequeue calls pop from directly.
+    // Consumers are serialized by |mFastDequeueLock|, the client only ever
+    // try-locks it and falls back to the looper if it is contended.
+    bool mUseFastDequeue;
+    FastDequeueRing *mFastDequeueRing[2];
+    Mutex mFastDequeueLock[2];
+
     int32_t mDequeueInputTimeoutGeneration;
     uint32_t mDequeueInputReplyID;
 
@@ -271,6 +328,7 @@ private:
 
     status_t init(const AString &name, bool nameIsType, bool encoder);
 
+    void onComponentAllocated(const AString &componentName);
     void setState(State newState);
     void returnBuffersToCodec();
     void returnBuffersToCodecOnPort(int32_t portIndex);
@@ -278,6 +336,12 @@ private:
     status_t onQueueInputBuffer(const sp<AMessage> &msg);
     status_t onReleaseOutputBuffer(const sp<AMessage> &msg);
     ssize_t dequeuePortBuffer(int32_t portIndex);
+    void fillDequeuedBuffer(int32_t portIndex, size_t index, BufferDescriptor *dequeued) const;
+
+    bool popFastDequeuedBuffer(int32_t portIndex, BufferDescriptor *dequeued, bool mayBlock);
+    void publishFastDequeueBuffers(int32_t portIndex);
+    void reclaimFastDequeueBuffers(int32_t portIndex);
+    void reclaimFastDequeueBuffers();
 
     status_t getBufferAndFormat(
             size_t portIndex, size_t index,
@@ -316,6 +380,7 @@ private:
     inline void setStickyError(status_t err) {
         mFlags |= kFlagStickyError;
         mStickyError = err;
+        reclaimFastDequeueBuffers();
     }
 
     DISALLOW_EVIL_CONSTRUCTORS(MediaCodec);
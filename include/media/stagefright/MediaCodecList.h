@@ -27,12 +27,14 @@
 #include <sys/types.h>
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
+#include <utils/threads.h>
 #include <utils/Vector.h>
 #include <utils/StrongPointer.h>
 
 namespace android {
 
 struct AMessage;
+struct Parcel;
 
 struct MediaCodecList : public BnMediaCodecList {
     static sp<IMediaCodecList> getInstance();
@@ -63,6 +65,10 @@ private:
         SECTION_INCLUDE,
     };
 
+    // A component capability query, deferred until the whole XML is parsed
+    // so that all of them can run concurrently.
+    struct CapabilityQuery;
+
     static sp<IMediaCodecList> sCodecList;
     static sp<IMediaCodecList> sRemoteList;
 
@@ -76,6 +82,10 @@ private:
     sp<MediaCodecInfo> mCurrentInfo;
     sp<IOMX> mOMX;
 
+    Vector<CapabilityQuery *> mQueries;
+    Mutex mQueryLock;
+    size_t mNextQuery;
+
     MediaCodecList();
     ~MediaCodecList();
 
@@ -102,6 +112,13 @@ private:
     void addType(const char *name);
 
     status_t initializeCapabilities(const char *type);
+    void queryCapabilities();
+    void runQueries();
+    static void *QueryThreadWrapper(void *me);
+
+    status_t makeCacheKey(const char *codecs_xml, Parcel *key) const;
+    status_t readCache(const Parcel &key);
+    void writeCache(const Parcel &key) const;
 
     DISALLOW_EVIL_CONSTRUCTORS(MediaCodecList);
 };
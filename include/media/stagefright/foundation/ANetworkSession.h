@@ -20,7 +20,9 @@
 
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/KeyedVector.h>
+#include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/SortedVector.h>
 #include <utils/Thread.h>
 
 #include <netinet/in.h>
@@ -31,6 +33,8 @@ struct AMessage;
 
 // Helper class to manage a number of live sockets (datagram and stream-based)
 // on a single thread. Clients are notified about activity through AMessages.
+// Socket readiness is tracked with epoll, so the cost of each iteration of
+// the network thread depends on the number of active sessions only.
 struct ANetworkSession : public RefBase {
     ANetworkSession();
 
@@ -79,6 +83,11 @@ struct ANetworkSession : public RefBase {
 
     status_t switchToWebSocketMode(int32_t sessionID);
 
+    // Datagram sessions receive and send up to 16 datagrams per system
+    // call (recvmmsg/sendmmsg) where the kernel supports it. Disabling this
+    // is primarily useful for benchmarking.
+    static void SetUseBatchedDatagramIO(bool enable);
+
     enum NotificationReason {
         kWhatError,
         kWhatConnected,
@@ -96,6 +105,7 @@ protected:
 private:
     struct NetworkThread;
     struct Session;
+    struct DatagramBatch;
 
     Mutex mLock;
     sp<Thread> mThread;
@@ -103,9 +113,15 @@ private:
     int32_t mNextSessionID;
 
     int mPipeFd[2];
+    int mEpollFd;
+
+    DatagramBatch *mDatagramBatch;
 
     KeyedVector<int32_t, sp<Session> > mSessions;
 
+    // Sessions that had output queued since the network thread last ran.
+    SortedVector<int32_t> mPendingWriteSessions;
+
     enum Mode {
         kModeCreateUDPSession,
         kModeCreateTCPDatagramSessionPassive,
@@ -125,6 +141,12 @@ private:
     void threadLoop();
     void interrupt();
 
+    status_t createEpoll();
+    status_t registerSession_l(const sp<Session> &session);
+
+    void acceptClients_l(
+            const sp<Session> &session, List<sp<Session> > *sessionsToAdd);
+
     static status_t MakeSocketNonBlocking(int s);
 
     DISALLOW_EVIL_CONSTRUCTORS(ANetworkSession);
@@ -145,6 +145,31 @@ media_status_t AMediaCodec_queueSecureInputBuffer(AMediaCodec*,
 ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec*, AMediaCodecBufferInfo *info, int64_t timeoutUs);
 AMediaFormat* AMediaCodec_getOutputFormat(AMediaCodec*);
 
+/**
+ * Send several buffers to the codec at once, info[i] describing the data in the buffer
+ * with index indices[i]. Returns the number of buffers queued, which is less than count
+ * only if queueing the next one failed, or an error if none could be queued.
+ */
+ssize_t AMediaCodec_queueInputBuffers(AMediaCodec*,
+        const size_t *indices, const AMediaCodecBufferInfo *info, size_t count);
+
+/**
+ * Get the indices of up to maxCount available input buffers, waiting at most timeoutUs for
+ * the first one. Returns the number of indices stored, or the same result as
+ * dequeueInputBuffer if there are none.
+ */
+ssize_t AMediaCodec_dequeueInputBuffers(AMediaCodec*,
+        size_t *indices, size_t maxCount, int64_t timeoutUs);
+
+/**
+ * Get up to maxCount buffers of processed data, waiting at most timeoutUs for the first one.
+ * Returns the number of buffers stored in indices and info, or the same result as
+ * dequeueOutputBuffer if there are none.
+ */
+ssize_t AMediaCodec_dequeueOutputBuffers(AMediaCodec*,
+        size_t *indices, AMediaCodecBufferInfo *info, size_t maxCount, int64_t timeoutUs);
+
+
 /**
  * If you are done with a buffer, use this call to return the buffer to
  * the codec. If you previously specified a surface when configuring this
@@ -152,6 +177,14 @@ AMediaFormat* AMediaCodec_getOutputFormat(AMediaCodec*);
  */
 media_status_t AMediaCodec_releaseOutputBuffer(AMediaCodec*, size_t idx, bool render);
 
+/**
+ * Return several buffers to the codec at once, optionally rendering them. Returns the
+ * number of buffers released, which is less than count only if releasing the next one
+ * failed, or an error if none could be released.
+ */
+ssize_t AMediaCodec_releaseOutputBuffers(AMediaCodec*,
+        const size_t *indices, size_t count, bool render);
+
 /**
  * If you are done with a buffer, use this call to update its surface timestamp
  * and return it to the codec to render it on the output surface. If you
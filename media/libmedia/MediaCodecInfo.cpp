@@ -214,9 +214,18 @@ void MediaCodecInfo::removeMime(const char *mime) {
     }
 }
 
-status_t MediaCodecInfo::initializeCapabilities(const CodecCapabilities &caps) {
-    mCurrentCaps->mProfileLevels.clear();
-    mCurrentCaps->mColorFormats.clear();
+// Capabilities are queried once the XML is fully parsed, keep the details
+// that came from it.
+status_t MediaCodecInfo::initializeCapabilities(
+        const char *mime, const CodecCapabilities &caps) {
+    ssize_t ix = getCapabilityIndex(mime);
+    if (ix < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    const sp<Capabilities> &dst = mCaps.valueAt(ix);
+    dst->mProfileLevels.clear();
+    dst->mColorFormats.clear();
 
     for (size_t i = 0; i < caps.mProfileLevels.size(); ++i) {
         const CodecProfileLevel &src = caps.mProfileLevels.itemAt(i);
@@ -224,15 +233,14 @@ status_t MediaCodecInfo::initializeCapabilities(const CodecCapabilities &caps) {
         ProfileLevel profileLevel;
         profileLevel.mProfile = src.mProfile;
         profileLevel.mLevel = src.mLevel;
-        mCurrentCaps->mProfileLevels.push_back(profileLevel);
+        dst->mProfileLevels.push_back(profileLevel);
     }
 
     for (size_t i = 0; i < caps.mColorFormats.size(); ++i) {
-        mCurrentCaps->mColorFormats.push_back(caps.mColorFormats.itemAt(i));
+        dst->mColorFormats.push_back(caps.mColorFormats.itemAt(i));
     }
 
-    mCurrentCaps->mFlags = caps.mFlags;
-    mCurrentCaps->mDetails = new AMessage;
+    dst->mFlags = caps.mFlags;
 
     return OK;
 }
@@ -322,17 +322,27 @@ nsecs_t VideoFrameScheduler::PLL::addSample(nsecs_t time) {
 
 static const nsecs_t kDefaultVsyncPeriod = kNanosIn1s / 60;  // 60Hz
 static const nsecs_t kVsyncRefreshPeriod = kNanosIn1s;       // 1 sec
+static const int64_t kCadenceRestartThresholdDiv = 100;     // 1%
+static const int64_t kCadencePhaseFilterDiv = 16;
 
 VideoFrameScheduler::VideoFrameScheduler()
     : mVsyncTime(0),
       mVsyncPeriod(0),
       mVsyncRefreshAt(0),
+      mFixedVsync(false),
+      mPacingMode(PACING_ADJUST),
+      mCadencePeriod(-1),
+      mCadenceStartTime(-1),
       mLastVsyncTime(-1),
       mTimeCorrection(0) {
 }
 
 void VideoFrameScheduler::updateVsync() {
     mVsyncRefreshAt = systemTime(SYSTEM_TIME_MONOTONIC) + kVsyncRefreshPeriod;
+    if (mFixedVsync) {
+        return;
+    }
+
     mVsyncPeriod = 0;
     mVsyncTime = 0;
 
@@ -364,13 +374,26 @@ void VideoFrameScheduler::init(float videoFps) {
 
     mLastVsyncTime = -1;
     mTimeCorrection = 0;
+    mCadenceStartTime = -1;
 
     mPll.reset(videoFps);
 }
 
+void VideoFrameScheduler::setPacingMode(PacingMode mode) {
+    mPacingMode = mode;
+    mCadenceStartTime = -1;
+}
+
+void VideoFrameScheduler::setFixedVsync(nsecs_t vsyncTime, nsecs_t vsyncPeriod) {
+    mFixedVsync = true;
+    mVsyncTime = vsyncTime;
+    mVsyncPeriod = vsyncPeriod;
+}
+
 void VideoFrameScheduler::restart() {
     mLastVsyncTime = -1;
     mTimeCorrection = 0;
+    mCadenceStartTime = -1;
 
     mPll.restart();
 }
@@ -407,6 +430,13 @@ nsecs_t VideoFrameScheduler::schedule(nsecs_t renderTime) {
     renderTime -= mVsyncPeriod / 2;
 
     const nsecs_t videoPeriod = mPll.addSample(origRenderTime);
+    if (mPacingMode == PACING_CADENCE && videoPeriod > 0) {
+        renderTime = scheduleCadence(origRenderTime, videoPeriod);
+        ALOGV("cadence render: %lld => %lld", (long long)origRenderTime, (long long)renderTime);
+        ATRACE_INT("FRAME_FLIP_IN(ms)", (renderTime - now) / 1000000);
+        return renderTime;
+    }
+
     if (videoPeriod > 0) {
         // Smooth out rendering
         size_t N = 12;
@@ -470,6 +500,51 @@ nsecs_t VideoFrameScheduler::schedule(nsecs_t renderTime) {
     return renderTime;
 }
 
+// Places frame N of the cadence on the VSYNC closest to N video periods
+// after the cadence start. Unlike adjusting each render time individually,
+// this yields a pattern that only depends on the ratio of the video and
+// display rates (e.g. 3:2 for 24fps on 60Hz, 2:2 for 30fps), so timestamp
+// noise does not turn into judder.
+nsecs_t VideoFrameScheduler::scheduleCadence(nsecs_t renderTime, nsecs_t videoPeriod) {
+    nsecs_t idealTime = -1;
+
+    if (mCadenceStartTime >= 0 && renderTime >= mCadenceStartTime) {
+        int64_t frame = divRound(renderTime - mCadenceStartTime, mCadencePeriod);
+
+        if (abs(videoPeriod - mCadencePeriod) > mCadencePeriod / kCadenceRestartThresholdDiv) {
+            // new period estimate: continue from this frame
+            mCadenceStartTime += frame * mCadencePeriod;
+            mCadencePeriod = videoPeriod;
+            frame = 0;
+        }
+
+        idealTime = mCadenceStartTime + frame * mCadencePeriod;
+
+        nsecs_t error = renderTime - idealTime;
+        if (abs(error) > mVsyncPeriod * 3 / 2) {
+            // discontinuity or the media clock drifted away from the cadence
+            ALOGV("cadence off by %lld, restarting", (long long)error);
+            idealTime = -1;
+        } else {
+            // follow slow drift of the media clock without passing noise on
+            mCadenceStartTime += error / kCadencePhaseFilterDiv;
+            idealTime += error / kCadencePhaseFilterDiv;
+        }
+    }
+
+    if (idealTime < 0) {
+        mCadencePeriod = videoPeriod;
+        mCadenceStartTime = renderTime;
+        idealTime = renderTime;
+    }
+
+    nsecs_t vsyncTime =
+        mVsyncTime + divRound(idealTime - mVsyncTime, mVsyncPeriod) * mVsyncPeriod;
+
+    // frames are shown at the first VSYNC after their render time
+    return vsyncTime - mVsyncPeriod / 2;
+}
+
 void VideoFrameScheduler::release() {
     mComposer.clear();
 }
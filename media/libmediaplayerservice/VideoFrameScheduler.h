@@ -27,10 +27,22 @@ namespace android {
 struct ISurfaceComposer;
 
 struct VideoFrameScheduler : public RefBase {
+    enum PacingMode {
+        // nudge render times towards the middle between VSYNCs
+        PACING_ADJUST,
+        // present frames on a fixed pattern of VSYNCs derived from the
+        // estimated video period, e.g. 3:2 for 24fps on a 60Hz display
+        PACING_CADENCE,
+    };
+
     VideoFrameScheduler();
 
     // (re)initialize scheduler
     void init(float videoFps = -1);
+    void setPacingMode(PacingMode mode);
+    // use the given display timing instead of querying the display, e.g.
+    // for simulations
+    void setFixedVsync(nsecs_t vsyncTime, nsecs_t vsyncPeriod);
     // use in case of video render-time discontinuity, e.g. seek
     void restart();
     // get adjusted nanotime for a video frame render at renderTime
@@ -78,10 +90,16 @@ private:
     };
 
     void updateVsync();
+    nsecs_t scheduleCadence(nsecs_t renderTime, nsecs_t videoPeriod);
 
     nsecs_t mVsyncTime;        // vsync timing from display
     nsecs_t mVsyncPeriod;
     nsecs_t mVsyncRefreshAt;   // next time to refresh timing info
+    bool mFixedVsync;          // vsync timing was set by setFixedVsync
+
+    PacingMode mPacingMode;
+    nsecs_t mCadencePeriod;     // video period the cadence was set up for
+    nsecs_t mCadenceStartTime;  // filtered render time of the frame at the cadence start
 
     nsecs_t mLastVsyncTime;    // estimated vsync time for last frame
     nsecs_t mTimeCorrection;   // running adjustment
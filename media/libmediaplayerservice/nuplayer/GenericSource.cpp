@@ -21,9 +21,11 @@
 
 #include "AnotherPacketSource.h"
 
+#include <cutils/properties.h>
 #include <media/IMediaHTTPService.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
@@ -40,6 +42,34 @@
 
 namespace android {
 
+// Reads a single track on a looper of its own, so that a slow read from
+// one track (e.g. a large video sync frame that is not cached yet) doesn't
+// hold up refilling the other.
+struct NuPlayer::GenericSource::TrackReader : public AHandler {
+    TrackReader(GenericSource *source)
+        : mSource(source) {
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        CHECK_EQ(msg->what(), (uint32_t)kWhatReadBuffer);
+        mSource->onReadBuffer(msg);
+    }
+
+private:
+    // Outlives us, the reader is unregistered before the source goes away.
+    GenericSource *mSource;
+
+    DISALLOW_EVIL_CONSTRUCTORS(TrackReader);
+};
+
+NuPlayer::GenericSource::Track::Track()
+    : mIndex(0),
+      mNumReads(0),
+      mTotalReadTimeUs(0ll),
+      mMaxReadTimeUs(0ll) {
+}
+
 NuPlayer::GenericSource::GenericSource(
         const sp<AMessage> &notify,
         bool uidValid,
@@ -56,14 +86,30 @@ NuPlayer::GenericSource::GenericSource(
       mMetaDataSize(-1ll),
       mBitrate(-1ll),
       mPollBufferingGeneration(0),
-      mPendingReadBufferTypes(0) {
+      mPendingReadBufferTypes(0),
+      mUseTrackReaders(false),
+      mReadAheadUs(-1ll) {
     resetDataSource();
     DataSource::RegisterDefaultSniffers();
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.generic.track-readers", value, NULL)) {
+        mUseTrackReaders = !strcmp("1", value) || !strcasecmp("true", value);
+    }
+    if (property_get("media.generic.read-ahead-us", value, NULL)) {
+        mReadAheadUs = strtoll(value, NULL, 10);
+    }
 }
 
 void NuPlayer::GenericSource::resetDataSource() {
-    mAudioTimeUs = 0;
-    mVideoTimeUs = 0;
+    {
+        Mutex::Autolock autoLock(mAudioTrack.mLock);
+        mAudioTimeUs = 0;
+    }
+    {
+        Mutex::Autolock autoLock(mVideoTrack.mLock);
+        mVideoTimeUs = 0;
+    }
     mHTTPService.clear();
     mHttpSource.clear();
     mUri.clear();
@@ -75,7 +121,7 @@ void NuPlayer::GenericSource::resetDataSource() {
     mDecryptHandle = NULL;
     mDrmManagerClient = NULL;
     mStarted = false;
-    mStopRead = true;
+    setStopRead(true);
 }
 
 status_t NuPlayer::GenericSource::setDataSource(
@@ -246,13 +292,28 @@ void NuPlayer::GenericSource::checkDrmStatus(const sp<DataSource>& dataSource) {
 }
 
 int64_t NuPlayer::GenericSource::getLastReadPosition() {
-    if (mAudioTrack.mSource != NULL) {
-        return mAudioTimeUs;
-    } else if (mVideoTrack.mSource != NULL) {
+    {
+        Mutex::Autolock autoLock(mAudioTrack.mLock);
+        if (mAudioTrack.mSource != NULL) {
+            return mAudioTimeUs;
+        }
+    }
+
+    Mutex::Autolock autoLock(mVideoTrack.mLock);
+    if (mVideoTrack.mSource != NULL) {
         return mVideoTimeUs;
-    } else {
-        return 0;
     }
+    return 0;
+}
+
+bool NuPlayer::GenericSource::isReadStopped() const {
+    Mutex::Autolock _l(mReadBufferLock);
+    return mStopRead;
+}
+
+void NuPlayer::GenericSource::setStopRead(bool stop) {
+    Mutex::Autolock _l(mReadBufferLock);
+    mStopRead = stop;
 }
 
 status_t NuPlayer::GenericSource::setBuffers(
@@ -264,6 +325,11 @@ status_t NuPlayer::GenericSource::setBuffers(
 }
 
 NuPlayer::GenericSource::~GenericSource() {
+    stopTrackReaders();
+
+    logReadStats("audio", mAudioTrack);
+    logReadStats("video", mVideoTrack);
+
     if (mLooper != NULL) {
         mLooper->unregisterHandler(id());
         mLooper->stop();
@@ -348,6 +414,12 @@ void NuPlayer::GenericSource::onPrepareAsync() {
         return;
     }
 
+    // Widevine sources are always read on this looper, so that their
+    // stop handling and mIsWidevine stay off the reader loopers.
+    if (mUseTrackReaders && !mIsWidevine) {
+        startTrackReaders();
+    }
+
     if (mVideoTrack.mSource != NULL) {
         sp<MetaData> meta = doGetFormatMeta(false /* audio */);
         sp<AMessage> msg = new AMessage;
@@ -456,7 +528,7 @@ status_t NuPlayer::GenericSource::prefillCacheIfNecessary() {
 void NuPlayer::GenericSource::start() {
     ALOGI("start");
 
-    mStopRead = false;
+    setStopRead(false);
     if (mAudioTrack.mSource != NULL) {
         CHECK_EQ(mAudioTrack.mSource->start(), (status_t)OK);
 
@@ -637,12 +709,15 @@ void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
           }
 
 
-          if (track->mSource != NULL) {
-              track->mSource->stop();
+          {
+              Mutex::Autolock autoLock(track->mLock);
+              if (track->mSource != NULL) {
+                  track->mSource->stop();
+              }
+              track->mSource = source;
+              track->mSource->start();
+              track->mIndex = trackIndex;
           }
-          track->mSource = source;
-          track->mSource->start();
-          track->mIndex = trackIndex;
 
           status_t avail;
           if (!track->mPackets->hasBufferAvailable(&avail)) {
@@ -655,8 +730,10 @@ void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
           const bool formatChange = true;
           sp<AMessage> latestMeta = track->mPackets->getLatestEnqueuedMeta();
           CHECK(latestMeta != NULL && latestMeta->findInt64("timeUs", &timeUs));
-          readBuffer(trackType, timeUs, &actualTimeUs, formatChange);
-          readBuffer(counterpartType, -1, NULL, formatChange);
+          readBuffer(trackType, timeUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC,
+                  &actualTimeUs, formatChange);
+          readBuffer(counterpartType, -1, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC,
+                  NULL, formatChange);
           ALOGV("timeUs %lld actualTimeUs %lld", timeUs, actualTimeUs);
 
           break;
@@ -705,7 +782,10 @@ void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
       {
           // mStopRead is only used for Widevine to prevent the video source
           // from being read while the associated video decoder is shutting down.
-          mStopRead = true;
+          // Taking the lock makes sure a read in progress on the video
+          // reader looper has completed.
+          Mutex::Autolock autoLock(mVideoTrack.mLock);
+          setStopRead(true);
           if (mVideoTrack.mSource != NULL) {
               mVideoTrack.mPackets->clear();
           }
@@ -743,7 +823,7 @@ void NuPlayer::GenericSource::fetchTextData(
     CHECK(msg->findInt64("timeUs", &timeUs));
 
     int64_t subTimeUs;
-    readBuffer(type, timeUs, &subTimeUs);
+    readBuffer(type, timeUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC, &subTimeUs);
 
     int64_t delayUs = subTimeUs - timeUs;
     if (msg->what() == kWhatFetchSubtitleData) {
@@ -774,7 +854,7 @@ void NuPlayer::GenericSource::sendTextData(
     }
 
     int64_t nextSubTimeUs;
-    readBuffer(type, -1, &nextSubTimeUs);
+    readBuffer(type, -1, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC, &nextSubTimeUs);
 
     sp<ABuffer> buffer;
     status_t dequeueStatus = packets->dequeueAccessUnit(&buffer);
@@ -849,6 +929,10 @@ status_t NuPlayer::GenericSource::dequeueAccessUnit(
 
     if (!track->mPackets->hasBufferAvailable(&finalResult)) {
         postReadBuffer(audio? MEDIA_TRACK_TYPE_AUDIO : MEDIA_TRACK_TYPE_VIDEO);
+    } else if (mReadAheadUs > 0 && !mIsWidevine
+            && track->mPackets->getEstimatedDurationUs() < mReadAheadUs / 2) {
+        // Top up well before running dry.
+        postReadBuffer(audio? MEDIA_TRACK_TYPE_AUDIO : MEDIA_TRACK_TYPE_VIDEO);
     }
 
     if (result != OK) {
@@ -1095,9 +1179,11 @@ status_t NuPlayer::GenericSource::doSelectTrack(size_t trackIndex, bool select)
     return INVALID_OPERATION;
 }
 
-status_t NuPlayer::GenericSource::seekTo(int64_t seekTimeUs) {
+status_t NuPlayer::GenericSource::seekTo(
+        int64_t seekTimeUs, MediaSource::ReadOptions::SeekMode mode) {
     sp<AMessage> msg = new AMessage(kWhatSeek, id());
     msg->setInt64("seekTimeUs", seekTimeUs);
+    msg->setInt32("mode", mode);
 
     sp<AMessage> response;
     status_t err = msg->postAndAwaitResponse(&response);
@@ -1110,10 +1196,12 @@ status_t NuPlayer::GenericSource::seekTo(int64_t seekTimeUs) {
 
 void NuPlayer::GenericSource::onSeek(sp<AMessage> msg) {
     int64_t seekTimeUs;
+    int32_t mode;
     CHECK(msg->findInt64("seekTimeUs", &seekTimeUs));
+    CHECK(msg->findInt32("mode", &mode));
 
     sp<AMessage> response = new AMessage;
-    status_t err = doSeek(seekTimeUs);
+    status_t err = doSeek(seekTimeUs, (MediaSource::ReadOptions::SeekMode)mode);
     response->setInt32("err", err);
 
     uint32_t replyID;
@@ -1121,16 +1209,19 @@ void NuPlayer::GenericSource::onSeek(sp<AMessage> msg) {
     response->postReply(replyID);
 }
 
-status_t NuPlayer::GenericSource::doSeek(int64_t seekTimeUs) {
+status_t NuPlayer::GenericSource::doSeek(
+        int64_t seekTimeUs, MediaSource::ReadOptions::SeekMode mode) {
     // If the Widevine source is stopped, do not attempt to read any
     // more buffers.
-    if (mStopRead) {
+    if (isReadStopped()) {
         return INVALID_OPERATION;
     }
     if (mVideoTrack.mSource != NULL) {
         int64_t actualTimeUs;
-        readBuffer(MEDIA_TRACK_TYPE_VIDEO, seekTimeUs, &actualTimeUs);
+        readBuffer(MEDIA_TRACK_TYPE_VIDEO, seekTimeUs, mode, &actualTimeUs);
 
+        // For SEEK_CLOSEST this is the target itself, audio then starts
+        // right there instead of at the sync frame video is decoded from.
         seekTimeUs = actualTimeUs;
     }
 
@@ -1211,12 +1302,93 @@ sp<ABuffer> NuPlayer::GenericSource::mediaBufferToABuffer(
     return ab;
 }
 
+void NuPlayer::GenericSource::startTrackReaders() {
+    static const struct {
+        media_track_type mType;
+        const char *mName;
+    } kReaders[] = {
+        { MEDIA_TRACK_TYPE_AUDIO, "generic-audio" },
+        { MEDIA_TRACK_TYPE_VIDEO, "generic-video" },
+    };
+
+    for (size_t i = 0; i < sizeof(kReaders) / sizeof(kReaders[0]); ++i) {
+        Track *track = kReaders[i].mType == MEDIA_TRACK_TYPE_AUDIO
+                ? &mAudioTrack : &mVideoTrack;
+
+        if (track->mSource == NULL || track->mReader != NULL) {
+            continue;
+        }
+
+        track->mReaderLooper = new ALooper;
+        track->mReaderLooper->setName(kReaders[i].mName);
+        track->mReaderLooper->start();
+
+        track->mReader = new TrackReader(this);
+        track->mReaderLooper->registerHandler(track->mReader);
+    }
+}
+
+void NuPlayer::GenericSource::stopTrackReaders() {
+    Track *tracks[] = { &mAudioTrack, &mVideoTrack };
+
+    for (size_t i = 0; i < sizeof(tracks) / sizeof(tracks[0]); ++i) {
+        Track *track = tracks[i];
+
+        if (track->mReaderLooper == NULL) {
+            continue;
+        }
+
+        track->mReaderLooper->unregisterHandler(track->mReader->id());
+        track->mReaderLooper->stop();
+
+        track->mReader.clear();
+        track->mReaderLooper.clear();
+    }
+}
+
+void NuPlayer::GenericSource::getReadStats(
+        bool audio, const sp<AMessage> &stats) {
+    Track *track = audio ? &mAudioTrack : &mVideoTrack;
+    Mutex::Autolock autoLock(track->mStatsLock);
+
+    stats->setInt64("reads", track->mNumReads);
+    stats->setInt64("avg-read-latency-us",
+            track->mNumReads == 0
+                ? 0ll : track->mTotalReadTimeUs / track->mNumReads);
+    stats->setInt64("max-read-latency-us", track->mMaxReadTimeUs);
+}
+
+void NuPlayer::GenericSource::logReadStats(
+        const char *name, const Track &track) {
+    Mutex::Autolock autoLock(const_cast<Mutex &>(track.mStatsLock));
+
+    if (track.mNumReads == 0) {
+        return;
+    }
+
+    ALOGI("%s: %lld reads, avg %lld us, max %lld us%s",
+          name,
+          track.mNumReads,
+          track.mTotalReadTimeUs / track.mNumReads,
+          track.mMaxReadTimeUs,
+          mUseTrackReaders ? " (own looper)" : "");
+}
+
 void NuPlayer::GenericSource::postReadBuffer(media_track_type trackType) {
     Mutex::Autolock _l(mReadBufferLock);
 
     if ((mPendingReadBufferTypes & (1 << trackType)) == 0) {
         mPendingReadBufferTypes |= (1 << trackType);
-        sp<AMessage> msg = new AMessage(kWhatReadBuffer, id());
+
+        sp<TrackReader> reader;
+        if (trackType == MEDIA_TRACK_TYPE_AUDIO) {
+            reader = mAudioTrack.mReader;
+        } else if (trackType == MEDIA_TRACK_TYPE_VIDEO) {
+            reader = mVideoTrack.mReader;
+        }
+
+        sp<AMessage> msg = new AMessage(
+                kWhatReadBuffer, reader != NULL ? reader->id() : id());
         msg->setInt32("trackType", trackType);
         msg->post();
     }
@@ -1237,9 +1409,13 @@ void NuPlayer::GenericSource::onReadBuffer(sp<AMessage> msg) {
 }
 
 void NuPlayer::GenericSource::readBuffer(
-        media_track_type trackType, int64_t seekTimeUs, int64_t *actualTimeUs, bool formatChange) {
+        media_track_type trackType,
+        int64_t seekTimeUs,
+        MediaSource::ReadOptions::SeekMode mode,
+        int64_t *actualTimeUs,
+        bool formatChange) {
     // Do not read data if Widevine source is stopped
-    if (mStopRead) {
+    if (isReadStopped()) {
         return;
     }
     Track *track;
@@ -1269,8 +1445,22 @@ void NuPlayer::GenericSource::readBuffer(
             TRESPASS();
     }
 
-    if (track->mSource == NULL) {
-        return;
+    // track->mSource is checked with track->mLock held in the loop below,
+    // since a track may be deselected meanwhile.
+
+    // Plain refills (as opposed to seeks and track changes, whose callers
+    // want to know where the first buffer landed) may fill up the read-ahead
+    // in one go.
+    bool fillReadAhead = mReadAheadUs > 0
+            && !mIsWidevine
+            && seekTimeUs < 0
+            && actualTimeUs == NULL
+            && !formatChange
+            && (trackType == MEDIA_TRACK_TYPE_AUDIO
+                    || trackType == MEDIA_TRACK_TYPE_VIDEO);
+
+    if (fillReadAhead) {
+        maxBuffers = kMaxBuffersPerRead;
     }
 
     if (actualTimeUs) {
@@ -1281,8 +1471,16 @@ void NuPlayer::GenericSource::readBuffer(
 
     bool seeking = false;
 
+    // Frame accurate seeks start decoding at the preceding sync frame and
+    // leave it to the decoder to skip the frames before the target.
+    bool seekToClosestFrame = false;
+
     if (seekTimeUs >= 0) {
-        options.setSeekTo(seekTimeUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+        if (mode == MediaSource::ReadOptions::SEEK_CLOSEST) {
+            seekToClosestFrame = (trackType == MEDIA_TRACK_TYPE_VIDEO);
+            mode = MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC;
+        }
+        options.setSeekTo(seekTimeUs, mode);
         seeking = true;
     }
 
@@ -1291,8 +1489,30 @@ void NuPlayer::GenericSource::readBuffer(
     }
 
     for (size_t numBuffers = 0; numBuffers < maxBuffers; ) {
+        // Only hold the lock for one buffer at a time, so a seek doesn't
+        // have to wait for a whole batch. Buffers are queued with the lock
+        // held and thus can't end up on the wrong side of a discontinuity.
+        Mutex::Autolock autoLock(track->mLock);
+
+        if (isReadStopped() || track->mSource == NULL) {
+            break;
+        }
+
         MediaBuffer *mbuf;
+        int64_t readStartUs = ALooper::GetNowUs();
         status_t err = track->mSource->read(&mbuf, &options);
+        int64_t readTimeUs = ALooper::GetNowUs() - readStartUs;
+
+        {
+            Mutex::Autolock statsLock(track->mStatsLock);
+            ++track->mNumReads;
+            track->mTotalReadTimeUs += readTimeUs;
+            if (readTimeUs > track->mMaxReadTimeUs) {
+                track->mMaxReadTimeUs = readTimeUs;
+            }
+        }
+
+        ALOGV("read from track type %d took %lld us", trackType, readTimeUs);
 
         options.clearSeekTo();
 
@@ -1320,10 +1540,25 @@ void NuPlayer::GenericSource::readBuffer(
             }
 
             sp<ABuffer> buffer = mediaBufferToABuffer(mbuf, trackType, actualTimeUs);
+
+            if (seeking && seekToClosestFrame) {
+                if (timeUs < seekTimeUs) {
+                    buffer->meta()->setInt64("targetTimeUs", seekTimeUs);
+                }
+                if (actualTimeUs) {
+                    *actualTimeUs = seekTimeUs;
+                }
+            }
+
             track->mPackets->queueAccessUnit(buffer);
             formatChange = false;
             seeking = false;
             ++numBuffers;
+
+            if (fillReadAhead
+                    && track->mPackets->getEstimatedDurationUs() >= mReadAheadUs) {
+                break;
+            }
         } else if (err == WOULD_BLOCK) {
             break;
         } else if (err == INFO_FORMAT_CHANGED) {
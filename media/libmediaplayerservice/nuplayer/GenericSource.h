@@ -61,6 +61,8 @@ struct NuPlayer::GenericSource : public NuPlayer::Source {
 
     virtual sp<MetaData> getFileFormatMeta() const;
 
+    virtual void getReadStats(bool audio, const sp<AMessage> &stats);
+
     virtual status_t dequeueAccessUnit(bool audio, sp<ABuffer> *accessUnit);
 
     virtual status_t getDuration(int64_t *durationUs);
@@ -68,7 +70,10 @@ struct NuPlayer::GenericSource : public NuPlayer::Source {
     virtual sp<AMessage> getTrackInfo(size_t trackIndex) const;
     virtual ssize_t getSelectedTrack(media_track_type type) const;
     virtual status_t selectTrack(size_t trackIndex, bool select);
-    virtual status_t seekTo(int64_t seekTimeUs);
+    virtual status_t seekTo(
+            int64_t seekTimeUs,
+            MediaSource::ReadOptions::SeekMode mode =
+                MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
 
     virtual status_t setBuffers(bool audio, Vector<MediaBuffer *> &buffers);
 
@@ -96,18 +101,43 @@ private:
         kWhatStopWidevine,
     };
 
+    enum {
+        // Upper bound on the number of access units a single read message
+        // pulls from a track's source while filling its read-ahead.
+        kMaxBuffersPerRead = 64,
+    };
+
     Vector<sp<MediaSource> > mSources;
 
+    struct TrackReader;
+
     struct Track {
+        Track();
+
         size_t mIndex;
         sp<MediaSource> mSource;
         sp<AnotherPacketSource> mPackets;
+
+        // Serializes reads from and changes to mSource, which may happen
+        // on the track's reader looper as well as on the source's looper.
+        Mutex mLock;
+
+        // Only set if the track is read on a looper of its own.
+        sp<ALooper> mReaderLooper;
+        sp<TrackReader> mReader;
+
+        // MediaSource::read latency, protected by mStatsLock rather than
+        // mLock, which is held across reads.
+        Mutex mStatsLock;
+        int64_t mNumReads;
+        int64_t mTotalReadTimeUs;
+        int64_t mMaxReadTimeUs;
     };
 
     Track mAudioTrack;
-    int64_t mAudioTimeUs;
+    int64_t mAudioTimeUs;  // protected by mAudioTrack.mLock
     Track mVideoTrack;
-    int64_t mVideoTimeUs;
+    int64_t mVideoTimeUs;  // protected by mVideoTrack.mLock
     Track mSubtitleTrack;
     Track mTimedTextTrack;
 
@@ -115,6 +145,7 @@ private:
     int32_t mFetchTimedTextDataGeneration;
     int64_t mDurationUs;
     bool mAudioIsVorbis;
+    // Set while preparing; Widevine sources never use track readers.
     bool mIsWidevine;
     bool mUIDValid;
     uid_t mUID;
@@ -133,7 +164,7 @@ private:
     DrmManagerClient *mDrmManagerClient;
     sp<DecryptHandle> mDecryptHandle;
     bool mStarted;
-    bool mStopRead;
+    bool mStopRead;  // protected by mReadBufferLock
     String8 mContentType;
     AString mSniffedMIME;
     off64_t mMetaDataSize;
@@ -142,6 +173,13 @@ private:
     uint32_t mPendingReadBufferTypes;
     mutable Mutex mReadBufferLock;
 
+    // If set, audio and video are each read on a looper of their own.
+    bool mUseTrackReaders;
+
+    // If positive, reads keep going until this much audio or video is
+    // buffered instead of stopping after a fixed number of buffers.
+    int64_t mReadAheadUs;
+
     sp<ALooper> mLooper;
 
     void resetDataSource();
@@ -149,6 +187,9 @@ private:
     status_t initFromDataSource();
     void checkDrmStatus(const sp<DataSource>& dataSource);
     int64_t getLastReadPosition();
+    // mStopRead is also checked on the track reader loopers
+    bool isReadStopped() const;
+    void setStopRead(bool stop);
     void setDrmPlaybackStatusIfNeeded(int playbackStatus, int64_t position);
 
     status_t prefillCacheIfNecessary();
@@ -165,7 +206,8 @@ private:
     status_t doSelectTrack(size_t trackIndex, bool select);
 
     void onSeek(sp<AMessage> msg);
-    status_t doSeek(int64_t seekTimeUs);
+    status_t doSeek(
+            int64_t seekTimeUs, MediaSource::ReadOptions::SeekMode mode);
 
     void onPrepareAsync();
 
@@ -182,11 +224,19 @@ private:
             media_track_type trackType,
             int64_t *actualTimeUs = NULL);
 
+    void startTrackReaders();
+    void stopTrackReaders();
+    void logReadStats(const char *name, const Track &track);
+
     void postReadBuffer(media_track_type trackType);
     void onReadBuffer(sp<AMessage> msg);
     void readBuffer(
             media_track_type trackType,
-            int64_t seekTimeUs = -1ll, int64_t *actualTimeUs = NULL, bool formatChange = false);
+            int64_t seekTimeUs = -1ll,
+            MediaSource::ReadOptions::SeekMode mode =
+                MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC,
+            int64_t *actualTimeUs = NULL,
+            bool formatChange = false);
 
     void schedulePollBuffering();
     void cancelPollBuffering();
@@ -153,7 +153,8 @@ status_t NuPlayer::HTTPLiveSource::selectTrack(size_t trackIndex, bool select) {
     return (err == OK || err == BAD_VALUE) ? (status_t)OK : err;
 }
 
-status_t NuPlayer::HTTPLiveSource::seekTo(int64_t seekTimeUs) {
+status_t NuPlayer::HTTPLiveSource::seekTo(
+        int64_t seekTimeUs, MediaSource::ReadOptions::SeekMode /* mode */) {
     return mLiveSession->seekTo(seekTimeUs);
 }
 
@@ -64,18 +64,23 @@ private:
 };
 
 struct NuPlayer::SeekAction : public Action {
-    SeekAction(int64_t seekTimeUs, bool needNotify)
+    SeekAction(
+            int64_t seekTimeUs,
+            bool needNotify,
+            MediaSource::ReadOptions::SeekMode mode)
         : mSeekTimeUs(seekTimeUs),
-          mNeedNotify(needNotify) {
+          mNeedNotify(needNotify),
+          mMode(mode) {
     }
 
     virtual void execute(NuPlayer *player) {
-        player->performSeek(mSeekTimeUs, mNeedNotify);
+        player->performSeek(mSeekTimeUs, mNeedNotify, mMode);
     }
 
 private:
     int64_t mSeekTimeUs;
     bool mNeedNotify;
+    MediaSource::ReadOptions::SeekMode mMode;
 
     DISALLOW_EVIL_CONSTRUCTORS(SeekAction);
 };
@@ -324,10 +329,14 @@ void NuPlayer::resetAsync() {
     (new AMessage(kWhatReset, id()))->post();
 }
 
-void NuPlayer::seekToAsync(int64_t seekTimeUs, bool needNotify) {
+void NuPlayer::seekToAsync(
+        int64_t seekTimeUs,
+        bool needNotify,
+        MediaSource::ReadOptions::SeekMode mode) {
     sp<AMessage> msg = new AMessage(kWhatSeek, id());
     msg->setInt64("seekTimeUs", seekTimeUs);
     msg->setInt32("needNotify", needNotify);
+    msg->setInt32("mode", mode);
     msg->post();
 }
 
@@ -427,6 +436,34 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatGetTrackStats:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            Vector<sp<AMessage> > *trackStats;
+            CHECK(msg->findPointer("trackStats", (void**)&trackStats));
+
+            if (mAudioDecoder != NULL) {
+                sp<AMessage> stats = mAudioDecoder->getStats();
+                if (mSource != NULL) {
+                    mSource->getReadStats(true /* audio */, stats);
+                }
+                trackStats->push(stats);
+            }
+            if (mVideoDecoder != NULL) {
+                sp<AMessage> stats = mVideoDecoder->getStats();
+                if (mSource != NULL) {
+                    mSource->getReadStats(false /* audio */, stats);
+                }
+                trackStats->push(stats);
+            }
+
+            sp<AMessage> response = new AMessage;
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatGetSelectedTrack:
         {
             status_t err = INVALID_OPERATION;
@@ -947,18 +984,22 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
         case kWhatSeek:
         {
             int64_t seekTimeUs;
-            int32_t needNotify;
+            int32_t needNotify, mode;
             CHECK(msg->findInt64("seekTimeUs", &seekTimeUs));
             CHECK(msg->findInt32("needNotify", &needNotify));
+            CHECK(msg->findInt32("mode", &mode));
 
-            ALOGV("kWhatSeek seekTimeUs=%lld us, needNotify=%d",
-                    seekTimeUs, needNotify);
+            ALOGV("kWhatSeek seekTimeUs=%lld us, needNotify=%d, mode=%d",
+                    seekTimeUs, needNotify, mode);
 
             mDeferredActions.push_back(
                     new SimpleAction(&NuPlayer::performDecoderFlush));
 
             mDeferredActions.push_back(
-                    new SeekAction(seekTimeUs, needNotify));
+                    new SeekAction(
+                        seekTimeUs,
+                        needNotify,
+                        (MediaSource::ReadOptions::SeekMode)mode));
 
             processDeferredActions();
             break;
@@ -1714,6 +1755,26 @@ void NuPlayer::getStats(int64_t *numFramesTotal, int64_t *numFramesDropped) {
     *numFramesDropped = mNumFramesDropped;
 }
 
+sp<AMessage> NuPlayer::getRendererStats() {
+    sp<Renderer> renderer = mRenderer;
+    if (renderer == NULL) {
+        return NULL;
+    }
+
+    return renderer->getStats();
+}
+
+void NuPlayer::getTrackStats(Vector<sp<AMessage> > *trackStats) {
+    trackStats->clear();
+
+    // The decoders are only stable on our looper
+    sp<AMessage> msg = new AMessage(kWhatGetTrackStats, id());
+    msg->setPointer("trackStats", trackStats);
+
+    sp<AMessage> response;
+    msg->postAndAwaitResponse(&response);
+}
+
 sp<MetaData> NuPlayer::getFileMeta() {
     return mSource->getFileFormatMeta();
 }
@@ -1751,11 +1812,15 @@ void NuPlayer::processDeferredActions() {
     }
 }
 
-void NuPlayer::performSeek(int64_t seekTimeUs, bool needNotify) {
-    ALOGV("performSeek seekTimeUs=%lld us (%.2f secs), needNotify(%d)",
+void NuPlayer::performSeek(
+        int64_t seekTimeUs,
+        bool needNotify,
+        MediaSource::ReadOptions::SeekMode mode) {
+    ALOGV("performSeek seekTimeUs=%lld us (%.2f secs), needNotify(%d), mode(%d)",
           seekTimeUs,
           seekTimeUs / 1E6,
-          needNotify);
+          needNotify,
+          mode);
 
     if (mSource == NULL) {
         // This happens when reset occurs right before the loop mode
@@ -1765,7 +1830,7 @@ void NuPlayer::performSeek(int64_t seekTimeUs, bool needNotify) {
                 mAudioDecoder.get(), mVideoDecoder.get());
         return;
     }
-    mSource->seekTo(seekTimeUs);
+    mSource->seekTo(seekTimeUs, mode);
     ++mTimedTextGeneration;
 
     if (mDriver != NULL) {
@@ -20,6 +20,7 @@
 
 #include <media/MediaPlayerInterface.h>
 #include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/MediaSource.h>
 #include <media/stagefright/NativeWindowWrapper.h>
 
 namespace android {
@@ -61,7 +62,14 @@ struct NuPlayer : public AHandler {
 
     // Will notify the driver through "notifySeekComplete" once finished
     // and needNotify is true.
-    void seekToAsync(int64_t seekTimeUs, bool needNotify = false);
+    // With SEEK_CLOSEST video is decoded from the preceding sync frame but
+    // only shown from "seekTimeUs" on, SEEK_CLOSEST_SYNC moves the position
+    // to the nearest sync frame, e.g. for scrubbing.
+    void seekToAsync(
+            int64_t seekTimeUs,
+            bool needNotify = false,
+            MediaSource::ReadOptions::SeekMode mode =
+                MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
 
     status_t setVideoScalingMode(int32_t mode);
     status_t getTrackInfo(Parcel* reply) const;
@@ -69,6 +77,10 @@ struct NuPlayer : public AHandler {
     status_t selectTrack(size_t trackIndex, bool select);
     status_t getCurrentPosition(int64_t *mediaUs);
     void getStats(int64_t *mNumFramesTotal, int64_t *mNumFramesDropped);
+    // Renderer statistics, see Renderer::getStats(), NULL without renderer.
+    sp<AMessage> getRendererStats();
+    // Decoder statistics, one message per active decoder.
+    void getTrackStats(Vector<sp<AMessage> > *trackStats);
 
     sp<MetaData> getFileMeta();
 
@@ -120,6 +132,7 @@ private:
         kWhatGetTrackInfo               = 'gTrI',
         kWhatGetSelectedTrack           = 'gSel',
         kWhatSelectTrack                = 'selT',
+        kWhatGetTrackStats              = 'gTrS',
     };
 
     wp<NuPlayerDriver> mDriver;
@@ -226,7 +239,11 @@ private:
 
     void processDeferredActions();
 
-    void performSeek(int64_t seekTimeUs, bool needNotify);
+    void performSeek(
+            int64_t seekTimeUs,
+            bool needNotify,
+            MediaSource::ReadOptions::SeekMode mode =
+                MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
     void performDecoderFlush();
     void performDecoderShutdown(bool audio, bool video);
     void performReset();
@@ -25,6 +25,7 @@
 #include <media/stagefright/foundation/ABitReader.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaCodec.h>
@@ -33,6 +34,8 @@
 
 namespace android {
 
+static const size_t kMaxPendingInputTimes = 64;
+
 NuPlayer::Decoder::Decoder(
         const sp<AMessage> &notify,
         const sp<NativeWindowWrapper> &nativeWindow)
@@ -40,7 +43,14 @@ NuPlayer::Decoder::Decoder(
       mNativeWindow(nativeWindow),
       mBufferGeneration(0),
       mPaused(true),
-      mComponentName("decoder") {
+      mComponentName("decoder"),
+      mSkipRenderingUntilMediaTimeUs(-1ll),
+      mPrerollStartTimeUs(-1ll),
+      mNumPrerollFramesDropped(0),
+      mNumFramesDecoded(0ll),
+      mNumDecodeLatencySamples(0ll),
+      mTotalDecodeLatencyUs(0ll),
+      mMaxDecodeLatencyUs(0ll) {
     // Every decoder has its own looper because MediaCodec operations
     // are blocking, but NuPlayer needs asynchronous operations.
     mDecoderLooper = new ALooper;
@@ -103,6 +113,11 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
 
     mComponentName = mime;
     mComponentName.append(" decoder");
+
+    {
+        Mutex::Autolock autoLock(mStatsLock);
+        mMime = mime;
+    }
     ALOGV("[%s] onConfigure (surface=%p)", mComponentName.c_str(), surface.get());
 
     mCodec = MediaCodec::CreateByType(mCodecLooper, mime.c_str(), false /* encoder */);
@@ -379,6 +394,16 @@ bool android::NuPlayer::Decoder::onInputBufferFilled(const sp<AMessage> &msg) {
         uint32_t flags = 0;
         CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
 
+        int64_t targetTimeUs;
+        if (buffer->meta()->findInt64("targetTimeUs", &targetTimeUs)) {
+            ALOGV("[%s] skipping rendering until %lld us",
+                    mComponentName.c_str(), targetTimeUs);
+
+            mSkipRenderingUntilMediaTimeUs = targetTimeUs;
+            mPrerollStartTimeUs = ALooper::GetNowUs();
+            mNumPrerollFramesDropped = 0;
+        }
+
         int32_t eos, csd;
         // we do not expect SYNCFRAME for decoder
         if (buffer->meta()->findInt32("eos", &eos) && eos) {
@@ -413,6 +438,16 @@ bool android::NuPlayer::Decoder::onInputBufferFilled(const sp<AMessage> &msg) {
                 CHECK(mMediaBuffers[bufferIx] == NULL);
                 mMediaBuffers.editItemAt(bufferIx) = mediaBuffer;
             }
+
+            if (!(flags & (MediaCodec::BUFFER_FLAG_EOS
+                    | MediaCodec::BUFFER_FLAG_CODECCONFIG))) {
+                // keep the bookkeeping bounded if the codec doesn't
+                // preserve timestamps
+                if (mInputQueueTimesUs.size() >= kMaxPendingInputTimes) {
+                    mInputQueueTimesUs.removeItemsAt(0);
+                }
+                mInputQueueTimesUs.add(timeUs, ALooper::GetNowUs());
+            }
         }
     }
     return true;
@@ -481,10 +516,34 @@ bool NuPlayer::Decoder::handleAnOutputBuffer() {
     }
     // we do not expect CODECCONFIG or SYNCFRAME for decoder
 
+    if (!(flags & MediaCodec::BUFFER_FLAG_EOS)) {
+        updateDecodeLatency(timeUs);
+    }
+
     sp<AMessage> reply = new AMessage(kWhatRenderBuffer, id());
     reply->setSize("buffer-ix", bufferIx);
     reply->setInt32("generation", mBufferGeneration);
 
+    if (mSkipRenderingUntilMediaTimeUs >= 0) {
+        if (timeUs < mSkipRenderingUntilMediaTimeUs
+                && !(flags & MediaCodec::BUFFER_FLAG_EOS)) {
+            // Seek preroll, hand it straight back to onRenderBuffer to be
+            // released unrendered.
+            ++mNumPrerollFramesDropped;
+            reply->post();
+            return true;
+        }
+
+        ALOGI("[%s] reached seek target %lld us after %zu preroll frames, "
+              "decode to target took %lld us",
+              mComponentName.c_str(),
+              mSkipRenderingUntilMediaTimeUs,
+              mNumPrerollFramesDropped,
+              ALooper::GetNowUs() - mPrerollStartTimeUs);
+
+        mSkipRenderingUntilMediaTimeUs = -1ll;
+    }
+
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatDrainThisBuffer);
     notify->setBuffer("buffer", buffer);
@@ -522,6 +581,44 @@ void NuPlayer::Decoder::onRenderBuffer(const sp<AMessage> &msg) {
     }
 }
 
+void NuPlayer::Decoder::updateDecodeLatency(int64_t timeUs) {
+    int64_t latencyUs = -1;
+    ssize_t index = mInputQueueTimesUs.indexOfKey(timeUs);
+    if (index >= 0) {
+        latencyUs = ALooper::GetNowUs() - mInputQueueTimesUs.valueAt(index);
+    }
+
+    // Output comes in presentation order, anything queued before this
+    // frame's timestamp was decoded or dropped by the codec by now.
+    while (!mInputQueueTimesUs.isEmpty() && mInputQueueTimesUs.keyAt(0) <= timeUs) {
+        mInputQueueTimesUs.removeItemsAt(0);
+    }
+
+    Mutex::Autolock autoLock(mStatsLock);
+    ++mNumFramesDecoded;
+    if (latencyUs >= 0) {
+        ++mNumDecodeLatencySamples;
+        mTotalDecodeLatencyUs += latencyUs;
+        if (latencyUs > mMaxDecodeLatencyUs) {
+            mMaxDecodeLatencyUs = latencyUs;
+        }
+    }
+}
+
+sp<AMessage> NuPlayer::Decoder::getStats() const {
+    sp<AMessage> stats = new AMessage;
+
+    Mutex::Autolock autoLock(mStatsLock);
+    stats->setString("mime", mMime.c_str());
+    stats->setInt64("frames-decoded", mNumFramesDecoded);
+    stats->setInt64("avg-decode-latency-us",
+            mNumDecodeLatencySamples == 0
+                ? 0ll : mTotalDecodeLatencyUs / mNumDecodeLatencySamples);
+    stats->setInt64("max-decode-latency-us", mMaxDecodeLatencyUs);
+
+    return stats;
+}
+
 void NuPlayer::Decoder::onFlush() {
     status_t err = OK;
     if (mCodec != NULL) {
@@ -529,6 +626,8 @@ void NuPlayer::Decoder::onFlush() {
         mCSDsToSubmit = mCSDsForCurrentFormat; // copy operator
         ++mBufferGeneration;
     }
+    mSkipRenderingUntilMediaTimeUs = -1ll;
+    mInputQueueTimesUs.clear();
 
     if (err != OK) {
         ALOGE("failed to flush %s (err=%d)", mComponentName.c_str(), err);
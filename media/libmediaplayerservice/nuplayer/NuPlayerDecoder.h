@@ -43,6 +43,11 @@ struct NuPlayer::Decoder : public AHandler {
 
     virtual bool supportsSeamlessFormatChange(const sp<AMessage> &to) const;
 
+    // Decode statistics: "mime", "frames-decoded" and the average and
+    // maximum time from queueing an access unit to getting its output,
+    // "avg-decode-latency-us" and "max-decode-latency-us".
+    sp<AMessage> getStats() const;
+
     enum {
         kWhatFillThisBuffer      = 'flTB',
         kWhatDrainThisBuffer     = 'drTB',
@@ -108,6 +113,24 @@ private:
     bool mPaused;
     AString mComponentName;
 
+    // Output before this media time is preroll of a frame accurate seek
+    // and released without ever reaching the renderer, -1 if none.
+    int64_t mSkipRenderingUntilMediaTimeUs;
+    int64_t mPrerollStartTimeUs;
+    size_t mNumPrerollFramesDropped;
+
+    // When access units were queued to the codec, by their timestamp.
+    KeyedVector<int64_t, int64_t> mInputQueueTimesUs;
+
+    mutable Mutex mStatsLock;  // protects the following 5 member vars.
+    AString mMime;
+    int64_t mNumFramesDecoded;
+    int64_t mNumDecodeLatencySamples;
+    int64_t mTotalDecodeLatencyUs;
+    int64_t mMaxDecodeLatencyUs;
+
+    void updateDecodeLatency(int64_t timeUs);
+
     bool supportsSeamlessAudioFormatChange(const sp<AMessage> &targetFormat) const;
     void rememberCodecSpecificData(const sp<AMessage> &format);
 
@@ -22,8 +22,10 @@
 #include "NuPlayerDriver.h"
 
 #include "NuPlayer.h"
+#include "NuPlayerRenderer.h"
 #include "NuPlayerSource.h"
 
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AUtils.h>
@@ -40,6 +42,7 @@ NuPlayerDriver::NuPlayerDriver()
       mDurationUs(-1),
       mPositionUs(-1),
       mSeekInProgress(false),
+      mSeekMode(MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC),
       mLooper(new ALooper),
       mPlayerFlags(0),
       mAtEOS(false),
@@ -364,7 +367,7 @@ status_t NuPlayerDriver::seekTo(int msec) {
             mSeekInProgress = true;
             // seeks can take a while, so we essentially paused
             notifyListener_l(MEDIA_PAUSED);
-            mPlayer->seekToAsync(seekTimeUs, true /* needNotify */);
+            mPlayer->seekToAsync(seekTimeUs, true /* needNotify */, mSeekMode);
             break;
         }
 
@@ -512,13 +515,92 @@ void NuPlayerDriver::setAudioSink(const sp<AudioSink> &audioSink) {
     mAudioSink = audioSink;
 }
 
-status_t NuPlayerDriver::setParameter(
-        int /* key */, const Parcel & /* request */) {
-    return INVALID_OPERATION;
+status_t NuPlayerDriver::setParameter(int key, const Parcel &request) {
+    switch (key) {
+        case KEY_PARAMETER_SEEK_MODE:
+        {
+            int32_t mode;
+            status_t err = request.readInt32(&mode);
+            if (err != OK) {
+                return err;
+            }
+
+            if (mode != MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC
+                    && mode != MediaSource::ReadOptions::SEEK_CLOSEST_SYNC
+                    && mode != MediaSource::ReadOptions::SEEK_CLOSEST) {
+                return BAD_VALUE;
+            }
+
+            Mutex::Autolock autoLock(mLock);
+            mSeekMode = (MediaSource::ReadOptions::SeekMode)mode;
+            return OK;
+        }
+
+        default:
+            return INVALID_OPERATION;
+    }
 }
 
-status_t NuPlayerDriver::getParameter(int /* key */, Parcel * /* reply */) {
-    return INVALID_OPERATION;
+status_t NuPlayerDriver::getParameter(int key, Parcel *reply) {
+    switch (key) {
+        case KEY_PARAMETER_PLAYBACK_STATS:
+        {
+            int64_t numFramesTotal;
+            int64_t numFramesDropped;
+            mPlayer->getStats(&numFramesTotal, &numFramesDropped);
+            reply->writeInt64(numFramesTotal);
+            reply->writeInt64(numFramesDropped);
+
+            int64_t numFramesRendered = 0;
+            int64_t numFramesDroppedLate = 0;
+            int64_t numUnderruns = 0;
+            const int64_t *histogram = NULL;
+
+            sp<AMessage> stats = mPlayer->getRendererStats();
+            sp<ABuffer> buffer;
+            if (stats != NULL) {
+                CHECK(stats->findInt64("frames-rendered", &numFramesRendered));
+                CHECK(stats->findInt64("frames-dropped-late", &numFramesDroppedLate));
+                CHECK(stats->findInt64("audio-underruns", &numUnderruns));
+                CHECK(stats->findBuffer("av-offset-histogram", &buffer));
+                histogram = (const int64_t *)buffer->data();
+            }
+
+            reply->writeInt64(numFramesRendered);
+            reply->writeInt64(numFramesDroppedLate);
+            reply->writeInt32(numUnderruns);
+
+            const size_t numBuckets = NuPlayer::Renderer::kNumAVOffsetBuckets;
+            reply->writeInt32(numBuckets);
+            for (size_t i = 0; i < numBuckets; ++i) {
+                reply->writeInt32(i + 1 < numBuckets
+                        ? NuPlayer::Renderer::kAVOffsetBucketLimitsUs[i] / 1000
+                        : 0x7fffffff);
+                reply->writeInt64(histogram != NULL ? histogram[i] : 0ll);
+            }
+
+            Vector<sp<AMessage> > trackStats;
+            mPlayer->getTrackStats(&trackStats);
+            reply->writeInt32(trackStats.size());
+            for (size_t i = 0; i < trackStats.size(); ++i) {
+                AString mime;
+                int64_t numFramesDecoded, avgLatencyUs, maxLatencyUs;
+                CHECK(trackStats[i]->findString("mime", &mime));
+                CHECK(trackStats[i]->findInt64("frames-decoded", &numFramesDecoded));
+                CHECK(trackStats[i]->findInt64("avg-decode-latency-us", &avgLatencyUs));
+                CHECK(trackStats[i]->findInt64("max-decode-latency-us", &maxLatencyUs));
+
+                reply->writeString16(String16(mime.c_str()));
+                reply->writeInt64(numFramesDecoded);
+                reply->writeInt64(avgLatencyUs);
+                reply->writeInt64(maxLatencyUs);
+            }
+            return OK;
+        }
+
+        default:
+            return INVALID_OPERATION;
+    }
 }
 
 status_t NuPlayerDriver::getMetadata(
@@ -612,6 +694,60 @@ status_t NuPlayerDriver::dump(
                  numFramesTotal == 0
                     ? 0.0 : (double)numFramesDropped / numFramesTotal);
 
+    sp<AMessage> stats = mPlayer->getRendererStats();
+    if (stats != NULL) {
+        int64_t numFramesRendered, numFramesDroppedLate, numUnderruns;
+        sp<ABuffer> buffer;
+        CHECK(stats->findInt64("frames-rendered", &numFramesRendered));
+        CHECK(stats->findInt64("frames-dropped-late", &numFramesDroppedLate));
+        CHECK(stats->findInt64("audio-underruns", &numUnderruns));
+        CHECK(stats->findBuffer("av-offset-histogram", &buffer));
+
+        fprintf(out, "  numFramesRendered(%" PRId64 "), numFramesDroppedLate(%" PRId64 "), "
+                     "numAudioUnderruns(%" PRId64 ")\n",
+                     numFramesRendered, numFramesDroppedLate, numUnderruns);
+
+        const int64_t *histogram = (const int64_t *)buffer->data();
+        const size_t numBuckets = NuPlayer::Renderer::kNumAVOffsetBuckets;
+        fprintf(out, "  avOffsetHistogram(ms):");
+        for (size_t i = 0; i < numBuckets; ++i) {
+            if (i + 1 < numBuckets) {
+                fprintf(out, " <%" PRId64 ":%" PRId64,
+                        NuPlayer::Renderer::kAVOffsetBucketLimitsUs[i] / 1000,
+                        histogram[i]);
+            } else {
+                fprintf(out, " rest:%" PRId64, histogram[i]);
+            }
+        }
+        fprintf(out, "\n");
+    }
+
+    Vector<sp<AMessage> > trackStats;
+    mPlayer->getTrackStats(&trackStats);
+    for (size_t i = 0; i < trackStats.size(); ++i) {
+        AString mime;
+        int64_t numFramesDecoded, avgLatencyUs, maxLatencyUs;
+        CHECK(trackStats[i]->findString("mime", &mime));
+        CHECK(trackStats[i]->findInt64("frames-decoded", &numFramesDecoded));
+        CHECK(trackStats[i]->findInt64("avg-decode-latency-us", &avgLatencyUs));
+        CHECK(trackStats[i]->findInt64("max-decode-latency-us", &maxLatencyUs));
+
+        fprintf(out, "  %s: numFramesDecoded(%" PRId64 "), "
+                     "decodeLatencyUs(avg %" PRId64 ", max %" PRId64 ")\n",
+                     mime.c_str(), numFramesDecoded, avgLatencyUs, maxLatencyUs);
+
+        int64_t numReads, avgReadLatencyUs, maxReadLatencyUs;
+        if (trackStats[i]->findInt64("reads", &numReads)
+                && trackStats[i]->findInt64(
+                        "avg-read-latency-us", &avgReadLatencyUs)
+                && trackStats[i]->findInt64(
+                        "max-read-latency-us", &maxReadLatencyUs)) {
+            fprintf(out, "    numReads(%" PRId64 "), "
+                         "readLatencyUs(avg %" PRId64 ", max %" PRId64 ")\n",
+                         numReads, avgReadLatencyUs, maxReadLatencyUs);
+        }
+    }
+
     fclose(out);
     out = NULL;
 
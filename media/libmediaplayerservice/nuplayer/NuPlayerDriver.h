@@ -17,6 +17,7 @@
 #include <media/MediaPlayerInterface.h>
 
 #include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/MediaSource.h>
 
 namespace android {
 
@@ -105,6 +106,7 @@ private:
     int64_t mDurationUs;
     int64_t mPositionUs;
     bool mSeekInProgress;
+    MediaSource::ReadOptions::SeekMode mSeekMode;
     // <<<
 
     sp<ALooper> mLooper;
@@ -43,7 +43,13 @@ static const int64_t kOffloadPauseMaxUs = 60000000ll;
 // static
 const int64_t NuPlayer::Renderer::kMinPositionUpdateDelayUs = 100000ll;
 
+// static
+const int64_t NuPlayer::Renderer::kAVOffsetBucketLimitsUs[kNumAVOffsetBuckets - 1] = {
+    -100000ll, -40000ll, -20000ll, -5000ll, 5000ll, 20000ll, 40000ll, 100000ll
+};
+
 static bool sFrameAccurateAVsync = false;
+static bool sVsyncCadencePacing = false;
 
 static void readProperties() {
     char value[PROPERTY_VALUE_MAX];
@@ -51,6 +57,10 @@ static void readProperties() {
         sFrameAccurateAVsync =
             !strcmp("1", value) || !strcasecmp("true", value);
     }
+    if (property_get("persist.sys.media.vsync-cadence", value, NULL)) {
+        sVsyncCadencePacing =
+            !strcmp("1", value) || !strcasecmp("true", value);
+    }
 }
 
 NuPlayer::Renderer::Renderer(
@@ -86,7 +96,12 @@ NuPlayer::Renderer::Renderer(
       mAudioOffloadTornDown(false),
       mCurrentOffloadInfo(AUDIO_INFO_INITIALIZER),
       mTotalBuffersQueued(0),
-      mLastAudioBufferDrained(0) {
+      mLastAudioBufferDrained(0),
+      mNumVideoFramesRendered(0ll),
+      mNumVideoFramesDroppedLate(0ll),
+      mNumAudioSinkUnderruns(0ll),
+      mAudioSinkStarved(false) {
+    memset(mAVOffsetHistogram, 0, sizeof(mAVOffsetHistogram));
     readProperties();
 }
 
@@ -250,6 +265,29 @@ int64_t NuPlayer::Renderer::getVideoLateByUs() {
     return mVideoLateByUs;
 }
 
+sp<AMessage> NuPlayer::Renderer::getStats() {
+    sp<AMessage> stats = new AMessage;
+    sp<ABuffer> histogram = new ABuffer(sizeof(mAVOffsetHistogram));
+
+    Mutex::Autolock autoLock(mStatsLock);
+    stats->setInt64("frames-rendered", mNumVideoFramesRendered);
+    stats->setInt64("frames-dropped-late", mNumVideoFramesDroppedLate);
+    stats->setInt64("audio-underruns", mNumAudioSinkUnderruns);
+    memcpy(histogram->data(), mAVOffsetHistogram, sizeof(mAVOffsetHistogram));
+    stats->setBuffer("av-offset-histogram", histogram);
+
+    return stats;
+}
+
+void NuPlayer::Renderer::addAVOffsetSample_l(int64_t avOffsetUs) {
+    size_t bucket = 0;
+    while (bucket < kNumAVOffsetBuckets - 1
+            && avOffsetUs >= kAVOffsetBucketLimitsUs[bucket]) {
+        ++bucket;
+    }
+    ++mAVOffsetHistogram[bucket];
+}
+
 void NuPlayer::Renderer::setPauseStartedTimeRealUs(int64_t realUs) {
     Mutex::Autolock autoLock(mTimeLock);
     mPauseStartedTimeRealUs = realUs;
@@ -371,7 +409,12 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
 
             mDrainVideoQueuePending = false;
 
-            onDrainVideoQueue();
+            int64_t scheduledTimeUs;
+            if (!msg->findInt64("scheduledTimeUs", &scheduledTimeUs)) {
+                scheduledTimeUs = -1;
+            }
+
+            onDrainVideoQueue(scheduledTimeUs);
 
             postDrainVideoQueue();
             break;
@@ -602,14 +645,15 @@ bool NuPlayer::Renderer::onDrainAudioQueue() {
     ssize_t numFramesAvailableToWrite =
         mAudioSink->frameCount() - (mNumFramesWritten - numFramesPlayed);
 
-#if 0
-    if (numFramesAvailableToWrite == mAudioSink->frameCount()) {
-        ALOGI("audio sink underrun");
-    } else {
-        ALOGV("audio queue has %d frames left to play",
-             mAudioSink->frameCount() - numFramesAvailableToWrite);
+    // Everything written so far has been played out, count each time the
+    // sink runs dry as one underrun.
+    bool starved = mNumFramesWritten > 0 && numFramesPlayed >= mNumFramesWritten;
+    if (starved && !mAudioSinkStarved) {
+        ALOGV("audio sink underrun");
+        Mutex::Autolock autoLock(mStatsLock);
+        ++mNumAudioSinkUnderruns;
     }
-#endif
+    mAudioSinkStarved = starved;
 
     size_t numBytesAvailableToWrite =
         numFramesAvailableToWrite * mAudioSink->frameSize();
@@ -786,6 +830,11 @@ void NuPlayer::Renderer::postDrainVideoQueue() {
     }
 
     realTimeUs = mVideoScheduler->schedule(realTimeUs * 1000) / 1000;
+    if (sVsyncCadencePacing) {
+        // the cadence is only kept if the frame is queued for the VSYNC
+        // picked by the scheduler
+        msg->setInt64("scheduledTimeUs", realTimeUs);
+    }
     int64_t twoVsyncsUs = 2 * (mVideoScheduler->getVsyncPeriod() / 1000);
 
     delayUs = realTimeUs - nowUs;
@@ -802,7 +851,7 @@ void NuPlayer::Renderer::postDrainVideoQueue() {
     mDrainVideoQueuePending = true;
 }
 
-void NuPlayer::Renderer::onDrainVideoQueue() {
+void NuPlayer::Renderer::onDrainVideoQueue(int64_t scheduledTimeUs) {
     if (mVideoQueue.empty()) {
         return;
     }
@@ -859,7 +908,24 @@ void NuPlayer::Renderer::onDrainVideoQueue() {
         }
     }
 
-    entry->mNotifyConsumed->setInt64("timestampNs", realTimeUs * 1000ll);
+    int64_t timestampUs = scheduledTimeUs >= 0 ? scheduledTimeUs : realTimeUs;
+
+    if (!mPaused) {
+        Mutex::Autolock autoLock(mStatsLock);
+        if (tooLate) {
+            ++mNumVideoFramesDroppedLate;
+        } else {
+            ++mNumVideoFramesRendered;
+
+            // The frame is shown at its timestamp unless that has already
+            // passed. The offset is only meaningful against an audio clock.
+            if (mHasAudio && !(mFlags & FLAG_REAL_TIME)) {
+                addAVOffsetSample_l(max(nowUs, timestampUs) - realTimeUs);
+            }
+        }
+    }
+
+    entry->mNotifyConsumed->setInt64("timestampNs", timestampUs * 1000ll);
     entry->mNotifyConsumed->setInt32("render", !tooLate);
     entry->mNotifyConsumed->post();
     mVideoQueue.erase(mVideoQueue.begin());
@@ -904,6 +970,9 @@ void NuPlayer::Renderer::onQueueBuffer(const sp<AMessage> &msg) {
         if (mVideoScheduler == NULL) {
             mVideoScheduler = new VideoFrameScheduler();
             mVideoScheduler->init();
+            if (sVsyncCadencePacing) {
+                mVideoScheduler->setPacingMode(VideoFrameScheduler::PACING_CADENCE);
+            }
         }
     }
 
@@ -1206,6 +1275,9 @@ void NuPlayer::Renderer::onResume() {
 void NuPlayer::Renderer::onSetVideoFrameRate(float fps) {
     if (mVideoScheduler == NULL) {
         mVideoScheduler = new VideoFrameScheduler();
+        if (sVsyncCadencePacing) {
+            mVideoScheduler->setPacingMode(VideoFrameScheduler::PACING_CADENCE);
+        }
     }
     mVideoScheduler->init(fps);
 }
@@ -72,6 +72,17 @@ struct NuPlayer::Renderer : public AHandler {
     int64_t getVideoLateByUs();
     void setPauseStartedTimeRealUs(int64_t realUs);
 
+    // Playback quality so far: "frames-rendered", "frames-dropped-late",
+    // "audio-underruns" and "av-offset-histogram", a buffer of
+    // kNumAVOffsetBuckets int64_t counts of rendered video frames by how far
+    // they were shown from their audio clock time.
+    sp<AMessage> getStats();
+
+    // Exclusive upper bounds of all but the last A/V offset bucket, the
+    // last one collects the rest. Positive offsets are video behind audio.
+    static const size_t kNumAVOffsetBuckets = 9;
+    static const int64_t kAVOffsetBucketLimitsUs[kNumAVOffsetBuckets - 1];
+
     bool openAudioSink(
             const sp<AMessage> &format,
             bool offloadOnly,
@@ -178,6 +189,14 @@ private:
     int32_t mTotalBuffersQueued;
     int32_t mLastAudioBufferDrained;
 
+    Mutex mStatsLock;  // protects the following 4 member vars.
+    int64_t mNumVideoFramesRendered;
+    int64_t mNumVideoFramesDroppedLate;
+    int64_t mNumAudioSinkUnderruns;
+    int64_t mAVOffsetHistogram[kNumAVOffsetBuckets];
+
+    bool mAudioSinkStarved;
+
 
     size_t fillAudioBuffer(void *buffer, size_t size);
 
@@ -189,7 +208,8 @@ private:
     void onNewAudioMediaTime(int64_t mediaTimeUs);
     int64_t getRealTimeUs(int64_t mediaTimeUs, int64_t nowUs);
 
-    void onDrainVideoQueue();
+    void onDrainVideoQueue(int64_t scheduledTimeUs);
+    void addAVOffsetSample_l(int64_t avOffsetUs);
     void postDrainVideoQueue();
 
     void prepareForMediaRenderingStart();
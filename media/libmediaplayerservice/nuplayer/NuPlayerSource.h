@@ -101,7 +101,12 @@ struct NuPlayer::Source : public AHandler {
         return INVALID_OPERATION;
     }
 
-    virtual status_t seekTo(int64_t /* seekTimeUs */) {
+    // Sources that can't seek to an arbitrary frame treat all modes
+    // like SEEK_PREVIOUS_SYNC.
+    virtual status_t seekTo(
+            int64_t /* seekTimeUs */,
+            MediaSource::ReadOptions::SeekMode /* mode */ =
+                MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC) {
         return INVALID_OPERATION;
     }
 
@@ -117,6 +122,11 @@ struct NuPlayer::Source : public AHandler {
         return false;
     }
 
+    // Adds "reads", "avg-read-latency-us" and "max-read-latency-us" to
+    // "stats", if the source measures how long reading the track takes.
+    virtual void getReadStats(
+            bool /* audio */, const sp<AMessage> & /* stats */) {}
+
     virtual void setRenderPosition(int64_t positionUs) {}
 
 protected:
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "VideoFrameScheduler_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <utils/Vector.h>
+
+#include "VideoFrameScheduler.h"
+
+namespace android {
+
+// Plays back a simulated stream through the scheduler on a display with a
+// fixed refresh rate. Frames are requested at their ideal time plus some
+// deterministic noise, as the media clock would, and are shown at the first
+// VSYNC after the time the scheduler picked for them.
+class VideoFrameSchedulerTest : public ::testing::Test {
+protected:
+    static const nsecs_t kNanosIn1s = 1000000000ll;
+    static const size_t kNumFrames = 2000;
+    static const size_t kNumWarmupFrames = 50;
+
+    struct Stats {
+        // variance of the time frames are shown at relative to their ideal
+        // time, in VSYNC periods squared; this is what is perceived as judder
+        double mPresentationVariance;
+        // largest distance of a frame from its ideal time, in VSYNC periods
+        double mMaxPresentationError;
+        // variance of how long frames stay on screen, in VSYNC periods squared
+        double mDurationVariance;
+        size_t mMinVsyncsPerFrame;
+        size_t mMaxVsyncsPerFrame;
+    };
+
+    static Stats simulate(
+            VideoFrameScheduler::PacingMode mode,
+            double fps, nsecs_t vsyncPeriod, nsecs_t noise) {
+        sp<VideoFrameScheduler> scheduler = new VideoFrameScheduler;
+        scheduler->setFixedVsync(0 /* vsyncTime */, vsyncPeriod);
+        scheduler->init();
+        scheduler->setPacingMode(mode);
+
+        const nsecs_t startTime = kNanosIn1s;
+        uint32_t seed = 1;
+
+        Vector<nsecs_t> errors;
+        Vector<nsecs_t> shownAt;
+        for (size_t i = 0; i < kNumFrames; ++i) {
+            nsecs_t idealTime = startTime + (nsecs_t)(i * kNanosIn1s / fps);
+
+            // uniform in [-noise, noise]
+            seed = seed * 1103515245 + 12345;
+            nsecs_t jitter = (nsecs_t)((seed >> 8) % (2 * noise + 1)) - noise;
+
+            nsecs_t renderTime = scheduler->schedule(idealTime + jitter);
+            nsecs_t vsyncTime = (renderTime / vsyncPeriod + 1) * vsyncPeriod;
+
+            if (i >= kNumWarmupFrames) {
+                errors.push(vsyncTime - idealTime);
+                shownAt.push(vsyncTime);
+            }
+        }
+
+        Stats stats;
+        stats.mPresentationVariance = variance(errors) / vsyncPeriod / vsyncPeriod;
+        stats.mMaxPresentationError = 0;
+        for (size_t i = 0; i < errors.size(); ++i) {
+            double error = fabs((double)errors[i] / vsyncPeriod);
+            stats.mMaxPresentationError = error > stats.mMaxPresentationError
+                    ? error : stats.mMaxPresentationError;
+        }
+
+        Vector<nsecs_t> durations;
+        stats.mMinVsyncsPerFrame = SIZE_MAX;
+        stats.mMaxVsyncsPerFrame = 0;
+        for (size_t i = 1; i < shownAt.size(); ++i) {
+            nsecs_t duration = shownAt[i] - shownAt[i - 1];
+            size_t vsyncs = duration / vsyncPeriod;
+            stats.mMinVsyncsPerFrame = vsyncs < stats.mMinVsyncsPerFrame
+                    ? vsyncs : stats.mMinVsyncsPerFrame;
+            stats.mMaxVsyncsPerFrame = vsyncs > stats.mMaxVsyncsPerFrame
+                    ? vsyncs : stats.mMaxVsyncsPerFrame;
+            durations.push(duration);
+        }
+        stats.mDurationVariance = variance(durations) / vsyncPeriod / vsyncPeriod;
+
+        return stats;
+    }
+
+    static double variance(const Vector<nsecs_t> &values) {
+        double sum = 0, sumSquares = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            sum += values[i];
+            sumSquares += (double)values[i] * values[i];
+        }
+        double mean = sum / values.size();
+        return sumSquares / values.size() - mean * mean;
+    }
+
+    static void compare(double fps, double refreshRate, nsecs_t noise) {
+        nsecs_t vsyncPeriod = (nsecs_t)(kNanosIn1s / refreshRate);
+
+        Stats adjust = simulate(
+                VideoFrameScheduler::PACING_ADJUST, fps, vsyncPeriod, noise);
+        Stats cadence = simulate(
+                VideoFrameScheduler::PACING_CADENCE, fps, vsyncPeriod, noise);
+
+        ALOGI("%.3f fps on %.0fHz, noise %lld us: presentation variance %.4f => %.4f, "
+              "max error %.2f => %.2f, duration variance %.4f => %.4f, %zu-%zu => %zu-%zu vsyncs per frame",
+              fps, refreshRate, (long long)(noise / 1000),
+              adjust.mPresentationVariance, cadence.mPresentationVariance,
+              adjust.mMaxPresentationError, cadence.mMaxPresentationError,
+              adjust.mDurationVariance, cadence.mDurationVariance,
+              adjust.mMinVsyncsPerFrame, adjust.mMaxVsyncsPerFrame,
+              cadence.mMinVsyncsPerFrame, cadence.mMaxVsyncsPerFrame);
+
+        // a fixed cadence is never worse than adjusting frame by frame
+        EXPECT_LE(cadence.mPresentationVariance, adjust.mPresentationVariance);
+
+        // and only ever shows a frame for one of the two VSYNC counts
+        // adjacent to the ratio of the rates, e.g. 2 or 3 for 24fps on 60Hz
+        size_t minVsyncs = (size_t)(refreshRate / fps);
+        size_t maxVsyncs = (size_t)(refreshRate / fps + 0.999);
+        EXPECT_GE(cadence.mMinVsyncsPerFrame, minVsyncs);
+        EXPECT_LE(cadence.mMaxVsyncsPerFrame, maxVsyncs);
+
+        // which keeps each frame within about half a VSYNC of its ideal
+        // position, regardless of the noise
+        EXPECT_LE(cadence.mMaxPresentationError, 0.65);
+    }
+};
+
+TEST_F(VideoFrameSchedulerTest, Film24On60Hz) {
+    compare(24, 60, 3000000ll);
+}
+
+TEST_F(VideoFrameSchedulerTest, Film23_976On60Hz) {
+    compare(24000 / 1001.0, 60, 3000000ll);
+}
+
+TEST_F(VideoFrameSchedulerTest, Pal25On60Hz) {
+    compare(25, 60, 3000000ll);
+}
+
+TEST_F(VideoFrameSchedulerTest, Pal25On50Hz) {
+    compare(25, 50, 3000000ll);
+}
+
+TEST_F(VideoFrameSchedulerTest, Ntsc30On60Hz) {
+    compare(30, 60, 3000000ll);
+}
+
+TEST_F(VideoFrameSchedulerTest, Film24On60HzNoiseFree) {
+    compare(24, 60, 0);
+}
+
+}  // namespace android
@@ -422,7 +422,10 @@ ACodec::ACodec()
       mTimePerFrameUs(-1ll),
       mTimePerCaptureUs(-1ll),
       mCreateInputBuffersSuspended(false),
-      mTunneled(false) {
+      mTunneled(false),
+      mLowLatency(false) {
+    mUntrimmedBufferCount[0] = mUntrimmedBufferCount[1] = 0;
+
     mUninitializedState = new UninitializedState(this);
     mLoadedState = new LoadedState(this);
     mLoadedToIdleState = new LoadedToIdleState(this);
@@ -541,6 +544,11 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
         err = mOMX->getParameter(
                 mNode, OMX_IndexParamPortDefinition, &def, sizeof(def));
 
+        if (err == OK) {
+            err = mLowLatency ?
+                    setMinBufferCount(&def) : restoreBufferCount(&def);
+        }
+
         if (err == OK) {
             ALOGV("[%s] Allocating %u buffers of size %u on %s port",
                     mComponentName.c_str(),
@@ -763,8 +771,11 @@ status_t ACodec::configureOutputBuffersFromNativeWindow(
     // XXX: Is this the right logic to use?  It's not clear to me what the OMX
     // buffer counts refer to - how do they account for the renderer holding on
     // to buffers?
+    // In low latency mode every extra buffer is a frame the consumer may
+    // queue up ahead of the display, so none are added.
     *minUndequeuedBuffers = 0;
-    for (OMX_U32 extraBuffers = 2 + 1; /* condition inside loop */; extraBuffers--) {
+    for (OMX_U32 extraBuffers = mLowLatency ? 0 : 2 + 1;
+            /* condition inside loop */; extraBuffers--) {
         OMX_U32 newBufferCount =
             def.nBufferCountMin + *minUndequeuedBuffers + extraBuffers;
         def.nBufferCountActual = newBufferCount;
@@ -1280,7 +1291,58 @@ status_t ACodec::configureCodec(
             mCreateInputBuffersSuspended = false;
         }
     }
+    mLowLatency = false;
     if (video && (!encoder)) {
+        // Interactive streams (wifi display sink, video calls) trade
+        // smoothness for latency: the fewest buffers the component allows
+        // on both ports, and frames returned as soon as they are decoded
+        // rather than held for reordering.
+        int32_t lowLatency;
+        if (msg->findInt32("low-latency", &lowLatency) && lowLatency != 0) {
+            ALOGV("[%s] configuring for low latency", mComponentName.c_str());
+            mLowLatency = true;
+        }
+
+        // Sent either way, the component keeps it from earlier sessions.
+        status_t decodeOrderErr = setBooleanExtension(
+                "OMX.google.android.index.outputDecodeOrder", mLowLatency);
+        if (decodeOrderErr == ERROR_UNSUPPORTED) {
+            ALOGW_IF(mLowLatency, "[%s] decode order output not supported",
+                    mComponentName.c_str());
+        } else if (decodeOrderErr != OK) {
+            ALOGE("[%s] setting decode order output failed: %d",
+                    mComponentName.c_str(), decodeOrderErr);
+            return decodeOrderErr;
+        }
+
+        // Software decoders can be told how many threads to decode with,
+        // and to decode off their message loop. Both are sent on every
+        // configure, so that keys left out go back to the defaults (0 picks
+        // one thread per core) instead of an earlier session's values.
+        int32_t threadCount;
+        bool haveThreadCount = msg->findInt32("thread-count", &threadCount);
+        if (!haveThreadCount || threadCount < 0) {
+            threadCount = 0;
+        }
+        status_t threadCountErr = setU32Extension(
+                "OMX.google.android.index.threadCount", threadCount);
+        ALOGW_IF(threadCountErr != OK
+                && (haveThreadCount || threadCountErr != ERROR_UNSUPPORTED),
+                "[%s] setting the thread count failed: %d",
+                mComponentName.c_str(), threadCountErr);
+
+        int32_t asyncDecode;
+        bool haveAsyncDecode = msg->findInt32("async-decode", &asyncDecode);
+        if (!haveAsyncDecode) {
+            asyncDecode = 0;
+        }
+        status_t asyncDecodeErr = setBooleanExtension(
+                "OMX.google.android.index.asyncDecode", asyncDecode != 0);
+        ALOGW_IF(asyncDecodeErr != OK
+                && (haveAsyncDecode || asyncDecodeErr != ERROR_UNSUPPORTED),
+                "[%s] setting asynchronous decoding failed: %d",
+                mComponentName.c_str(), asyncDecodeErr);
+
         OMX_INDEXTYPE index;
         err = mOMX->getExtensionIndex(
                 mNode,
@@ -1299,6 +1361,9 @@ status_t ACodec::configureCodec(
                 params.bDisable = OMX_FALSE;
             else
                 params.bDisable = (!strcmp(temp.c_str(), "1")) ? OMX_TRUE : OMX_FALSE;
+            if (mLowLatency) {
+                params.bDisable = OMX_TRUE;
+            }
             ALOGI("Send reorder config(%d) to VPU",params.bDisable);
             err = mOMX->setParameter(
                     mNode, index, &params, sizeof(params));
@@ -1624,6 +1689,91 @@ status_t ACodec::setMinBufferSize(OMX_U32 portIndex, size_t size) {
     return OK;
 }
 
+status_t ACodec::setMinBufferCount(OMX_PARAM_PORTDEFINITIONTYPE *def) {
+    if (def->nBufferCountActual <= def->nBufferCountMin) {
+        return OK;
+    }
+
+    OMX_U32 bufferCount = def->nBufferCountActual;
+    if (mUntrimmedBufferCount[def->nPortIndex] == 0) {
+        mUntrimmedBufferCount[def->nPortIndex] = bufferCount;
+    }
+    def->nBufferCountActual = def->nBufferCountMin;
+
+    status_t err = mOMX->setParameter(
+            mNode, OMX_IndexParamPortDefinition, def, sizeof(*def));
+
+    if (err != OK) {
+        ALOGW("[%s] setting nBufferCountActual to %u failed: %d",
+                mComponentName.c_str(), def->nBufferCountMin, err);
+
+        // allow failure
+        def->nBufferCountActual = bufferCount;
+        return OK;
+    }
+
+    ALOGV("[%s] using %u instead of %u buffers on %s port",
+            mComponentName.c_str(), def->nBufferCountActual, bufferCount,
+            def->nPortIndex == kPortIndexInput ? "input" : "output");
+
+    return mOMX->getParameter(
+            mNode, OMX_IndexParamPortDefinition, def, sizeof(*def));
+}
+
+status_t ACodec::restoreBufferCount(OMX_PARAM_PORTDEFINITIONTYPE *def) {
+    OMX_U32 bufferCount = mUntrimmedBufferCount[def->nPortIndex];
+    mUntrimmedBufferCount[def->nPortIndex] = 0;
+
+    if (def->nBufferCountActual >= bufferCount) {
+        return OK;
+    }
+
+    def->nBufferCountActual = bufferCount;
+
+    status_t err = mOMX->setParameter(
+            mNode, OMX_IndexParamPortDefinition, def, sizeof(*def));
+
+    if (err != OK) {
+        ALOGE("[%s] restoring nBufferCountActual to %u failed: %d",
+                mComponentName.c_str(), bufferCount, err);
+        return err;
+    }
+
+    return mOMX->getParameter(
+            mNode, OMX_IndexParamPortDefinition, def, sizeof(*def));
+}
+
+status_t ACodec::setBooleanExtension(const char *name, bool enable) {
+    OMX_INDEXTYPE index;
+    status_t err = mOMX->getExtensionIndex(mNode, name, &index);
+
+    if (err != OK) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    OMX_CONFIG_BOOLEANTYPE params;
+    InitOMXParams(&params);
+    params.bEnabled = enable ? OMX_TRUE : OMX_FALSE;
+
+    return mOMX->setParameter(mNode, index, &params, sizeof(params));
+}
+
+status_t ACodec::setU32Extension(const char *name, OMX_U32 value) {
+    OMX_INDEXTYPE index;
+    status_t err = mOMX->getExtensionIndex(mNode, name, &index);
+
+    if (err != OK) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    OMX_PARAM_U32TYPE params;
+    InitOMXParams(&params);
+    params.nPortIndex = kPortIndexOutput;
+    params.nU32 = value;
+
+    return mOMX->setParameter(mNode, index, &params, sizeof(params));
+}
+
 status_t ACodec::selectAudioPortFormat(
         OMX_U32 portIndex, OMX_AUDIO_CODINGTYPE desiredFormat) {
     OMX_AUDIO_PARAM_PORTFORMATTYPE format;
@@ -4477,6 +4627,8 @@ void ACodec::UninitializedState::stateEntered() {
     mCodec->mNode = NULL;
     mCodec->mOMX.clear();
     mCodec->mQuirks = 0;
+    mCodec->mUntrimmedBufferCount[kPortIndexInput] = 0;
+    mCodec->mUntrimmedBufferCount[kPortIndexOutput] = 0;
     mCodec->mFlags = 0;
     mCodec->mUseMetadataOnEncoderOutput = 0;
     mCodec->mComponentName.clear();
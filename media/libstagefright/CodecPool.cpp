@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "CodecPool"
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include "include/CodecPool.h"
+
+#include <cutils/properties.h>
+#include <media/IMediaCodecList.h>
+#include <media/MediaCodecInfo.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/CodecBase.h>
+#include <media/stagefright/MediaCodecList.h>
+
+namespace android {
+
+Mutex CodecPool::sLock;
+int64_t CodecPool::sTTLUs = -1ll;
+sp<CodecPool> CodecPool::sInstance;
+
+// static
+int64_t CodecPool::GetTTL() {
+    Mutex::Autolock autoLock(sLock);
+
+    if (sTTLUs < 0ll) {
+        char value[PROPERTY_VALUE_MAX];
+        if (property_get("media.stagefright.codec-pool-ms", value, NULL)
+                && atoi(value) > 0) {
+            sTTLUs = atoi(value) * 1000ll;
+        } else {
+            sTTLUs = 0ll;
+        }
+    }
+
+    return sTTLUs;
+}
+
+// static
+void CodecPool::SetTTL(int64_t ttlUs) {
+    Mutex::Autolock autoLock(sLock);
+
+    sTTLUs = ttlUs > 0ll ? ttlUs : 0ll;
+
+    if (sTTLUs == 0ll && sInstance != NULL) {
+        (new AMessage(kWhatFlush, sInstance->id()))->post();
+    }
+}
+
+// static
+sp<CodecPool> CodecPool::getInstance() {
+    Mutex::Autolock autoLock(sLock);
+
+    if (sInstance == NULL) {
+        sInstance = new CodecPool;
+
+        sInstance->mLooper = new ALooper;
+        sInstance->mLooper->setName("CodecPool");
+        sInstance->mLooper->start();
+        sInstance->mLooper->registerHandler(sInstance);
+    }
+
+    return sInstance;
+}
+
+CodecPool::CodecPool()
+    : mNextID(1) {
+}
+
+CodecPool::~CodecPool() {
+}
+
+void CodecPool::add(
+        const AString &componentName,
+        const sp<CodecBase> &codec,
+        const sp<ALooper> &codecLooper,
+        bool reusable) {
+    Entry entry;
+    entry.mComponentName = componentName;
+    entry.mIsEncoder = false;
+    entry.mIsSecure = componentName.endsWith(".secure");
+    entry.mCodec = codec;
+    entry.mCodecLooper = codecLooper;
+
+    AString tmp = componentName;
+    if (entry.mIsSecure) {
+        tmp.erase(tmp.size() - 7, 7);
+    }
+
+    const sp<IMediaCodecList> mcl = MediaCodecList::getInstance();
+    ssize_t codecIdx = mcl != NULL ? mcl->findCodecByName(tmp.c_str()) : -1;
+    if (codecIdx >= 0) {
+        const sp<MediaCodecInfo> info = mcl->getCodecInfo(codecIdx);
+        info->getSupportedMimes(&entry.mMimes);
+        entry.mIsEncoder = info->isEncoder();
+    }
+
+    int64_t ttlUs = GetTTL();
+
+    Mutex::Autolock autoLock(mLock);
+
+    entry.mID = mNextID++;
+
+    sp<AMessage> notify = new AMessage(kWhatCodecNotify, id());
+    notify->setInt32("id", entry.mID);
+    codec->setNotificationMessage(notify);
+
+    if (ttlUs == 0ll || !reusable) {
+        freeEntry_l(entry);
+        return;
+    }
+
+    ALOGV("pooling %s for %" PRId64 " ms", componentName.c_str(), ttlUs / 1000);
+
+    mEntries.push_front(entry);
+
+    while (mEntries.size() > kMaxPooledCodecs) {
+        List<Entry>::iterator oldest = --mEntries.end();
+        freeEntry_l(*oldest);
+        mEntries.erase(oldest);
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatExpire, id());
+    msg->setInt32("id", entry.mID);
+    msg->post(ttlUs);
+}
+
+bool CodecPool::acquire(
+        const AString &name, bool nameIsType, bool encoder,
+        sp<CodecBase> *codec,
+        sp<ALooper> *codecLooper,
+        AString *componentName) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (List<Entry>::iterator it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (!matches_l(*it, name, nameIsType, encoder)) {
+            continue;
+        }
+
+        ALOGV("reusing pooled %s", it->mComponentName.c_str());
+
+        *codec = it->mCodec;
+        *codecLooper = it->mCodecLooper;
+        *componentName = it->mComponentName;
+
+        // its expiry message will find nothing to do
+        mEntries.erase(it);
+        return true;
+    }
+
+    return false;
+}
+
+bool CodecPool::matches_l(
+        const Entry &entry,
+        const AString &name, bool nameIsType, bool encoder) const {
+    if (!nameIsType) {
+        return entry.mComponentName == name;
+    }
+
+    // creating by type never picks a secure component
+    if (entry.mIsSecure || entry.mIsEncoder != encoder) {
+        return false;
+    }
+
+    for (size_t i = 0; i < entry.mMimes.size(); ++i) {
+        if (entry.mMimes[i].equalsIgnoreCase(name)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void CodecPool::freeEntry_l(const Entry &entry) {
+    ALOGV("freeing pooled %s", entry.mComponentName.c_str());
+
+    mShuttingDown.add(entry.mID, entry);
+    entry.mCodec->initiateShutdown(false /* keepComponentAllocated */);
+}
+
+void CodecPool::onCodecGone(int32_t id) {
+    Entry entry;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        ssize_t index = mShuttingDown.indexOfKey(id);
+        if (index >= 0) {
+            entry = mShuttingDown.valueAt(index);
+            mShuttingDown.removeItemsAt(index);
+        } else {
+            List<Entry>::iterator it = mEntries.begin();
+            while (it != mEntries.end() && it->mID != id) {
+                ++it;
+            }
+
+            if (it == mEntries.end()) {
+                return;
+            }
+
+            entry = *it;
+            mEntries.erase(it);
+        }
+    }
+
+    // Dropping the last reference to the codec looper stops its thread,
+    // which must not happen with mLock held.
+    entry.mCodecLooper->unregisterHandler(entry.mCodec->id());
+}
+
+void CodecPool::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatCodecNotify:
+        {
+            int32_t what;
+            CHECK(msg->findInt32("what", &what));
+
+            int32_t id;
+            CHECK(msg->findInt32("id", &id));
+
+            if (what == CodecBase::kWhatShutdownCompleted) {
+                onCodecGone(id);
+            } else if (what == CodecBase::kWhatError) {
+                // Most likely mediaserver died, there's nothing left to free.
+                ALOGW("pooled codec %d signaled an error", id);
+                onCodecGone(id);
+            }
+            break;
+        }
+
+        case kWhatExpire:
+        {
+            int32_t id;
+            CHECK(msg->findInt32("id", &id));
+
+            Mutex::Autolock autoLock(mLock);
+
+            for (List<Entry>::iterator it = mEntries.begin();
+                    it != mEntries.end(); ++it) {
+                if (it->mID == id) {
+                    freeEntry_l(*it);
+                    mEntries.erase(it);
+                    break;
+                }
+            }
+            break;
+        }
+
+        case kWhatFlush:
+        {
+            Mutex::Autolock autoLock(mLock);
+
+            while (!mEntries.empty()) {
+                freeEntry_l(*mEntries.begin());
+                mEntries.erase(mEntries.begin());
+            }
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+}  // namespace android
@@ -19,10 +19,12 @@
 #include <inttypes.h>
 
 #include "include/avc_utils.h"
+#include "include/CodecPool.h"
 #include "include/SoftwareRenderer.h"
 
 #include <binder/IBatteryStats.h>
 #include <binder/IServiceManager.h>
+#include <cutils/atomic.h>
 #include <gui/Surface.h>
 #include <media/ICrypto.h>
 #include <media/stagefright/foundation/ABuffer.h>
@@ -44,6 +46,55 @@
 
 namespace android {
 
+static bool sUseFastDequeue = true;
+
+// Ring of buffers dequeued ahead of time. push() must only ever be called
+// from one thread (the looper) and pop() from one thread at a time.
+struct MediaCodec::FastDequeueRing {
+    FastDequeueRing()
+        : mHead(0),
+          mTail(0) {
+    }
+
+    size_t size() const {
+        return android_atomic_acquire_load(&mTail)
+                - android_atomic_acquire_load(&mHead);
+    }
+
+    bool push(const BufferDescriptor &dequeued) {
+        int32_t tail = mTail;
+        if (tail - android_atomic_acquire_load(&mHead) == (int32_t)kCapacity) {
+            return false;
+        }
+
+        mEntries[tail & (kCapacity - 1)] = dequeued;
+        android_atomic_release_store(tail + 1, &mTail);
+        return true;
+    }
+
+    bool pop(BufferDescriptor *dequeued) {
+        int32_t head = mHead;
+        if (head == android_atomic_acquire_load(&mTail)) {
+            return false;
+        }
+
+        *dequeued = mEntries[head & (kCapacity - 1)];
+        android_atomic_release_store(head + 1, &mHead);
+        return true;
+    }
+
+private:
+    enum {
+        kCapacity = 64,  // must be a power of 2
+    };
+
+    BufferDescriptor mEntries[kCapacity];
+    volatile int32_t mHead;  // only written by the consumer
+    volatile int32_t mTail;  // only written by the producer
+
+    DISALLOW_EVIL_CONSTRUCTORS(FastDequeueRing);
+};
+
 struct MediaCodec::BatteryNotifier : public Singleton<BatteryNotifier> {
     BatteryNotifier();
 
@@ -149,11 +200,30 @@ MediaCodec::MediaCodec(const sp<ALooper> &looper)
       mDequeueInputReplyID(0),
       mDequeueOutputTimeoutGeneration(0),
       mDequeueOutputReplyID(0),
+      mUseFastDequeue(sUseFastDequeue),
       mHaveInputSurface(false) {
+    mFastDequeueRing[kPortIndexInput] = new FastDequeueRing;
+    mFastDequeueRing[kPortIndexOutput] = new FastDequeueRing;
 }
 
 MediaCodec::~MediaCodec() {
     CHECK_EQ(mState, UNINITIALIZED);
+
+    delete mFastDequeueRing[kPortIndexInput];
+    mFastDequeueRing[kPortIndexInput] = NULL;
+
+    delete mFastDequeueRing[kPortIndexOutput];
+    mFastDequeueRing[kPortIndexOutput] = NULL;
+}
+
+// static
+void MediaCodec::SetUseFastDequeue(bool use) {
+    sUseFastDequeue = use;
+}
+
+// static
+void MediaCodec::SetCodecPoolTTL(int64_t ttlUs) {
+    CodecPool::SetTTL(ttlUs);
 }
 
 // static
@@ -185,6 +255,25 @@ status_t MediaCodec::init(const AString &name, bool nameIsType, bool encoder) {
     mInitNameIsType = nameIsType;
     mInitIsEncoder = encoder;
 
+    bool usePool = CodecPool::GetTTL() > 0ll;
+
+    AString pooledComponentName;
+    if (usePool && CodecPool::getInstance()->acquire(
+                name, nameIsType, encoder,
+                &mCodec, &mCodecLooper, &pooledComponentName)) {
+        mLooper->registerHandler(this);
+
+        mCodec->setNotificationMessage(new AMessage(kWhatCodecNotify, id()));
+
+        sp<AMessage> msg = new AMessage(kWhatInit, id());
+        msg->setString("name", pooledComponentName);
+        msg->setInt32("nameIsType", false);
+        msg->setInt32("pooled", true);
+
+        sp<AMessage> response;
+        return PostAndAwaitResponse(msg, &response);
+    }
+
     // Current video decoders do not return from OMX_FillThisBuffer
     // quickly, violating the OpenMAX specs, until that is remedied
     // we need to invest in an extra looper to free the main event
@@ -213,7 +302,8 @@ status_t MediaCodec::init(const AString &name, bool nameIsType, bool encoder) {
         }
     }
 
-    if (needDedicatedLooper) {
+    // Pooled codecs outlive this instance and must not depend on mLooper.
+    if (needDedicatedLooper || usePool) {
         if (mCodecLooper == NULL) {
             mCodecLooper = new ALooper;
             mCodecLooper->setName("CodecLooper");
@@ -419,6 +509,12 @@ status_t MediaCodec::queueSecureInputBuffer(
 }
 
 status_t MediaCodec::dequeueInputBuffer(size_t *index, int64_t timeoutUs) {
+    BufferDescriptor dequeued;
+    if (popFastDequeuedBuffer(kPortIndexInput, &dequeued, false /* mayBlock */)) {
+        *index = dequeued.mIndex;
+        return OK;
+    }
+
     sp<AMessage> msg = new AMessage(kWhatDequeueInputBuffer, id());
     msg->setInt64("timeoutUs", timeoutUs);
 
@@ -440,6 +536,16 @@ status_t MediaCodec::dequeueOutputBuffer(
         int64_t *presentationTimeUs,
         uint32_t *flags,
         int64_t timeoutUs) {
+    BufferDescriptor dequeued;
+    if (popFastDequeuedBuffer(kPortIndexOutput, &dequeued, false /* mayBlock */)) {
+        *index = dequeued.mIndex;
+        *offset = dequeued.mOffset;
+        *size = dequeued.mSize;
+        *presentationTimeUs = dequeued.mTimeUs;
+        *flags = dequeued.mFlags;
+        return OK;
+    }
+
     sp<AMessage> msg = new AMessage(kWhatDequeueOutputBuffer, id());
     msg->setInt64("timeoutUs", timeoutUs);
 
@@ -485,6 +591,121 @@ status_t MediaCodec::releaseOutputBuffer(size_t index) {
     return PostAndAwaitResponse(msg, &response);
 }
 
+status_t MediaCodec::queueInputBuffers(
+        const BufferDescriptor *buffers, size_t count, size_t *numDone,
+        AString *errorDetailMsg) {
+    if (errorDetailMsg != NULL) {
+        errorDetailMsg->clear();
+    }
+
+    *numDone = 0;
+    if (count == 0) {
+        return OK;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatQueueInputBuffers, id());
+    msg->setPointer("buffers", (void *)buffers);
+    msg->setSize("count", count);
+    msg->setPointer("errorDetailMsg", errorDetailMsg);
+
+    sp<AMessage> response;
+    status_t err = PostAndAwaitResponse(msg, &response);
+
+    if (response != NULL) {
+        response->findSize("numDone", numDone);
+    }
+
+    return err;
+}
+
+status_t MediaCodec::dequeueInputBuffers(
+        size_t *indices, size_t maxCount, size_t *count, int64_t timeoutUs) {
+    *count = 0;
+    if (maxCount == 0) {
+        return OK;
+    }
+
+    BufferDescriptor dequeued;
+    while (*count < maxCount
+            && popFastDequeuedBuffer(kPortIndexInput, &dequeued, false /* mayBlock */)) {
+        indices[(*count)++] = dequeued.mIndex;
+    }
+
+    if (*count > 0) {
+        return OK;
+    }
+
+    // The looper republishes whatever else is available once it hands out
+    // the first buffer, pick those up without another round trip.
+    status_t err = dequeueInputBuffer(&indices[0], timeoutUs);
+    if (err != OK) {
+        return err;
+    }
+
+    *count = 1;
+    while (*count < maxCount
+            && popFastDequeuedBuffer(kPortIndexInput, &dequeued, false /* mayBlock */)) {
+        indices[(*count)++] = dequeued.mIndex;
+    }
+
+    return OK;
+}
+
+status_t MediaCodec::dequeueOutputBuffers(
+        BufferDescriptor *buffers, size_t maxCount, size_t *count, int64_t timeoutUs) {
+    *count = 0;
+    if (maxCount == 0) {
+        return OK;
+    }
+
+    while (*count < maxCount
+            && popFastDequeuedBuffer(kPortIndexOutput, &buffers[*count], false /* mayBlock */)) {
+        ++*count;
+    }
+
+    if (*count > 0) {
+        return OK;
+    }
+
+    BufferDescriptor *first = &buffers[0];
+    status_t err = dequeueOutputBuffer(
+            &first->mIndex, &first->mOffset, &first->mSize,
+            &first->mTimeUs, &first->mFlags, timeoutUs);
+    if (err != OK) {
+        return err;
+    }
+
+    *count = 1;
+    while (*count < maxCount
+            && popFastDequeuedBuffer(kPortIndexOutput, &buffers[*count], false /* mayBlock */)) {
+        ++*count;
+    }
+
+    return OK;
+}
+
+status_t MediaCodec::releaseOutputBuffers(
+        const size_t *indices, size_t count, bool render, size_t *numDone) {
+    *numDone = 0;
+    if (count == 0) {
+        return OK;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffers, id());
+    msg->setPointer("indices", (void *)indices);
+    msg->setSize("count", count);
+    msg->setInt32("render", render);
+
+    sp<AMessage> response;
+    status_t err = PostAndAwaitResponse(msg, &response);
+
+    if (response != NULL) {
+        response->findSize("numDone", numDone);
+    }
+
+    return err;
+}
+
 status_t MediaCodec::signalEndOfInputStream() {
     sp<AMessage> msg = new AMessage(kWhatSignalEndOfInputStream, id());
 
@@ -650,15 +871,21 @@ bool MediaCodec::handleDequeueInputBuffer(uint32_t replyID, bool newRequest) {
         return true;
     }
 
-    ssize_t index = dequeuePortBuffer(kPortIndexInput);
+    // buffers handed out ahead of time come first
+    BufferDescriptor dequeued;
+    if (!popFastDequeuedBuffer(kPortIndexInput, &dequeued, true /* mayBlock */)) {
+        ssize_t index = dequeuePortBuffer(kPortIndexInput);
 
-    if (index < 0) {
-        CHECK_EQ(index, -EAGAIN);
-        return false;
+        if (index < 0) {
+            CHECK_EQ(index, -EAGAIN);
+            return false;
+        }
+
+        dequeued.mIndex = index;
     }
 
     sp<AMessage> response = new AMessage;
-    response->setSize("index", index);
+    response->setSize("index", dequeued.mIndex);
     response->postReply(replyID);
 
     return true;
@@ -679,40 +906,25 @@ bool MediaCodec::handleDequeueOutputBuffer(uint32_t replyID, bool newRequest) {
         response->setInt32("err", INFO_FORMAT_CHANGED);
         mFlags &= ~kFlagOutputFormatChanged;
     } else {
-        ssize_t index = dequeuePortBuffer(kPortIndexOutput);
-
-        if (index < 0) {
-            CHECK_EQ(index, -EAGAIN);
-            return false;
-        }
-
-        const sp<ABuffer> &buffer =
-            mPortBuffers[kPortIndexOutput].itemAt(index).mData;
-
-        response->setSize("index", index);
-        response->setSize("offset", buffer->offset());
-        response->setSize("size", buffer->size());
-
-        int64_t timeUs;
-        CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
-
-        response->setInt64("timeUs", timeUs);
-
-        int32_t omxFlags;
-        CHECK(buffer->meta()->findInt32("omxFlags", &omxFlags));
+        // buffers handed out ahead of time come first, there are none
+        // while output buffers or format changes are pending
+        BufferDescriptor dequeued;
+        if (!popFastDequeuedBuffer(kPortIndexOutput, &dequeued, true /* mayBlock */)) {
+            ssize_t index = dequeuePortBuffer(kPortIndexOutput);
+
+            if (index < 0) {
+                CHECK_EQ(index, -EAGAIN);
+                return false;
+            }
 
-        uint32_t flags = 0;
-        if (omxFlags & OMX_BUFFERFLAG_SYNCFRAME) {
-            flags |= BUFFER_FLAG_SYNCFRAME;
-        }
-        if (omxFlags & OMX_BUFFERFLAG_CODECCONFIG) {
-            flags |= BUFFER_FLAG_CODECCONFIG;
-        }
-        if (omxFlags & OMX_BUFFERFLAG_EOS) {
-            flags |= BUFFER_FLAG_EOS;
+            fillDequeuedBuffer(kPortIndexOutput, index, &dequeued);
         }
 
-        response->setInt32("flags", flags);
+        response->setSize("index", dequeued.mIndex);
+        response->setSize("offset", dequeued.mOffset);
+        response->setSize("size", dequeued.mSize);
+        response->setInt64("timeUs", dequeued.mTimeUs);
+        response->setInt32("flags", dequeued.mFlags);
     }
 
     response->postReply(replyID);
@@ -772,6 +984,12 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
 
                             sendErrorResponse = false;
 
+                            if (mFlags & kFlagReturnToPool) {
+                                // don't hand a failing component to
+                                // anyone else.
+                                setStickyError(err);
+                            }
+
                             if (mFlags & kFlagSawMediaServerDie) {
                                 // MediaServer died, there definitely won't
                                 // be a shutdown complete notification after
@@ -784,6 +1002,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                                 if (mState == RELEASING) {
                                     mComponentName.clear();
                                 }
+                                mFlags &= ~kFlagReturnToPool;
                                 (new AMessage)->postReply(mReplyID);
                             }
                             break;
@@ -863,22 +1082,10 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                 case CodecBase::kWhatComponentAllocated:
                 {
                     CHECK_EQ(mState, INITIALIZING);
-                    setState(INITIALIZED);
-                    mFlags |= kFlagIsComponentAllocated;
-
-                    CHECK(msg->findString("componentName", &mComponentName));
-
-                    if (mComponentName.startsWith("OMX.google.")) {
-                        mFlags |= kFlagIsSoftwareCodec;
-                    } else {
-                        mFlags &= ~kFlagIsSoftwareCodec;
-                    }
 
-                    if (mComponentName.endsWith(".secure")) {
-                        mFlags |= kFlagIsSecure;
-                    } else {
-                        mFlags &= ~kFlagIsSecure;
-                    }
+                    AString componentName;
+                    CHECK(msg->findString("componentName", &componentName));
+                    onComponentAllocated(componentName);
 
                     (new AMessage)->postReply(mReplyID);
                     break;
@@ -932,10 +1139,14 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
 
                 case CodecBase::kWhatBuffersAllocated:
                 {
-                    Mutex::Autolock al(mBufferLock);
                     int32_t portIndex;
                     CHECK(msg->findInt32("portIndex", &portIndex));
 
+                    // buffers handed out ahead of time belong to the old set
+                    reclaimFastDequeueBuffers(portIndex);
+
+                    Mutex::Autolock al(mBufferLock);
+
                     ALOGV("%s buffers allocated",
                           portIndex == kPortIndexInput ? "input" : "output");
 
@@ -1008,6 +1219,9 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                     } else if (mFlags & kFlagIsAsync) {
                         onOutputFormatChanged();
                     } else {
+                        // the format change is reported before any buffer
+                        // that is still available
+                        reclaimFastDequeueBuffers(kPortIndexOutput);
                         mFlags |= kFlagOutputFormatChanged;
                         postActivityNotificationIfPossible();
                     }
@@ -1060,6 +1274,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                         mFlags &= ~kFlagDequeueInputPending;
                         mDequeueInputReplyID = 0;
                     } else {
+                        publishFastDequeueBuffers(kPortIndexInput);
                         postActivityNotificationIfPossible();
                     }
                     break;
@@ -1103,6 +1318,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                         if (mFlags & kFlagIsAsync) {
                             onOutputFormatChanged();
                         } else {
+                            reclaimFastDequeueBuffers(kPortIndexOutput);
                             mFlags |= kFlagOutputFormatChanged;
                         }
                     }
@@ -1116,6 +1332,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                         mFlags &= ~kFlagDequeueOutputPending;
                         mDequeueOutputReplyID = 0;
                     } else {
+                        publishFastDequeueBuffers(kPortIndexOutput);
                         postActivityNotificationIfPossible();
                     }
 
@@ -1135,7 +1352,20 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                         setState(INITIALIZED);
                     } else {
                         CHECK_EQ(mState, RELEASING);
+                        bool reusable = !(mFlags & kFlagStickyError);
                         setState(UNINITIALIZED);
+
+                        if (mFlags & kFlagReturnToPool) {
+                            // The component is still allocated, the pool
+                            // frees it once nobody picked it up in time.
+                            CodecPool::getInstance()->add(
+                                    mComponentName, mCodec, mCodecLooper, reusable);
+
+                            mCodec.clear();
+                            mCodecLooper.clear();
+                            mFlags &= ~kFlagReturnToPool;
+                        }
+
                         mComponentName.clear();
                     }
                     mFlags &= ~kFlagIsComponentAllocated;
@@ -1185,6 +1415,15 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             AString name;
             CHECK(msg->findString("name", &name));
 
+            int32_t pooled;
+            if (msg->findInt32("pooled", &pooled) && pooled) {
+                // the component is allocated already
+                onComponentAllocated(name);
+
+                (new AMessage)->postReply(mReplyID);
+                break;
+            }
+
             int32_t nameIsType;
             int32_t encoder = false;
             CHECK(msg->findInt32("nameIsType", &nameIsType));
@@ -1369,11 +1608,24 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
+            // Healthy components on a looper of their own can be handed
+            // to the next client instead of being freed.
+            bool returnToPool = msg->what() == kWhatRelease
+                && mCodecLooper != NULL
+                && !(mFlags & (kFlagIsSecure | kFlagStickyError))
+                && !mHaveInputSurface
+                && (mState == INITIALIZED || mState == CONFIGURED || isExecuting())
+                && CodecPool::GetTTL() > 0ll;
+
+            if (returnToPool) {
+                mFlags |= kFlagReturnToPool;
+            }
+
             mReplyID = replyID;
             setState(msg->what() == kWhatStop ? STOPPING : RELEASING);
 
             mCodec->initiateShutdown(
-                    msg->what() == kWhatStop /* keepComponentAllocated */);
+                    msg->what() == kWhatStop || returnToPool /* keepComponentAllocated */);
 
             returnBuffersToCodec();
             break;
@@ -1397,6 +1649,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             }
 
             if (handleDequeueInputBuffer(replyID, true /* new request */)) {
+                publishFastDequeueBuffers(kPortIndexInput);
                 break;
             }
 
@@ -1459,6 +1712,57 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatQueueInputBuffers:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            if (!isExecuting()) {
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagStickyError) {
+                PostReplyWithError(replyID, getStickyError());
+                break;
+            }
+
+            const BufferDescriptor *buffers;
+            size_t count;
+            AString *errorDetailMsg;
+            CHECK(msg->findPointer("buffers", (void **)&buffers));
+            CHECK(msg->findSize("count", &count));
+            CHECK(msg->findPointer("errorDetailMsg", (void **)&errorDetailMsg));
+
+            // onQueueInputBuffer takes its arguments as a message, reuse
+            // a single one for the whole batch.
+            sp<AMessage> entry = new AMessage;
+            entry->setPointer("errorDetailMsg", errorDetailMsg);
+
+            status_t err = OK;
+            size_t numDone = 0;
+            while (numDone < count) {
+                const BufferDescriptor &buffer = buffers[numDone];
+                entry->setSize("index", buffer.mIndex);
+                entry->setSize("offset", buffer.mOffset);
+                entry->setSize("size", buffer.mSize);
+                entry->setInt64("timeUs", buffer.mTimeUs);
+                entry->setInt32("flags", buffer.mFlags);
+
+                err = onQueueInputBuffer(entry);
+                if (err != OK) {
+                    break;
+                }
+                ++numDone;
+            }
+
+            sp<AMessage> response = new AMessage;
+            response->setSize("numDone", numDone);
+            if (err != OK) {
+                response->setInt32("err", err);
+            }
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatDequeueOutputBuffer:
         {
             uint32_t replyID;
@@ -1471,6 +1775,8 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             }
 
             if (handleDequeueOutputBuffer(replyID, true /* new request */)) {
+                // buffers held back by a format change can go out now
+                publishFastDequeueBuffers(kPortIndexOutput);
                 break;
             }
 
@@ -1533,6 +1839,50 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatReleaseOutputBuffers:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            if (!isExecuting()) {
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagStickyError) {
+                PostReplyWithError(replyID, getStickyError());
+                break;
+            }
+
+            const size_t *indices;
+            size_t count;
+            int32_t render;
+            CHECK(msg->findPointer("indices", (void **)&indices));
+            CHECK(msg->findSize("count", &count));
+            CHECK(msg->findInt32("render", &render));
+
+            sp<AMessage> entry = new AMessage;
+            entry->setInt32("render", render);
+
+            status_t err = OK;
+            size_t numDone = 0;
+            while (numDone < count) {
+                entry->setSize("index", indices[numDone]);
+
+                err = onReleaseOutputBuffer(entry);
+                if (err != OK) {
+                    break;
+                }
+                ++numDone;
+            }
+
+            sp<AMessage> response = new AMessage;
+            response->setSize("numDone", numDone);
+            if (err != OK) {
+                response->setInt32("err", err);
+            }
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatSignalEndOfInputStream:
         {
             uint32_t replyID;
@@ -1635,7 +1985,10 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
 
         case kWhatRequestIDRFrame:
         {
-            mCodec->signalRequestIDRFrame();
+            // the codec may have gone back to the pool
+            if (mCodec != NULL) {
+                mCodec->signalRequestIDRFrame();
+            }
             break;
         }
 
@@ -1731,7 +2084,29 @@ status_t MediaCodec::queueCSDInputBuffer(size_t bufferIndex) {
     return onQueueInputBuffer(msg);
 }
 
+void MediaCodec::onComponentAllocated(const AString &componentName) {
+    setState(INITIALIZED);
+    mFlags |= kFlagIsComponentAllocated;
+
+    mComponentName = componentName;
+
+    if (mComponentName.startsWith("OMX.google.")) {
+        mFlags |= kFlagIsSoftwareCodec;
+    } else {
+        mFlags &= ~kFlagIsSoftwareCodec;
+    }
+
+    if (mComponentName.endsWith(".secure")) {
+        mFlags |= kFlagIsSecure;
+    } else {
+        mFlags &= ~kFlagIsSecure;
+    }
+}
+
 void MediaCodec::setState(State newState) {
+    // only STARTED hands out buffers ahead of time
+    reclaimFastDequeueBuffers();
+
     if (newState == INITIALIZED || newState == UNINITIALIZED) {
         delete mSoftRenderer;
         mSoftRenderer = NULL;
@@ -2042,6 +2417,127 @@ ssize_t MediaCodec::dequeuePortBuffer(int32_t portIndex) {
     return index;
 }
 
+void MediaCodec::fillDequeuedBuffer(
+        int32_t portIndex, size_t index, BufferDescriptor *dequeued) const {
+    dequeued->mIndex = index;
+    dequeued->mOffset = 0;
+    dequeued->mSize = 0;
+    dequeued->mTimeUs = 0ll;
+    dequeued->mFlags = 0;
+
+    if (portIndex == kPortIndexInput) {
+        return;
+    }
+
+    const sp<ABuffer> &buffer = mPortBuffers[portIndex].itemAt(index).mData;
+
+    dequeued->mOffset = buffer->offset();
+    dequeued->mSize = buffer->size();
+    CHECK(buffer->meta()->findInt64("timeUs", &dequeued->mTimeUs));
+
+    int32_t omxFlags;
+    CHECK(buffer->meta()->findInt32("omxFlags", &omxFlags));
+
+    if (omxFlags & OMX_BUFFERFLAG_SYNCFRAME) {
+        dequeued->mFlags |= BUFFER_FLAG_SYNCFRAME;
+    }
+    if (omxFlags & OMX_BUFFERFLAG_CODECCONFIG) {
+        dequeued->mFlags |= BUFFER_FLAG_CODECCONFIG;
+    }
+    if (omxFlags & OMX_BUFFERFLAG_EOS) {
+        dequeued->mFlags |= BUFFER_FLAG_EOS;
+    }
+}
+
+bool MediaCodec::popFastDequeuedBuffer(
+        int32_t portIndex, BufferDescriptor *dequeued, bool mayBlock) {
+    Mutex &lock = mFastDequeueLock[portIndex];
+
+    if (mayBlock) {
+        lock.lock();
+    } else if (lock.tryLock() != OK) {
+        // another thread is dequeueing, leave it to the looper
+        return false;
+    }
+
+    bool found = mFastDequeueRing[portIndex]->pop(dequeued);
+    lock.unlock();
+
+    return found;
+}
+
+void MediaCodec::publishFastDequeueBuffers(int32_t portIndex) {
+    if (!mUseFastDequeue
+            || mState != STARTED
+            || (mFlags & (kFlagIsAsync | kFlagStickyError))) {
+        return;
+    }
+
+    if (portIndex == kPortIndexInput) {
+        if (mHaveInputSurface
+                || !mCSD.empty()
+                || (mFlags & kFlagDequeueInputPending)) {
+            return;
+        }
+    } else if (mFlags & (kFlagDequeueOutputPending
+                    | kFlagOutputBuffersChanged
+                    | kFlagOutputFormatChanged
+                    | kFlagGatherCodecSpecificData)) {
+        return;
+    }
+
+    FastDequeueRing *ring = mFastDequeueRing[portIndex];
+    while (!mAvailPortBuffers[portIndex].empty()) {
+        size_t index = *mAvailPortBuffers[portIndex].begin();
+
+        BufferDescriptor dequeued;
+        if (portIndex == kPortIndexOutput) {
+            fillDequeuedBuffer(portIndex, index, &dequeued);
+        } else {
+            dequeued.mIndex = index;
+        }
+
+        if (!ring->push(dequeued)) {
+            // the rest stays available through the looper
+            break;
+        }
+
+        CHECK_EQ(dequeuePortBuffer(portIndex), (ssize_t)index);
+    }
+}
+
+void MediaCodec::reclaimFastDequeueBuffers(int32_t portIndex) {
+    Vector<size_t> indices;
+    {
+        Mutex::Autolock autoLock(mFastDequeueLock[portIndex]);
+
+        BufferDescriptor dequeued;
+        while (mFastDequeueRing[portIndex]->pop(&dequeued)) {
+            indices.push(dequeued.mIndex);
+        }
+    }
+
+    if (indices.isEmpty()) {
+        return;
+    }
+
+    ALOGV("reclaiming %zu %s buffers", indices.size(),
+            portIndex == kPortIndexInput ? "input" : "output");
+
+    // these were never seen by the client, make them available again
+    // ahead of everything that came in after them
+    Mutex::Autolock al(mBufferLock);
+    for (size_t i = indices.size(); i-- > 0;) {
+        mPortBuffers[portIndex].editItemAt(indices[i]).mOwnedByClient = false;
+        mAvailPortBuffers[portIndex].push_front(indices[i]);
+    }
+}
+
+void MediaCodec::reclaimFastDequeueBuffers() {
+    reclaimFastDequeueBuffers(kPortIndexInput);
+    reclaimFastDequeueBuffers(kPortIndexOutput);
+}
+
 status_t MediaCodec::setNativeWindow(
         const sp<Surface> &surfaceTextureClient) {
     status_t err;
@@ -2156,18 +2652,22 @@ void MediaCodec::postActivityNotificationIfPossible() {
                     | kFlagOutputBuffersChanged
                     | kFlagOutputFormatChanged));
 
+    // buffers handed out ahead of time are still available to the client
+    size_t numInputBuffers = mAvailPortBuffers[kPortIndexInput].size()
+            + mFastDequeueRing[kPortIndexInput]->size();
+    size_t numOutputBuffers = mAvailPortBuffers[kPortIndexOutput].size()
+            + mFastDequeueRing[kPortIndexOutput]->size();
+
     if (isErrorOrOutputChanged
-            || !mAvailPortBuffers[kPortIndexInput].empty()
-            || !mAvailPortBuffers[kPortIndexOutput].empty()) {
-        mActivityNotify->setInt32("input-buffers",
-                mAvailPortBuffers[kPortIndexInput].size());
+            || numInputBuffers > 0
+            || numOutputBuffers > 0) {
+        mActivityNotify->setInt32("input-buffers", numInputBuffers);
 
         if (isErrorOrOutputChanged) {
             // we want consumer to dequeue as many times as it can
             mActivityNotify->setInt32("output-buffers", INT32_MAX);
         } else {
-            mActivityNotify->setInt32("output-buffers",
-                    mAvailPortBuffers[kPortIndexOutput].size());
+            mActivityNotify->setInt32("output-buffers", numOutputBuffers);
         }
         mActivityNotify->post();
         mActivityNotify.clear();
@@ -2183,6 +2683,10 @@ status_t MediaCodec::setParameters(const sp<AMessage> &params) {
 }
 
 status_t MediaCodec::onSetParameters(const sp<AMessage> &params) {
+    if (mCodec == NULL) {
+        return INVALID_OPERATION;
+    }
+
     mCodec->signalSetParameters(params);
 
     return OK;
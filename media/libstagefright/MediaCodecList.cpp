@@ -19,6 +19,8 @@
 #include <utils/Log.h>
 
 #include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
+#include <cutils/properties.h>
 
 #include <media/IMediaCodecList.h>
 #include <media/IMediaPlayerService.h>
@@ -31,12 +33,37 @@
 #include <media/stagefright/OMXClient.h>
 #include <media/stagefright/OMXCodec.h>
 
+#include <utils/SortedVector.h>
 #include <utils/threads.h>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <libexpat/expat.h>
 
 namespace android {
 
+// Holds the fully populated list, only valid for the XML files, OMX
+// components and build it was created from.
+static const char *kCacheFile = "/data/misc/media/media_codecs.cache";
+static const int32_t kCacheMagic = 'mclc';
+static const int32_t kCacheVersion = 1;
+
+// Capability queries allocate a node for each component and type, which
+// is mostly waiting on the component's initialization.
+static const size_t kMaxQueryThreads = 4;
+
+struct MediaCodecList::CapabilityQuery {
+    sp<MediaCodecInfo> mInfo;
+    AString mMime;
+    bool mIsSoleMime;
+    status_t mResult;
+    CodecCapabilities mCaps;
+};
+
 static Mutex sInitMutex;
 
 static MediaCodecList *gCodecList = NULL;
@@ -83,7 +110,8 @@ sp<IMediaCodecList> MediaCodecList::getInstance() {
 }
 
 MediaCodecList::MediaCodecList()
-    : mInitCheck(NO_INIT) {
+    : mInitCheck(NO_INIT),
+      mNextQuery(0) {
     parseTopLevelXMLFile("/etc/media_codecs.xml");
 }
 
@@ -104,7 +132,17 @@ void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml) {
         return;
     }
     mOMX = client.interface();
+
+    Parcel cacheKey;
+    bool haveCacheKey = makeCacheKey(codecs_xml, &cacheKey) == OK;
+
+    if (haveCacheKey && readCache(cacheKey) == OK) {
+        mOMX.clear();
+        return;
+    }
+
     parseXMLFile(codecs_xml);
+    queryCapabilities();
     mOMX.clear();
 
     if (mInitCheck != OK) {
@@ -163,6 +201,10 @@ void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml) {
         }
     }
 
+    if (haveCacheKey) {
+        writeCache(cacheKey);
+    }
+
 #if 0
     for (size_t i = 0; i < mCodecInfos.size(); ++i) {
         const CodecInfo &info = mCodecInfos.itemAt(i);
@@ -184,6 +226,154 @@ void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml) {
 }
 
 MediaCodecList::~MediaCodecList() {
+    for (size_t i = 0; i < mQueries.size(); ++i) {
+        delete mQueries.itemAt(i);
+    }
+}
+
+status_t MediaCodecList::makeCacheKey(const char *codecs_xml, Parcel *key) const {
+    key->writeInt32(kCacheMagic);
+    key->writeInt32(kCacheVersion);
+
+    char fingerprint[PROPERTY_VALUE_MAX];
+    property_get("ro.build.fingerprint", fingerprint, "");
+    AString(fingerprint).writeToParcel(key);
+
+    // Includes are restricted to media_codecs_*.xml files next to the top
+    // level file, any of them changing invalidates the cache.
+    SortedVector<AString> files;
+    files.add(AString(codecs_xml));
+
+    DIR *dir = opendir(mHrefBase.size() > 0 ? mHrefBase.c_str() : ".");
+    if (dir != NULL) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            AString filename = entry->d_name;
+            if (filename.startsWith("media_codecs_") && filename.endsWith(".xml")) {
+                filename.insert(mHrefBase, 0);
+                files.add(filename);
+            }
+        }
+        closedir(dir);
+    }
+
+    key->writeInt32(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        const AString &path = files.itemAt(i);
+
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            st.st_size = -1;
+            st.st_mtime = 0;
+        }
+
+        path.writeToParcel(key);
+        key->writeInt64(st.st_size);
+        key->writeInt64(st.st_mtime);
+    }
+
+    List<IOMX::ComponentInfo> components;
+    status_t err = mOMX->listNodes(&components);
+    if (err != OK) {
+        return err;
+    }
+
+    key->writeInt32(components.size());
+    for (List<IOMX::ComponentInfo>::iterator it = components.begin();
+            it != components.end(); ++it) {
+        key->writeString8(it->mName);
+        key->writeInt32(it->mRoles.size());
+        for (List<String8>::iterator role = it->mRoles.begin();
+                role != it->mRoles.end(); ++role) {
+            key->writeString8(*role);
+        }
+    }
+
+    return OK;
+}
+
+status_t MediaCodecList::readCache(const Parcel &key) {
+    int fd = open(kCacheFile, O_RDONLY);
+    if (fd < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= (off_t)key.dataSize()) {
+        close(fd);
+        return ERROR_MALFORMED;
+    }
+
+    size_t size = st.st_size;
+    uint8_t *data = new uint8_t[size];
+    ssize_t n = read(fd, data, size);
+    close(fd);
+
+    if (n != (ssize_t)size || memcmp(data, key.data(), key.dataSize())) {
+        ALOGI("codec list cache is stale");
+        delete[] data;
+        return ERROR_MALFORMED;
+    }
+
+    Parcel parcel;
+    parcel.setData(data, size);
+    parcel.setDataPosition(key.dataSize());
+    delete[] data;
+
+    size_t numInfos = parcel.readInt32();
+    if (numInfos > size) {
+        return ERROR_MALFORMED;
+    }
+
+    Vector<sp<MediaCodecInfo> > infos;
+    for (size_t i = 0; i < numInfos; ++i) {
+        sp<MediaCodecInfo> info = MediaCodecInfo::FromParcel(parcel);
+        if (info == NULL) {
+            return ERROR_MALFORMED;
+        }
+        infos.push_back(info);
+    }
+
+    // guards against truncated files
+    if (parcel.readInt32() != kCacheMagic) {
+        return ERROR_MALFORMED;
+    }
+
+    ALOGV("read %zu codecs from cache", infos.size());
+    mCodecInfos = infos;
+
+    return OK;
+}
+
+void MediaCodecList::writeCache(const Parcel &key) const {
+    Parcel parcel;
+    parcel.setData(key.data(), key.dataSize());
+    parcel.setDataPosition(key.dataSize());
+
+    parcel.writeInt32(mCodecInfos.size());
+    for (size_t i = 0; i < mCodecInfos.size(); ++i) {
+        mCodecInfos.itemAt(i)->writeToParcel(&parcel);
+    }
+    parcel.writeInt32(kCacheMagic);
+
+    // write to a temporary file first so readers never see a partial one
+    AString tmpFile = kCacheFile;
+    tmpFile.append(".tmp");
+
+    int fd = open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        ALOGV("unable to create %s", tmpFile.c_str());
+        return;
+    }
+
+    ssize_t n = write(fd, parcel.data(), parcel.dataSize());
+    close(fd);
+
+    if (n != (ssize_t)parcel.dataSize()
+            || rename(tmpFile.c_str(), kCacheFile) != 0) {
+        ALOGW("unable to write codec list cache");
+        unlink(tmpFile.c_str());
+    }
 }
 
 status_t MediaCodecList::initCheck() const {
@@ -483,13 +673,12 @@ status_t MediaCodecList::addMediaCodecFromAttributes(
 
     mCurrentInfo = new MediaCodecInfo(name, encoder, type);
     // The next step involves trying to load the codec, which may
-    // fail.  Only list the codec if this succeeds.
+    // fail.  The codec is dropped from the list again in that case
+    // once all queries are done.
     // However, keep mCurrentInfo object around until parsing
     // of full codec info is completed.
-    if (initializeCapabilities(type) == OK) {
-        mCodecInfos.push_back(mCurrentInfo);
-    }
-    return OK;
+    mCodecInfos.push_back(mCurrentInfo);
+    return initializeCapabilities(type);
 }
 
 status_t MediaCodecList::initializeCapabilities(const char *type) {
@@ -500,18 +689,89 @@ status_t MediaCodecList::initializeCapabilities(const char *type) {
     ALOGV("initializeCapabilities %s:%s",
             mCurrentInfo->mName.c_str(), type);
 
-    CodecCapabilities caps;
-    status_t err = QueryCodec(
-            mOMX,
-            mCurrentInfo->mName.c_str(),
-            type,
-            mCurrentInfo->mIsEncoder,
-            &caps);
-    if (err != OK) {
-        return err;
+    CapabilityQuery *query = new CapabilityQuery;
+    query->mInfo = mCurrentInfo;
+    query->mMime = type;
+    query->mIsSoleMime = mCurrentInfo->mHasSoleMime;
+    query->mResult = NO_INIT;
+    mQueries.push_back(query);
+
+    return OK;
+}
+
+void MediaCodecList::queryCapabilities() {
+    if (mInitCheck != OK || mQueries.empty()) {
+        return;
+    }
+
+    size_t numThreads = mQueries.size() < kMaxQueryThreads
+        ? mQueries.size() : kMaxQueryThreads;
+
+    // the calling thread takes its share of the queries as well
+    Vector<pthread_t> threads;
+    for (size_t i = 1; i < numThreads; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, QueryThreadWrapper, this) == 0) {
+            threads.push_back(thread);
+        }
     }
 
-    return mCurrentInfo->initializeCapabilities(caps);
+    runQueries();
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        pthread_join(threads.itemAt(i), NULL);
+    }
+
+    for (size_t i = 0; i < mQueries.size(); ++i) {
+        CapabilityQuery *query = mQueries.itemAt(i);
+        const sp<MediaCodecInfo> &info = query->mInfo;
+
+        if (query->mResult == OK) {
+            info->initializeCapabilities(query->mMime.c_str(), query->mCaps);
+        } else if (!query->mIsSoleMime) {
+            // Handle this gracefully (by not reporting such mime).
+            info->removeMime(query->mMime.c_str());
+        } else {
+            // Only list the codec if loading it succeeded.
+            for (size_t j = mCodecInfos.size(); j-- > 0;) {
+                if (mCodecInfos.itemAt(j) == info) {
+                    mCodecInfos.removeAt(j);
+                    break;
+                }
+            }
+        }
+
+        delete query;
+    }
+
+    mQueries.clear();
+}
+
+// static
+void *MediaCodecList::QueryThreadWrapper(void *me) {
+    static_cast<MediaCodecList *>(me)->runQueries();
+    return NULL;
+}
+
+void MediaCodecList::runQueries() {
+    for (;;) {
+        CapabilityQuery *query;
+
+        {
+            Mutex::Autolock autoLock(mQueryLock);
+            if (mNextQuery >= mQueries.size()) {
+                break;
+            }
+            query = mQueries.itemAt(mNextQuery++);
+        }
+
+        query->mResult = QueryCodec(
+                mOMX,
+                query->mInfo->mName.c_str(),
+                query->mMime.c_str(),
+                query->mInfo->mIsEncoder,
+                &query->mCaps);
+    }
 }
 
 status_t MediaCodecList::addQuirk(const char **attrs) {
@@ -568,11 +828,8 @@ status_t MediaCodecList::addTypeFromAttributes(const char **attrs) {
     }
 
     // The next step involves trying to load the codec, which may
-    // fail.  Handle this gracefully (by not reporting such mime).
-    if (initializeCapabilities(name) != OK) {
-        mCurrentInfo->removeMime(name);
-    }
-    return OK;
+    // fail, such mimes are removed once all queries are done.
+    return initializeCapabilities(name);
 }
 
 // legacy method for non-advanced codecs
@@ -30,52 +30,89 @@
 
 namespace android {
 
+// A sparse map of cached pages keyed by their absolute offset in the
+// underlying source. Pages never overlap, but need not be contiguous, so
+// several disjoint byte ranges (e.g. the "moov" atom at the end of a file
+// and the sample data near its start) can be cached at the same time.
 struct PageCache {
-    PageCache(size_t pageSize);
+    PageCache();
     ~PageCache();
 
     struct Page {
+        off64_t mOffset;
         void *mData;
         size_t mSize;
+        size_t mCapacity;
+        uint32_t mLastUse;
     };
 
-    Page *acquirePage();
+    // Returns a page able to hold at least "capacity" bytes.
+    Page *acquirePage(size_t capacity);
     void releasePage(Page *page);
 
-    void appendPage(Page *page);
-    size_t releaseFromStart(size_t maxBytes);
+    // Takes ownership of "page", which must not overlap any cached page.
+    void insertPage(Page *page);
+
+    // Releases least recently used pages outside of
+    // [keepFrom, keepTo) until at least "maxBytes" have been freed or no
+    // more pages are eligible. Returns the number of bytes released.
+    size_t evict(size_t maxBytes, off64_t keepFrom, off64_t keepTo);
 
     size_t totalSize() const {
         return mTotalSize;
     }
 
-    void copy(size_t from, void *data, size_t size);
+    size_t numRanges() const;
+
+    // Returns the number of bytes cached contiguously starting at "offset".
+    size_t contiguousSizeAt(off64_t offset) const;
+
+    // Returns the offset of the first cached page starting after "offset",
+    // or -1 if there is none.
+    off64_t nextPageOffsetAfter(off64_t offset) const;
+
+    // Returns the number of cached bytes within [from, to).
+    size_t sizeWithin(off64_t from, off64_t to) const;
+
+    // Copies at most "size" contiguously cached bytes starting at "offset",
+    // returns the number of bytes copied.
+    size_t copy(off64_t offset, void *data, size_t size);
 
 private:
-    size_t mPageSize;
     size_t mTotalSize;
+    uint32_t mUseCounter;
 
-    List<Page *> mActivePages;
+    KeyedVector<off64_t, Page *> mActivePages;
     List<Page *> mFreePages;
 
-    void freePages(List<Page *> *list);
+    // Returns the index of the page containing "offset" or -1.
+    ssize_t indexOfPageContaining(off64_t offset) const;
+
+    // Returns the index of the last page starting at or before "offset"
+    // or -1.
+    ssize_t indexOfFloor(off64_t offset) const;
+
+    void removePageAt(size_t index);
 
     DISALLOW_EVIL_CONSTRUCTORS(PageCache);
 };
 
-PageCache::PageCache(size_t pageSize)
-    : mPageSize(pageSize),
-      mTotalSize(0) {
+PageCache::PageCache()
+    : mTotalSize(0),
+      mUseCounter(0) {
 }
 
 PageCache::~PageCache() {
-    freePages(&mActivePages);
-    freePages(&mFreePages);
-}
+    for (size_t i = 0; i < mActivePages.size(); ++i) {
+        Page *page = mActivePages.valueAt(i);
+
+        free(page->mData);
+        delete page;
+    }
+    mActivePages.clear();
 
-void PageCache::freePages(List<Page *> *list) {
-    List<Page *>::iterator it = list->begin();
-    while (it != list->end()) {
+    List<Page *>::iterator it = mFreePages.begin();
+    while (it != mFreePages.end()) {
         Page *page = *it;
 
         free(page->mData);
@@ -86,95 +123,255 @@ void PageCache::freePages(List<Page *> *list) {
     }
 }
 
-PageCache::Page *PageCache::acquirePage() {
+PageCache::Page *PageCache::acquirePage(size_t capacity) {
     if (!mFreePages.empty()) {
         List<Page *>::iterator it = mFreePages.begin();
         Page *page = *it;
         mFreePages.erase(it);
 
+        if (page->mCapacity < capacity) {
+            free(page->mData);
+            page->mData = malloc(capacity);
+            page->mCapacity = capacity;
+        }
+
         return page;
     }
 
     Page *page = new Page;
-    page->mData = malloc(mPageSize);
+    page->mOffset = -1;
+    page->mData = malloc(capacity);
     page->mSize = 0;
+    page->mCapacity = capacity;
+    page->mLastUse = 0;
 
     return page;
 }
 
 void PageCache::releasePage(Page *page) {
+    page->mOffset = -1;
     page->mSize = 0;
     mFreePages.push_back(page);
 }
 
-void PageCache::appendPage(Page *page) {
+void PageCache::insertPage(Page *page) {
+    CHECK_GE(page->mOffset, 0ll);
+    CHECK_GT(page->mSize, 0u);
+    CHECK_EQ(contiguousSizeAt(page->mOffset), 0u);
+
+    off64_t next = nextPageOffsetAfter(page->mOffset);
+    CHECK(next < 0 || page->mOffset + (off64_t)page->mSize <= next);
+
+    page->mLastUse = ++mUseCounter;
+
+    mActivePages.add(page->mOffset, page);
     mTotalSize += page->mSize;
-    mActivePages.push_back(page);
 }
 
-size_t PageCache::releaseFromStart(size_t maxBytes) {
-    size_t bytesReleased = 0;
+void PageCache::removePageAt(size_t index) {
+    Page *page = mActivePages.valueAt(index);
+    mActivePages.removeItemsAt(index);
 
-    while (maxBytes > 0 && !mActivePages.empty()) {
-        List<Page *>::iterator it = mActivePages.begin();
+    mTotalSize -= page->mSize;
+    releasePage(page);
+}
 
-        Page *page = *it;
+static int CompareLastUse(
+        PageCache::Page *const *a, PageCache::Page *const *b) {
+    // Use counts wrap around, only their distance is meaningful
+    int32_t diff = (int32_t)((*a)->mLastUse - (*b)->mLastUse);
+    return diff < 0 ? -1 : (diff > 0 ? 1 : 0);
+}
 
-        if (maxBytes < page->mSize) {
-            break;
+size_t PageCache::evict(size_t maxBytes, off64_t keepFrom, off64_t keepTo) {
+    // Candidates outside of the keep window, least recently used first
+    Vector<Page *> candidates;
+    for (size_t i = 0; i < mActivePages.size(); ++i) {
+        Page *page = mActivePages.valueAt(i);
+
+        if (page->mOffset + (off64_t)page->mSize > keepFrom
+                && page->mOffset < keepTo) {
+            continue;
         }
+        candidates.push(page);
+    }
+    candidates.sort(CompareLastUse);
+
+    // Victims are marked by their offset, the pages are keyed separately
+    size_t bytesReleased = 0;
+    for (size_t i = 0; i < candidates.size() && bytesReleased < maxBytes; ++i) {
+        bytesReleased += candidates[i]->mSize;
+        candidates.editItemAt(i)->mOffset = -1;
+    }
 
-        mActivePages.erase(it);
+    if (bytesReleased == 0) {
+        return 0;
+    }
 
-        maxBytes -= page->mSize;
-        bytesReleased += page->mSize;
+    KeyedVector<off64_t, Page *> keptPages;
+    keptPages.setCapacity(mActivePages.size());
+    for (size_t i = 0; i < mActivePages.size(); ++i) {
+        Page *page = mActivePages.valueAt(i);
 
-        releasePage(page);
+        if (page->mOffset < 0) {
+            mTotalSize -= page->mSize;
+            releasePage(page);
+        } else {
+            // Offsets come in increasing order, so this appends
+            keptPages.add(page->mOffset, page);
+        }
     }
+    mActivePages = keptPages;
 
-    mTotalSize -= bytesReleased;
     return bytesReleased;
 }
 
-void PageCache::copy(size_t from, void *data, size_t size) {
-    ALOGV("copy from %zu size %zu", from, size);
+size_t PageCache::numRanges() const {
+    size_t numRanges = 0;
+    off64_t prevEnd = -1;
+    for (size_t i = 0; i < mActivePages.size(); ++i) {
+        const Page *page = mActivePages.valueAt(i);
+        if (page->mOffset != prevEnd) {
+            ++numRanges;
+        }
+        prevEnd = page->mOffset + page->mSize;
+    }
 
-    if (size == 0) {
-        return;
+    return numRanges;
+}
+
+ssize_t PageCache::indexOfFloor(off64_t offset) const {
+    ssize_t lo = 0;
+    ssize_t hi = (ssize_t)mActivePages.size() - 1;
+    ssize_t index = -1;
+
+    while (lo <= hi) {
+        ssize_t mid = lo + (hi - lo) / 2;
+        if (mActivePages.keyAt(mid) <= offset) {
+            index = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
     }
 
-    CHECK_LE(from + size, mTotalSize);
+    return index;
+}
 
-    size_t offset = 0;
-    List<Page *>::iterator it = mActivePages.begin();
-    while (from >= offset + (*it)->mSize) {
-        offset += (*it)->mSize;
-        ++it;
+ssize_t PageCache::indexOfPageContaining(off64_t offset) const {
+    ssize_t index = indexOfFloor(offset);
+
+    if (index < 0) {
+        return -1;
     }
 
-    size_t delta = from - offset;
-    size_t avail = (*it)->mSize - delta;
+    const Page *page = mActivePages.valueAt(index);
+    if (offset >= page->mOffset + (off64_t)page->mSize) {
+        return -1;
+    }
 
-    if (avail >= size) {
-        memcpy(data, (const uint8_t *)(*it)->mData + delta, size);
-        return;
+    return index;
+}
+
+size_t PageCache::contiguousSizeAt(off64_t offset) const {
+    ssize_t index = indexOfPageContaining(offset);
+
+    if (index < 0) {
+        return 0;
     }
 
-    memcpy(data, (const uint8_t *)(*it)->mData + delta, avail);
-    ++it;
-    data = (uint8_t *)data + avail;
-    size -= avail;
+    const Page *page = mActivePages.valueAt(index);
+    size_t size = page->mOffset + page->mSize - offset;
+    off64_t end = page->mOffset + page->mSize;
 
-    while (size > 0) {
-        size_t copy = (*it)->mSize;
-        if (copy > size) {
-            copy = size;
+    for (size_t i = index + 1; i < mActivePages.size(); ++i) {
+        page = mActivePages.valueAt(i);
+        if (page->mOffset != end) {
+            break;
         }
-        memcpy(data, (*it)->mData, copy);
-        data = (uint8_t *)data + copy;
-        size -= copy;
-        ++it;
+
+        size += page->mSize;
+        end += page->mSize;
+    }
+
+    return size;
+}
+
+off64_t PageCache::nextPageOffsetAfter(off64_t offset) const {
+    size_t index = indexOfFloor(offset) + 1;
+
+    if (index >= mActivePages.size()) {
+        return -1;
     }
+
+    return mActivePages.keyAt(index);
+}
+
+size_t PageCache::sizeWithin(off64_t from, off64_t to) const {
+    size_t size = 0;
+    ssize_t index = indexOfFloor(from);
+    if (index < 0) {
+        index = 0;
+    }
+
+    for (size_t i = index; i < mActivePages.size(); ++i) {
+        const Page *page = mActivePages.valueAt(i);
+        if (page->mOffset >= to) {
+            break;
+        }
+
+        off64_t start = page->mOffset > from ? page->mOffset : from;
+        off64_t end = page->mOffset + (off64_t)page->mSize;
+        if (end > to) {
+            end = to;
+        }
+
+        if (end > start) {
+            size += end - start;
+        }
+    }
+
+    return size;
+}
+
+size_t PageCache::copy(off64_t offset, void *data, size_t size) {
+    ALOGV("copy from %lld size %zu", offset, size);
+
+    ssize_t index = indexOfPageContaining(offset);
+    if (size == 0 || index < 0) {
+        return 0;
+    }
+
+    uint32_t use = ++mUseCounter;
+
+    size_t copied = 0;
+    while (copied < size && (size_t)index < mActivePages.size()) {
+        Page *page = mActivePages.valueAt(index);
+        if (page->mOffset != offset) {
+            if (copied > 0) {
+                // Reached the end of this contiguous range.
+                break;
+            }
+        }
+
+        size_t delta = offset - page->mOffset;
+        size_t avail = page->mSize - delta;
+        if (avail > size - copied) {
+            avail = size - copied;
+        }
+
+        memcpy((uint8_t *)data + copied,
+               (const uint8_t *)page->mData + delta,
+               avail);
+
+        page->mLastUse = use;
+
+        copied += avail;
+        offset += avail;
+        ++index;
+    }
+
+    return copied;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -186,13 +383,22 @@ NuCachedSource2::NuCachedSource2(
     : mSource(source),
       mReflector(new AHandlerReflector<NuCachedSource2>(this)),
       mLooper(new ALooper),
-      mCache(new PageCache(kPageSize)),
-      mCacheOffset(0),
+      mCache(new PageCache),
+      mFetchOffset(0),
       mFinalStatus(OK),
       mLastAccessPos(0),
       mFetching(true),
       mDisconnecting(false),
       mLastFetchTimeUs(-1),
+      mFetchSize(kPageSize),
+      mNumFetches(0),
+      mNumRanges(1),
+      mBytesFetched(0),
+      mFetchTimeUs(0),
+      mConsumeStartPos(0),
+      mConsumeStartTimeUs(-1),
+      mConsumerBytesPerSec(0),
+      mAdaptiveWatermarks(true),
       mNumRetriesLeft(kMaxNumRetries),
       mHighwaterThresholdBytes(kDefaultHighWaterThreshold),
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
@@ -311,6 +517,8 @@ void NuCachedSource2::fetchInternal() {
     ALOGV("fetchInternal");
 
     bool reconnect = false;
+    off64_t offset;
+    size_t size;
 
     {
         Mutex::Autolock autoLock(mLock);
@@ -318,14 +526,28 @@ void NuCachedSource2::fetchInternal() {
 
         if (mFinalStatus != OK) {
             --mNumRetriesLeft;
+            ++mNumRanges;
 
             reconnect = true;
         }
+
+        // Keep-alives only need to touch the connection.
+        size = mFetching ? mFetchSize : kPageSize;
+
+        // The current range may have caught up with a range that was
+        // cached earlier, skip over the data we already have.
+        mFetchOffset += mCache->contiguousSizeAt(mFetchOffset);
+        offset = mFetchOffset;
+
+        // Never fetch data overlapping the next cached range.
+        off64_t nextPageOffset = mCache->nextPageOffsetAfter(offset);
+        if (nextPageOffset >= 0 && nextPageOffset - offset < (off64_t)size) {
+            size = nextPageOffset - offset;
+        }
     }
 
     if (reconnect) {
-        status_t err =
-            mSource->reconnectAtOffset(mCacheOffset + mCache->totalSize());
+        status_t err = mSource->reconnectAtOffset(offset);
 
         Mutex::Autolock autoLock(mLock);
 
@@ -346,13 +568,16 @@ void NuCachedSource2::fetchInternal() {
         }
     }
 
-    PageCache::Page *page = mCache->acquirePage();
+    PageCache::Page *page = mCache->acquirePage(size);
 
-    ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+    int64_t startTimeUs = ALooper::GetNowUs();
+    ssize_t n = mSource->readAt(offset, page->mData, size);
+    int64_t delayUs = ALooper::GetNowUs() - startTimeUs;
 
     Mutex::Autolock autoLock(mLock);
 
+    ++mNumFetches;
+
     if (n == 0 || mDisconnecting) {
         ALOGI("ERROR_END_OF_STREAM");
 
@@ -377,11 +602,113 @@ void NuCachedSource2::fetchInternal() {
         mNumRetriesLeft = kMaxNumRetries;
         mFinalStatus = OK;
 
+        mBytesFetched += n;
+        mFetchTimeUs += delayUs;
+
+        page->mOffset = offset;
         page->mSize = n;
-        mCache->appendPage(page);
+        mCache->insertPage(page);
+
+        mFetchOffset = offset + n;
+        mFetchOffset += mCache->contiguousSizeAt(mFetchOffset);
+
+        updateFetchParams_l();
     }
 }
 
+void NuCachedSource2::updateFetchParams_l() {
+    // Prefer the estimate of the HTTP layer, it covers all traffic on the
+    // connection, fall back to the throughput of our own reads otherwise.
+    int32_t bandwidthBps;
+    if (!(mSource->flags() & kIsHTTPBasedSource)
+            || !static_cast<HTTPBase *>(mSource.get())->estimateBandwidth(
+                    &bandwidthBps)) {
+        if (mFetchTimeUs <= 0) {
+            return;
+        }
+
+        bandwidthBps = mBytesFetched * 8000000ll / mFetchTimeUs;
+    }
+
+    // Size reads so that each takes about kTargetFetchDurationUs, fast
+    // links get fewer and larger requests.
+    int64_t fetchSize =
+        (int64_t)bandwidthBps / 8 * kTargetFetchDurationUs / 1000000ll;
+
+    fetchSize = (fetchSize / kPageSize) * kPageSize;
+    if (fetchSize < kPageSize) {
+        fetchSize = kPageSize;
+    } else if (fetchSize > kMaxFetchSize) {
+        fetchSize = kMaxFetchSize;
+    }
+
+    if ((size_t)fetchSize != mFetchSize) {
+        ALOGV("bandwidth %d bps, fetch size %zu -> %" PRId64 " bytes",
+              bandwidthBps, mFetchSize, fetchSize);
+
+        mFetchSize = fetchSize;
+    }
+
+    if (!mAdaptiveWatermarks || mConsumerBytesPerSec <= 0) {
+        return;
+    }
+
+    // Restart prefetching early enough that the data remaining covers
+    // kLowWaterDurationUs of playback, and that refilling is worth a new
+    // burst of requests on links barely faster than the content.
+    int64_t lowwater = mConsumerBytesPerSec * kLowWaterDurationUs / 1000000ll;
+    if (bandwidthBps / 8 < 2 * mConsumerBytesPerSec) {
+        lowwater *= 2;
+    }
+
+    if (lowwater < kDefaultLowWaterThreshold) {
+        lowwater = kDefaultLowWaterThreshold;
+    } else if (lowwater > (int64_t)mHighwaterThresholdBytes / 2) {
+        lowwater = mHighwaterThresholdBytes / 2;
+    }
+
+    mLowwaterThresholdBytes = lowwater;
+}
+
+void NuCachedSource2::updateConsumerRate_l() {
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (mConsumeStartTimeUs < 0) {
+        mConsumeStartTimeUs = nowUs;
+        mConsumeStartPos = mLastAccessPos;
+        return;
+    }
+
+    int64_t elapsedUs = nowUs - mConsumeStartTimeUs;
+    if (elapsedUs < kConsumerRateWindowUs) {
+        return;
+    }
+
+    if (mLastAccessPos > mConsumeStartPos) {
+        int64_t bytesPerSec =
+            (mLastAccessPos - mConsumeStartPos) * 1000000ll / elapsedUs;
+
+        // Smooth out the burst of reads at start-up and after seeks.
+        mConsumerBytesPerSec = (mConsumerBytesPerSec <= 0)
+            ? bytesPerSec : (3 * mConsumerBytesPerSec + bytesPerSec) / 4;
+    }
+
+    mConsumeStartTimeUs = nowUs;
+    mConsumeStartPos = mLastAccessPos;
+}
+
+void NuCachedSource2::getFetchStats(FetchStats *stats) {
+    Mutex::Autolock autoLock(mLock);
+
+    stats->mNumFetches = mNumFetches;
+    stats->mNumRanges = mNumRanges;
+    stats->mBytesFetched = mBytesFetched;
+    stats->mThroughputKbps =
+        (mFetchTimeUs > 0) ? mBytesFetched * 8000ll / mFetchTimeUs : 0;
+    stats->mFetchSize = mFetchSize;
+    stats->mConsumerKbps = mConsumerBytesPerSec * 8 / 1000;
+}
+
 void NuCachedSource2::onFetch() {
     ALOGV("onFetch");
 
@@ -405,8 +732,22 @@ void NuCachedSource2::onFetch() {
 
         mLastFetchTimeUs = ALooper::GetNowUs();
 
+        bool cacheFull = false;
         if (mFetching && mCache->totalSize() >= mHighwaterThresholdBytes) {
-            ALOGI("Cache full, done prefetching for now");
+            // Make room for the next page by dropping the least recently
+            // used data outside of the range currently being streamed.
+            Mutex::Autolock autoLock(mLock);
+            trimCache_l(
+                    mCache->totalSize() - mHighwaterThresholdBytes + mFetchSize);
+
+            cacheFull = mCache->totalSize() >= mHighwaterThresholdBytes;
+        }
+
+        if (cacheFull) {
+            ALOGI("Cache full, done prefetching for now "
+                  "(%zu reads in %zu ranges, %" PRId64 " bytes at %" PRId64 " kbps)",
+                  mNumFetches, mNumRanges, mBytesFetched,
+                  (mFetchTimeUs > 0) ? mBytesFetched * 8000ll / mFetchTimeUs : 0);
             mFetching = false;
 
             if (mDisconnectAtHighwatermark
@@ -471,35 +812,68 @@ void NuCachedSource2::onRead(const sp<AMessage> &msg) {
 
 void NuCachedSource2::restartPrefetcherIfNecessary_l(
         bool ignoreLowWaterThreshold, bool force) {
-    static const size_t kGrayArea = 1024 * 1024;
-
     if (mFetching || (mFinalStatus != OK && mNumRetriesLeft == 0)) {
         return;
     }
 
     if (!ignoreLowWaterThreshold && !force
-            && mCacheOffset + mCache->totalSize() - mLastAccessPos
-                >= mLowwaterThresholdBytes) {
+            && mFetchOffset - mLastAccessPos
+                >= (off64_t)mLowwaterThresholdBytes) {
         return;
     }
 
-    size_t maxBytes = mLastAccessPos - mCacheOffset;
-
     if (!force) {
-        if (maxBytes < kGrayArea) {
+        // Only restart if at least kGrayArea bytes can be fetched, either
+        // into free budget or by evicting data nobody is streaming from.
+        size_t totalSize = mCache->totalSize();
+        size_t available = (totalSize < mHighwaterThresholdBytes)
+            ? mHighwaterThresholdBytes - totalSize : 0;
+
+        off64_t keepFrom, keepTo;
+        getActiveWindow_l(&keepFrom, &keepTo);
+        available += totalSize - mCache->sizeWithin(keepFrom, keepTo);
+
+        if (available < kGrayArea) {
             return;
         }
-
-        maxBytes -= kGrayArea;
     }
 
-    size_t actualBytes = mCache->releaseFromStart(maxBytes);
-    mCacheOffset += actualBytes;
-
-    ALOGI("restarting prefetcher, totalSize = %zu", mCache->totalSize());
+    ALOGI("restarting prefetcher, totalSize = %zu in %zu range(s)",
+          mCache->totalSize(), mCache->numRanges());
     mFetching = true;
 }
 
+void NuCachedSource2::getActiveWindow_l(off64_t *from, off64_t *to) const {
+    *from = (mLastAccessPos > kGrayArea) ? mLastAccessPos - kGrayArea : 0;
+    *to = (mFetchOffset > mLastAccessPos) ? mFetchOffset : mLastAccessPos;
+}
+
+size_t NuCachedSource2::trimCache_l(size_t maxBytes) {
+    off64_t keepFrom, keepTo;
+    getActiveWindow_l(&keepFrom, &keepTo);
+
+    size_t bytesReleased = mCache->evict(maxBytes, keepFrom, keepTo);
+
+    ALOGV("evicted %zu bytes, totalSize = %zu in %zu range(s)",
+          bytesReleased, mCache->totalSize(), mCache->numRanges());
+
+    return bytesReleased;
+}
+
+bool NuCachedSource2::isInFetchRange_l(off64_t offset) const {
+    return offset <= mFetchOffset
+        && offset + (off64_t)mCache->contiguousSizeAt(offset) >= mFetchOffset;
+}
+
+void NuCachedSource2::updateLastAccessPos_l(off64_t offset, size_t size) {
+    // Reads served from other cached ranges do not move the position
+    // the prefetcher is working relative to.
+    if (isInFetchRange_l(offset)) {
+        mLastAccessPos = offset + size;
+        updateConsumerRate_l();
+    }
+}
+
 ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
     Mutex::Autolock autoSerializer(mSerializer);
 
@@ -510,14 +884,13 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         return ERROR_END_OF_STREAM;
     }
 
-    // If the request can be completely satisfied from the cache, do so.
+    // If the request can be completely satisfied from any cached range,
+    // do so.
 
-    if (offset >= mCacheOffset
-            && offset + size <= mCacheOffset + mCache->totalSize()) {
-        size_t delta = offset - mCacheOffset;
-        mCache->copy(delta, data, size);
+    if (mCache->contiguousSizeAt(offset) >= size) {
+        mCache->copy(offset, data, size);
 
-        mLastAccessPos = offset + size;
+        updateLastAccessPos_l(offset, size);
 
         return size;
     }
@@ -545,7 +918,7 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
     mAsyncResult.clear();
 
     if (result > 0) {
-        mLastAccessPos = offset + result;
+        updateLastAccessPos_l(offset, result);
     }
 
     return (ssize_t)result;
@@ -553,7 +926,7 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
 
 size_t NuCachedSource2::cachedSize() {
     Mutex::Autolock autoLock(mLock);
-    return mCacheOffset + mCache->totalSize();
+    return mFetchOffset;
 }
 
 size_t NuCachedSource2::approxDataRemaining(status_t *finalStatus) const {
@@ -569,9 +942,8 @@ size_t NuCachedSource2::approxDataRemaining_l(status_t *finalStatus) const {
         *finalStatus = OK;
     }
 
-    off64_t lastBytePosCached = mCacheOffset + mCache->totalSize();
-    if (mLastAccessPos < lastBytePosCached) {
-        return lastBytePosCached - mLastAccessPos;
+    if (mLastAccessPos < mFetchOffset) {
+        return mFetchOffset - mLastAccessPos;
     }
     return 0;
 }
@@ -583,15 +955,16 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
 
     Mutex::Autolock autoLock(mLock);
 
-    if (!mFetching) {
-        mLastAccessPos = offset;
-        restartPrefetcherIfNecessary_l(
-                false, // ignoreLowWaterThreshold
-                true); // force
+    // Any cached range can satisfy the request without disturbing the
+    // prefetcher.
+    if (mCache->contiguousSizeAt(offset) >= size) {
+        mCache->copy(offset, data, size);
+        updateLastAccessPos_l(offset, size);
+
+        return size;
     }
 
-    if (offset < mCacheOffset
-            || offset >= (off64_t)(mCacheOffset + mCache->totalSize())) {
+    if (!isInFetchRange_l(offset)) {
         static const off64_t kPadding = 256 * 1024;
 
         // In the presence of multiple decoded streams, once of them will
@@ -603,30 +976,29 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
         seekInternal_l(seekOffset);
     }
 
-    size_t delta = offset - mCacheOffset;
+    if (!mFetching) {
+        mLastAccessPos = offset;
+        restartPrefetcherIfNecessary_l(
+                false, // ignoreLowWaterThreshold
+                true); // force
+    }
 
     if (mFinalStatus != OK && mNumRetriesLeft == 0) {
-        if (delta >= mCache->totalSize()) {
+        size_t avail = mCache->contiguousSizeAt(offset);
+
+        if (avail == 0) {
             return mFinalStatus;
         }
 
-        size_t avail = mCache->totalSize() - delta;
-
         if (avail > size) {
             avail = size;
         }
 
-        mCache->copy(delta, data, avail);
+        mCache->copy(offset, data, avail);
 
         return avail;
     }
 
-    if (offset + size <= mCacheOffset + mCache->totalSize()) {
-        mCache->copy(delta, data, size);
-
-        return size;
-    }
-
     ALOGV("deferring read");
 
     return -EAGAIN;
@@ -635,17 +1007,19 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
 status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     mLastAccessPos = offset;
 
-    if (offset >= mCacheOffset
-            && offset <= (off64_t)(mCacheOffset + mCache->totalSize())) {
+    if (isInFetchRange_l(offset)) {
         return OK;
     }
 
     ALOGI("new range: offset= %lld", offset);
 
-    mCacheOffset = offset;
+    // Previously cached ranges are retained, they are only evicted once
+    // the cache exceeds its budget.
+    mFetchOffset = offset + mCache->contiguousSizeAt(offset);
+    ++mNumRanges;
 
-    size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
+    // Consumption measured across the jump is meaningless.
+    mConsumeStartTimeUs = -1;
 
     mNumRetriesLeft = kMaxNumRetries;
     mFetching = true;
@@ -694,7 +1068,8 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
         return;
     }
 
-    if (lowwaterMarkKb >= 0) {
+    bool lowwaterSet = (lowwaterMarkKb >= 0);
+    if (lowwaterSet) {
         mLowwaterThresholdBytes = lowwaterMarkKb * 1024;
     } else {
         mLowwaterThresholdBytes = kDefaultLowWaterThreshold;
@@ -711,8 +1086,13 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
 
         mLowwaterThresholdBytes = kDefaultLowWaterThreshold;
         mHighwaterThresholdBytes = kDefaultHighWaterThreshold;
+        lowwaterSet = false;
     }
 
+    // Only the low watermark adapts, an explicitly configured one is used
+    // as is.
+    mAdaptiveWatermarks = !lowwaterSet;
+
     if (keepAliveSecs >= 0) {
         mKeepAliveIntervalUs = keepAliveSecs * 1000000ll;
     } else {
@@ -69,12 +69,20 @@ SoftHEVC::SoftHEVC(
             320 /* width */, 240 /* height */, callbacks,
             appData, component),
       mMemRecords(NULL),
+      mNumThreads(0),
       mFlushOutBuffer(NULL),
       mOmxColorFormat(OMX_COLOR_FormatYUV420Planar),
       mIvColorFormat(IV_YUV_420P),
       mNewWidth(mWidth),
       mNewHeight(mHeight),
-      mChangingResolution(false) {
+      mChangingResolution(false),
+      mAsyncDecode(false),
+      mDecodeInInfo(NULL),
+      mDecodeOutInfo(NULL),
+      mDecodeTimeStampIx(0),
+      mDecodeState(DECODE_IDLE),
+      mDecodeThreadStarted(false),
+      mStopDecodeThread(false) {
     initPorts(kNumBuffers, INPUT_BUF_SIZE, kNumBuffers,
             CODEC_MIME_TYPE);
     CHECK_EQ(initDecoder(), (status_t)OK);
@@ -82,6 +90,7 @@ SoftHEVC::SoftHEVC(
 
 SoftHEVC::~SoftHEVC() {
     ALOGD("In SoftHEVC::~SoftHEVC");
+    stopDecodeThread();
     CHECK_EQ(deInitDecoder(), (status_t)OK);
 }
 
@@ -131,7 +140,8 @@ status_t SoftHEVC::setParams(size_t stride) {
     s_ctl_ip.u4_disp_wd = (UWORD32)stride;
     s_ctl_ip.e_frm_skip_mode = IVD_SKIP_NONE;
 
-    s_ctl_ip.e_frm_out_mode = IVD_DISPLAY_FRAME_OUT;
+    s_ctl_ip.e_frm_out_mode =
+        mOutputDecodeOrder ? IVD_DECODE_FRAME_OUT : IVD_DISPLAY_FRAME_OUT;
     s_ctl_ip.e_vid_dec_mode = IVD_DECODE_FRAME;
     s_ctl_ip.e_cmd = IVD_CMD_VIDEO_CTL;
     s_ctl_ip.e_sub_cmd = IVD_CMD_CTL_SETPARAMS;
@@ -243,7 +253,7 @@ status_t SoftHEVC::initDecoder() {
     UWORD32 u4_share_disp_buf;
     WORD32 i4_level;
 
-    mNumCores = GetCPUCoreCount();
+    mNumCores = mNumThreads > 0 ? mNumThreads : GetCPUCoreCount();
 
     /* Initialize number of ref and reorder modes (for HEVC) */
     u4_num_reorder_frames = 16;
@@ -463,12 +473,99 @@ void SoftHEVC::onReset() {
     resetPlugin();
 }
 
+OMX_ERRORTYPE SoftHEVC::getExtensionIndex(const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, "OMX.google.android.index.threadCount")) {
+        *(int32_t*)index = kThreadCountIndex;
+        return OMX_ErrorNone;
+    }
+
+    if (!strcmp(name, "OMX.google.android.index.asyncDecode")) {
+        *(int32_t*)index = kAsyncDecodeIndex;
+        return OMX_ErrorNone;
+    }
+
+    return SoftVideoDecoderOMXComponent::getExtensionIndex(name, index);
+}
+
+OMX_ERRORTYPE SoftHEVC::internalGetParameter(OMX_INDEXTYPE index, OMX_PTR params) {
+    // Include extension index OMX_INDEXEXTTYPE.
+    const int32_t indexFull = index;
+
+    switch (indexFull) {
+        case kThreadCountIndex:
+        {
+            OMX_PARAM_U32TYPE *threadCountParams = (OMX_PARAM_U32TYPE *)params;
+            threadCountParams->nU32 = MIN(mNumCores, CODEC_MAX_NUM_CORES);
+            return OMX_ErrorNone;
+        }
+
+        case kAsyncDecodeIndex:
+        {
+            OMX_CONFIG_BOOLEANTYPE *asyncParams = (OMX_CONFIG_BOOLEANTYPE *)params;
+            asyncParams->bEnabled = mAsyncDecode ? OMX_TRUE : OMX_FALSE;
+            return OMX_ErrorNone;
+        }
+
+        default:
+            return SoftVideoDecoderOMXComponent::internalGetParameter(index, params);
+    }
+}
+
 OMX_ERRORTYPE SoftHEVC::internalSetParameter(OMX_INDEXTYPE index, const OMX_PTR params) {
+    // Include extension index OMX_INDEXEXTTYPE.
+    const int32_t indexFull = index;
+
+    /* Parameters that reconfigure the decoder must not race the decode
+     * thread. onQueueFilled() runs under the same component lock as this
+     * call, so no new decode can start once the running one is done. A
+     * finished decode whose results were not picked up yet still refers to
+     * the current configuration, so reject the change until it is. */
+    switch (indexFull) {
+        case kThreadCountIndex:
+        case kAsyncDecodeIndex:
+        case kPrepareForAdaptivePlaybackIndex:
+        case kOutputDecodeOrderIndex:
+        case OMX_IndexParamPortDefinition:
+            if (waitForDecode() != DECODE_IDLE) {
+                return OMX_ErrorIncorrectStateOperation;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    switch (indexFull) {
+        case kThreadCountIndex:
+        {
+            const OMX_PARAM_U32TYPE *threadCountParams =
+                (const OMX_PARAM_U32TYPE *)params;
+            mNumThreads = threadCountParams->nU32;
+            mNumCores = mNumThreads > 0 ? mNumThreads : GetCPUCoreCount();
+            setNumCores();
+            return OMX_ErrorNone;
+        }
+
+        case kAsyncDecodeIndex:
+        {
+            const OMX_CONFIG_BOOLEANTYPE *asyncParams =
+                (const OMX_CONFIG_BOOLEANTYPE *)params;
+            mAsyncDecode = asyncParams->bEnabled;
+            return OMX_ErrorNone;
+        }
+
+        default:
+            break;
+    }
+
     const uint32_t oldWidth = mWidth;
     const uint32_t oldHeight = mHeight;
+    const bool oldOutputDecodeOrder = mOutputDecodeOrder;
     OMX_ERRORTYPE ret = SoftVideoDecoderOMXComponent::internalSetParameter(index, params);
     if (mWidth != oldWidth || mHeight != oldHeight) {
         reInitDecoder();
+    } else if (mOutputDecodeOrder != oldOutputDecodeOrder) {
+        setParams(outputBufferWidth());
     }
     return ret;
 }
@@ -540,6 +637,116 @@ void SoftHEVC::onPortFlushCompleted(OMX_U32 portIndex) {
     }
 }
 
+void SoftHEVC::decode() {
+    WORD32 timeDelay, timeTaken;
+
+    GETTIME(&mTimeStart, NULL);
+    /* Compute time elapsed between end of previous decode()
+     * to start of current decode() */
+    TIME_DIFF(mTimeEnd, mTimeStart, timeDelay);
+
+    mDecodeStatus = ivdec_api_function(mCodecCtx, (void *)&mDecodeIp, (void *)&mDecodeOp);
+
+    GETTIME(&mTimeEnd, NULL);
+    /* Compute time taken for decode() */
+    TIME_DIFF(mTimeStart, mTimeEnd, timeTaken);
+
+    ALOGV("timeTaken=%6d delay=%6d numBytes=%6d", timeTaken, timeDelay,
+           mDecodeOp.u4_num_bytes_consumed);
+}
+
+void SoftHEVC::startDecode() {
+    Mutex::Autolock autoLock(mDecodeLock);
+    CHECK_EQ((int)mDecodeState, (int)DECODE_IDLE);
+
+    if (!mDecodeThreadStarted) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+        CHECK_EQ(pthread_create(&mDecodeThread, &attr, DecodeThreadWrapper, this), 0);
+        pthread_attr_destroy(&attr);
+
+        mDecodeThreadStarted = true;
+    }
+
+    mDecodeState = DECODE_RUNNING;
+    mDecodeCondition.broadcast();
+}
+
+SoftHEVC::DecodeState SoftHEVC::waitForDecode() {
+    Mutex::Autolock autoLock(mDecodeLock);
+    while (mDecodeState == DECODE_RUNNING) {
+        mDecodeCondition.wait(mDecodeLock);
+    }
+    return mDecodeState;
+}
+
+void SoftHEVC::stopDecodeThread() {
+    {
+        Mutex::Autolock autoLock(mDecodeLock);
+        if (!mDecodeThreadStarted) {
+            return;
+        }
+
+        while (mDecodeState == DECODE_RUNNING) {
+            mDecodeCondition.wait(mDecodeLock);
+        }
+
+        mStopDecodeThread = true;
+        mDecodeCondition.broadcast();
+    }
+
+    pthread_join(mDecodeThread, NULL);
+    mDecodeThreadStarted = false;
+}
+
+// static
+void *SoftHEVC::DecodeThreadWrapper(void *me) {
+    static_cast<SoftHEVC *>(me)->decodeThread();
+    return NULL;
+}
+
+void SoftHEVC::decodeThread() {
+    Mutex::Autolock autoLock(mDecodeLock);
+
+    for (;;) {
+        while (mDecodeState != DECODE_RUNNING && !mStopDecodeThread) {
+            mDecodeCondition.wait(mDecodeLock);
+        }
+
+        if (mStopDecodeThread) {
+            break;
+        }
+
+        mDecodeLock.unlock();
+        decode();
+        mDecodeLock.lock();
+
+        mDecodeState = DECODE_DONE;
+        mDecodeCondition.broadcast();
+
+        signalQueueFilled(kOutputPortIndex);
+    }
+}
+
+void SoftHEVC::onReturningBuffers(OMX_U32 portIndex) {
+    UNUSED(portIndex);
+
+    /* The buffers of a decode in progress are about to be returned, its
+     * results are of no use anymore */
+    if (waitForDecode() == DECODE_DONE) {
+        if (mDecodeInInfo != NULL) {
+            mTimeStampsValid[mDecodeTimeStampIx] = false;
+        }
+
+        mDecodeInInfo = NULL;
+        mDecodeOutInfo = NULL;
+
+        Mutex::Autolock autoLock(mDecodeLock);
+        mDecodeState = DECODE_IDLE;
+    }
+}
+
 void SoftHEVC::onQueueFilled(OMX_U32 portIndex) {
     UNUSED(portIndex);
 
@@ -547,6 +754,17 @@ void SoftHEVC::onQueueFilled(OMX_U32 portIndex) {
         return;
     }
 
+    /* The decoder must not be touched while the decode thread runs, it will
+     * get us called again once it is done */
+    bool haveDecodeResult;
+    {
+        Mutex::Autolock autoLock(mDecodeLock);
+        if (mDecodeState == DECODE_RUNNING) {
+            return;
+        }
+        haveDecodeResult = (mDecodeState == DECODE_DONE);
+    }
+
     List<BufferInfo *> &inQueue = getPortQueue(kInputPortIndex);
     List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
 
@@ -556,7 +774,7 @@ void SoftHEVC::onQueueFilled(OMX_U32 portIndex) {
      * In that case, only after decoding that input data, decoder has to be
      * put in flush. This case is handled here  */
 
-    if (mReceivedEOS && !mIsInFlush) {
+    if (mReceivedEOS && !mIsInFlush && !haveDecodeResult) {
         setFlushMode();
     }
 
@@ -568,97 +786,111 @@ void SoftHEVC::onQueueFilled(OMX_U32 portIndex) {
         OMX_BUFFERHEADERTYPE *outHeader;
         size_t timeStampIx;
 
-        inInfo = NULL;
-        inHeader = NULL;
+        if (haveDecodeResult) {
+            /* Pick up where the decode thread left off */
+            haveDecodeResult = false;
 
-        if (!mIsInFlush) {
-            if (!inQueue.empty()) {
-                inInfo = *inQueue.begin();
-                inHeader = inInfo->mHeader;
-            } else {
-                break;
-            }
-        }
+            inInfo = mDecodeInInfo;
+            inHeader = inInfo != NULL ? inInfo->mHeader : NULL;
+            outInfo = mDecodeOutInfo;
+            outHeader = outInfo->mHeader;
+            timeStampIx = mDecodeTimeStampIx;
 
-        outInfo = *outQueue.begin();
-        outHeader = outInfo->mHeader;
-        outHeader->nFlags = 0;
-        outHeader->nTimeStamp = 0;
-        outHeader->nOffset = 0;
-
-        if (inHeader != NULL && (inHeader->nFlags & OMX_BUFFERFLAG_EOS)) {
-            ALOGD("EOS seen on input");
-            mReceivedEOS = true;
-            if (inHeader->nFilledLen == 0) {
-                inQueue.erase(inQueue.begin());
-                inInfo->mOwnedByUs = false;
-                notifyEmptyBufferDone(inHeader);
-                inHeader = NULL;
-                setFlushMode();
-            }
-        }
+            CHECK(inInfo == NULL || inInfo == *inQueue.begin());
+            CHECK(outInfo == *outQueue.begin());
 
-        // When there is an init required and the decoder is not in flush mode,
-        // update output port's definition and reinitialize decoder.
-        if (mInitNeeded && !mIsInFlush) {
-            bool portWillReset = false;
-            handlePortSettingsChange(&portWillReset, mNewWidth, mNewHeight);
+            mDecodeInInfo = NULL;
+            mDecodeOutInfo = NULL;
 
-            CHECK_EQ(reInitDecoder(), (status_t)OK);
-            return;
-        }
+            Mutex::Autolock autoLock(mDecodeLock);
+            mDecodeState = DECODE_IDLE;
+        } else {
+            inInfo = NULL;
+            inHeader = NULL;
 
-        /* Get a free slot in timestamp array to hold input timestamp */
-        {
-            size_t i;
-            timeStampIx = 0;
-            for (i = 0; i < MAX_TIME_STAMPS; i++) {
-                if (!mTimeStampsValid[i]) {
-                    timeStampIx = i;
+            if (!mIsInFlush) {
+                if (!inQueue.empty()) {
+                    inInfo = *inQueue.begin();
+                    inHeader = inInfo->mHeader;
+                } else {
                     break;
                 }
             }
-            if (inHeader != NULL) {
-                mTimeStampsValid[timeStampIx] = true;
-                mTimeStamps[timeStampIx] = inHeader->nTimeStamp;
+
+            outInfo = *outQueue.begin();
+            outHeader = outInfo->mHeader;
+            outHeader->nFlags = 0;
+            outHeader->nTimeStamp = 0;
+            outHeader->nOffset = 0;
+
+            if (inHeader != NULL && (inHeader->nFlags & OMX_BUFFERFLAG_EOS)) {
+                ALOGD("EOS seen on input");
+                mReceivedEOS = true;
+                if (inHeader->nFilledLen == 0) {
+                    inQueue.erase(inQueue.begin());
+                    inInfo->mOwnedByUs = false;
+                    notifyEmptyBufferDone(inHeader);
+                    inHeader = NULL;
+                    setFlushMode();
+                }
             }
-        }
 
-        {
-            ivd_video_decode_ip_t s_dec_ip;
-            ivd_video_decode_op_t s_dec_op;
-            WORD32 timeDelay, timeTaken;
-            size_t sizeY, sizeUV;
+            // When there is an init required and the decoder is not in flush mode,
+            // update output port's definition and reinitialize decoder.
+            if (mInitNeeded && !mIsInFlush) {
+                bool portWillReset = false;
+                handlePortSettingsChange(&portWillReset, mNewWidth, mNewHeight);
+
+                CHECK_EQ(reInitDecoder(), (status_t)OK);
+                return;
+            }
 
-            setDecodeArgs(&s_dec_ip, &s_dec_op, inHeader, outHeader, timeStampIx);
+            /* Get a free slot in timestamp array to hold input timestamp */
+            {
+                size_t i;
+                timeStampIx = 0;
+                for (i = 0; i < MAX_TIME_STAMPS; i++) {
+                    if (!mTimeStampsValid[i]) {
+                        timeStampIx = i;
+                        break;
+                    }
+                }
+                if (inHeader != NULL) {
+                    mTimeStampsValid[timeStampIx] = true;
+                    mTimeStamps[timeStampIx] = inHeader->nTimeStamp;
+                }
+            }
 
-            GETTIME(&mTimeStart, NULL);
-            /* Compute time elapsed between end of previous decode()
-             * to start of current decode() */
-            TIME_DIFF(mTimeEnd, mTimeStart, timeDelay);
+            setDecodeArgs(&mDecodeIp, &mDecodeOp, inHeader, outHeader, timeStampIx);
 
-            IV_API_CALL_STATUS_T status;
-            status = ivdec_api_function(mCodecCtx, (void *)&s_dec_ip, (void *)&s_dec_op);
+            if (mAsyncDecode) {
+                mDecodeInInfo = inHeader != NULL ? inInfo : NULL;
+                mDecodeOutInfo = outInfo;
+                mDecodeTimeStampIx = timeStampIx;
+
+                startDecode();
+                return;
+            }
+
+            decode();
+        }
+
+        {
+            IV_API_CALL_STATUS_T status = mDecodeStatus;
             // FIXME: Compare |status| to IHEVCD_UNSUPPORTED_DIMENSIONS, which is not one of the
             // IV_API_CALL_STATUS_T, seems be wrong. But this is what the decoder returns right now.
             // The decoder should be fixed so that |u4_error_code| instead of |status| returns
             // IHEVCD_UNSUPPORTED_DIMENSIONS.
             bool unsupportedDimensions =
                 ((IHEVCD_UNSUPPORTED_DIMENSIONS == status)
-                    || (IHEVCD_UNSUPPORTED_DIMENSIONS == s_dec_op.u4_error_code));
-            bool resChanged = (IVD_RES_CHANGED == (s_dec_op.u4_error_code & 0xFF));
-
-            GETTIME(&mTimeEnd, NULL);
-            /* Compute time taken for decode() */
-            TIME_DIFF(mTimeStart, mTimeEnd, timeTaken);
+                    || (IHEVCD_UNSUPPORTED_DIMENSIONS == mDecodeOp.u4_error_code));
+            bool resChanged = (IVD_RES_CHANGED == (mDecodeOp.u4_error_code & 0xFF));
 
-            ALOGV("timeTaken=%6d delay=%6d numBytes=%6d", timeTaken, timeDelay,
-                   s_dec_op.u4_num_bytes_consumed);
-            if (s_dec_op.u4_frame_decoded_flag && !mFlushNeeded) {
+            if (mDecodeOp.u4_frame_decoded_flag && !mFlushNeeded) {
                 mFlushNeeded = true;
             }
 
-            if ((inHeader != NULL) && (1 != s_dec_op.u4_frame_decoded_flag)) {
+            if ((inHeader != NULL) && (1 != mDecodeOp.u4_frame_decoded_flag)) {
                 /* If the input did not contain picture data, then ignore
                  * the associated timestamp */
                 mTimeStampsValid[timeStampIx] = false;
@@ -668,19 +900,19 @@ void SoftHEVC::onQueueFilled(OMX_U32 portIndex) {
             // which is not sending SPS/PPS after port reconfiguration and flush to the codec.
             if (unsupportedDimensions && !mFlushNeeded) {
                 bool portWillReset = false;
-                handlePortSettingsChange(&portWillReset, s_dec_op.u4_pic_wd, s_dec_op.u4_pic_ht);
+                handlePortSettingsChange(&portWillReset, mDecodeOp.u4_pic_wd, mDecodeOp.u4_pic_ht);
 
                 CHECK_EQ(reInitDecoder(), (status_t)OK);
 
-                setDecodeArgs(&s_dec_ip, &s_dec_op, inHeader, outHeader, timeStampIx);
+                setDecodeArgs(&mDecodeIp, &mDecodeOp, inHeader, outHeader, timeStampIx);
 
-                ivdec_api_function(mCodecCtx, (void *)&s_dec_ip, (void *)&s_dec_op);
+                ivdec_api_function(mCodecCtx, (void *)&mDecodeIp, (void *)&mDecodeOp);
                 return;
             }
 
             // If the decoder is in the changing resolution mode and there is no output present,
             // that means the switching is done and it's ready to reset the decoder and the plugin.
-            if (mChangingResolution && !s_dec_op.u4_output_present) {
+            if (mChangingResolution && !mDecodeOp.u4_output_present) {
                 mChangingResolution = false;
                 resetDecoder();
                 resetPlugin();
@@ -694,16 +926,16 @@ void SoftHEVC::onQueueFilled(OMX_U32 portIndex) {
                 }
 
                 if (unsupportedDimensions) {
-                    mNewWidth = s_dec_op.u4_pic_wd;
-                    mNewHeight = s_dec_op.u4_pic_ht;
+                    mNewWidth = mDecodeOp.u4_pic_wd;
+                    mNewHeight = mDecodeOp.u4_pic_ht;
                     mInitNeeded = true;
                 }
                 continue;
             }
 
-            if ((0 < s_dec_op.u4_pic_wd) && (0 < s_dec_op.u4_pic_ht)) {
-                uint32_t width = s_dec_op.u4_pic_wd;
-                uint32_t height = s_dec_op.u4_pic_ht;
+            if ((0 < mDecodeOp.u4_pic_wd) && (0 < mDecodeOp.u4_pic_ht)) {
+                uint32_t width = mDecodeOp.u4_pic_wd;
+                uint32_t height = mDecodeOp.u4_pic_ht;
                 bool portWillReset = false;
                 handlePortSettingsChange(&portWillReset, width, height);
 
@@ -713,11 +945,11 @@ void SoftHEVC::onQueueFilled(OMX_U32 portIndex) {
                 }
             }
 
-            if (s_dec_op.u4_output_present) {
+            if (mDecodeOp.u4_output_present) {
                 outHeader->nFilledLen = (mWidth * mHeight * 3) / 2;
 
-                outHeader->nTimeStamp = mTimeStamps[s_dec_op.u4_ts];
-                mTimeStampsValid[s_dec_op.u4_ts] = false;
+                outHeader->nTimeStamp = mTimeStamps[mDecodeOp.u4_ts];
+                mTimeStampsValid[mDecodeOp.u4_ts] = false;
 
                 outInfo->mOwnedByUs = false;
                 outQueue.erase(outQueue.begin());
@@ -20,6 +20,7 @@
 
 #include "SoftVideoDecoderOMXComponent.h"
 #include <sys/time.h>
+#include <utils/threads.h>
 
 namespace android {
 
@@ -62,7 +63,10 @@ protected:
     virtual void onQueueFilled(OMX_U32 portIndex);
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onReset();
+    virtual void onReturningBuffers(OMX_U32 portIndex);
+    virtual OMX_ERRORTYPE internalGetParameter(OMX_INDEXTYPE index, OMX_PTR params);
     virtual OMX_ERRORTYPE internalSetParameter(OMX_INDEXTYPE index, const OMX_PTR params);
+    virtual OMX_ERRORTYPE getExtensionIndex(const char *name, OMX_INDEXTYPE *index);
 private:
     // Number of input and output buffers
     enum {
@@ -74,6 +78,7 @@ private:
     size_t mNumMemRecords;       // Number of memory records requested by the codec
 
     size_t mNumCores;            // Number of cores to be uesd by the codec
+    size_t mNumThreads;          // Number of cores requested by the client, 0 if any
 
     struct timeval mTimeStart;   // Time at the start of decode()
     struct timeval mTimeEnd;     // Time at the end of decode()
@@ -101,6 +106,30 @@ private:
     bool mChangingResolution;
     bool mFlushNeeded;
 
+    // In asynchronous mode decode() runs on mDecodeThread, which lets the
+    // component take in and hand out buffers while a frame is decoded. The
+    // arguments and results of the decode call in progress are kept here.
+    bool mAsyncDecode;
+    ivd_video_decode_ip_t mDecodeIp;
+    ivd_video_decode_op_t mDecodeOp;
+    IV_API_CALL_STATUS_T mDecodeStatus;
+    BufferInfo *mDecodeInInfo;
+    BufferInfo *mDecodeOutInfo;
+    size_t mDecodeTimeStampIx;
+
+    enum DecodeState {
+        DECODE_IDLE,
+        DECODE_RUNNING,     // decode thread owns the decoder and arguments
+        DECODE_DONE,        // results waiting for onQueueFilled()
+    };
+
+    Mutex mDecodeLock;
+    Condition mDecodeCondition;
+    DecodeState mDecodeState;
+    bool mDecodeThreadStarted;
+    bool mStopDecodeThread;
+    pthread_t mDecodeThread;
+
     status_t initDecoder();
     status_t deInitDecoder();
     status_t setFlushMode();
@@ -111,6 +140,13 @@ private:
     status_t resetPlugin();
     status_t reInitDecoder();
 
+    void decode();
+    void startDecode();
+    DecodeState waitForDecode();
+    void stopDecodeThread();
+    static void *DecodeThreadWrapper(void *me);
+    void decodeThread();
+
     void setDecodeArgs(ivd_video_decode_ip_t *ps_dec_ip,
         ivd_video_decode_op_t *ps_dec_op,
         OMX_BUFFERHEADERTYPE *inHeader,
@@ -90,13 +90,43 @@ SoftAVC::~SoftAVC() {
 }
 
 status_t SoftAVC::initDecoder() {
-    // Force decoder to output buffers in display order.
-    if (H264SwDecInit(&mHandle, 0) == H264SWDEC_OK) {
+    // Output buffers in display order unless decode order was requested.
+    if (H264SwDecInit(&mHandle, mOutputDecodeOrder ? 1 : 0) == H264SWDEC_OK) {
         return OK;
     }
     return UNKNOWN_ERROR;
 }
 
+OMX_ERRORTYPE SoftAVC::internalSetParameter(OMX_INDEXTYPE index, const OMX_PTR params) {
+    // Include extension index OMX_INDEXEXTTYPE.
+    const int32_t indexFull = index;
+
+    if (indexFull != kOutputDecodeOrderIndex) {
+        return SoftVideoDecoderOMXComponent::internalSetParameter(index, params);
+    }
+
+    const bool oldOutputDecodeOrder = mOutputDecodeOrder;
+    OMX_ERRORTYPE ret = SoftVideoDecoderOMXComponent::internalSetParameter(index, params);
+    if (ret != OMX_ErrorNone || mOutputDecodeOrder == oldOutputDecodeOrder) {
+        return ret;
+    }
+
+    // The reordering mode is fixed when the decoder is created, so the
+    // decoder has to be recreated. Only do so before any input of the
+    // current session was decoded.
+    if (mPicId != 0) {
+        mOutputDecodeOrder = oldOutputDecodeOrder;
+        return OMX_ErrorIncorrectStateOperation;
+    }
+
+    H264SwDecRelease(mHandle);
+    mHandle = NULL;
+    if (initDecoder() != OK) {
+        return OMX_ErrorUndefined;
+    }
+    return OMX_ErrorNone;
+}
+
 void SoftAVC::onQueueFilled(OMX_U32 /* portIndex */) {
     if (mSignalledError || mOutputPortSettingsChange != NONE) {
         return;
@@ -308,6 +338,25 @@ void SoftAVC::onPortFlushCompleted(OMX_U32 portIndex) {
 void SoftAVC::onReset() {
     SoftVideoDecoderOMXComponent::onReset();
     mSignalledError = false;
+
+    // Start the next session from a fresh decoder, so that the output
+    // order can be chosen again before its first input.
+    H264SwDecRelease(mHandle);
+    mHandle = NULL;
+    CHECK_EQ(initDecoder(), (status_t)OK);
+
+    while (mPicToHeaderMap.size() != 0) {
+        OMX_BUFFERHEADERTYPE *header = mPicToHeaderMap.editValueAt(0);
+        mPicToHeaderMap.removeItemsAt(0);
+        delete header;
+    }
+    delete[] mFirstPicture;
+    mFirstPicture = NULL;
+    mFirstPictureId = -1;
+    mPicId = 0;
+    mInputBufferCount = 0;
+    mHeadersDecoded = false;
+    mEOSStatus = INPUT_DATA_AVAILABLE;
 }
 
 }  // namespace android
@@ -39,6 +39,9 @@ protected:
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onReset();
 
+    virtual OMX_ERRORTYPE internalSetParameter(
+            OMX_INDEXTYPE index, const OMX_PTR params);
+
 private:
     enum {
         kNumInputBuffers  = 8,
@@ -22,13 +22,16 @@
 #include "ParsedMessage.h"
 
 #include <arpa/inet.h>
+#include <cutils/atomic.h>
 #include <fcntl.h>
 #include <linux/tcp.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -52,6 +55,40 @@ static uint64_t U64_AT(const uint8_t *ptr) {
 static const size_t kMaxUDPSize = 1500;
 static const int32_t kMaxUDPRetries = 200;
 
+// Maximum number of readiness events handled per epoll_wait call and of
+// queued fragments handed to a single writev call.
+static const int kMaxEpollEvents = 64;
+static const size_t kMaxIOVecs = 16;
+
+// The wakeup pipe is registered with this ID, session IDs start at 1.
+static const int32_t kPipeID = 0;
+
+// Cleared if the kernel turns out not to support recvmmsg/sendmmsg. Shared
+// by all sessions' network threads, so only accessed through the helpers.
+static volatile int32_t gUseBatchedDatagramIO = 1;
+
+static bool useBatchedDatagramIO() {
+    return android_atomic_acquire_load(&gUseBatchedDatagramIO) != 0;
+}
+
+static void setUseBatchedDatagramIO(bool enable) {
+    android_atomic_release_store(enable ? 1 : 0, &gUseBatchedDatagramIO);
+}
+
+// Preallocated storage for receiving and sending up to kMaxDatagrams
+// datagrams per system call. Owned by the ANetworkSession and only ever
+// used on its network thread.
+struct ANetworkSession::DatagramBatch {
+    enum {
+        kMaxDatagrams = 16,
+    };
+
+    struct mmsghdr mMsgs[kMaxDatagrams];
+    struct iovec mIOVecs[kMaxDatagrams];
+    struct sockaddr_in mAddrs[kMaxDatagrams];
+    uint8_t mData[kMaxDatagrams][kMaxUDPSize];
+};
+
 struct ANetworkSession::NetworkThread : public Thread {
     NetworkThread(ANetworkSession *session);
 
@@ -96,8 +133,12 @@ struct ANetworkSession::Session : public RefBase {
     bool wantsToRead();
     bool wantsToWrite();
 
-    status_t readMore();
-    status_t writeMore();
+    // True if output is queued on an established session, i.e. writeMore
+    // may be called without waiting for a readiness notification.
+    bool hasQueuedOutput();
+
+    status_t readMore(DatagramBatch *batch);
+    status_t writeMore(DatagramBatch *batch);
 
     status_t sendRequest(
             const void *data, ssize_t size, bool timeValid, int64_t timeUs);
@@ -136,6 +177,10 @@ private:
     void notifyError(bool send, status_t err, const char *detail);
     void notify(NotificationReason reason);
 
+    // Return the number of datagrams received/sent or a negative error.
+    ssize_t receiveDatagrams(DatagramBatch *batch);
+    ssize_t sendDatagrams(DatagramBatch *batch, size_t count);
+
     void dumpFragmentStats(const Fragment &frag);
 
     DISALLOW_EVIL_CONSTRUCTORS(Session);
@@ -265,39 +310,98 @@ bool ANetworkSession::Session::wantsToWrite() {
             || (mState == DATAGRAM && !mOutFragments.empty()));
 }
 
-status_t ANetworkSession::Session::readMore() {
+bool ANetworkSession::Session::hasQueuedOutput() {
+    return !mSawSendFailure
+        && (mState == CONNECTED || mState == DATAGRAM)
+        && !mOutFragments.empty();
+}
+
+ssize_t ANetworkSession::Session::receiveDatagrams(DatagramBatch *batch) {
+    size_t count = useBatchedDatagramIO() ? DatagramBatch::kMaxDatagrams : 1;
+
+    for (size_t i = 0; i < count; ++i) {
+        batch->mIOVecs[i].iov_base = batch->mData[i];
+        batch->mIOVecs[i].iov_len = kMaxUDPSize;
+
+        struct msghdr *hdr = &batch->mMsgs[i].msg_hdr;
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->msg_name = &batch->mAddrs[i];
+        hdr->msg_namelen = sizeof(batch->mAddrs[i]);
+        hdr->msg_iov = &batch->mIOVecs[i];
+        hdr->msg_iovlen = 1;
+
+        batch->mMsgs[i].msg_len = 0;
+    }
+
+    if (useBatchedDatagramIO()) {
+        int n;
+        do {
+            n = recvmmsg(mSocket, batch->mMsgs, count, 0, NULL);
+        } while (n < 0 && errno == EINTR);
+
+        if (n >= 0) {
+            return n;
+        } else if (errno != ENOSYS) {
+            return -errno;
+        }
+
+        ALOGW("recvmmsg is not supported, receiving one datagram at a time.");
+        setUseBatchedDatagramIO(false);
+    }
+
+    socklen_t remoteAddrLen = sizeof(batch->mAddrs[0]);
+
+    ssize_t n;
+    do {
+        n = recvfrom(
+                mSocket, batch->mData[0], kMaxUDPSize, 0,
+                (struct sockaddr *)&batch->mAddrs[0], &remoteAddrLen);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        return -errno;
+    }
+
+    batch->mMsgs[0].msg_len = n;
+
+    return 1;
+}
+
+status_t ANetworkSession::Session::readMore(DatagramBatch *batch) {
     if (mState == DATAGRAM) {
         CHECK_EQ(mMode, MODE_DATAGRAM);
 
         status_t err;
         do {
-            sp<ABuffer> buf = new ABuffer(kMaxUDPSize);
+            ssize_t count = receiveDatagrams(batch);
 
-            struct sockaddr_in remoteAddr;
-            socklen_t remoteAddrLen = sizeof(remoteAddr);
+            err = OK;
+            if (count < 0) {
+                err = count;
+                break;
+            }
 
-            ssize_t n;
-            do {
-                n = recvfrom(
-                        mSocket, buf->data(), buf->capacity(), 0,
-                        (struct sockaddr *)&remoteAddr, &remoteAddrLen);
-            } while (n < 0 && errno == EINTR);
+            int64_t nowUs = ALooper::GetNowUs();
 
-            err = OK;
-            if (n < 0) {
-                err = -errno;
-            } else if (n == 0) {
-                err = -ECONNRESET;
-            } else {
-                buf->setRange(0, n);
+            for (ssize_t i = 0; i < count; ++i) {
+                size_t n = batch->mMsgs[i].msg_len;
+
+                if (n == 0) {
+                    err = -ECONNRESET;
+                    break;
+                }
+
+                sp<ABuffer> buf = new ABuffer(n);
+                memcpy(buf->data(), batch->mData[i], n);
 
-                int64_t nowUs = ALooper::GetNowUs();
                 buf->meta()->setInt64("arrivalTimeUs", nowUs);
 
                 sp<AMessage> notify = mNotify->dup();
                 notify->setInt32("sessionID", mSessionID);
                 notify->setInt32("reason", kWhatDatagram);
 
+                const struct sockaddr_in &remoteAddr = batch->mAddrs[i];
+
                 uint32_t ip = ntohl(remoteAddr.sin_addr.s_addr);
                 notify->setString(
                         "fromAddr",
@@ -313,6 +417,13 @@ status_t ANetworkSession::Session::readMore() {
                 notify->setBuffer("data", buf);
                 notify->post();
             }
+
+            if (err == OK && useBatchedDatagramIO()
+                    && count < DatagramBatch::kMaxDatagrams) {
+                // The receive queue has been drained, if more datagrams
+                // arrive from now on we'll be notified again.
+                break;
+            }
         } while (err == OK);
 
         if (err == -EAGAIN) {
@@ -336,25 +447,33 @@ status_t ANetworkSession::Session::readMore() {
         return err;
     }
 
-    char tmp[512];
+    char tmp[4096];
     ssize_t n;
-    do {
-        n = recv(mSocket, tmp, sizeof(tmp), 0);
-    } while (n < 0 && errno == EINTR);
-
     status_t err = OK;
 
-    if (n > 0) {
-        mInBuffer.append(tmp, n);
+    for (;;) {
+        do {
+            n = recv(mSocket, tmp, sizeof(tmp), 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n > 0) {
+            mInBuffer.append(tmp, n);
 
 #if 0
-        ALOGI("in:");
-        hexdump(tmp, n);
+            ALOGI("in:");
+            hexdump(tmp, n);
 #endif
-    } else if (n < 0) {
-        err = -errno;
-    } else {
-        err = -ECONNRESET;
+            continue;
+        }
+
+        if (n < 0) {
+            if (errno != EAGAIN) {
+                err = -errno;
+            }
+        } else {
+            err = -ECONNRESET;
+        }
+        break;
     }
 
     if (mMode == MODE_DATAGRAM) {
@@ -548,32 +667,80 @@ void ANetworkSession::Session::dumpFragmentStats(const Fragment & /* frag */) {
 #endif
 }
 
-status_t ANetworkSession::Session::writeMore() {
+ssize_t ANetworkSession::Session::sendDatagrams(
+        DatagramBatch *batch, size_t count) {
+    if (useBatchedDatagramIO()) {
+        int n;
+        do {
+            n = sendmmsg(mSocket, batch->mMsgs, count, 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n > 0) {
+            return n;
+        } else if (n == 0) {
+            return -ECONNRESET;
+        } else if (errno != ENOSYS) {
+            return -errno;
+        }
+
+        ALOGW("sendmmsg is not supported, sending one datagram at a time.");
+        setUseBatchedDatagramIO(false);
+    }
+
+    ssize_t n;
+    do {
+        n = send(mSocket,
+                 batch->mIOVecs[0].iov_base, batch->mIOVecs[0].iov_len, 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        return -errno;
+    } else if (n == 0) {
+        return -ECONNRESET;
+    }
+
+    return 1;
+}
+
+status_t ANetworkSession::Session::writeMore(DatagramBatch *batch) {
     if (mState == DATAGRAM) {
         CHECK(!mOutFragments.empty());
 
         status_t err;
         do {
-            const Fragment &frag = *mOutFragments.begin();
-            const sp<ABuffer> &datagram = frag.mBuffer;
+            size_t count = 0;
+            for (List<Fragment>::iterator it = mOutFragments.begin();
+                    it != mOutFragments.end()
+                        && count < DatagramBatch::kMaxDatagrams;
+                    ++it, ++count) {
+                const sp<ABuffer> &datagram = (*it).mBuffer;
+
+                batch->mIOVecs[count].iov_base = datagram->data();
+                batch->mIOVecs[count].iov_len = datagram->size();
+
+                struct msghdr *hdr = &batch->mMsgs[count].msg_hdr;
+                memset(hdr, 0, sizeof(*hdr));
+                hdr->msg_iov = &batch->mIOVecs[count];
+                hdr->msg_iovlen = 1;
+            }
 
-            int n;
-            do {
-                n = send(mSocket, datagram->data(), datagram->size(), 0);
-            } while (n < 0 && errno == EINTR);
+            ssize_t n = sendDatagrams(batch, count);
 
             err = OK;
 
-            if (n > 0) {
+            if (n < 0) {
+                err = n;
+                break;
+            }
+
+            for (ssize_t i = 0; i < n; ++i) {
+                const Fragment &frag = *mOutFragments.begin();
+
                 if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
                     dumpFragmentStats(frag);
                 }
 
                 mOutFragments.erase(mOutFragments.begin());
-            } else if (n < 0) {
-                err = -errno;
-            } else if (n == 0) {
-                err = -ECONNRESET;
             }
         } while (err == OK && !mOutFragments.empty());
 
@@ -623,36 +790,62 @@ status_t ANetworkSession::Session::writeMore() {
     CHECK_EQ(mState, CONNECTED);
     CHECK(!mOutFragments.empty());
 
+    // Hand as many queued fragments as possible to the kernel at once,
+    // until it stops accepting data.
     ssize_t n = -1;
     while (!mOutFragments.empty()) {
-        const Fragment &frag = *mOutFragments.begin();
+        struct iovec iov[kMaxIOVecs];
+        size_t numIOVecs = 0;
+        size_t numBytes = 0;
+
+        for (List<Fragment>::iterator it = mOutFragments.begin();
+                it != mOutFragments.end() && numIOVecs < kMaxIOVecs; ++it) {
+            iov[numIOVecs].iov_base = (*it).mBuffer->data();
+            iov[numIOVecs].iov_len = (*it).mBuffer->size();
+            numBytes += (*it).mBuffer->size();
+            ++numIOVecs;
+        }
 
         do {
-            n = send(mSocket, frag.mBuffer->data(), frag.mBuffer->size(), 0);
+            n = writev(mSocket, iov, numIOVecs);
         } while (n < 0 && errno == EINTR);
 
         if (n <= 0) {
             break;
         }
 
-        frag.mBuffer->setRange(
-                frag.mBuffer->offset() + n, frag.mBuffer->size() - n);
+        size_t remaining = n;
+        while (remaining > 0) {
+            const Fragment &frag = *mOutFragments.begin();
+            size_t size = frag.mBuffer->size();
 
-        if (frag.mBuffer->size() > 0) {
-            break;
-        }
+            if (remaining < size) {
+                frag.mBuffer->setRange(
+                        frag.mBuffer->offset() + remaining, size - remaining);
+                break;
+            }
+
+            remaining -= size;
+
+            if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
+                dumpFragmentStats(frag);
+            }
 
-        if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
-            dumpFragmentStats(frag);
+            mOutFragments.erase(mOutFragments.begin());
         }
 
-        mOutFragments.erase(mOutFragments.begin());
+        if ((size_t)n < numBytes) {
+            // The socket's send buffer is full.
+            break;
+        }
     }
 
     status_t err = OK;
 
     if (n < 0) {
-        err = -errno;
+        if (errno != EAGAIN) {
+            err = -errno;
+        }
     } else if (n == 0) {
         err = -ECONNRESET;
     }
@@ -798,12 +991,22 @@ void ANetworkSession::Session::notify(NotificationReason reason) {
 ////////////////////////////////////////////////////////////////////////////////
 
 ANetworkSession::ANetworkSession()
-    : mNextSessionID(1) {
+    : mNextSessionID(kPipeID + 1),
+      mEpollFd(-1),
+      mDatagramBatch(new DatagramBatch) {
     mPipeFd[0] = mPipeFd[1] = -1;
 }
 
 ANetworkSession::~ANetworkSession() {
     stop();
+
+    delete mDatagramBatch;
+    mDatagramBatch = NULL;
+}
+
+// static
+void ANetworkSession::SetUseBatchedDatagramIO(bool enable) {
+    setUseBatchedDatagramIO(enable);
 }
 
 status_t ANetworkSession::start() {
@@ -817,12 +1020,27 @@ status_t ANetworkSession::start() {
         return -errno;
     }
 
-    mThread = new NetworkThread(this);
+    status_t err = MakeSocketNonBlocking(mPipeFd[0]);
+
+    if (err == OK) {
+        err = createEpoll();
+    }
+
+    if (err == OK) {
+        mThread = new NetworkThread(this);
 
-    status_t err = mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
+        err = mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
+
+        if (err != OK) {
+            mThread.clear();
+        }
+    }
 
     if (err != OK) {
-        mThread.clear();
+        if (mEpollFd >= 0) {
+            close(mEpollFd);
+            mEpollFd = -1;
+        }
 
         close(mPipeFd[0]);
         close(mPipeFd[1]);
@@ -834,6 +1052,56 @@ status_t ANetworkSession::start() {
     return OK;
 }
 
+status_t ANetworkSession::createEpoll() {
+    Mutex::Autolock autoLock(mLock);
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (mEpollFd < 0) {
+        return -errno;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = kPipeID;
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mPipeFd[0], &ev) < 0) {
+        return -errno;
+    }
+
+    // Sessions may have been created before we were started.
+    for (size_t i = 0; i < mSessions.size(); ++i) {
+        status_t err = registerSession_l(mSessions.valueAt(i));
+
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    return OK;
+}
+
+status_t ANetworkSession::registerSession_l(const sp<Session> &session) {
+    if (mEpollFd < 0) {
+        // Will be registered once we're started.
+        return OK;
+    }
+
+    // Readiness is edge-triggered, sessions always drain their socket
+    // (or the kernel's buffers fill up) before returning.
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    ev.data.u64 = session->sessionID();
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, session->socket(), &ev) < 0) {
+        return -errno;
+    }
+
+    return OK;
+}
+
 status_t ANetworkSession::stop() {
     if (mThread == NULL) {
         return INVALID_OPERATION;
@@ -845,6 +1113,9 @@ status_t ANetworkSession::stop() {
 
     mThread.clear();
 
+    close(mEpollFd);
+    mEpollFd = -1;
+
     close(mPipeFd[0]);
     close(mPipeFd[1]);
     mPipeFd[0] = mPipeFd[1] = -1;
@@ -937,9 +1208,13 @@ status_t ANetworkSession::destroySession(int32_t sessionID) {
         return -ENOENT;
     }
 
-    mSessions.removeItemsAt(index);
+    if (mEpollFd >= 0) {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL,
+                  mSessions.valueAt(index)->socket(), NULL);
+    }
 
-    interrupt();
+    mSessions.removeItemsAt(index);
+    mPendingWriteSessions.remove(sessionID);
 
     return OK;
 }
@@ -1148,9 +1423,14 @@ status_t ANetworkSession::createClientOrServer(
         session->setMode(Session::MODE_RTSP);
     }
 
-    mSessions.add(session->sessionID(), session);
+    err = registerSession_l(session);
 
-    interrupt();
+    if (err != OK) {
+        // The session owns the socket now.
+        return err;
+    }
+
+    mSessions.add(session->sessionID(), session);
 
     *sessionID = session->sessionID();
 
@@ -1222,7 +1502,12 @@ status_t ANetworkSession::sendRequest(
 
     status_t err = session->sendRequest(data, size, timeValid, timeUs);
 
-    interrupt();
+    // Edge-triggered readiness won't tell us about a socket that is
+    // already writable, have the network thread flush the queue.
+    if (mPendingWriteSessions.indexOf(sessionID) < 0) {
+        mPendingWriteSessions.add(sessionID);
+        interrupt();
+    }
 
     return err;
 }
@@ -1254,162 +1539,177 @@ void ANetworkSession::interrupt() {
 }
 
 void ANetworkSession::threadLoop() {
-    fd_set rs, ws;
-    FD_ZERO(&rs);
-    FD_ZERO(&ws);
+    struct epoll_event events[kMaxEpollEvents];
+
+    int res = epoll_wait(mEpollFd, events, kMaxEpollEvents, -1 /* timeout */);
+
+    if (res == 0) {
+        return;
+    }
+
+    if (res < 0) {
+        if (errno == EINTR) {
+            return;
+        }
 
-    FD_SET(mPipeFd[0], &rs);
-    int maxFd = mPipeFd[0];
+        ALOGE("epoll_wait failed w/ error %d (%s)", errno, strerror(errno));
+        return;
+    }
 
-    {
-        Mutex::Autolock autoLock(mLock);
+    Mutex::Autolock autoLock(mLock);
 
-        for (size_t i = 0; i < mSessions.size(); ++i) {
-            const sp<Session> &session = mSessions.valueAt(i);
+    List<sp<Session> > sessionsToAdd;
 
-            int s = session->socket();
+    for (int i = 0; i < res; ++i) {
+        int32_t sessionID = (int32_t)events[i].data.u64;
 
-            if (s < 0) {
-                continue;
-            }
+        if (sessionID == kPipeID) {
+            char tmp[64];
+            ssize_t n;
+            do {
+                n = read(mPipeFd[0], tmp, sizeof(tmp));
+            } while (n > 0 || (n < 0 && errno == EINTR));
 
-            if (session->wantsToRead()) {
-                FD_SET(s, &rs);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
+            if (n < 0 && errno != EAGAIN) {
+                ALOGW("Error reading from pipe (%s)", strerror(errno));
             }
+            continue;
+        }
 
-            if (session->wantsToWrite()) {
-                FD_SET(s, &ws);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
+        ssize_t index = mSessions.indexOfKey(sessionID);
+
+        if (index < 0) {
+            // Destroyed after the event was reported.
+            continue;
         }
-    }
 
-    int res = select(maxFd + 1, &rs, &ws, NULL, NULL /* tv */);
+        sp<Session> session = mSessions.valueAt(index);
+        uint32_t ev = events[i].events;
 
-    if (res == 0) {
-        return;
-    }
+        if (session->isRTSPServer() || session->isTCPDatagramServer()) {
+            if (ev & EPOLLIN) {
+                acceptClients_l(session, &sessionsToAdd);
+            }
+            continue;
+        }
 
-    if (res < 0) {
-        if (errno == EINTR) {
-            return;
+        int s = session->socket();
+
+        if ((ev & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                && session->wantsToWrite()) {
+            status_t err = session->writeMore(mDatagramBatch);
+            if (err != OK) {
+                ALOGE("writeMore on socket %d failed w/ error %d (%s)",
+                      s, err, strerror(-err));
+            }
         }
 
-        ALOGE("select failed w/ error %d (%s)", errno, strerror(errno));
-        return;
+        if ((ev & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                && session->wantsToRead()) {
+            status_t err = session->readMore(mDatagramBatch);
+            if (err != OK) {
+                ALOGE("readMore on socket %d failed w/ error %d (%s)",
+                      s, err, strerror(-err));
+            }
+        }
     }
 
-    if (FD_ISSET(mPipeFd[0], &rs)) {
-        char c;
-        ssize_t n;
-        do {
-            n = read(mPipeFd[0], &c, 1);
-        } while (n < 0 && errno == EINTR);
+    for (size_t i = 0; i < mPendingWriteSessions.size(); ++i) {
+        ssize_t index = mSessions.indexOfKey(mPendingWriteSessions.itemAt(i));
 
-        if (n < 0) {
-            ALOGW("Error reading from pipe (%s)", strerror(errno));
+        if (index < 0) {
+            continue;
         }
 
-        --res;
+        const sp<Session> &session = mSessions.valueAt(index);
+
+        if (session->hasQueuedOutput()) {
+            status_t err = session->writeMore(mDatagramBatch);
+            if (err != OK) {
+                ALOGE("writeMore on socket %d failed w/ error %d (%s)",
+                      session->socket(), err, strerror(-err));
+            }
+        }
     }
+    mPendingWriteSessions.clear();
 
-    {
-        Mutex::Autolock autoLock(mLock);
+    while (!sessionsToAdd.empty()) {
+        sp<Session> session = *sessionsToAdd.begin();
+        sessionsToAdd.erase(sessionsToAdd.begin());
 
-        List<sp<Session> > sessionsToAdd;
+        status_t err = registerSession_l(session);
 
-        for (size_t i = mSessions.size(); res > 0 && i-- > 0;) {
-            const sp<Session> &session = mSessions.valueAt(i);
+        if (err != OK) {
+            ALOGE("Unable to watch client socket %d, failed w/ error %d (%s)",
+                  session->socket(), err, strerror(-err));
+            continue;
+        }
 
-            int s = session->socket();
+        mSessions.add(session->sessionID(), session);
 
-            if (s < 0) {
-                continue;
-            }
+        ALOGI("added clientSession %d", session->sessionID());
+    }
+}
 
-            if (FD_ISSET(s, &rs) || FD_ISSET(s, &ws)) {
-                --res;
-            }
+void ANetworkSession::acceptClients_l(
+        const sp<Session> &session, List<sp<Session> > *sessionsToAdd) {
+    int s = session->socket();
 
-            if (FD_ISSET(s, &rs)) {
-                if (session->isRTSPServer() || session->isTCPDatagramServer()) {
-                    struct sockaddr_in remoteAddr;
-                    socklen_t remoteAddrLen = sizeof(remoteAddr);
-
-                    int clientSocket = accept(
-                            s, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
-
-                    if (clientSocket >= 0) {
-                        status_t err = MakeSocketNonBlocking(clientSocket);
-
-                        if (err != OK) {
-                            ALOGE("Unable to make client socket non blocking, "
-                                  "failed w/ error %d (%s)",
-                                  err, strerror(-err));
-
-                            close(clientSocket);
-                            clientSocket = -1;
-                        } else {
-                            in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
-
-                            ALOGI("incoming connection from %d.%d.%d.%d:%d "
-                                  "(socket %d)",
-                                  (addr >> 24),
-                                  (addr >> 16) & 0xff,
-                                  (addr >> 8) & 0xff,
-                                  addr & 0xff,
-                                  ntohs(remoteAddr.sin_port),
-                                  clientSocket);
-
-                            sp<Session> clientSession =
-                                new Session(
-                                        mNextSessionID++,
-                                        Session::CONNECTED,
-                                        clientSocket,
-                                        session->getNotificationMessage());
-
-                            clientSession->setMode(
-                                    session->isRTSPServer()
-                                        ? Session::MODE_RTSP
-                                        : Session::MODE_DATAGRAM);
-
-                            sessionsToAdd.push_back(clientSession);
-                        }
-                    } else {
-                        ALOGE("accept returned error %d (%s)",
-                              errno, strerror(errno));
-                    }
-                } else {
-                    status_t err = session->readMore();
-                    if (err != OK) {
-                        ALOGE("readMore on socket %d failed w/ error %d (%s)",
-                              s, err, strerror(-err));
-                    }
-                }
+    // Readiness is edge-triggered, accept all pending connections.
+    for (;;) {
+        struct sockaddr_in remoteAddr;
+        socklen_t remoteAddrLen = sizeof(remoteAddr);
+
+        int clientSocket = accept(
+                s, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
+
+        if (clientSocket < 0) {
+            if (errno == EINTR) {
+                continue;
             }
 
-            if (FD_ISSET(s, &ws)) {
-                status_t err = session->writeMore();
-                if (err != OK) {
-                    ALOGE("writeMore on socket %d failed w/ error %d (%s)",
-                          s, err, strerror(-err));
-                }
+            if (errno != EAGAIN) {
+                ALOGE("accept returned error %d (%s)", errno, strerror(errno));
             }
+            break;
         }
 
-        while (!sessionsToAdd.empty()) {
-            sp<Session> session = *sessionsToAdd.begin();
-            sessionsToAdd.erase(sessionsToAdd.begin());
+        status_t err = MakeSocketNonBlocking(clientSocket);
 
-            mSessions.add(session->sessionID(), session);
+        if (err != OK) {
+            ALOGE("Unable to make client socket non blocking, "
+                  "failed w/ error %d (%s)",
+                  err, strerror(-err));
 
-            ALOGI("added clientSession %d", session->sessionID());
+            close(clientSocket);
+            clientSocket = -1;
+            continue;
         }
+
+        in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
+
+        ALOGI("incoming connection from %d.%d.%d.%d:%d "
+              "(socket %d)",
+              (addr >> 24),
+              (addr >> 16) & 0xff,
+              (addr >> 8) & 0xff,
+              addr & 0xff,
+              ntohs(remoteAddr.sin_port),
+              clientSocket);
+
+        sp<Session> clientSession =
+            new Session(
+                    mNextSessionID++,
+                    Session::CONNECTED,
+                    clientSocket,
+                    session->getNotificationMessage());
+
+        clientSession->setMode(
+                session->isRTSPServer()
+                    ? Session::MODE_RTSP
+                    : Session::MODE_DATAGRAM);
+
+        sessionsToAdd->push_back(clientSession);
     }
 }
 
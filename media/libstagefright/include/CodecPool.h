@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CODEC_POOL_H_
+
+#define CODEC_POOL_H_
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ALooper;
+struct CodecBase;
+
+// Keeps the components of released codecs allocated, but unconfigured, for
+// a little while so that the next MediaCodec created for the same component
+// or for a type it supports skips the component lookup and allocation.
+// Pooled codecs run on their own dedicated looper, their handler ids (which
+// OMX callbacks are addressed to) must survive the hand over.
+struct CodecPool : public AHandler {
+    // How long released codecs are kept around, 0 if pooling is disabled.
+    // Defaults to the "media.stagefright.codec-pool-ms" property.
+    static int64_t GetTTL();
+    static void SetTTL(int64_t ttlUs);
+
+    static sp<CodecPool> getInstance();
+
+    // Takes ownership of a codec whose component is allocated and in the
+    // loaded state. It is freed right away if pooling is disabled or the
+    // codec isn't |reusable|.
+    void add(const AString &componentName,
+             const sp<CodecBase> &codec,
+             const sp<ALooper> &codecLooper,
+             bool reusable = true);
+
+    // Hands out a pooled codec for component |name|, or for mime type |name|
+    // if |nameIsType|. The caller must set the codec's notification message.
+    bool acquire(const AString &name, bool nameIsType, bool encoder,
+                 sp<CodecBase> *codec,
+                 sp<ALooper> *codecLooper,
+                 AString *componentName);
+
+protected:
+    CodecPool();
+    virtual ~CodecPool();
+
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatCodecNotify    = 'cdcN',
+        kWhatExpire         = 'expi',
+        kWhatFlush          = 'flus',
+    };
+
+    enum {
+        kMaxPooledCodecs    = 4,
+    };
+
+    struct Entry {
+        int32_t mID;
+        AString mComponentName;
+        Vector<AString> mMimes;
+        bool mIsEncoder;
+        bool mIsSecure;
+        sp<CodecBase> mCodec;
+        sp<ALooper> mCodecLooper;
+    };
+
+    static Mutex sLock;
+    static int64_t sTTLUs;
+    static sp<CodecPool> sInstance;
+
+    sp<ALooper> mLooper;
+
+    Mutex mLock;
+    int32_t mNextID;
+    List<Entry> mEntries;  // most recently released first
+    KeyedVector<int32_t, Entry> mShuttingDown;
+
+    bool matches_l(const Entry &entry,
+                   const AString &name, bool nameIsType, bool encoder) const;
+    void freeEntry_l(const Entry &entry);
+    void onCodecGone(int32_t id);
+
+    DISALLOW_EVIL_CONSTRUCTORS(CodecPool);
+};
+
+}  // namespace android
+
+#endif  // CODEC_POOL_H_
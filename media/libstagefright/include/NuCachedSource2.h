@@ -61,6 +61,17 @@ struct NuCachedSource2 : public DataSource {
     status_t getEstimatedBandwidthKbps(int32_t *kbps);
     status_t setCacheStatCollectFreq(int32_t freqMs);
 
+    struct FetchStats {
+        size_t mNumFetches;     // reads issued to the underlying source
+        size_t mNumRanges;      // ranges started, including reconnects
+        int64_t mBytesFetched;
+        int64_t mThroughputKbps;  // achieved while reading from the source
+        size_t mFetchSize;      // current size of each read
+        int64_t mConsumerKbps;  // measured rate the data is consumed at
+    };
+
+    void getFetchStats(FetchStats *stats);
+
     static void RemoveCacheSpecificHeaders(
             KeyedVector<String8, String8> *headers,
             String8 *cacheConfig,
@@ -77,6 +88,21 @@ private:
         kDefaultHighWaterThreshold      = 20 * 1024 * 1024,
         kDefaultLowWaterThreshold       = 4 * 1024 * 1024,
 
+        // Data this far behind the last access position is kept around
+        // when making room in the cache.
+        kGrayArea                       = 1024 * 1024,
+
+        // Reads to the underlying source are sized to take about
+        // kTargetFetchDurationUs at the measured bandwidth, in multiples
+        // of kPageSize up to kMaxFetchSize.
+        kMaxFetchSize                   = 1024 * 1024,
+        kTargetFetchDurationUs          = 250000,
+
+        // Unless configured explicitly, the low watermark is raised to
+        // cover this much playback at the measured consumption rate.
+        kLowWaterDurationUs             = 10000000,
+        kConsumerRateWindowUs           = 2000000,
+
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
         kDefaultKeepAliveIntervalUs     = 15000000,
@@ -99,8 +125,11 @@ private:
     mutable Mutex mLock;
     Condition mCondition;
 
+    // Holds any number of disjoint cached ranges, the prefetcher extends
+    // the one ending at mFetchOffset. mHighwaterThresholdBytes bounds the
+    // total number of bytes cached across all ranges.
     PageCache *mCache;
-    off64_t mCacheOffset;
+    off64_t mFetchOffset;
     status_t mFinalStatus;
     off64_t mLastAccessPos;
     sp<AMessage> mAsyncResult;
@@ -108,6 +137,18 @@ private:
     bool mDisconnecting;
     int64_t mLastFetchTimeUs;
 
+    size_t mFetchSize;
+    size_t mNumFetches;
+    size_t mNumRanges;
+    int64_t mBytesFetched;
+    int64_t mFetchTimeUs;
+
+    off64_t mConsumeStartPos;
+    int64_t mConsumeStartTimeUs;
+    int64_t mConsumerBytesPerSec;
+
+    bool mAdaptiveWatermarks;
+
     int32_t mNumRetriesLeft;
 
     size_t mHighwaterThresholdBytes;
@@ -131,6 +172,14 @@ private:
     void restartPrefetcherIfNecessary_l(
             bool ignoreLowWaterThreshold = false, bool force = false);
 
+    bool isInFetchRange_l(off64_t offset) const;
+    void updateLastAccessPos_l(off64_t offset, size_t size);
+    void getActiveWindow_l(off64_t *from, off64_t *to) const;
+    size_t trimCache_l(size_t maxBytes);
+
+    void updateFetchParams_l();
+    void updateConsumerRate_l();
+
     void updateCacheParamsFromSystemProperty();
     void updateCacheParamsFromString(const char *s);
 
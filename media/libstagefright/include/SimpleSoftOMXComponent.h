@@ -61,6 +61,9 @@ protected:
     enum {
         kStoreMetaDataExtensionIndex = OMX_IndexVendorStartUnused + 1,
         kPrepareForAdaptivePlaybackIndex,
+        kOutputDecodeOrderIndex,
+        kThreadCountIndex,
+        kAsyncDecodeIndex,
     };
 
     void addPort(const OMX_PARAM_PORTDEFINITIONTYPE &def);
@@ -74,6 +77,15 @@ protected:
     virtual void onQueueFilled(OMX_U32 portIndex);
     List<BufferInfo *> &getPortQueue(OMX_U32 portIndex);
 
+    // Components that process buffers on threads of their own use this to
+    // get onQueueFilled() called again on the component's looper.
+    void signalQueueFilled(OMX_U32 portIndex);
+
+    // Called before the buffers owned by the component on |portIndex| are
+    // returned by a flush, a port disable or a transition to idle. The
+    // component must not touch them anymore once this returns.
+    virtual void onReturningBuffers(OMX_U32 portIndex);
+
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
     virtual void onReset();
@@ -85,6 +97,7 @@ private:
         kWhatSendCommand,
         kWhatEmptyThisBuffer,
         kWhatFillThisBuffer,
+        kWhatQueueFilled,
     };
 
     Mutex mLock;
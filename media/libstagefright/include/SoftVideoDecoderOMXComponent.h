@@ -88,6 +88,9 @@ protected:
     };
 
     bool mIsAdaptive;
+    // Output frames as soon as they are decoded instead of in display
+    // order, for low latency decoding of streams without reordering.
+    bool mOutputDecodeOrder;
     uint32_t mAdaptiveMaxWidth, mAdaptiveMaxHeight;
     uint32_t mWidth, mHeight;
     uint32_t mCropLeft, mCropTop, mCropWidth, mCropHeight;
@@ -383,6 +383,17 @@ void SimpleSoftOMXComponent::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatQueueFilled:
+        {
+            int32_t portIndex;
+            CHECK(msg->findInt32("portIndex", &portIndex));
+
+            if (mState == OMX_StateExecuting && mTargetState == mState) {
+                onQueueFilled(portIndex);
+            }
+            break;
+        }
+
         default:
             TRESPASS();
             break;
@@ -465,6 +476,8 @@ void SimpleSoftOMXComponent::onPortEnable(OMX_U32 portIndex, bool enable) {
         port->mDef.bEnabled = OMX_FALSE;
         port->mTransition = PortInfo::DISABLING;
 
+        onReturningBuffers(portIndex);
+
         for (size_t i = 0; i < port->mBuffers.size(); ++i) {
             BufferInfo *buffer = &port->mBuffers.editItemAt(i);
 
@@ -507,6 +520,8 @@ void SimpleSoftOMXComponent::onPortFlush(
     PortInfo *port = &mPorts.editItemAt(portIndex);
     CHECK_EQ((int)port->mTransition, (int)PortInfo::NONE);
 
+    onReturningBuffers(portIndex);
+
     for (size_t i = 0; i < port->mBuffers.size(); ++i) {
         BufferInfo *buffer = &port->mBuffers.editItemAt(i);
 
@@ -631,6 +646,15 @@ void SimpleSoftOMXComponent::addPort(const OMX_PARAM_PORTDEFINITIONTYPE &def) {
 void SimpleSoftOMXComponent::onQueueFilled(OMX_U32 portIndex) {
 }
 
+void SimpleSoftOMXComponent::signalQueueFilled(OMX_U32 portIndex) {
+    sp<AMessage> msg = new AMessage(kWhatQueueFilled, mHandler->id());
+    msg->setInt32("portIndex", portIndex);
+    msg->post();
+}
+
+void SimpleSoftOMXComponent::onReturningBuffers(OMX_U32 portIndex) {
+}
+
 void SimpleSoftOMXComponent::onPortFlushCompleted(OMX_U32 portIndex) {
 }
 
@@ -52,6 +52,7 @@ SoftVideoDecoderOMXComponent::SoftVideoDecoderOMXComponent(
         OMX_COMPONENTTYPE **component)
         : SimpleSoftOMXComponent(name, callbacks, appData, component),
         mIsAdaptive(false),
+        mOutputDecodeOrder(false),
         mAdaptiveMaxWidth(0),
         mAdaptiveMaxHeight(0),
         mWidth(width),
@@ -352,6 +353,14 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kOutputDecodeOrderIndex:
+        {
+            const OMX_CONFIG_BOOLEANTYPE *decodeOrderParams =
+                    (const OMX_CONFIG_BOOLEANTYPE *)params;
+            mOutputDecodeOrder = decodeOrderParams->bEnabled;
+            return OMX_ErrorNone;
+        }
+
         case OMX_IndexParamPortDefinition:
         {
             OMX_PARAM_PORTDEFINITIONTYPE *newParams =
@@ -422,6 +431,11 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::getExtensionIndex(
         return OMX_ErrorNone;
     }
 
+    if (!strcmp(name, "OMX.google.android.index.outputDecodeOrder")) {
+        *(int32_t*)index = kOutputDecodeOrderIndex;
+        return OMX_ErrorNone;
+    }
+
     return SimpleSoftOMXComponent::getExtensionIndex(name, index);
 }
 
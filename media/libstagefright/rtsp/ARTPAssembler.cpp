@@ -25,8 +25,7 @@
 
 namespace android {
 
-ARTPAssembler::ARTPAssembler()
-    : mFirstFailureTimeUs(-1) {
+ARTPAssembler::ARTPAssembler() {
 }
 
 void ARTPAssembler::onPacketReceived(const sp<ARTPSource> &source) {
@@ -35,24 +34,14 @@ void ARTPAssembler::onPacketReceived(const sp<ARTPSource> &source) {
         status = assembleMore(source);
 
         if (status == WRONG_SEQUENCE_NUMBER) {
-            if (mFirstFailureTimeUs >= 0) {
-                if (ALooper::GetNowUs() - mFirstFailureTimeUs > 10000ll) {
-                    mFirstFailureTimeUs = -1;
-
-                    // LOG(VERBOSE) << "waited too long for packet.";
-                    packetLost();
-                    continue;
-                }
-            } else {
-                mFirstFailureTimeUs = ALooper::GetNowUs();
-            }
-            break;
-        } else {
-            mFirstFailureTimeUs = -1;
+            // The source's jitter buffer only lets gaps through once it
+            // has given up on the missing packets, no point in waiting.
+            packetLost();
+            continue;
+        }
 
-            if (status == NOT_ENOUGH_DATA) {
-                break;
-            }
+        if (status == NOT_ENOUGH_DATA) {
+            break;
         }
     }
 }
@@ -56,8 +56,6 @@ protected:
             const List<sp<ABuffer> > &frames);
 
 private:
-    int64_t mFirstFailureTimeUs;
-
     DISALLOW_EVIL_CONSTRUCTORS(ARTPAssembler);
 };
 
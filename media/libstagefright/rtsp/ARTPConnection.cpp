@@ -31,12 +31,32 @@
 #include <media/stagefright/foundation/hexdump.h>
 
 #include <arpa/inet.h>
+#include <cutils/atomic.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// Cleared if the kernel turns out not to support recvmmsg. Shared by all
+// connections' loopers, so only accessed atomically.
+static volatile int32_t gUseRecvMMsg = 1;
+
+// Preallocated storage used to receive up to kMaxPackets RTP packets per
+// system call, each is then copied into an ABuffer of the exact size.
+// Slots hold the largest possible datagram, like the single packet path.
+struct ARTPConnection::RTPBatch {
+    enum {
+        kMaxPackets     = 16,
+        kMaxPacketSize  = 65536,
+    };
+
+    struct mmsghdr mMsgs[kMaxPackets];
+    struct iovec mIOVecs[kMaxPackets];
+    uint8_t mData[kMaxPackets][kMaxPacketSize];
+};
+
 static uint16_t u16at(const uint8_t *data) {
     return data[0] << 8 | data[1];
 }
@@ -70,10 +90,13 @@ struct ARTPConnection::StreamInfo {
 ARTPConnection::ARTPConnection(uint32_t flags)
     : mFlags(flags),
       mPollEventPending(false),
-      mLastReceiverReportTimeUs(-1) {
+      mLastReceiverReportTimeUs(-1),
+      mRTPBatch(NULL) {
 }
 
 ARTPConnection::~ARTPConnection() {
+    delete mRTPBatch;
+    mRTPBatch = NULL;
 }
 
 void ARTPConnection::addStream(
@@ -306,6 +329,16 @@ void ARTPConnection::onPollStreams() {
     }
 
     int64_t nowUs = ALooper::GetNowUs();
+
+    // Let go of packets whose reorder window has expired even if nothing
+    // else arrives.
+    for (List<StreamInfo>::iterator it = mStreams.begin();
+         it != mStreams.end(); ++it) {
+        for (size_t i = 0; i < it->mSources.size(); ++i) {
+            it->mSources.valueAt(i)->releaseDuePackets(nowUs);
+        }
+    }
+
     if (mLastReceiverReportTimeUs <= 0
             || mLastReceiverReportTimeUs + 5000000ll <= nowUs) {
         sp<ABuffer> buffer = new ABuffer(kMaxUDPSize);
@@ -370,11 +403,82 @@ void ARTPConnection::onPollStreams() {
     }
 }
 
+status_t ARTPConnection::receiveRTPBatch(StreamInfo *s) {
+    if (mRTPBatch == NULL) {
+        mRTPBatch = new RTPBatch;
+    }
+
+    for (size_t i = 0; i < RTPBatch::kMaxPackets; ++i) {
+        mRTPBatch->mIOVecs[i].iov_base = mRTPBatch->mData[i];
+        mRTPBatch->mIOVecs[i].iov_len = RTPBatch::kMaxPacketSize;
+
+        struct msghdr *hdr = &mRTPBatch->mMsgs[i].msg_hdr;
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->msg_iov = &mRTPBatch->mIOVecs[i];
+        hdr->msg_iovlen = 1;
+
+        mRTPBatch->mMsgs[i].msg_len = 0;
+    }
+
+    // The socket is known to be readable, collect whatever has queued up
+    // without blocking.
+    int n;
+    do {
+        n = recvmmsg(s->mRTPSocket, mRTPBatch->mMsgs, RTPBatch::kMaxPackets,
+                     MSG_DONTWAIT, NULL);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // Nothing queued after all, not an error.
+            return OK;
+        }
+
+        if (errno == ENOSYS) {
+            ALOGW("recvmmsg is not supported, receiving one packet at a time.");
+            android_atomic_release_store(0, &gUseRecvMMsg);
+
+            return receive(s, true /* receiveRTP */);
+        }
+
+        return -ECONNRESET;
+    }
+
+    status_t err = OK;
+    for (int i = 0; i < n; ++i) {
+        size_t nbytes = mRTPBatch->mMsgs[i].msg_len;
+
+        if (nbytes == 0) {
+            return -ECONNRESET;
+        }
+
+        if (mRTPBatch->mMsgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            ALOGW("dropping RTP packet larger than %d bytes.",
+                  RTPBatch::kMaxPacketSize);
+            continue;
+        }
+
+        sp<ABuffer> buffer = new ABuffer(nbytes);
+        memcpy(buffer->data(), mRTPBatch->mData[i], nbytes);
+
+        status_t parseErr = parseRTP(s, buffer);
+        if (err == OK) {
+            err = parseErr;
+        }
+    }
+
+    return err;
+}
+
 status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
     ALOGV("receiving %s", receiveRTP ? "RTP" : "RTCP");
 
     CHECK(!s->mIsInjected);
 
+    if (receiveRTP && android_atomic_acquire_load(&gUseRecvMMsg)) {
+        return receiveRTPBatch(s);
+    }
+
     sp<ABuffer> buffer = new ABuffer(65536);
 
     socklen_t remoteAddrLen =
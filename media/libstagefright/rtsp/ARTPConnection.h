@@ -72,6 +72,9 @@ private:
     bool mPollEventPending;
     int64_t mLastReceiverReportTimeUs;
 
+    struct RTPBatch;
+    RTPBatch *mRTPBatch;
+
     void onAddStream(const sp<AMessage> &msg);
     void onRemoveStream(const sp<AMessage> &msg);
     void onPollStreams();
@@ -79,6 +82,7 @@ private:
     void onSendReceiverReports();
 
     status_t receive(StreamInfo *info, bool receiveRTP);
+    status_t receiveRTPBatch(StreamInfo *info);
 
     status_t parseRTP(StreamInfo *info, const sp<ABuffer> &buffer);
     status_t parseRTCP(StreamInfo *info, const sp<ABuffer> &buffer);
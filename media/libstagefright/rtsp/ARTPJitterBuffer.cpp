@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ARTPJitterBuffer"
+#include <utils/Log.h>
+
+#include "ARTPJitterBuffer.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+namespace android {
+
+// static
+const int64_t ARTPJitterBuffer::kMinPlayoutDelayUs = 10000ll;
+
+// static
+const int64_t ARTPJitterBuffer::kMaxPlayoutDelayUs = 300000ll;
+
+ARTPJitterBuffer::ARTPJitterBuffer(int32_t clockRate)
+    : mClockRate(clockRate > 0 ? clockRate : 90000),
+      mSlots(new Slot[kCapacity]),
+      mNumPacketsHeld(0),
+      mNumPacketsLost(0),
+      mInitialized(false),
+      mNextSeqNum(0),
+      mStarted(false),
+      mFirstArrivalTimeUs(0),
+      mHighestSeqNum(0),
+      mHaveTransit(false),
+      mLastTransit(0),
+      mJitterQ4(0) {
+}
+
+ARTPJitterBuffer::~ARTPJitterBuffer() {
+    delete[] mSlots;
+    mSlots = NULL;
+}
+
+bool ARTPJitterBuffer::insert(
+        const sp<ABuffer> &buffer, int64_t arrivalTimeUs) {
+    uint32_t seqNum = (uint32_t)buffer->int32Data();
+
+    if (!mInitialized) {
+        mNextSeqNum = seqNum;
+        mHighestSeqNum = seqNum;
+        mFirstArrivalTimeUs = arrivalTimeUs;
+        mInitialized = true;
+    }
+
+    int32_t offset = (int32_t)(seqNum - mNextSeqNum);
+
+    if (offset < 0 && !mStarted
+            && (int32_t)(mHighestSeqNum - seqNum) < kCapacity) {
+        // The first packet arrived out of order, start from this one.
+        ALOGV("Moving the start of the stream back to %u", seqNum);
+        mNextSeqNum = seqNum;
+        offset = 0;
+    }
+
+    if (offset < 0) {
+        ALOGV("Discarding late packet %u (expecting %u)", seqNum, mNextSeqNum);
+        return false;
+    }
+
+    if (offset >= kCapacity) {
+        // Give up on whatever is missing in front of the new window.
+        advanceTo(seqNum - kCapacity + 1);
+    }
+
+    Slot *slot = slotAt(seqNum);
+
+    if (slot->mBuffer != NULL) {
+        ALOGW("Discarding duplicate buffer");
+        return false;
+    }
+
+    slot->mBuffer = buffer;
+    slot->mArrivalTimeUs = arrivalTimeUs;
+    ++mNumPacketsHeld;
+
+    if ((int32_t)(seqNum - mHighestSeqNum) > 0) {
+        mHighestSeqNum = seqNum;
+    }
+
+    updateJitter(buffer, arrivalTimeUs);
+
+    return true;
+}
+
+size_t ARTPJitterBuffer::dequeue(
+        int64_t nowUs, List<sp<ABuffer> > *queue) {
+    size_t count = mReady.size();
+
+    while (!mReady.empty()) {
+        queue->push_back(*mReady.begin());
+        mReady.erase(mReady.begin());
+    }
+
+    int64_t delayUs = playoutDelayUs();
+
+    if (!mStarted) {
+        if (!mInitialized || nowUs < mFirstArrivalTimeUs + delayUs) {
+            return count;
+        }
+        mStarted = true;
+    }
+
+    while (mNumPacketsHeld > 0) {
+        Slot *slot = slotAt(mNextSeqNum);
+
+        if (slot->mBuffer != NULL) {
+            queue->push_back(slot->mBuffer);
+            slot->mBuffer.clear();
+
+            --mNumPacketsHeld;
+            ++mNextSeqNum;
+            ++count;
+            continue;
+        }
+
+        // The next packet is missing, find the first one we do have.
+        uint32_t seqNum = mNextSeqNum + 1;
+        while (slotAt(seqNum)->mBuffer == NULL) {
+            ++seqNum;
+        }
+
+        if (nowUs < slotAt(seqNum)->mArrivalTimeUs + delayUs) {
+            break;
+        }
+
+        ALOGV("Giving up on packets %u-%u", mNextSeqNum, seqNum - 1);
+
+        mNumPacketsLost += seqNum - mNextSeqNum;
+        mNextSeqNum = seqNum;
+    }
+
+    return count;
+}
+
+void ARTPJitterBuffer::advanceTo(uint32_t seqNum) {
+    if ((int32_t)(seqNum - mNextSeqNum) <= 0) {
+        return;
+    }
+
+    // Held packets all lie within kCapacity of mNextSeqNum, so the walk
+    // can stop after the last of them and jump over the rest of the gap.
+    uint32_t gap = seqNum - mNextSeqNum;
+    uint32_t numFound = 0;
+    for (uint32_t i = 0; i < gap && mNumPacketsHeld > 0; ++i) {
+        Slot *slot = slotAt(mNextSeqNum + i);
+
+        if (slot->mBuffer != NULL) {
+            mReady.push_back(slot->mBuffer);
+            slot->mBuffer.clear();
+            --mNumPacketsHeld;
+            ++numFound;
+        }
+    }
+
+    mNumPacketsLost += gap - numFound;
+    mNextSeqNum = seqNum;
+
+    // Packets were handed out, the start can't move back anymore.
+    mStarted = true;
+}
+
+void ARTPJitterBuffer::updateJitter(
+        const sp<ABuffer> &buffer, int64_t arrivalTimeUs) {
+    uint32_t rtpTime;
+    if (!buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime)) {
+        return;
+    }
+
+    // The relative transit time in timestamp units, wraparound of either
+    // clock cancels out in the difference below.
+    uint32_t arrival = (uint32_t)(arrivalTimeUs * mClockRate / 1000000ll);
+    int32_t transit = (int32_t)(arrival - rtpTime);
+
+    if (!mHaveTransit) {
+        mLastTransit = transit;
+        mHaveTransit = true;
+        return;
+    }
+
+    int32_t d = transit - mLastTransit;
+    mLastTransit = transit;
+
+    if (d < 0) {
+        d = -d;
+    }
+
+    mJitterQ4 += d - ((mJitterQ4 + 8) >> 4);
+}
+
+uint32_t ARTPJitterBuffer::jitter() const {
+    return mJitterQ4 >> 4;
+}
+
+int64_t ARTPJitterBuffer::playoutDelayUs() const {
+    // Wait for a missing packet about three times the mean deviation of
+    // the interarrival time before declaring it lost.
+    int64_t delayUs = 3ll * jitter() * 1000000ll / mClockRate;
+
+    if (delayUs < kMinPlayoutDelayUs) {
+        delayUs = kMinPlayoutDelayUs;
+    } else if (delayUs > kMaxPlayoutDelayUs) {
+        delayUs = kMaxPlayoutDelayUs;
+    }
+
+    return delayUs;
+}
+
+}  // namespace android
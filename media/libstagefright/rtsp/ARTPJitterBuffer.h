@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_RTP_JITTER_BUFFER_H_
+
+#define A_RTP_JITTER_BUFFER_H_
+
+#include <stdint.h>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+struct ABuffer;
+
+// Reorders the RTP packets of a single source. Packets are held in a ring
+// indexed by their extended sequence number and handed out in order. A
+// missing packet is waited for up to the current playout delay, which
+// follows the interarrival jitter measured as described in RFC 3550.
+struct ARTPJitterBuffer {
+    ARTPJitterBuffer(int32_t clockRate);
+    ~ARTPJitterBuffer();
+
+    // The packet's extended sequence number is taken from its int32Data(),
+    // its RTP timestamp from the "rtp-time" meta entry. Returns false if
+    // the packet is a duplicate or arrived after it had been given up on.
+    bool insert(const sp<ABuffer> &buffer, int64_t arrivalTimeUs);
+
+    // Appends all packets up to the first missing one to "queue", skipping
+    // over missing packets whose reorder window expired at "nowUs".
+    // Returns the number of packets appended.
+    size_t dequeue(int64_t nowUs, List<sp<ABuffer> > *queue);
+
+    int64_t playoutDelayUs() const;
+
+    // Interarrival jitter in timestamp units.
+    uint32_t jitter() const;
+
+    uint32_t numPacketsLost() const { return mNumPacketsLost; }
+    size_t numPacketsHeld() const { return mNumPacketsHeld; }
+
+private:
+    enum {
+        // Must be a power of 2.
+        kCapacity = 1024,
+    };
+
+    static const int64_t kMinPlayoutDelayUs;
+    static const int64_t kMaxPlayoutDelayUs;
+
+    struct Slot {
+        sp<ABuffer> mBuffer;
+        int64_t mArrivalTimeUs;
+    };
+
+    int32_t mClockRate;
+
+    Slot *mSlots;
+    size_t mNumPacketsHeld;
+    uint32_t mNumPacketsLost;
+
+    bool mInitialized;
+    uint32_t mNextSeqNum;
+
+    // Until the reorder window of the first packet expires nothing is
+    // handed out, and an earlier packet moves the start of the stream back
+    // instead of being discarded as late.
+    bool mStarted;
+    int64_t mFirstArrivalTimeUs;
+    uint32_t mHighestSeqNum;
+
+    // Packets pushed out of the window by packets far ahead of it.
+    List<sp<ABuffer> > mReady;
+
+    bool mHaveTransit;
+    int32_t mLastTransit;
+
+    // Scaled by 16, see RFC 3550, A.8.
+    uint32_t mJitterQ4;
+
+    Slot *slotAt(uint32_t seqNum) {
+        return &mSlots[seqNum & (kCapacity - 1)];
+    }
+
+    void advanceTo(uint32_t seqNum);
+    void updateJitter(const sp<ABuffer> &buffer, int64_t arrivalTimeUs);
+
+    DISALLOW_EVIL_CONSTRUCTORS(ARTPJitterBuffer);
+};
+
+}  // namespace android
+
+#endif  // A_RTP_JITTER_BUFFER_H_
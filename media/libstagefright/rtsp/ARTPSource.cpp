@@ -26,6 +26,7 @@
 #include "AMPEG2TSAssembler.h"
 #include "AMPEG4AudioAssembler.h"
 #include "AMPEG4ElementaryAssembler.h"
+#include "ARTPJitterBuffer.h"
 #include "ARawAudioAssembler.h"
 #include "ASessionDescription.h"
 
@@ -44,6 +45,7 @@ ARTPSource::ARTPSource(
     : mID(id),
       mHighestSeqNumber(0),
       mNumBuffersReceived(0),
+      mJitterBuffer(NULL),
       mLastNTPTime(0),
       mLastNTPTimeUpdateUs(0),
       mIssueFIRRequests(false),
@@ -55,6 +57,15 @@ ARTPSource::ARTPSource(
     AString params;
     sessionDesc->getFormatType(index, &PT, &desc, &params);
 
+    int32_t clockRate = 0;
+    if (strchr(desc.c_str(), '/') != NULL) {
+        int32_t numChannels;
+        ASessionDescription::ParseFormatDesc(
+                desc.c_str(), &clockRate, &numChannels);
+    }
+
+    mJitterBuffer = new ARTPJitterBuffer(clockRate);
+
     if (!strncmp(desc.c_str(), "H264/", 5)) {
         mAssembler = new AAVCAssembler(notify);
         mIssueFIRRequests = true;
@@ -81,12 +92,25 @@ ARTPSource::ARTPSource(
     }
 }
 
+ARTPSource::~ARTPSource() {
+    delete mJitterBuffer;
+    mJitterBuffer = NULL;
+}
+
 static uint32_t AbsDiff(uint32_t seq1, uint32_t seq2) {
     return seq1 > seq2 ? seq1 - seq2 : seq2 - seq1;
 }
 
 void ARTPSource::processRTPPacket(const sp<ABuffer> &buffer) {
-    if (queuePacket(buffer) && mAssembler != NULL) {
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (queuePacket(buffer, nowUs)) {
+        releaseDuePackets(nowUs);
+    }
+}
+
+void ARTPSource::releaseDuePackets(int64_t nowUs) {
+    if (mJitterBuffer->dequeue(nowUs, &mQueue) > 0 && mAssembler != NULL) {
         mAssembler->onPacketReceived(this);
     }
 }
@@ -102,13 +126,13 @@ void ARTPSource::timeUpdate(uint32_t rtpTime, uint64_t ntpTime) {
     notify->post();
 }
 
-bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
+bool ARTPSource::queuePacket(
+        const sp<ABuffer> &buffer, int64_t arrivalTimeUs) {
     uint32_t seqNum = (uint32_t)buffer->int32Data();
 
     if (mNumBuffersReceived++ == 0) {
         mHighestSeqNumber = seqNum;
-        mQueue.push_back(buffer);
-        return true;
+        return mJitterBuffer->insert(buffer, arrivalTimeUs);
     }
 
     // Only the lower 16-bit of the sequence numbers are transmitted,
@@ -144,19 +168,7 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     buffer->setInt32Data(seqNum);
 
-    List<sp<ABuffer> >::iterator it = mQueue.begin();
-    while (it != mQueue.end() && (uint32_t)(*it)->int32Data() < seqNum) {
-        ++it;
-    }
-
-    if (it != mQueue.end() && (uint32_t)(*it)->int32Data() == seqNum) {
-        ALOGW("Discarding duplicate buffer");
-        return false;
-    }
-
-    mQueue.insert(it, buffer);
-
-    return true;
+    return mJitterBuffer->insert(buffer, arrivalTimeUs);
 }
 
 void ARTPSource::byeReceived() {
@@ -237,19 +249,26 @@ void ARTPSource::addReceiverReport(const sp<ABuffer> &buffer) {
 
     data[12] = 0x00;  // fraction lost
 
-    data[13] = 0x00;  // cumulative lost
-    data[14] = 0x00;
-    data[15] = 0x00;
+    uint32_t numLost = mJitterBuffer->numPacketsLost();
+    if (numLost > 0x7fffff) {
+        numLost = 0x7fffff;
+    }
+
+    data[13] = (numLost >> 16) & 0xff;  // cumulative lost
+    data[14] = (numLost >> 8) & 0xff;
+    data[15] = numLost & 0xff;
 
     data[16] = mHighestSeqNumber >> 24;
     data[17] = (mHighestSeqNumber >> 16) & 0xff;
     data[18] = (mHighestSeqNumber >> 8) & 0xff;
     data[19] = mHighestSeqNumber & 0xff;
 
-    data[20] = 0x00;  // Interarrival jitter
-    data[21] = 0x00;
-    data[22] = 0x00;
-    data[23] = 0x00;
+    uint32_t jitter = mJitterBuffer->jitter();
+
+    data[20] = jitter >> 24;  // Interarrival jitter
+    data[21] = (jitter >> 16) & 0xff;
+    data[22] = (jitter >> 8) & 0xff;
+    data[23] = jitter & 0xff;
 
     uint32_t LSR = 0;
     uint32_t DLSR = 0;
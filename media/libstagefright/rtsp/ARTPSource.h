@@ -29,6 +29,7 @@ namespace android {
 struct ABuffer;
 struct AMessage;
 struct ARTPAssembler;
+struct ARTPJitterBuffer;
 struct ASessionDescription;
 
 struct ARTPSource : public RefBase {
@@ -38,6 +39,11 @@ struct ARTPSource : public RefBase {
             const sp<AMessage> &notify);
 
     void processRTPPacket(const sp<ABuffer> &buffer);
+
+    // Hands packets whose reorder window expired by "nowUs" to the
+    // assembler, to be called periodically.
+    void releaseDuePackets(int64_t nowUs);
+
     void timeUpdate(uint32_t rtpTime, uint64_t ntpTime);
     void byeReceived();
 
@@ -46,12 +52,18 @@ struct ARTPSource : public RefBase {
     void addReceiverReport(const sp<ABuffer> &buffer);
     void addFIR(const sp<ABuffer> &buffer);
 
+protected:
+    virtual ~ARTPSource();
+
 private:
     uint32_t mID;
     uint32_t mHighestSeqNumber;
     int32_t mNumBuffersReceived;
 
+    // Packets in sequence number order, with gaps only where the jitter
+    // buffer gave up on the missing ones.
     List<sp<ABuffer> > mQueue;
+    ARTPJitterBuffer *mJitterBuffer;
     sp<ARTPAssembler> mAssembler;
 
     uint64_t mLastNTPTime;
@@ -63,7 +75,7 @@ private:
 
     sp<AMessage> mNotify;
 
-    bool queuePacket(const sp<ABuffer> &buffer);
+    bool queuePacket(const sp<ABuffer> &buffer, int64_t arrivalTimeUs);
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPSource);
 };
@@ -13,6 +13,7 @@ LOCAL_SRC_FILES:=       \
         ARawAudioAssembler.cpp      \
         ARTPAssembler.cpp           \
         ARTPConnection.cpp          \
+        ARTPJitterBuffer.cpp        \
         ARTPSource.cpp              \
         ARTPWriter.cpp              \
         ARTSPConnection.cpp         \
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ARTPJitterBuffer_test"
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+#include "rtsp/ARTPJitterBuffer.h"
+
+namespace android {
+
+// 90kHz clock, one packet every 10ms.
+static const int32_t kClockRate = 90000;
+static const int64_t kPacketIntervalUs = 10000ll;
+
+class ARTPJitterBufferTest : public ::testing::Test {
+protected:
+    static sp<ABuffer> makePacket(uint32_t seqNum) {
+        sp<ABuffer> buffer = new ABuffer(1);
+        buffer->setInt32Data(seqNum);
+        buffer->meta()->setInt32(
+                "rtp-time", seqNum * (kClockRate / 100));
+        return buffer;
+    }
+
+    // Inserts packet "seqNum" as if it arrived "lateUs" after its
+    // nominal time.
+    static bool insert(
+            ARTPJitterBuffer *jb, uint32_t seqNum, int64_t lateUs = 0) {
+        return jb->insert(
+                makePacket(seqNum), seqNum * kPacketIntervalUs + lateUs);
+    }
+
+    static void expectSequence(
+            const List<sp<ABuffer> > &queue,
+            const uint32_t *seqNums, size_t count) {
+        ASSERT_EQ(count, queue.size());
+
+        List<sp<ABuffer> >::const_iterator it = queue.begin();
+        for (size_t i = 0; i < count; ++i, ++it) {
+            EXPECT_EQ(seqNums[i], (uint32_t)(*it)->int32Data());
+        }
+    }
+};
+
+TEST_F(ARTPJitterBufferTest, ReleasesInOrderPacketsImmediately) {
+    ARTPJitterBuffer jb(kClockRate);
+    List<sp<ABuffer> > queue;
+
+    for (uint32_t i = 100; i < 105; ++i) {
+        ASSERT_TRUE(insert(&jb, i));
+        EXPECT_EQ(1u, jb.dequeue(i * kPacketIntervalUs, &queue));
+    }
+
+    const uint32_t expected[] = { 100, 101, 102, 103, 104 };
+    expectSequence(queue, expected, 5);
+    EXPECT_EQ(0u, jb.numPacketsLost());
+    EXPECT_EQ(0u, jb.numPacketsHeld());
+}
+
+TEST_F(ARTPJitterBufferTest, ReordersWithinWindow) {
+    ARTPJitterBuffer jb(kClockRate);
+    List<sp<ABuffer> > queue;
+
+    ASSERT_TRUE(insert(&jb, 0));
+    ASSERT_TRUE(insert(&jb, 2));
+    ASSERT_TRUE(insert(&jb, 3));
+
+    // Packet 1 is still within its reorder window.
+    EXPECT_EQ(1u, jb.dequeue(25000ll, &queue));
+    EXPECT_EQ(2u, jb.numPacketsHeld());
+
+    ASSERT_TRUE(insert(&jb, 1, 2 * kPacketIntervalUs));
+    EXPECT_EQ(3u, jb.dequeue(3 * kPacketIntervalUs, &queue));
+
+    const uint32_t expected[] = { 0, 1, 2, 3 };
+    expectSequence(queue, expected, 4);
+    EXPECT_EQ(0u, jb.numPacketsLost());
+}
+
+TEST_F(ARTPJitterBufferTest, GivesUpAfterPlayoutDelay) {
+    ARTPJitterBuffer jb(kClockRate);
+    List<sp<ABuffer> > queue;
+
+    ASSERT_TRUE(insert(&jb, 0));
+    ASSERT_TRUE(insert(&jb, 3));
+    ASSERT_TRUE(insert(&jb, 4));
+
+    int64_t deadlineUs = 3 * kPacketIntervalUs + jb.playoutDelayUs();
+
+    EXPECT_EQ(1u, jb.dequeue(deadlineUs - 1, &queue));
+    EXPECT_EQ(0u, jb.numPacketsLost());
+
+    EXPECT_EQ(2u, jb.dequeue(deadlineUs, &queue));
+    EXPECT_EQ(2u, jb.numPacketsLost());
+
+    const uint32_t expected[] = { 0, 3, 4 };
+    expectSequence(queue, expected, 3);
+
+    // Packets that were given up on are not accepted anymore.
+    EXPECT_FALSE(insert(&jb, 1, 100 * kPacketIntervalUs));
+}
+
+TEST_F(ARTPJitterBufferTest, DiscardsDuplicates) {
+    ARTPJitterBuffer jb(kClockRate);
+    List<sp<ABuffer> > queue;
+
+    ASSERT_TRUE(insert(&jb, 10));
+    ASSERT_TRUE(insert(&jb, 12));
+    EXPECT_FALSE(insert(&jb, 12));
+
+    EXPECT_EQ(1u, jb.dequeue(12 * kPacketIntervalUs, &queue));
+
+    // Already handed out.
+    EXPECT_FALSE(insert(&jb, 10));
+
+    ASSERT_TRUE(insert(&jb, 11));
+    EXPECT_EQ(2u, jb.dequeue(12 * kPacketIntervalUs, &queue));
+
+    const uint32_t expected[] = { 10, 11, 12 };
+    expectSequence(queue, expected, 3);
+    EXPECT_EQ(0u, jb.numPacketsLost());
+}
+
+TEST_F(ARTPJitterBufferTest, WindowOverflowFlushesOldPackets) {
+    ARTPJitterBuffer jb(kClockRate);
+    List<sp<ABuffer> > queue;
+
+    ASSERT_TRUE(insert(&jb, 0));
+    ASSERT_TRUE(insert(&jb, 2));
+
+    // Far enough ahead to push both 0 and 2 out of the window.
+    ASSERT_TRUE(insert(&jb, 5000));
+
+    EXPECT_EQ(2u, jb.dequeue(0, &queue));
+
+    const uint32_t expected[] = { 0, 2 };
+    expectSequence(queue, expected, 2);
+
+    // Everything in front of the new window counts as lost.
+    EXPECT_EQ(5000u - 1024u + 1u - 2u, jb.numPacketsLost());
+    EXPECT_EQ(1u, jb.numPacketsHeld());
+}
+
+TEST_F(ARTPJitterBufferTest, HandlesSequenceNumberWraparound) {
+    ARTPJitterBuffer jb(kClockRate);
+    List<sp<ABuffer> > queue;
+
+    ASSERT_TRUE(jb.insert(makePacket(0xfffffffe), 0));
+    ASSERT_TRUE(jb.insert(makePacket(0), 0));
+    ASSERT_TRUE(jb.insert(makePacket(0xffffffff), 0));
+
+    EXPECT_EQ(3u, jb.dequeue(0, &queue));
+
+    const uint32_t expected[] = { 0xfffffffe, 0xffffffff, 0 };
+    expectSequence(queue, expected, 3);
+}
+
+TEST_F(ARTPJitterBufferTest, PlayoutDelayFollowsJitter) {
+    ARTPJitterBuffer steady(kClockRate);
+    ARTPJitterBuffer jittery(kClockRate);
+    List<sp<ABuffer> > queue;
+
+    for (uint32_t i = 0; i < 200; ++i) {
+        ASSERT_TRUE(insert(&steady, i));
+
+        // Alternate between on time and 40ms late.
+        ASSERT_TRUE(insert(&jittery, i, (i & 1) ? 40000ll : 0ll));
+
+        steady.dequeue(i * kPacketIntervalUs, &queue);
+        jittery.dequeue(i * kPacketIntervalUs + 40000ll, &queue);
+    }
+
+    EXPECT_EQ(0u, steady.jitter());
+    EXPECT_EQ(10000ll, steady.playoutDelayUs());
+
+    // A mean deviation of 40ms is 3600 timestamp units at 90kHz.
+    EXPECT_NEAR(3600.0, (double)jittery.jitter(), 100.0);
+    EXPECT_GT(jittery.playoutDelayUs(), 100000ll);
+    EXPECT_LE(jittery.playoutDelayUs(), 300000ll);
+}
+
+}  // namespace android
@@ -328,6 +328,74 @@ ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec *mData,
     return translate_error(ret);
 }
 
+EXPORT
+ssize_t AMediaCodec_queueInputBuffers(AMediaCodec *mData,
+        const size_t *indices, const AMediaCodecBufferInfo *info, size_t count) {
+    MediaCodec::BufferDescriptor *buffers = new MediaCodec::BufferDescriptor[count];
+    for (size_t i = 0; i < count; i++) {
+        buffers[i].mIndex = indices[i];
+        buffers[i].mOffset = info[i].offset;
+        buffers[i].mSize = info[i].size;
+        buffers[i].mTimeUs = info[i].presentationTimeUs;
+        buffers[i].mFlags = info[i].flags;
+    }
+
+    AString errorMsg;
+    size_t numDone;
+    status_t ret = mData->mCodec->queueInputBuffers(buffers, count, &numDone, &errorMsg);
+    delete [] buffers;
+
+    if (ret != OK && numDone == 0) {
+        return translate_error(ret);
+    }
+    return numDone;
+}
+
+EXPORT
+ssize_t AMediaCodec_dequeueInputBuffers(AMediaCodec *mData,
+        size_t *indices, size_t maxCount, int64_t timeoutUs) {
+    size_t count;
+    status_t ret = mData->mCodec->dequeueInputBuffers(indices, maxCount, &count, timeoutUs);
+    requestActivityNotification(mData);
+    if (ret == OK) {
+        return count;
+    }
+    return translate_error(ret);
+}
+
+EXPORT
+ssize_t AMediaCodec_dequeueOutputBuffers(AMediaCodec *mData,
+        size_t *indices, AMediaCodecBufferInfo *info, size_t maxCount, int64_t timeoutUs) {
+    MediaCodec::BufferDescriptor *buffers = new MediaCodec::BufferDescriptor[maxCount];
+    size_t count;
+    status_t ret = mData->mCodec->dequeueOutputBuffers(buffers, maxCount, &count, timeoutUs);
+    requestActivityNotification(mData);
+    if (ret == OK) {
+        for (size_t i = 0; i < count; i++) {
+            indices[i] = buffers[i].mIndex;
+            info[i].offset = buffers[i].mOffset;
+            info[i].size = buffers[i].mSize;
+            info[i].flags = buffers[i].mFlags;
+            info[i].presentationTimeUs = buffers[i].mTimeUs;
+        }
+    }
+    delete [] buffers;
+
+    switch (ret) {
+        case OK:
+            return count;
+        case -EAGAIN:
+            return AMEDIACODEC_INFO_TRY_AGAIN_LATER;
+        case android::INFO_FORMAT_CHANGED:
+            return AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED;
+        case INFO_OUTPUT_BUFFERS_CHANGED:
+            return AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED;
+        default:
+            break;
+    }
+    return translate_error(ret);
+}
+
 EXPORT
 AMediaFormat* AMediaCodec_getOutputFormat(AMediaCodec *mData) {
     sp<AMessage> format;
@@ -344,6 +412,17 @@ media_status_t AMediaCodec_releaseOutputBuffer(AMediaCodec *mData, size_t idx, b
     }
 }
 
+EXPORT
+ssize_t AMediaCodec_releaseOutputBuffers(AMediaCodec *mData,
+        const size_t *indices, size_t count, bool render) {
+    size_t numDone;
+    status_t ret = mData->mCodec->releaseOutputBuffers(indices, count, render, &numDone);
+    if (ret != OK && numDone == 0) {
+        return translate_error(ret);
+    }
+    return numDone;
+}
+
 EXPORT
 media_status_t AMediaCodec_releaseOutputBufferAtTime(
         AMediaCodec *mData, size_t idx, int64_t timestampNs) {
@@ -78,3 +78,5 @@ LOCAL_CFLAGS += -Wall -Wextra
 LOCAL_MODULE:= libcameraservice
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -17,6 +17,7 @@
 #define LOG_TAG "CameraService"
 //#define LOG_NDEBUG 0
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
@@ -37,6 +38,7 @@
 #include <utils/Errors.h>
 #include <utils/Log.h>
 #include <utils/String16.h>
+#include <utils/Thread.h>
 #include <utils/Trace.h>
 #include <system/camera_vendor_tags.h>
 #include <system/camera_metadata.h>
@@ -102,11 +104,34 @@ CameraService::CameraService()
 
     for (size_t i = 0; i < MAX_CAMERAS; ++i) {
         mStatusList[i] = ICameraServiceListener::STATUS_PRESENT;
+        mStaticInfoValid[i] = false;
+        mStaticInfoProbeTime[i] = 0;
+        mLastConnectTime[i] = 0;
     }
 
     this->camera_device_status_change = android::camera_device_status_change;
 }
 
+// Reads the static info of one camera, so that all cameras can be probed at
+// once at startup
+class CameraService::StaticInfoProbe : public Thread {
+  public:
+    StaticInfoProbe(CameraService *service, int cameraId) :
+            Thread(/*canCallJava*/false),
+            mService(service),
+            mCameraId(cameraId) {
+    }
+
+  private:
+    virtual bool threadLoop() {
+        mService->probeStaticInfo(mCameraId);
+        return false;
+    }
+
+    CameraService *mService;
+    int mCameraId;
+};
+
 void CameraService::onFirstRef()
 {
     LOG1("CameraService::onFirstRef");
@@ -130,6 +155,26 @@ void CameraService::onFirstRef()
             setCameraFree(i);
         }
 
+        // Probe all cameras' static info in parallel; some HALs power up
+        // the sensor to answer the first get_camera_info
+        nsecs_t probeStart = systemTime();
+        Vector<sp<StaticInfoProbe> > probes;
+        for (int i = 1; i < mNumberOfCameras; i++) {
+            sp<StaticInfoProbe> probe = new StaticInfoProbe(this, i);
+            if (probe->run(String8::format("CameraProbe-%d", i).string())
+                    == OK) {
+                probes.push(probe);
+            }
+        }
+        if (mNumberOfCameras > 0) {
+            probeStaticInfo(0);
+        }
+        for (size_t i = 0; i < probes.size(); i++) {
+            probes[i]->join();
+        }
+        ALOGI("Probed static info of %d cameras in %" PRId64 " ms",
+                mNumberOfCameras, (systemTime() - probeStart) / 1000000);
+
         if (mModule->common.module_api_version >=
                 CAMERA_MODULE_API_VERSION_2_1) {
             mModule->set_callbacks(this);
@@ -173,6 +218,12 @@ void CameraService::onDeviceStatusChanged(int cameraId,
         return;
     }
 
+    {
+        // A camera that comes back may not be the same one
+        Mutex::Autolock l(mStaticInfoLock);
+        mStaticInfoValid[cameraId] = false;
+    }
+
     /* don't do this in updateStatus
        since it is also called from connect and we could get into a deadlock */
     if (newStatus == CAMERA_DEVICE_STATUS_NOT_PRESENT) {
@@ -385,9 +436,49 @@ status_t CameraService::getCameraVendorTagDescriptor(/*out*/sp<VendorTagDescript
     return OK;
 }
 
+status_t CameraService::probeStaticInfo(int cameraId) {
+    ATRACE_CALL();
+    struct camera_info info;
+    nsecs_t start = systemTime();
+    status_t res = mModule->get_camera_info(cameraId, &info);
+    nsecs_t probeTime = systemTime() - start;
+    if (res != OK) {
+        ALOGE("%s: Camera %d: Unable to get static info: %s (%d)",
+                __FUNCTION__, cameraId, strerror(-res), res);
+        return res;
+    }
+
+    Mutex::Autolock l(mStaticInfoLock);
+    mStaticInfo[cameraId] = info;
+    mStaticInfoValid[cameraId] = true;
+    mStaticInfoProbeTime[cameraId] = probeTime;
+    return OK;
+}
+
+status_t CameraService::getStaticInfo(int cameraId, struct camera_info *info) {
+    if (cameraId < 0 || cameraId >= MAX_CAMERAS) {
+        return mModule->get_camera_info(cameraId, info);
+    }
+
+    {
+        Mutex::Autolock l(mStaticInfoLock);
+        if (mStaticInfoValid[cameraId]) {
+            *info = mStaticInfo[cameraId];
+            return OK;
+        }
+    }
+
+    status_t res = probeStaticInfo(cameraId);
+    if (res != OK) return res;
+
+    Mutex::Autolock l(mStaticInfoLock);
+    *info = mStaticInfo[cameraId];
+    return OK;
+}
+
 int CameraService::getDeviceVersion(int cameraId, int* facing) {
     struct camera_info info;
-    if (mModule->get_camera_info(cameraId, &info) != OK) {
+    if (getStaticInfo(cameraId, &info) != OK) {
         return -1;
     }
 
@@ -717,7 +808,7 @@ status_t CameraService::connectHelperLocked(
         }
     }
 
-    status_t status = connectFinishUnsafe(client, client->getRemote());
+    status_t status = connectFinishUnsafe(client, client->getRemote(), cameraId);
     if (status != OK) {
         // this is probably not recoverable.. maybe the client can try again
         return status;
@@ -847,11 +938,16 @@ status_t CameraService::connectLegacy(
 }
 
 status_t CameraService::connectFinishUnsafe(const sp<BasicClient>& client,
-                                            const sp<IBinder>& remoteCallback) {
+                                            const sp<IBinder>& remoteCallback,
+                                            int cameraId) {
+    nsecs_t start = systemTime();
     status_t status = client->initialize(mModule);
     if (status != OK) {
         return status;
     }
+    mLastConnectTime[cameraId] = systemTime() - start;
+    LOG1("Camera %d: client initialized in %" PRId64 " ms", cameraId,
+            mLastConnectTime[cameraId] / 1000000);
     if (remoteCallback != NULL) {
         remoteCallback->linkToDeath(this);
     }
@@ -919,7 +1015,7 @@ status_t CameraService::connectPro(
             return INVALID_OPERATION;
         }
 
-        status_t status = connectFinishUnsafe(client, client->getRemote());
+        status_t status = connectFinishUnsafe(client, client->getRemote(), cameraId);
         if (status != OK) {
             return status;
         }
@@ -991,7 +1087,7 @@ status_t CameraService::connectDevice(
             return INVALID_OPERATION;
         }
 
-        status_t status = connectFinishUnsafe(client, client->getRemote());
+        status_t status = connectFinishUnsafe(client, client->getRemote(), cameraId);
         if (status != OK) {
             // this is probably not recoverable.. maybe the client can try again
             return status;
@@ -1682,6 +1778,20 @@ status_t CameraService::dump(int fd, const Vector<String16>& args) {
                 }
             }
 
+            result = String8();
+            {
+                Mutex::Autolock l(mStaticInfoLock);
+                if (mStaticInfoValid[i]) {
+                    result.appendFormat("  Static info probed in %.2f ms\n",
+                            mStaticInfoProbeTime[i] / 1e6);
+                }
+            }
+            if (mLastConnectTime[i] > 0) {
+                result.appendFormat("  Last client initialized in %.2f ms\n",
+                        mLastConnectTime[i] / 1e6);
+            }
+            write(fd, result.string(), result.size());
+
             sp<BasicClient> client = mClient[i].promote();
             if (client == 0) {
                 result = String8::format("  Device is closed, no client instance\n");
@@ -355,7 +355,8 @@ private:
 
     // When connection is successful, initialize client and track its death
     status_t            connectFinishUnsafe(const sp<BasicClient>& client,
-                                            const sp<IBinder>& remoteCallback);
+                                            const sp<IBinder>& remoteCallback,
+                                            int cameraId);
 
     virtual sp<BasicClient>  getClientByRemote(const wp<IBinder>& cameraClient);
 
@@ -373,6 +374,25 @@ private:
     sp<ProClient>       findProClientUnsafe(
                                      const wp<IBinder>& cameraCallbacksRemote);
 
+    // How long the latest client initialize() took, for dump()
+    nsecs_t             mLastConnectTime[MAX_CAMERAS];  // protected by mServiceLock
+
+    /**
+     * Static camera info, read in parallel for all cameras by onFirstRef so
+     * that connects don't go to the HAL for the device version and facing.
+     * An entry is read again after a status change for its camera.
+     */
+    class StaticInfoProbe;
+    Mutex               mStaticInfoLock;
+    struct camera_info  mStaticInfo[MAX_CAMERAS];      // protected by mStaticInfoLock
+    bool                mStaticInfoValid[MAX_CAMERAS]; // protected by mStaticInfoLock
+    nsecs_t             mStaticInfoProbeTime[MAX_CAMERAS]; // protected by mStaticInfoLock
+
+    // Read camera_info from the HAL into the cache
+    status_t            probeStaticInfo(int cameraId);
+    // Cached camera_info, probing the HAL if there's none
+    status_t            getStaticInfo(int cameraId, struct camera_info *info);
+
     // atomics to record whether the hardware is allocated to some client.
     volatile int32_t    mBusy[MAX_CAMERAS];
     void                setCameraBusy(int cameraId);
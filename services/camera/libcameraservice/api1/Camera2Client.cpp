@@ -372,8 +372,12 @@ status_t Camera2Client::dump(int fd, const Vector<String16>& args) {
 
     mStreamingProcessor->dump(fd, args);
 
+    mCallbackProcessor->dump(fd, args);
+
     mCaptureSequencer->dump(fd, args);
 
+    mJpegProcessor->dump(fd, args);
+
     mFrameProcessor->dump(fd, args);
 
     mZslProcessor->dump(fd, args);
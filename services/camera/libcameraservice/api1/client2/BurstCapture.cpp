@@ -19,6 +19,7 @@
 
 #include <utils/Log.h>
 #include <utils/Trace.h>
+#include <utils/List.h>
 
 #include "BurstCapture.h"
 
@@ -38,10 +39,27 @@ BurstCapture::BurstCapture(wp<Camera2Client> client, wp<CaptureSequencer> sequen
 BurstCapture::~BurstCapture() {
 }
 
-status_t BurstCapture::start(Vector<CameraMetadata> &/*metadatas*/,
-                             int32_t /*firstCaptureId*/) {
-    ALOGE("Not completely implemented");
-    return INVALID_OPERATION;
+status_t BurstCapture::start(Vector<CameraMetadata> &metadatas,
+                             int32_t firstCaptureId) {
+    ATRACE_CALL();
+    sp<Camera2Client> client = mClient.promote();
+    if (client == 0) return INVALID_OPERATION;
+
+    // Submit the whole burst at once so the HAL can pipeline it
+    List<const CameraMetadata> requests;
+    for (size_t i = 0; i < metadatas.size(); i++) {
+        requests.push_back(metadatas[i]);
+    }
+
+    ALOGV("%s: Submitting %zu requests, capture IDs from %d", __FUNCTION__,
+            metadatas.size(), firstCaptureId);
+    status_t res = client->getCameraDevice()->captureList(requests);
+    if (res != OK) {
+        ALOGE("%s: Camera %d: Unable to submit burst of %zu requests: %s (%d)",
+                __FUNCTION__, client->getCameraId(), metadatas.size(),
+                strerror(-res), res);
+    }
+    return res;
 }
 
 void BurstCapture::onFrameAvailable() {
@@ -76,7 +94,7 @@ bool BurstCapture::threadLoop() {
 
 CpuConsumer::LockedBuffer* BurstCapture::jpegEncode(
     CpuConsumer::LockedBuffer *imgBuffer,
-    int /*quality*/)
+    int quality)
 {
     ALOGV("%s", __FUNCTION__);
 
@@ -92,7 +110,7 @@ CpuConsumer::LockedBuffer* BurstCapture::jpegEncode(
     buffers.push_back(imgEncoded);
 
     sp<JpegCompressor> jpeg = new JpegCompressor();
-    jpeg->start(buffers, 1);
+    jpeg->start(buffers, 1, quality);
 
     bool success = jpeg->waitForDone(10 * 1e9);
     if(success) {
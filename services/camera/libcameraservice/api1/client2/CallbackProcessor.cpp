@@ -27,11 +27,98 @@
 #include "api1/Camera2Client.h"
 #include "api1/client2/CallbackProcessor.h"
 
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #define ALIGN(x, mask) ( ((x) + (mask) - 1) & ~((mask) - 1) )
 
 namespace android {
 namespace camera2 {
 
+/**
+ * One frame in the callback heap. Its slot goes back to the ring once the
+ * client, and anyone else, lets go of it.
+ */
+class CallbackProcessor::CallbackBuffer : public MemoryBase {
+  public:
+    CallbackBuffer(const wp<CallbackProcessor> &processor,
+            const sp<Camera2Heap> &heap, size_t index) :
+            MemoryBase(heap->mHeap, index * heap->mBufSize, heap->mBufSize),
+            mProcessor(processor),
+            mCallbackHeap(heap),
+            mIndex(index) {
+    }
+
+    virtual ~CallbackBuffer() {
+        sp<CallbackProcessor> processor = mProcessor.promote();
+        if (processor != 0) {
+            processor->onCallbackBufferFreed(mCallbackHeap, mIndex);
+        }
+    }
+
+  private:
+    wp<CallbackProcessor> mProcessor;
+    sp<Camera2Heap> mCallbackHeap;
+    size_t mIndex;
+};
+
+// Chroma row helpers for the flexible YUV conversion. Each handles
+// width chroma samples per plane.
+
+// Two chroma planes to one interleaved plane, first plane's samples first
+static void interleaveChromaRow(uint8_t *dst, const uint8_t *first,
+        const uint8_t *second, size_t width) {
+    size_t col = 0;
+#if defined(__ARM_NEON__)
+    for (; col + 16 <= width; col += 16) {
+        uint8x16x2_t pairs;
+        pairs.val[0] = vld1q_u8(first + col);
+        pairs.val[1] = vld1q_u8(second + col);
+        vst2q_u8(dst + col * 2, pairs);
+    }
+#endif
+    for (; col < width; col++) {
+        dst[col * 2] = first[col];
+        dst[col * 2 + 1] = second[col];
+    }
+}
+
+// Interleaved chroma with the two samples of each pair swapped
+static void swapChromaRow(uint8_t *dst, const uint8_t *src, size_t width) {
+    size_t col = 0;
+#if defined(__ARM_NEON__)
+    for (; col + 16 <= width; col += 16) {
+        uint8x16x2_t pairs = vld2q_u8(src + col * 2);
+        uint8x16_t first = pairs.val[0];
+        pairs.val[0] = pairs.val[1];
+        pairs.val[1] = first;
+        vst2q_u8(dst + col * 2, pairs);
+    }
+#endif
+    for (; col < width; col++) {
+        dst[col * 2] = src[col * 2 + 1];
+        dst[col * 2 + 1] = src[col * 2];
+    }
+}
+
+// One interleaved chroma plane to two planes
+static void deinterleaveChromaRow(uint8_t *first, uint8_t *second,
+        const uint8_t *src, size_t width) {
+    size_t col = 0;
+#if defined(__ARM_NEON__)
+    for (; col + 16 <= width; col += 16) {
+        uint8x16x2_t pairs = vld2q_u8(src + col * 2);
+        vst1q_u8(first + col, pairs.val[0]);
+        vst1q_u8(second + col, pairs.val[1]);
+    }
+#endif
+    for (; col < width; col++) {
+        first[col] = src[col * 2];
+        second[col] = src[col * 2 + 1];
+    }
+}
+
 CallbackProcessor::CallbackProcessor(sp<Camera2Client> client):
         Thread(false),
         mClient(client),
@@ -39,7 +126,12 @@ CallbackProcessor::CallbackProcessor(sp<Camera2Client> client):
         mId(client->getCameraId()),
         mCallbackAvailable(false),
         mCallbackToApp(false),
-        mCallbackStreamId(NO_STREAM) {
+        mCallbackStreamId(NO_STREAM),
+        mCallbackHeapHead(0),
+        mCallbackHeapFree(0),
+        mCallbackFramesSent(0),
+        mCallbackFramesDropped(0),
+        mCallbackFramesRepacked(0) {
 }
 
 CallbackProcessor::~CallbackProcessor() {
@@ -215,12 +307,20 @@ int CallbackProcessor::getStreamId() const {
     return mCallbackStreamId;
 }
 
-void CallbackProcessor::dump(int /*fd*/, const Vector<String16>& /*args*/) const {
+void CallbackProcessor::dump(int fd, const Vector<String16>& /*args*/) const {
+    Mutex::Autolock l(mInputMutex);
+    String8 result = String8::format("    Preview callbacks: %zu sent, "
+            "%zu repacked, %zu dropped with no free buffer\n",
+            mCallbackFramesSent, mCallbackFramesRepacked, mCallbackFramesDropped);
+    if (mCallbackHeap != 0) {
+        result.appendFormat("      %zu of %zu buffers of %zu bytes free\n",
+                mCallbackHeapFree, kCallbackHeapCount, mCallbackHeap->mBufSize);
+    }
+    write(fd, result.string(), result.size());
 }
 
 bool CallbackProcessor::threadLoop() {
     status_t res;
-    sp<Camera2Heap> callbackHeap = NULL;
     sp<CpuConsumer> callbackConsumer = NULL;
 
     {
@@ -231,7 +331,6 @@ bool CallbackProcessor::threadLoop() {
             if (res == TIMED_OUT) return true;
         }
         mCallbackAvailable = false;
-        callbackHeap = mCallbackHeap;
         callbackConsumer = mCallbackConsumer;
     }
 
@@ -240,7 +339,7 @@ bool CallbackProcessor::threadLoop() {
         if (client == 0) {
             res = discardNewCallback();
         } else {
-            res = processNewCallback(client, callbackHeap, callbackConsumer);
+            res = processNewCallback(client, callbackConsumer);
         }
     } while (res == OK);
 
@@ -268,15 +367,25 @@ status_t CallbackProcessor::discardNewCallback() {
     return OK;
 }
 
+void CallbackProcessor::onCallbackBufferFreed(const sp<Camera2Heap> &heap,
+        size_t index) {
+    Mutex::Autolock l(mInputMutex);
+    // Buffers of a heap that has since been replaced don't count
+    if (heap == mCallbackHeap && mCallbackBufferInUse[index]) {
+        mCallbackBufferInUse[index] = false;
+        mCallbackHeapFree++;
+    }
+}
+
 status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client,
-        sp<Camera2Heap> callbackHeap, sp<CpuConsumer> callbackConsumer) {
+        sp<CpuConsumer> callbackConsumer) {
     ATRACE_CALL();
     status_t res;
 
-    //sp<Camera2Heap> callbackHeap;
     bool useFlexibleYuv = false;
     int32_t previewFormat = 0;
-    size_t heapIdx;
+    // Outside of the locks, since letting go of it takes mInputMutex
+    sp<MemoryBase> callbackBuffer;
 
     if (callbackConsumer.get() == NULL) {
          return BAD_VALUE;
@@ -385,8 +494,9 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client,
         size_t bufferSize = Camera2Client::calculateBufferSize(
                 imgBuffer.width, imgBuffer.height,
                 previewFormat, destYStride);
+        sp<Camera2Heap> callbackHeap = mCallbackHeap;
         size_t currentBufferSize = (callbackHeap == 0) ?
-                0 : (callbackHeap->mHeap->getSize() / kCallbackHeapCount);
+                0 : callbackHeap->mBufSize;
         if (bufferSize != currentBufferSize) {
             callbackHeap.clear();
             callbackHeap = new Camera2Heap(bufferSize, kCallbackHeapCount,
@@ -401,52 +511,61 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client,
             mCallbackHeapHead = 0;
             mCallbackHeap = callbackHeap;
             mCallbackHeapFree = kCallbackHeapCount;
+            for (size_t i = 0; i < kCallbackHeapCount; i++) {
+                mCallbackBufferInUse[i] = false;
+            }
         }
 
         if (mCallbackHeapFree == 0) {
             ALOGE("%s: Camera %d: No free callback buffers, dropping frame",
                     __FUNCTION__, mId);
+            mCallbackFramesDropped++;
             callbackConsumer->unlockBuffer(imgBuffer);
             return OK;
         }
 
-        heapIdx = mCallbackHeapHead;
-
-        mCallbackHeapHead = (mCallbackHeapHead + 1) & kCallbackHeapCount;
+        // Oldest buffer first, skipping any the client still holds
+        size_t heapIdx = mCallbackHeapHead;
+        while (mCallbackBufferInUse[heapIdx]) {
+            heapIdx = (heapIdx + 1) % kCallbackHeapCount;
+        }
+        mCallbackHeapHead = (heapIdx + 1) % kCallbackHeapCount;
+        mCallbackBufferInUse[heapIdx] = true;
         mCallbackHeapFree--;
+        callbackBuffer = new CallbackBuffer(this, callbackHeap, heapIdx);
 
         // TODO: Get rid of this copy by passing the gralloc queue all the way
         // to app
 
-        ssize_t offset;
-        size_t size;
-        if (callbackHeap == NULL || callbackHeap->mBuffers == NULL) {
-            return BAD_VALUE;
-        }
-        sp<IMemoryHeap> heap =
-                callbackHeap->mBuffers[heapIdx]->getMemory(&offset,
-                        &size);
-        uint8_t *data = (uint8_t*)heap->getBase() + offset;
+        uint8_t *data = (uint8_t*)callbackHeap->mHeap->getBase() +
+                heapIdx * callbackHeap->mBufSize;
 
-        if (!useFlexibleYuv) {
-            // Can just memcpy when HAL format matches API format
+        bool repacked = true;
+        if (useFlexibleYuv) {
+            res = convertFromFlexibleYuv(previewFormat, data, imgBuffer,
+                    destYStride, destCStride);
+        } else if (imgBuffer.stride == destYStride) {
+            // Can just memcpy when HAL format and layout match API format
             memcpy(data, imgBuffer.data, bufferSize);
+            repacked = false;
+            res = OK;
         } else {
-            res = convertFromFlexibleYuv(previewFormat, data, imgBuffer,
+            res = repackYuv(previewFormat, data, bufferSize, imgBuffer,
                     destYStride, destCStride);
-            if (res != OK) {
-                ALOGE("%s: Camera %d: Can't convert between 0x%x and 0x%x formats!",
-                        __FUNCTION__, mId, imgBuffer.format, previewFormat);
-                callbackConsumer->unlockBuffer(imgBuffer);
-                return BAD_VALUE;
-            }
+        }
+        if (res != OK) {
+            ALOGE("%s: Camera %d: Can't convert between 0x%x and 0x%x formats!",
+                    __FUNCTION__, mId, imgBuffer.format, previewFormat);
+            callbackConsumer->unlockBuffer(imgBuffer);
+            return BAD_VALUE;
+        }
+        if (repacked) {
+            mCallbackFramesRepacked++;
         }
 
         ALOGV("%s: Freeing buffer", __FUNCTION__);
         mCallbackConsumer->unlockBuffer(imgBuffer);
-
-        // mCallbackHeap may get freed up once input mutex is released
-        callbackHeap = mCallbackHeap;
+        mCallbackFramesSent++;
     }
 
     // Call outside parameter lock to allow re-entrancy from notification
@@ -457,13 +576,10 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client,
             ALOGV("%s: Camera %d: Invoking client data callback",
                     __FUNCTION__, mId);
             l.mRemoteCallback->dataCallback(CAMERA_MSG_PREVIEW_FRAME,
-                    callbackHeap->mBuffers[heapIdx], NULL);
+                    callbackBuffer, NULL);
         }
     }
 
-    // Only increment free if we're still using the same heap
-    mCallbackHeapFree++;
-
     ALOGV("%s: exit", __FUNCTION__);
 
     return OK;
@@ -512,6 +628,23 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
                 crcbDst += src.width;
                 crSrc += src.chromaStride;
             }
+        } else if (crSrc == cbSrc + 1 && src.chromaStep == 2) {
+            ALOGV("%s: Fast NV12->NV21", __FUNCTION__);
+            // Source has semiplanar CbCr chroma layout, swap each pair
+            for (size_t row = 0; row < chromaHeight; row++) {
+                swapChromaRow(crcbDst, cbSrc, chromaWidth);
+                crcbDst += src.width;
+                cbSrc += src.chromaStride;
+            }
+        } else if (src.chromaStep == 1) {
+            ALOGV("%s: Fast planar->NV21", __FUNCTION__);
+            // Source has planar chroma layout, interleave by rows
+            for (size_t row = 0; row < chromaHeight; row++) {
+                interleaveChromaRow(crcbDst, crSrc, cbSrc, chromaWidth);
+                crcbDst += src.width;
+                crSrc += src.chromaStride;
+                cbSrc += src.chromaStride;
+            }
         } else {
             ALOGV("%s: Generic->NV21", __FUNCTION__);
             // Generic copy, always works but not very efficient
@@ -545,6 +678,22 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
                 cbDst += dstCStride;
                 cbSrc += src.chromaStride;
             }
+        } else if (src.chromaStep == 2 &&
+                (cbSrc == crSrc + 1 || crSrc == cbSrc + 1)) {
+            ALOGV("%s: Fast semiplanar->YV12", __FUNCTION__);
+            // Source has semiplanar chroma layout, split by rows
+            bool crFirst = (cbSrc == crSrc + 1);
+            const uint8_t *pairSrc = crFirst ? crSrc : cbSrc;
+            for (size_t row = 0; row < chromaHeight; row++) {
+                if (crFirst) {
+                    deinterleaveChromaRow(crDst, cbDst, pairSrc, chromaWidth);
+                } else {
+                    deinterleaveChromaRow(cbDst, crDst, pairSrc, chromaWidth);
+                }
+                crDst += dstCStride;
+                cbDst += dstCStride;
+                pairSrc += src.chromaStride;
+            }
         } else {
             ALOGV("%s: Generic->YV12", __FUNCTION__);
             // Generic copy, always works but not very efficient
@@ -566,5 +715,63 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
     return OK;
 }
 
+status_t CallbackProcessor::repackYuv(int32_t previewFormat,
+        uint8_t *dst,
+        size_t dstSize,
+        const CpuConsumer::LockedBuffer &src,
+        uint32_t dstYStride,
+        uint32_t dstCStride) const {
+    size_t chromaHeight = src.height / 2;
+    size_t chromaRows;
+    size_t chromaRowBytes;
+    uint32_t srcCStride;
+    if (previewFormat == HAL_PIXEL_FORMAT_YCrCb_420_SP) {
+        // One CrCb plane at the luma stride, in the source as in the
+        // destination; dstCStride only applies to planar chroma
+        chromaRows = chromaHeight;
+        chromaRowBytes = src.width;
+        srcCStride = src.stride;
+        dstCStride = dstYStride;
+    } else if (previewFormat == HAL_PIXEL_FORMAT_YV12) {
+        // Cr then Cb planes, each at half the luma stride aligned to 16
+        chromaRows = chromaHeight * 2;
+        chromaRowBytes = src.width / 2;
+        srcCStride = ALIGN(src.stride / 2, 16);
+    } else {
+        ALOGE("%s: Camera %d: Unexpected preview format when repacking: 0x%x",
+                __FUNCTION__, mId, previewFormat);
+        return INVALID_OPERATION;
+    }
+
+    // Rows must neither overlap nor run past the callback buffer
+    if (src.width > dstYStride || chromaRowBytes > dstCStride ||
+            (size_t)dstYStride * src.height +
+                    (size_t)dstCStride * chromaRows > dstSize) {
+        ALOGE("%s: Camera %d: %ux%u frame doesn't fit strides %u/%u in a "
+                "%zu byte buffer", __FUNCTION__, mId, src.width, src.height,
+                dstYStride, dstCStride, dstSize);
+        return BAD_VALUE;
+    }
+
+    const uint8_t *ySrc = src.data;
+    uint8_t *yDst = dst;
+    for (size_t row = 0; row < src.height; row++) {
+        memcpy(yDst, ySrc, src.width);
+        ySrc += src.stride;
+        yDst += dstYStride;
+    }
+
+    // Both chroma planes of YV12 are contiguous at the same stride
+    const uint8_t *cSrc = src.data + src.stride * src.height;
+    uint8_t *cDst = yDst;
+    for (size_t row = 0; row < chromaRows; row++) {
+        memcpy(cDst, cSrc, chromaRowBytes);
+        cSrc += srcCStride;
+        cDst += dstCStride;
+    }
+
+    return OK;
+}
+
 }; // namespace camera2
 }; // namespace android
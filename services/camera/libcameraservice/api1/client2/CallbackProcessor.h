@@ -74,16 +74,33 @@ class CallbackProcessor:
     static const size_t kCallbackHeapCount = 6;
     sp<CpuConsumer>    mCallbackConsumer;
     sp<ANativeWindow>  mCallbackWindow;
+    // Ring of callback buffers in one ashmem heap. A buffer is in use until
+    // the last reference to the frame handed to the client goes away.
+    class CallbackBuffer;
     sp<Camera2Heap>    mCallbackHeap;
-    int mCallbackHeapId;
+    bool mCallbackBufferInUse[kCallbackHeapCount];
     size_t mCallbackHeapHead, mCallbackHeapFree;
 
+    // Callback statistics, for dump()
+    size_t mCallbackFramesSent;
+    size_t mCallbackFramesDropped;
+    size_t mCallbackFramesRepacked;
+
     virtual bool threadLoop();
 
     status_t processNewCallback(sp<Camera2Client> &client,
-             sp<Camera2Heap> callbackHeap, sp<CpuConsumer> callbackConsumer);
+             sp<CpuConsumer> callbackConsumer);
     // Used when shutting down
     status_t discardNewCallback();
+    void onCallbackBufferFreed(const sp<Camera2Heap> &heap, size_t index);
+
+    // Copy an NV21 or YV12 buffer whose strides differ from the API ones
+    status_t repackYuv(int32_t previewFormat,
+            uint8_t *dst,
+            size_t dstSize,
+            const CpuConsumer::LockedBuffer &src,
+            uint32_t dstYStride,
+            uint32_t dstCStride) const;
 
     // Convert from flexible YUV to NV21 or YV12
     status_t convertFromFlexibleYuv(int32_t previewFormat,
@@ -47,6 +47,7 @@ CaptureSequencer::CaptureSequencer(wp<Camera2Client> client):
         mNewFrameReceived(false),
         mNewCaptureReceived(false),
         mShutterNotified(false),
+        mBurstActive(false),
         mClient(client),
         mCaptureState(IDLE),
         mStateTransitionCount(0),
@@ -55,6 +56,7 @@ CaptureSequencer::CaptureSequencer(wp<Camera2Client> client):
         mCaptureId(Camera2Client::kCaptureRequestIdStart),
         mMsgType(0) {
     ALOGV("%s", __FUNCTION__);
+    memset(&mBurstStats, 0, sizeof(mBurstStats));
 }
 
 CaptureSequencer::~CaptureSequencer() {
@@ -128,7 +130,11 @@ void CaptureSequencer::onCaptureAvailable(nsecs_t timestamp,
     ALOGV("%s", __FUNCTION__);
     Mutex::Autolock l(mInputMutex);
     mCaptureTimestamp = timestamp;
-    mCaptureBuffer = captureBuffer;
+    if (mBurstActive) {
+        mBurstBuffers.push_back(captureBuffer);
+    } else {
+        mCaptureBuffer = captureBuffer;
+    }
     if (!mNewCaptureReceived) {
         mNewCaptureReceived = true;
         mNewCaptureSignal.signal();
@@ -151,6 +157,23 @@ void CaptureSequencer::dump(int fd, const Vector<String16>& /*args*/) {
     result.append("    Latest captured frame:\n");
     write(fd, result.string(), result.size());
     mNewFrame.dump(fd, 2, 6);
+
+    BurstStats burstStats;
+    {
+        Mutex::Autolock l(mInputMutex);
+        burstStats = mBurstStats;
+    }
+    if (burstStats.requested > 0) {
+        result = String8::format("    Latest burst: %zu of %zu JPEGs in "
+                "%.1f ms (%.2f fps)\n", burstStats.received,
+                burstStats.requested, burstStats.elapsed / 1e6,
+                burstStats.elapsed > 0 ?
+                        burstStats.received * 1e9 / burstStats.elapsed : 0.0);
+        result.appendFormat("      First JPEG after %.1f ms, at most %zu JPEGs "
+                "waiting for the client\n", burstStats.firstJpegLatency / 1e6,
+                burstStats.peakPending);
+        write(fd, result.string(), result.size());
+    }
 }
 
 /** Private members */
@@ -633,70 +656,179 @@ CaptureSequencer::CaptureState CaptureSequencer::manageBurstCaptureStart(
     ALOGV("%s", __FUNCTION__);
     status_t res;
     ATRACE_CALL();
+    SharedParameters::Lock l(client->getParameters());
 
-    // check which burst mode is set, create respective burst object
-    {
-        SharedParameters::Lock l(client->getParameters());
-
-        res = updateCaptureRequest(l.mParameters, client);
-        if(res != OK) {
-            return DONE;
-        }
+    res = updateCaptureRequest(l.mParameters, client);
+    if (res != OK) {
+        return DONE;
+    }
 
-        //
-        // check for burst mode type in mParameters here
-        //
+    //
+    // check for burst mode type in mParameters here
+    //
+    if (mBurstCapture == 0) {
         mBurstCapture = new BurstCapture(client, this);
     }
 
-    res = mCaptureRequest.update(ANDROID_REQUEST_ID, &mCaptureId, 1);
+    // Only a client that asked for every image of the burst gets more than
+    // one; anyone else keeps the single jpeg callback per takePicture()
+    size_t burstLength = l.mParameters.lightFxAllImages ? kBurstLength : 1;
+
+    // The whole burst needs consecutive capture IDs
+    if (mCaptureId + static_cast<int32_t>(burstLength) >
+            Camera2Client::kCaptureRequestIdEnd) {
+        mCaptureId = Camera2Client::kCaptureRequestIdStart;
+    }
+
+    Vector<int32_t> outputStreams;
+    outputStreams.push(client->getPreviewStreamId());
+    outputStreams.push(client->getCaptureStreamId());
+    uint8_t captureIntent =
+            static_cast<uint8_t>(ANDROID_CONTROL_CAPTURE_INTENT_STILL_CAPTURE);
+
+    res = mCaptureRequest.update(ANDROID_REQUEST_OUTPUT_STREAMS,
+            outputStreams);
     if (res == OK) {
-        res = mCaptureRequest.sort();
+        res = mCaptureRequest.update(ANDROID_CONTROL_CAPTURE_INTENT,
+                &captureIntent, 1);
+    }
+
+    Vector<CameraMetadata> requests;
+    for (size_t i = 0; i < burstLength && res == OK; i++) {
+        int32_t captureId = mCaptureId + i;
+        res = mCaptureRequest.update(ANDROID_REQUEST_ID, &captureId, 1);
+        if (res == OK) {
+            res = mCaptureRequest.sort();
+        }
+        if (res == OK) {
+            requests.push(mCaptureRequest);
+        }
     }
     if (res != OK) {
-        ALOGE("%s: Camera %d: Unable to set up still capture request: %s (%d)",
+        ALOGE("%s: Camera %d: Unable to set up burst capture requests: %s (%d)",
                 __FUNCTION__, client->getCameraId(), strerror(-res), res);
         return DONE;
     }
 
-    CameraMetadata captureCopy = mCaptureRequest;
-    if (captureCopy.entryCount() == 0) {
-        ALOGE("%s: Camera %d: Unable to copy capture request for HAL device",
-                __FUNCTION__, client->getCameraId());
+    // API definition of takePicture() - stop preview before taking pic
+    res = client->stopStream();
+    if (res != OK) {
+        ALOGE("%s: Camera %d: Unable to stop preview for burst capture: "
+                "%s (%d)",
+                __FUNCTION__, client->getCameraId(), strerror(-res), res);
         return DONE;
     }
 
-    Vector<CameraMetadata> requests;
-    requests.push(mCaptureRequest);
+    {
+        Mutex::Autolock il(mInputMutex);
+        mBurstActive = true;
+        mBurstBuffers.clear();
+        mNewCaptureReceived = false;
+        memset(&mBurstStats, 0, sizeof(mBurstStats));
+        mBurstStats.requested = burstLength;
+        mBurstStats.startTime = systemTime();
+    }
+
     res = mBurstCapture->start(requests, mCaptureId);
-    mTimeoutCount = kMaxTimeoutsForCaptureEnd * 10;
+    if (res != OK) {
+        Mutex::Autolock il(mInputMutex);
+        mBurstActive = false;
+        return DONE;
+    }
+
+    mTimeoutCount = kMaxTimeoutsForCaptureEnd;
     return BURST_CAPTURE_WAIT;
 }
 
 CaptureSequencer::CaptureState CaptureSequencer::manageBurstCaptureWait(
-        sp<Camera2Client> &/*client*/) {
+        sp<Camera2Client> &client) {
     status_t res;
     ATRACE_CALL();
+    List<sp<MemoryBase> > jpegs;
+    bool timedOut = false;
+    {
+        Mutex::Autolock l(mInputMutex);
+        while (!mNewCaptureReceived) {
+            res = mNewCaptureSignal.waitRelative(mInputMutex, kWaitDuration);
+            if (res == TIMED_OUT) {
+                mTimeoutCount--;
+                break;
+            }
+        }
+        mNewCaptureReceived = false;
 
-    while (!mNewCaptureReceived) {
-        res = mNewCaptureSignal.waitRelative(mInputMutex, kWaitDuration);
-        if (res == TIMED_OUT) {
-            mTimeoutCount--;
-            break;
+        if (mBurstBuffers.size() > mBurstStats.peakPending) {
+            mBurstStats.peakPending = mBurstBuffers.size();
+        }
+        jpegs = mBurstBuffers;
+        mBurstBuffers.clear();
+        timedOut = jpegs.empty() && mTimeoutCount <= 0;
+
+        if (!jpegs.empty()) {
+            nsecs_t now = systemTime();
+            if (mBurstStats.received == 0) {
+                mBurstStats.firstJpegLatency = now - mBurstStats.startTime;
+            }
+            mBurstStats.elapsed = now - mBurstStats.startTime;
         }
     }
 
-    if (mTimeoutCount <= 0) {
-        ALOGW("Timed out waiting for burst capture to complete");
-        return DONE;
+    if (!jpegs.empty()) {
+        size_t received = mBurstStats.received;
+        if (!mShutterNotified) {
+            SharedParameters::Lock l(client->getParameters());
+            /* warning: this also locks a SharedCameraCallbacks */
+            shutterNotifyLocked(l.mParameters, client, mMsgType);
+            mShutterNotified = true;
+        }
+
+        // Stream each JPEG out as soon as it is ready; the last one goes out
+        // from manageDone like a single capture. Dropping our reference
+        // returns its heap to the JpegProcessor for the next capture.
+        while (!jpegs.empty()) {
+            sp<MemoryBase> jpeg = *jpegs.begin();
+            jpegs.erase(jpegs.begin());
+            received++;
+            if (received >= mBurstStats.requested) {
+                mCaptureBuffer = jpeg;
+                continue;
+            }
+
+            Camera2Client::SharedCameraCallbacks::Lock
+                l(client->mSharedCameraCallbacks);
+            ALOGV("%s: Sending burst image %zu of %zu to client", __FUNCTION__,
+                    received, mBurstStats.requested);
+            if (l.mRemoteCallback != 0) {
+                l.mRemoteCallback->dataCallback(CAMERA_MSG_COMPRESSED_IMAGE,
+                        jpeg, NULL);
+            }
+        }
+        {
+            Mutex::Autolock l(mInputMutex);
+            mBurstStats.received = received;
+        }
+        mTimeoutCount = kMaxTimeoutsForCaptureEnd;
     }
-    if (mNewCaptureReceived) {
-        mNewCaptureReceived = false;
-        // TODO: update mCaptureId to last burst's capture ID + 1?
-        return DONE;
+
+    if (timedOut) {
+        ALOGW("Timed out waiting for burst capture to complete: "
+                "got %zu of %zu images", mBurstStats.received,
+                mBurstStats.requested);
+    } else if (mBurstStats.received < mBurstStats.requested) {
+        return BURST_CAPTURE_WAIT;
     }
 
-    return BURST_CAPTURE_WAIT;
+    {
+        Mutex::Autolock l(mInputMutex);
+        mBurstActive = false;
+        mBurstBuffers.clear();
+    }
+    ALOGV("%s: Burst of %zu images took %" PRId64 " ms", __FUNCTION__,
+            mBurstStats.received, mBurstStats.elapsed / 1000000);
+
+    // manageDone moves past the last capture ID of the burst
+    mCaptureId += mBurstStats.requested - 1;
+    return DONE;
 }
 
 status_t CaptureSequencer::updateCaptureRequest(const Parameters &params,
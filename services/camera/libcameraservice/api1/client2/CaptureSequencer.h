@@ -21,6 +21,7 @@
 #include <utils/Thread.h>
 #include <utils/String16.h>
 #include <utils/Vector.h>
+#include <utils/List.h>
 #include <utils/Mutex.h>
 #include <utils/Condition.h>
 #include "camera/CameraMetadata.h"
@@ -95,6 +96,22 @@ class CaptureSequencer:
     sp<MemoryBase> mCaptureBuffer;
     Condition mNewCaptureSignal;
 
+    // While a burst is running, JPEGs queue up here instead of replacing
+    // mCaptureBuffer, and go out to the client as they arrive
+    bool mBurstActive;
+    List<sp<MemoryBase> > mBurstBuffers;
+
+    // Latest burst, for dump(). Only the sequencer thread writes it, so
+    // that thread may read it without the lock.
+    struct BurstStats {
+        size_t requested;
+        size_t received;
+        size_t peakPending;
+        nsecs_t startTime;
+        nsecs_t firstJpegLatency;
+        nsecs_t elapsed;
+    } mBurstStats;
+
     bool mShutterNotified;
 
     /**
@@ -104,6 +121,9 @@ class CaptureSequencer:
     static const int kMaxTimeoutsForPrecaptureStart = 10; // 1 sec
     static const int kMaxTimeoutsForPrecaptureEnd = 20;  // 2 sec
     static const int kMaxTimeoutsForCaptureEnd    = 100;  // 10 sec
+    // Captures submitted back-to-back for a burst, when the client asked
+    // for all of its images
+    static const size_t kBurstLength = 5;
 
     wp<Camera2Client> mClient;
     wp<ZslProcessorInterface> mZslProcessor;
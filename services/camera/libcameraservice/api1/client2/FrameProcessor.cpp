@@ -60,7 +60,7 @@ FrameProcessor::FrameProcessor(wp<CameraDeviceBase> device,
 FrameProcessor::~FrameProcessor() {
 }
 
-bool FrameProcessor::processSingleFrame(CaptureResult &frame,
+bool FrameProcessor::processSingleFrame(const sp<const CaptureResult> &result,
                                         const sp<CameraDeviceBase> &device) {
 
     sp<Camera2Client> client = mClient.promote();
@@ -68,12 +68,14 @@ bool FrameProcessor::processSingleFrame(CaptureResult &frame,
         return false;
     }
 
+    const CaptureResult &frame = *result;
+
     bool isPartialResult = false;
     if (mUsePartialResult) {
         if (client->getCameraDeviceVersion() >= CAMERA_DEVICE_API_VERSION_3_2) {
             isPartialResult = frame.mResultExtras.partialResultCount < mNumPartialResults;
         } else {
-            camera_metadata_entry_t entry;
+            camera_metadata_ro_entry_t entry;
             entry = frame.mMetadata.find(ANDROID_QUIRKS_PARTIAL_RESULT);
             if (entry.count > 0 &&
                     entry.data.u8[0] == ANDROID_QUIRKS_PARTIAL_RESULT_PARTIAL) {
@@ -90,7 +92,7 @@ bool FrameProcessor::processSingleFrame(CaptureResult &frame,
         process3aState(frame, client);
     }
 
-    return FrameProcessorBase::processSingleFrame(frame, device);
+    return FrameProcessorBase::processSingleFrame(result, device);
 }
 
 status_t FrameProcessor::processFaceDetect(const CameraMetadata &frame,
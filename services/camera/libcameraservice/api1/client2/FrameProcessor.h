@@ -51,7 +51,7 @@ class FrameProcessor : public FrameProcessorBase {
 
     void processNewFrames(const sp<Camera2Client> &client);
 
-    virtual bool processSingleFrame(CaptureResult &frame,
+    virtual bool processSingleFrame(const sp<const CaptureResult> &result,
                                     const sp<CameraDeviceBase> &device);
 
     status_t processFaceDetect(const CameraMetadata &frame,
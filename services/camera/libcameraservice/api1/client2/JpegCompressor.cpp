@@ -17,18 +17,167 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "Camera2-JpegCompressor"
 
+#include <setjmp.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cutils/atomic.h>
 #include <utils/Log.h>
 #include <ui/GraphicBufferMapper.h>
 
 #include "JpegCompressor.h"
 
+extern "C" {
+#include <jerror.h>
+}
+
 namespace android {
 namespace camera2 {
 
+/**
+ * Luma MCUs are 8x8 and there is one restart interval per MCU row. Every band
+ * but the last holds a multiple of 8 MCU rows, so the RST0..RST7 markers
+ * libjpeg writes within a band are numbered just as they would be in the
+ * whole image, and the marker between two bands is always RST7.
+ */
+static const uint32_t kMcuSize = 8;
+static const uint32_t kBandRowAlignment = kMcuSize * 8;
+// The restart interval is a 16-bit count of MCUs
+static const uint32_t kMaxRestartInterval = 65535;
+static const size_t kChunkSize = 32;
+static const size_t kMinBandCapacity = 4096;
+
+static const uint8_t kMarkerSOF0 = 0xC0;
+static const uint8_t kMarkerRST7 = 0xD7;
+static const uint8_t kMarkerSOI = 0xD8;
+static const uint8_t kMarkerEOI = 0xD9;
+static const uint8_t kMarkerSOS = 0xDA;
+
+namespace {
+
+struct JpegError : public jpeg_error_mgr {
+    jmp_buf jump;
+};
+
+void jpegErrorHandler(j_common_ptr cinfo) {
+    char errBuffer[JMSG_LENGTH_MAX];
+    cinfo->err->format_message(cinfo, errBuffer);
+    ALOGE("%s: %s", __FUNCTION__, errBuffer);
+    longjmp(static_cast<JpegError*>(cinfo->err)->jump, 1);
+}
+
+// Writes into a malloc'd buffer, doubling it whenever it fills up
+struct JpegDestination : public jpeg_destination_mgr {
+    uint8_t *data;
+    size_t capacity;
+};
+
+void jpegInitDestination(j_compress_ptr cinfo) {
+    JpegDestination *dest = static_cast<JpegDestination*>(cinfo->dest);
+    dest->next_output_byte = dest->data;
+    dest->free_in_buffer = dest->capacity;
+}
+
+boolean jpegEmptyOutputBuffer(j_compress_ptr cinfo) {
+    JpegDestination *dest = static_cast<JpegDestination*>(cinfo->dest);
+    uint8_t *data = static_cast<uint8_t*>(realloc(dest->data,
+            dest->capacity * 2));
+    if (data == NULL) {
+        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    }
+    dest->data = data;
+    dest->next_output_byte = data + dest->capacity;
+    dest->free_in_buffer = dest->capacity;
+    dest->capacity *= 2;
+    return TRUE;
+}
+
+void jpegTermDestination(j_compress_ptr /*cinfo*/) {
+}
+
+/**
+ * Find the height field of the frame header and the start of the
+ * entropy-coded data in a JPEG written by libjpeg.
+ */
+bool findScan(const uint8_t *data, size_t size,
+        size_t *sofHeightOffset, size_t *scanOffset) {
+    if (size < 4 || data[0] != 0xFF || data[1] != kMarkerSOI ||
+            data[size - 2] != 0xFF || data[size - 1] != kMarkerEOI) {
+        return false;
+    }
+
+    *sofHeightOffset = 0;
+    size_t pos = 2;
+    while (pos + 4 <= size && data[pos] == 0xFF) {
+        uint8_t marker = data[pos + 1];
+        size_t length = (data[pos + 2] << 8) | data[pos + 3];
+        if (marker == kMarkerSOF0) {
+            // Length, precision, then height
+            *sofHeightOffset = pos + 5;
+        } else if (marker == kMarkerSOS) {
+            *scanOffset = pos + 2 + length;
+            return *sofHeightOffset != 0 && *scanOffset <= size - 2;
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+struct JpegCompressor::Band {
+    Band() : src(NULL), height(0), size(0), res(OK) {
+        dest.data = NULL;
+        dest.capacity = 0;
+    }
+
+    const uint8_t *src;
+    uint32_t height;
+    // The band on its own as a complete JPEG
+    JpegDestination dest;
+    size_t size;
+    status_t res;
+};
+
+struct JpegCompressor::BandJob {
+    const CpuConsumer::LockedBuffer *src;
+    int quality;
+    bool restartMarkers;
+    const volatile int32_t *cancel;
+    Band *bands;
+    size_t bandCount;
+    volatile int32_t nextBand;
+
+    // Compress bands until none are left
+    void run() {
+        int32_t i;
+        while ((i = android_atomic_inc(&nextBand)) < (int32_t)bandCount) {
+            bands[i].res = compressBand(*src, &bands[i], quality,
+                    restartMarkers, cancel);
+        }
+    }
+};
+
+class JpegCompressor::BandThread : public Thread {
+  public:
+    BandThread(BandJob *job) : Thread(false), mJob(job) {}
+
+  private:
+    virtual bool threadLoop() {
+        mJob->run();
+        return false;
+    }
+
+    BandJob *mJob;
+};
+
 JpegCompressor::JpegCompressor():
         Thread(false),
         mIsBusy(false),
-        mCaptureTime(0) {
+        mCaptureTime(0),
+        mQuality(kDefaultQuality),
+        mJpegSize(0),
+        mCancel(0) {
 }
 
 JpegCompressor::~JpegCompressor() {
@@ -37,7 +186,7 @@ JpegCompressor::~JpegCompressor() {
 }
 
 status_t JpegCompressor::start(Vector<CpuConsumer::LockedBuffer*> buffers,
-        nsecs_t captureTime) {
+        nsecs_t captureTime, int quality) {
     ALOGV("%s", __FUNCTION__);
     Mutex::Autolock busyLock(mBusyMutex);
 
@@ -50,6 +199,9 @@ status_t JpegCompressor::start(Vector<CpuConsumer::LockedBuffer*> buffers,
 
     mBuffers = buffers;
     mCaptureTime = captureTime;
+    mQuality = quality;
+    mJpegSize = 0;
+    android_atomic_release_store(0, &mCancel);
 
     status_t res;
     res = run("JpegCompressor");
@@ -63,6 +215,7 @@ status_t JpegCompressor::start(Vector<CpuConsumer::LockedBuffer*> buffers,
 
 status_t JpegCompressor::cancel() {
     ALOGV("%s", __FUNCTION__);
+    android_atomic_release_store(1, &mCancel);
     requestExitAndWait();
     return OK;
 }
@@ -78,63 +231,203 @@ bool JpegCompressor::threadLoop() {
     mAuxBuffer = mBuffers[0];    // input
     mJpegBuffer = mBuffers[1];    // output
 
-    // Set up error management
-    mJpegErrorInfo = NULL;
-    JpegError error;
-    error.parent = this;
+    ALOGV("%s: image_width = %d, image_height = %d", __FUNCTION__,
+            mAuxBuffer->width, mAuxBuffer->height);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threadCount = cpus < 1 ? 1 :
+            ((size_t)cpus > kMaxThreads ? kMaxThreads : cpus);
 
-    mCInfo.err = jpeg_std_error(&error);
-    mCInfo.err->error_exit = jpegErrorHandler;
+    size_t jpegSize = 0;
+    status_t res = compress(*mAuxBuffer, mJpegBuffer->data, kMaxJpegSize,
+            mQuality, threadCount, &jpegSize, &mCancel);
+    if (res != OK) {
+        if (android_atomic_acquire_load(&mCancel)) {
+            ALOGV("%s: Cancel called, exiting early", __FUNCTION__);
+        } else {
+            ALOGE("%s: Unable to compress image: %s (%d)",
+                    __FUNCTION__, strerror(-res), res);
+        }
+        jpegSize = 0;
+    } else {
+        ALOGV("%s: Done writing JPEG data, %zu bytes on %zu threads",
+                __FUNCTION__, jpegSize, threadCount);
+    }
 
-    jpeg_create_compress(&mCInfo);
-    if (checkError("Error initializing compression")) return false;
+    cleanUp(jpegSize);
+    return false;
+}
 
-    // Route compressed data straight to output stream buffer
-    JpegDestination jpegDestMgr;
-    jpegDestMgr.parent = this;
-    jpegDestMgr.init_destination = jpegInitDestination;
-    jpegDestMgr.empty_output_buffer = jpegEmptyOutputBuffer;
-    jpegDestMgr.term_destination = jpegTermDestination;
+status_t JpegCompressor::compress(const CpuConsumer::LockedBuffer &src,
+        uint8_t *dst, size_t dstSize, int quality, size_t threadCount,
+        size_t *jpegSize, const volatile int32_t *cancel) {
+    if (src.data == NULL || src.width == 0 || src.height == 0 ||
+            dst == NULL || jpegSize == NULL) {
+        return BAD_VALUE;
+    }
 
-    mCInfo.dest = &jpegDestMgr;
+    // Cut the image into at most threadCount bands of whole alignment units
+    size_t units = (src.height + kBandRowAlignment - 1) / kBandRowAlignment;
+    size_t bandCount = threadCount < units ? threadCount : units;
+    uint32_t mcusPerRow = (src.width + kMcuSize - 1) / kMcuSize;
+    if (bandCount == 0 || mcusPerRow > kMaxRestartInterval) {
+        bandCount = 1;
+    }
+    size_t rowsPerBand =
+            (units + bandCount - 1) / bandCount * kBandRowAlignment;
+    bandCount = (src.height + rowsPerBand - 1) / rowsPerBand;
+
+    Vector<Band> bands;
+    bands.insertAt(Band(), 0, bandCount);
+    for (size_t i = 0; i < bandCount; i++) {
+        Band &band = bands.editItemAt(i);
+        size_t firstRow = i * rowsPerBand;
+        band.src = src.data + firstRow * src.stride;
+        band.height = (src.height - firstRow < rowsPerBand) ?
+                src.height - firstRow : rowsPerBand;
+    }
 
-    // Set up compression parameters
-    mCInfo.image_width = mAuxBuffer->width;
-    mCInfo.image_height = mAuxBuffer->height;
-    mCInfo.input_components = 1; // 3;
-    mCInfo.in_color_space = JCS_GRAYSCALE; // JCS_RGB
+    BandJob job;
+    job.src = &src;
+    job.quality = quality;
+    job.restartMarkers = bandCount > 1;
+    job.cancel = cancel;
+    job.bands = bands.editArray();
+    job.bandCount = bandCount;
+    job.nextBand = 0;
+
+    // This thread compresses bands too; if a helper fails to start, the
+    // others pick up its share.
+    Vector<sp<BandThread> > threads;
+    for (size_t i = 1; i < bandCount; i++) {
+        sp<BandThread> thread = new BandThread(&job);
+        if (thread->run("JpegCompressorBand") == OK) {
+            threads.push(thread);
+        }
+    }
+    job.run();
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i]->join();
+    }
+
+    status_t res = OK;
+    for (size_t i = 0; i < bandCount && res == OK; i++) {
+        res = bands[i].res;
+    }
+    if (res == OK) {
+        res = joinBands(bands.array(), bandCount, src.height, dst, dstSize,
+                jpegSize);
+    }
+
+    for (size_t i = 0; i < bandCount; i++) {
+        free(bands[i].dest.data);
+    }
+    return res;
+}
+
+status_t JpegCompressor::compressBand(const CpuConsumer::LockedBuffer &src,
+        Band *band, int quality, bool restartMarkers,
+        const volatile int32_t *cancel) {
+    size_t capacity = src.width * band->height / 4;
+    band->dest.capacity = capacity > kMinBandCapacity ?
+            capacity : kMinBandCapacity;
+    band->dest.data = static_cast<uint8_t*>(malloc(band->dest.capacity));
+    if (band->dest.data == NULL) {
+        return NO_MEMORY;
+    }
+    band->dest.init_destination = jpegInitDestination;
+    band->dest.empty_output_buffer = jpegEmptyOutputBuffer;
+    band->dest.term_destination = jpegTermDestination;
+
+    // Set up error management
+    jpeg_compress_struct cinfo;
+    JpegError error;
+    cinfo.err = jpeg_std_error(&error);
+    error.error_exit = jpegErrorHandler;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        return UNKNOWN_ERROR;
+    }
 
-    ALOGV("%s: image_width = %d, image_height = %d", __FUNCTION__, mCInfo.image_width, mCInfo.image_height);
+    jpeg_create_compress(&cinfo);
 
-    jpeg_set_defaults(&mCInfo);
-    if (checkError("Error configuring defaults")) return false;
+    // Route compressed data to the band's own buffer
+    cinfo.dest = &band->dest;
+
+    // Set up compression parameters
+    cinfo.image_width = src.width;
+    cinfo.image_height = band->height;
+    cinfo.input_components = 1; // 3;
+    cinfo.in_color_space = JCS_GRAYSCALE; // JCS_RGB
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    // Bands are joined without rewriting their Huffman-coded data, so they
+    // all need the default tables
+    cinfo.optimize_coding = FALSE;
+    if (restartMarkers) {
+        cinfo.restart_in_rows = 1;
+    }
 
     // Do compression
-    jpeg_start_compress(&mCInfo, TRUE);
-    if (checkError("Error starting compression")) return false;
+    jpeg_start_compress(&cinfo, TRUE);
 
-    size_t rowStride = mAuxBuffer->stride;// * 3;
-    const size_t kChunkSize = 32;
-    while (mCInfo.next_scanline < mCInfo.image_height) {
+    size_t rowStride = src.stride;// * 3;
+    while (cinfo.next_scanline < cinfo.image_height) {
         JSAMPROW chunk[kChunkSize];
-        for (size_t i = 0 ; i < kChunkSize; i++) {
+        size_t rows = cinfo.image_height - cinfo.next_scanline;
+        if (rows > kChunkSize) rows = kChunkSize;
+        for (size_t i = 0 ; i < rows; i++) {
             chunk[i] = (JSAMPROW)
-                    (mAuxBuffer->data + (i + mCInfo.next_scanline) * rowStride);
+                    (band->src + (i + cinfo.next_scanline) * rowStride);
         }
-        jpeg_write_scanlines(&mCInfo, chunk, kChunkSize);
-        if (checkError("Error while compressing")) return false;
-        if (exitPending()) {
-            ALOGV("%s: Cancel called, exiting early", __FUNCTION__);
-            cleanUp();
-            return false;
+        jpeg_write_scanlines(&cinfo, chunk, rows);
+        if (cancel != NULL && android_atomic_acquire_load(cancel)) {
+            jpeg_destroy_compress(&cinfo);
+            return INVALID_OPERATION;
         }
     }
 
-    jpeg_finish_compress(&mCInfo);
-    if (checkError("Error while finishing compression")) return false;
+    jpeg_finish_compress(&cinfo);
+    band->size = band->dest.capacity - band->dest.free_in_buffer;
+    jpeg_destroy_compress(&cinfo);
 
-    cleanUp();
-    return false;
+    return OK;
+}
+
+status_t JpegCompressor::joinBands(const Band *bands, size_t bandCount,
+        uint32_t height, uint8_t *dst, size_t dstSize, size_t *jpegSize) {
+    size_t size = 0;
+    for (size_t i = 0; i < bandCount; i++) {
+        const uint8_t *data = bands[i].dest.data;
+        size_t sofHeightOffset, scanOffset;
+        if (!findScan(data, bands[i].size, &sofHeightOffset, &scanOffset)) {
+            ALOGE("%s: Band %zu is not a well-formed JPEG", __FUNCTION__, i);
+            return UNKNOWN_ERROR;
+        }
+
+        // Headers come from the first band only. Each band's data is
+        // followed by a restart marker, or the EOI after the last band.
+        size_t start = (i == 0) ? 0 : scanOffset;
+        size_t length = bands[i].size - 2 - start;
+        if (size + length + 2 > dstSize) {
+            ALOGE("%s: JPEG destination buffer overflow!", __FUNCTION__);
+            return NO_MEMORY;
+        }
+
+        memcpy(dst + size, data + start, length);
+        if (i == 0) {
+            dst[sofHeightOffset] = height >> 8;
+            dst[sofHeightOffset + 1] = height & 0xFF;
+        }
+        size += length;
+
+        dst[size++] = 0xFF;
+        dst[size++] = (i + 1 < bandCount) ? kMarkerRST7 : kMarkerEOI;
+    }
+
+    *jpegSize = size;
+    return OK;
 }
 
 bool JpegCompressor::isBusy() {
@@ -166,56 +459,18 @@ bool JpegCompressor::waitForDone(nsecs_t timeout) {
     return (res == OK);
 }
 
-bool JpegCompressor::checkError(const char *msg) {
-    ALOGV("%s", __FUNCTION__);
-    if (mJpegErrorInfo) {
-        char errBuffer[JMSG_LENGTH_MAX];
-        mJpegErrorInfo->err->format_message(mJpegErrorInfo, errBuffer);
-        ALOGE("%s: %s: %s",
-                __FUNCTION__, msg, errBuffer);
-        cleanUp();
-        mJpegErrorInfo = NULL;
-        return true;
-    }
-    return false;
+size_t JpegCompressor::getJpegSize() {
+    Mutex::Autolock lock(mBusyMutex);
+    return mJpegSize;
 }
 
-void JpegCompressor::cleanUp() {
+void JpegCompressor::cleanUp(size_t jpegSize) {
     ALOGV("%s", __FUNCTION__);
-    jpeg_destroy_compress(&mCInfo);
     Mutex::Autolock lock(mBusyMutex);
+    mJpegSize = jpegSize;
     mIsBusy = false;
     mDone.signal();
 }
 
-void JpegCompressor::jpegErrorHandler(j_common_ptr cinfo) {
-    ALOGV("%s", __FUNCTION__);
-    JpegError *error = static_cast<JpegError*>(cinfo->err);
-    error->parent->mJpegErrorInfo = cinfo;
-}
-
-void JpegCompressor::jpegInitDestination(j_compress_ptr cinfo) {
-    ALOGV("%s", __FUNCTION__);
-    JpegDestination *dest= static_cast<JpegDestination*>(cinfo->dest);
-    ALOGV("%s: Setting destination to %p, size %zu",
-            __FUNCTION__, dest->parent->mJpegBuffer->data, kMaxJpegSize);
-    dest->next_output_byte = (JOCTET*)(dest->parent->mJpegBuffer->data);
-    dest->free_in_buffer = kMaxJpegSize;
-}
-
-boolean JpegCompressor::jpegEmptyOutputBuffer(j_compress_ptr /*cinfo*/) {
-    ALOGV("%s", __FUNCTION__);
-    ALOGE("%s: JPEG destination buffer overflow!",
-            __FUNCTION__);
-    return true;
-}
-
-void JpegCompressor::jpegTermDestination(j_compress_ptr cinfo) {
-    (void) cinfo; // TODO: clean up
-    ALOGV("%s", __FUNCTION__);
-    ALOGV("%s: Done writing JPEG data. %zu bytes left in buffer",
-            __FUNCTION__, cinfo->dest->free_in_buffer);
-}
-
 }; // namespace camera2
 }; // namespace android
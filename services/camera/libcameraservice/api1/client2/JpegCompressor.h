@@ -19,6 +19,10 @@
  * This class simulates a hardware JPEG compressor.  It receives image buffers
  * in RGBA_8888 format, processes them in a worker thread, and then pushes them
  * out to their destination stream.
+ *
+ * Large images are cut into horizontal bands that are compressed on several
+ * threads, and the bands are joined into one baseline JPEG using restart
+ * markers.
  */
 
 #ifndef ANDROID_SERVERS_CAMERA_JPEGCOMPRESSOR_H
@@ -49,7 +53,7 @@ class JpegCompressor: private Thread, public virtual RefBase {
     // Start compressing COMPRESSED format buffers; JpegCompressor takes
     // ownership of the Buffers vector.
     status_t start(Vector<CpuConsumer::LockedBuffer*> buffers,
-            nsecs_t captureTime);
+            nsecs_t captureTime, int quality = kDefaultQuality);
 
     status_t cancel();
 
@@ -58,8 +62,25 @@ class JpegCompressor: private Thread, public virtual RefBase {
 
     bool waitForDone(nsecs_t timeout);
 
+    // Size of the JPEG written by the last compression, 0 if it failed
+    size_t getJpegSize();
+
+    /**
+     * Compress the 8-bit grayscale image in src into a baseline JPEG in dst,
+     * on up to threadCount threads. Each thread compresses a band of whole
+     * restart intervals, and the bands are joined into a single scan.
+     * Compression stops early with INVALID_OPERATION if cancel is set and
+     * becomes nonzero.
+     */
+    static status_t compress(const CpuConsumer::LockedBuffer &src,
+            uint8_t *dst, size_t dstSize, int quality, size_t threadCount,
+            size_t *jpegSize, const volatile int32_t *cancel = NULL);
+
     // TODO: Measure this
     static const size_t kMaxJpegSize = 300000;
+    static const int kDefaultQuality = 75;
+    // Most threads start() compresses a buffer on
+    static const size_t kMaxThreads = 4;
 
   private:
     Mutex mBusyMutex;
@@ -67,31 +88,26 @@ class JpegCompressor: private Thread, public virtual RefBase {
     bool mIsBusy;
     Condition mDone;
     nsecs_t mCaptureTime;
+    int mQuality;
+    size_t mJpegSize;
+    volatile int32_t mCancel;
 
     Vector<CpuConsumer::LockedBuffer*> mBuffers;
     CpuConsumer::LockedBuffer *mJpegBuffer;
     CpuConsumer::LockedBuffer *mAuxBuffer;
     bool mFoundJpeg, mFoundAux;
 
-    jpeg_compress_struct mCInfo;
-
-    struct JpegError : public jpeg_error_mgr {
-        JpegCompressor *parent;
-    };
-    j_common_ptr mJpegErrorInfo;
-
-    struct JpegDestination : public jpeg_destination_mgr {
-        JpegCompressor *parent;
-    };
-
-    static void jpegErrorHandler(j_common_ptr cinfo);
+    struct Band;
+    struct BandJob;
+    class BandThread;
 
-    static void jpegInitDestination(j_compress_ptr cinfo);
-    static boolean jpegEmptyOutputBuffer(j_compress_ptr cinfo);
-    static void jpegTermDestination(j_compress_ptr cinfo);
+    static status_t compressBand(const CpuConsumer::LockedBuffer &src,
+            Band *band, int quality, bool restartMarkers,
+            const volatile int32_t *cancel);
+    static status_t joinBands(const Band *bands, size_t bandCount,
+            uint32_t height, uint8_t *dst, size_t dstSize, size_t *jpegSize);
 
-    bool checkError(const char *msg);
-    void cleanUp();
+    void cleanUp(size_t jpegSize);
 
     /**
      * Inherited Thread virtual overrides
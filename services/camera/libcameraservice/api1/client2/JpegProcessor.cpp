@@ -39,6 +39,29 @@
 namespace android {
 namespace camera2 {
 
+/**
+ * A JPEG in one of the capture heaps. The heap takes another capture only once
+ * this is gone, which includes the client letting go of it.
+ */
+class JpegProcessor::CaptureBuffer : public MemoryBase {
+  public:
+    CaptureBuffer(const wp<JpegProcessor> &processor,
+            const sp<MemoryHeapBase> &heap, size_t size) :
+            MemoryBase(heap, 0, size),
+            mProcessor(processor) {
+    }
+
+    virtual ~CaptureBuffer() {
+        sp<JpegProcessor> processor = mProcessor.promote();
+        if (processor != 0) {
+            processor->onCaptureBufferFreed(getHeap());
+        }
+    }
+
+  private:
+    wp<JpegProcessor> mProcessor;
+};
+
 JpegProcessor::JpegProcessor(
     sp<Camera2Client> client,
     wp<CaptureSequencer> sequencer):
@@ -47,7 +70,11 @@ JpegProcessor::JpegProcessor(
         mSequencer(sequencer),
         mId(client->getCameraId()),
         mCaptureAvailable(false),
-        mCaptureStreamId(NO_STREAM) {
+        mCaptureStreamId(NO_STREAM),
+        mCaptureHeapSize(0),
+        mCaptureHeapsInUse(0),
+        mPeakCaptureHeapsInUse(0),
+        mCaptureHeapsFull(false) {
 }
 
 JpegProcessor::~JpegProcessor() {
@@ -98,22 +125,34 @@ status_t JpegProcessor::updateStream(const Parameters &params) {
     // Since ashmem heaps are rounded up to page size, don't reallocate if
     // the capture heap isn't exactly the same size as the required JPEG buffer
     const size_t HEAP_SLACK_FACTOR = 2;
-    if (mCaptureHeap == 0 ||
-            (mCaptureHeap->getSize() < static_cast<size_t>(maxJpegSize)) ||
-            (mCaptureHeap->getSize() >
+    if (mCaptureHeaps.isEmpty() ||
+            (mCaptureHeapSize < static_cast<size_t>(maxJpegSize)) ||
+            (mCaptureHeapSize >
                     static_cast<size_t>(maxJpegSize) * HEAP_SLACK_FACTOR) ) {
-        // Create memory for API consumption
-        mCaptureHeap.clear();
-        mCaptureHeap =
+        // Create memory for API consumption. JPEGs that are still out keep
+        // their old heaps until they are done with.
+        mCaptureHeaps.clear();
+        mCaptureHeapsInUse = 0;
+        CaptureHeap captureHeap;
+        captureHeap.heap =
                 new MemoryHeapBase(maxJpegSize, 0, "Camera2Client::CaptureHeap");
-        if (mCaptureHeap->getSize() == 0) {
+        captureHeap.inUse = false;
+        if (captureHeap.heap->getSize() == 0) {
             ALOGE("%s: Camera %d: Unable to allocate memory for capture",
                     __FUNCTION__, mId);
             return NO_MEMORY;
         }
+        mCaptureHeapSize = captureHeap.heap->getSize();
+        mCaptureHeaps.push(captureHeap);
+
+        if (mCaptureHeapsFull) {
+            mCaptureHeapsFull = false;
+            mCaptureAvailable = true;
+            mCaptureAvailableSignal.signal();
+        }
     }
-    ALOGV("%s: Camera %d: JPEG capture heap now %d bytes; requested %d bytes",
-            __FUNCTION__, mId, mCaptureHeap->getSize(), maxJpegSize);
+    ALOGV("%s: Camera %d: JPEG capture heap now %zu bytes; requested %zd bytes",
+            __FUNCTION__, mId, mCaptureHeapSize, maxJpegSize);
 
     if (mCaptureStreamId != NO_STREAM) {
         // Check if stream parameters have to change
@@ -175,7 +214,8 @@ status_t JpegProcessor::deleteStream() {
 
         device->deleteStream(mCaptureStreamId);
 
-        mCaptureHeap.clear();
+        mCaptureHeaps.clear();
+        mCaptureHeapsInUse = 0;
         mCaptureWindow.clear();
         mCaptureConsumer.clear();
 
@@ -189,7 +229,16 @@ int JpegProcessor::getStreamId() const {
     return mCaptureStreamId;
 }
 
-void JpegProcessor::dump(int /*fd*/, const Vector<String16>& /*args*/) const {
+void JpegProcessor::dump(int fd, const Vector<String16>& /*args*/) const {
+    Mutex::Autolock l(mInputMutex);
+    String8 result = String8::format("    JPEG heaps: %zu of %zu allocated, "
+            "%zu bytes each\n", mCaptureHeaps.size(), kMaxCaptureHeaps,
+            mCaptureHeapSize);
+    result.appendFormat("      In use: %zu, peak %zu (%zu bytes)%s\n",
+            mCaptureHeapsInUse, mPeakCaptureHeapsInUse,
+            mPeakCaptureHeapsInUse * mCaptureHeapSize,
+            mCaptureHeapsFull ? ", capture waiting for a heap" : "");
+    write(fd, result.string(), result.size());
 }
 
 bool JpegProcessor::threadLoop() {
@@ -215,7 +264,6 @@ bool JpegProcessor::threadLoop() {
 status_t JpegProcessor::processNewCapture() {
     ATRACE_CALL();
     status_t res;
-    sp<Camera2Heap> captureHeap;
     sp<MemoryBase> captureBuffer;
 
     CpuConsumer::LockedBuffer imgBuffer;
@@ -227,6 +275,15 @@ status_t JpegProcessor::processNewCapture() {
             return INVALID_OPERATION;
         }
 
+        ssize_t heapIdx = findFreeCaptureHeapLocked();
+        if (heapIdx < 0) {
+            // Leave the capture in the stream until a JPEG is done with
+            ALOGV("%s: Camera %d: All %zu JPEG heaps in use", __FUNCTION__,
+                    mId, mCaptureHeaps.size());
+            mCaptureHeapsFull = true;
+            return heapIdx;
+        }
+
         res = mCaptureConsumer->lockNextBuffer(&imgBuffer);
         if (res != OK) {
             if (res != BAD_VALUE) {
@@ -266,7 +323,7 @@ status_t JpegProcessor::processNewCapture() {
         if (jpegSize == 0) { // failed to find size, default to whole buffer
         jpegSize = size;//imgBuffer.width;
         }
-        size_t heapSize = mCaptureHeap->getSize();
+        size_t heapSize = mCaptureHeapSize;
         if (jpegSize > heapSize) {
             ALOGW("%s: JPEG image is larger than expected, truncating "
                     "(got %zu, expected at most %zu bytes)",
@@ -274,9 +331,16 @@ status_t JpegProcessor::processNewCapture() {
             jpegSize = heapSize;
         }
 
+        CaptureHeap &captureHeap = mCaptureHeaps.editItemAt(heapIdx);
+        captureHeap.inUse = true;
+        mCaptureHeapsInUse++;
+        if (mCaptureHeapsInUse > mPeakCaptureHeapsInUse) {
+            mPeakCaptureHeapsInUse = mCaptureHeapsInUse;
+        }
+
         // TODO: Optimize this to avoid memcopy
-        captureBuffer = new MemoryBase(mCaptureHeap, 0, jpegSize);
-        void* captureMemory = mCaptureHeap->getBase();
+        captureBuffer = new CaptureBuffer(this, captureHeap.heap, jpegSize);
+        void* captureMemory = captureHeap.heap->getBase();
         memcpy(captureMemory, imgBuffer.data, jpegSize);
 
         mCaptureConsumer->unlockBuffer(imgBuffer);
@@ -290,6 +354,46 @@ status_t JpegProcessor::processNewCapture() {
     return OK;
 }
 
+ssize_t JpegProcessor::findFreeCaptureHeapLocked() {
+    for (size_t i = 0; i < mCaptureHeaps.size(); i++) {
+        if (!mCaptureHeaps[i].inUse) {
+            return i;
+        }
+    }
+    if (mCaptureHeaps.size() >= kMaxCaptureHeaps) {
+        return NOT_ENOUGH_DATA;
+    }
+
+    CaptureHeap captureHeap;
+    captureHeap.heap =
+            new MemoryHeapBase(mCaptureHeapSize, 0, "Camera2Client::CaptureHeap");
+    captureHeap.inUse = false;
+    if (captureHeap.heap->getSize() == 0) {
+        ALOGE("%s: Camera %d: Unable to allocate memory for capture",
+                __FUNCTION__, mId);
+        return NO_MEMORY;
+    }
+    return mCaptureHeaps.add(captureHeap);
+}
+
+void JpegProcessor::onCaptureBufferFreed(const sp<IMemoryHeap> &heap) {
+    Mutex::Autolock l(mInputMutex);
+    for (size_t i = 0; i < mCaptureHeaps.size(); i++) {
+        CaptureHeap &captureHeap = mCaptureHeaps.editItemAt(i);
+        if (captureHeap.inUse && captureHeap.heap.get() == heap.get()) {
+            captureHeap.inUse = false;
+            mCaptureHeapsInUse--;
+            if (mCaptureHeapsFull) {
+                mCaptureHeapsFull = false;
+                mCaptureAvailable = true;
+                mCaptureAvailableSignal.signal();
+            }
+            return;
+        }
+    }
+    // The heap was dropped by updateStream or deleteStream meanwhile
+}
+
 /*
  * JPEG FILE FORMAT OVERVIEW.
  * http://www.jpeg.org/public/jfif.pdf
@@ -31,6 +31,7 @@ namespace android {
 class Camera2Client;
 class CameraDeviceBase;
 class MemoryHeapBase;
+class IMemoryHeap;
 
 namespace camera2 {
 
@@ -54,6 +55,12 @@ class JpegProcessor:
     int getStreamId() const;
 
     void dump(int fd, const Vector<String16>& args) const;
+
+    // Most JPEGs that can be out with the capture sequencer or the client at
+    // once. Once they all are, new captures wait in the stream, which holds
+    // back the HAL.
+    static const size_t kMaxCaptureHeaps = 3;
+
   private:
     static const nsecs_t kWaitDuration = 10000000; // 10 ms
     wp<CameraDeviceBase> mDevice;
@@ -71,11 +78,27 @@ class JpegProcessor:
     int mCaptureStreamId;
     sp<CpuConsumer>    mCaptureConsumer;
     sp<ANativeWindow>  mCaptureWindow;
-    sp<MemoryHeapBase>    mCaptureHeap;
+
+    // JPEG memory for API consumption, one heap per JPEG. Heaps are
+    // allocated as captures need them, up to kMaxCaptureHeaps, and each is in
+    // use until the last reference to the JPEG in it goes away.
+    class CaptureBuffer;
+    struct CaptureHeap {
+        sp<MemoryHeapBase> heap;
+        bool inUse;
+    };
+    Vector<CaptureHeap> mCaptureHeaps;
+    size_t mCaptureHeapSize;
+    size_t mCaptureHeapsInUse;
+    size_t mPeakCaptureHeapsInUse;
+    // A capture is waiting in the stream for a heap to be freed
+    bool mCaptureHeapsFull;
 
     virtual bool threadLoop();
 
     status_t processNewCapture();
+    ssize_t findFreeCaptureHeapLocked();
+    void onCaptureBufferFreed(const sp<IMemoryHeap> &heap);
     size_t findJpegSize(uint8_t* jpegBuffer, size_t maxSize);
     int mMaxJpegSize;
 };
@@ -897,6 +897,7 @@ status_t Parameters::initialize(const CameraMetadata *info, int deviceVersion) {
     }
 
     lightFx = LIGHTFX_NONE;
+    lightFxAllImages = false;
 
     state = STOPPED;
 
@@ -1853,6 +1854,8 @@ status_t Parameters::set(const String8& paramString) {
     // LIGHTFX
     validatedParams.lightFx = lightFxStringToEnum(
         newParams.get(CameraParameters::KEY_LIGHTFX));
+    validatedParams.lightFxAllImages = boolFromString(
+        newParams.get(CameraParameters::KEY_LIGHTFX_ALL_IMAGES));
 
     /** Update internal parameters */
 
@@ -139,6 +139,7 @@ struct Parameters {
         LIGHTFX_LOWLIGHT,
         LIGHTFX_HDR
     } lightFx;
+    bool lightFxAllImages;
 
     CameraParameters2 params;
     String8 paramsFlattened;
@@ -50,7 +50,6 @@ ZslProcessor3::ZslProcessor3(
         mSequencer(sequencer),
         mId(client->getCameraId()),
         mZslStreamId(NO_STREAM),
-        mFrameListHead(0),
         mZslQueueHead(0),
         mZslQueueTail(0),
         mHasFocuser(false) {
@@ -87,7 +86,6 @@ ZslProcessor3::ZslProcessor3(
 
 
     mZslQueue.insertAt(0, mBufferQueueDepth);
-    mFrameList.insertAt(0, mFrameListDepth);
     sp<CaptureSequencer> captureSequencer = mSequencer.promote();
     if (captureSequencer != 0) captureSequencer->setZslProcessor(this);
 }
@@ -98,16 +96,22 @@ ZslProcessor3::~ZslProcessor3() {
 }
 
 void ZslProcessor3::onResultAvailable(const CaptureResult &result) {
+    onSharedResultAvailable(new CaptureResult(result));
+}
+
+void ZslProcessor3::onSharedResultAvailable(
+        const sp<const CaptureResult> &resultHandle) {
     ATRACE_CALL();
     ALOGV("%s:", __FUNCTION__);
     Mutex::Autolock l(mInputMutex);
+    const CaptureResult &result = *resultHandle;
     camera_metadata_ro_entry_t entry;
     entry = result.mMetadata.find(ANDROID_SENSOR_TIMESTAMP);
-    nsecs_t timestamp = entry.data.i64[0];
     if (entry.count == 0) {
         ALOGE("%s: metadata doesn't have timestamp, skip this result", __FUNCTION__);
         return;
     }
+    nsecs_t timestamp = entry.data.i64[0];
 
     entry = result.mMetadata.find(ANDROID_REQUEST_FRAME_COUNT);
     if (entry.count == 0) {
@@ -123,8 +127,18 @@ void ZslProcessor3::onResultAvailable(const CaptureResult &result) {
     // Corresponding buffer has been cleared. No need to push into mFrameList
     if (timestamp <= mLatestClearedBufferTimestamp) return;
 
-    mFrameList.editItemAt(mFrameListHead) = result.mMetadata;
-    mFrameListHead = (mFrameListHead + 1) % mFrameListDepth;
+    // A later result for the same frame replaces the earlier one
+    mFrameList.add(timestamp, resultHandle);
+    if (isGoodCandidate(result.mMetadata)) {
+        mGoodFrames.add(timestamp);
+    } else {
+        mGoodFrames.remove(timestamp);
+    }
+
+    while (mFrameList.size() > mFrameListDepth) {
+        mGoodFrames.remove(mFrameList.keyAt(0));
+        mFrameList.removeItemsAt(0);
+    }
 }
 
 status_t ZslProcessor3::updateStream(const Parameters &params) {
@@ -300,8 +314,8 @@ status_t ZslProcessor3::pushToReprocess(int32_t requestId) {
         dumpZslQueue(-1);
     }
 
-    size_t metadataIdx;
-    nsecs_t candidateTimestamp = getCandidateTimestampLocked(&metadataIdx);
+    sp<const CaptureResult> candidate;
+    nsecs_t candidateTimestamp = getCandidateTimestampLocked(&candidate);
 
     if (candidateTimestamp == -1) {
         ALOGE("%s: Could not find good candidate for ZSL reprocessing",
@@ -322,7 +336,7 @@ status_t ZslProcessor3::pushToReprocess(int32_t requestId) {
     }
 
     {
-        CameraMetadata request = mFrameList[metadataIdx];
+        CameraMetadata request = candidate->mMetadata;
 
         // Verify that the frame is reasonable for reprocessing
 
@@ -449,8 +463,7 @@ status_t ZslProcessor3::clearZslQueueLocked() {
 
 void ZslProcessor3::clearZslResultQueueLocked() {
     mFrameList.clear();
-    mFrameListHead = 0;
-    mFrameList.insertAt(0, mFrameListDepth);
+    mGoodFrames.clear();
 }
 
 void ZslProcessor3::dump(int fd, const Vector<String16>& /*args*/) const {
@@ -521,92 +534,14 @@ bool ZslProcessor3::isFixedFocusMode(uint8_t afMode) const {
     }
 }
 
-nsecs_t ZslProcessor3::getCandidateTimestampLocked(size_t* metadataIdx) const {
+nsecs_t ZslProcessor3::getCandidateTimestampLocked(
+        sp<const CaptureResult>* candidate) const {
     /**
-     * Find the smallest timestamp we know about so far
-     * - ensure that aeState is either converged or locked
+     * Find the smallest timestamp we know about so far among the frames
+     * whose 3A state was good when they arrived (see isGoodCandidate)
      */
 
-    size_t idx = 0;
-    nsecs_t minTimestamp = -1;
-
-    size_t emptyCount = mFrameList.size();
-
-    for (size_t j = 0; j < mFrameList.size(); j++) {
-        const CameraMetadata &frame = mFrameList[j];
-        if (!frame.isEmpty()) {
-
-            emptyCount--;
-
-            camera_metadata_ro_entry_t entry;
-            entry = frame.find(ANDROID_SENSOR_TIMESTAMP);
-            if (entry.count == 0) {
-                ALOGE("%s: Can't find timestamp in frame!",
-                        __FUNCTION__);
-                continue;
-            }
-            nsecs_t frameTimestamp = entry.data.i64[0];
-            if (minTimestamp > frameTimestamp || minTimestamp == -1) {
-
-                entry = frame.find(ANDROID_CONTROL_AE_STATE);
-
-                if (entry.count == 0) {
-                    /**
-                     * This is most likely a HAL bug. The aeState field is
-                     * mandatory, so it should always be in a metadata packet.
-                     */
-                    ALOGW("%s: ZSL queue frame has no AE state field!",
-                            __FUNCTION__);
-                    continue;
-                }
-                if (entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_CONVERGED &&
-                        entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_LOCKED) {
-                    ALOGVV("%s: ZSL queue frame AE state is %d, need "
-                           "full capture",  __FUNCTION__, entry.data.u8[0]);
-                    continue;
-                }
-
-                entry = frame.find(ANDROID_CONTROL_AF_MODE);
-                if (entry.count == 0) {
-                    ALOGW("%s: ZSL queue frame has no AF mode field!",
-                            __FUNCTION__);
-                    continue;
-                }
-                uint8_t afMode = entry.data.u8[0];
-                if (afMode == ANDROID_CONTROL_AF_MODE_OFF) {
-                    // Skip all the ZSL buffer for manual AF mode, as we don't really
-                    // know the af state.
-                    continue;
-                }
-
-                // Check AF state if device has focuser and focus mode isn't fixed
-                if (mHasFocuser && !isFixedFocusMode(afMode)) {
-                    // Make sure the candidate frame has good focus.
-                    entry = frame.find(ANDROID_CONTROL_AF_STATE);
-                    if (entry.count == 0) {
-                        ALOGW("%s: ZSL queue frame has no AF state field!",
-                                __FUNCTION__);
-                        continue;
-                    }
-                    uint8_t afState = entry.data.u8[0];
-                    if (afState != ANDROID_CONTROL_AF_STATE_PASSIVE_FOCUSED &&
-                            afState != ANDROID_CONTROL_AF_STATE_FOCUSED_LOCKED &&
-                            afState != ANDROID_CONTROL_AF_STATE_NOT_FOCUSED_LOCKED) {
-                        ALOGW("%s: ZSL queue frame AF state is %d is not good for capture, skip it",
-                                __FUNCTION__, afState);
-                        continue;
-                    }
-                }
-
-                minTimestamp = frameTimestamp;
-                idx = j;
-            }
-
-            ALOGVV("%s: Saw timestamp %" PRId64, __FUNCTION__, frameTimestamp);
-        }
-    }
-
-    if (emptyCount == mFrameList.size()) {
+    if (mFrameList.isEmpty()) {
         /**
          * This could be mildly bad and means our ZSL was triggered before
          * there were any frames yet received by the camera framework.
@@ -622,16 +557,76 @@ nsecs_t ZslProcessor3::getCandidateTimestampLocked(size_t* metadataIdx) const {
         ALOGW("%s: ZSL queue has no metadata frames", __FUNCTION__);
     }
 
-    ALOGV("%s: Candidate timestamp %" PRId64 " (idx %zu), empty frames: %zu",
-          __FUNCTION__, minTimestamp, idx, emptyCount);
-
-    if (metadataIdx) {
-        *metadataIdx = idx;
+    nsecs_t minTimestamp = -1;
+    if (!mGoodFrames.isEmpty()) {
+        minTimestamp = mGoodFrames[0];
+        if (candidate) {
+            *candidate = mFrameList.valueFor(minTimestamp);
+        }
     }
 
+    ALOGV("%s: Candidate timestamp %" PRId64 ", frames: %zu, good frames: %zu",
+          __FUNCTION__, minTimestamp, mFrameList.size(), mGoodFrames.size());
+
     return minTimestamp;
 }
 
+bool ZslProcessor3::isGoodCandidate(const CameraMetadata& frame) const {
+    camera_metadata_ro_entry_t entry;
+    entry = frame.find(ANDROID_CONTROL_AE_STATE);
+
+    if (entry.count == 0) {
+        /**
+         * This is most likely a HAL bug. The aeState field is
+         * mandatory, so it should always be in a metadata packet.
+         * This runs for every frame, so don't warn about it.
+         */
+        ALOGV("%s: ZSL queue frame has no AE state field!",
+                __FUNCTION__);
+        return false;
+    }
+    if (entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_CONVERGED &&
+            entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_LOCKED) {
+        ALOGVV("%s: ZSL queue frame AE state is %d, need "
+               "full capture",  __FUNCTION__, entry.data.u8[0]);
+        return false;
+    }
+
+    entry = frame.find(ANDROID_CONTROL_AF_MODE);
+    if (entry.count == 0) {
+        ALOGV("%s: ZSL queue frame has no AF mode field!",
+                __FUNCTION__);
+        return false;
+    }
+    uint8_t afMode = entry.data.u8[0];
+    if (afMode == ANDROID_CONTROL_AF_MODE_OFF) {
+        // Skip all the ZSL buffer for manual AF mode, as we don't really
+        // know the af state.
+        return false;
+    }
+
+    // Check AF state if device has focuser and focus mode isn't fixed
+    if (mHasFocuser && !isFixedFocusMode(afMode)) {
+        // Make sure the candidate frame has good focus.
+        entry = frame.find(ANDROID_CONTROL_AF_STATE);
+        if (entry.count == 0) {
+            ALOGV("%s: ZSL queue frame has no AF state field!",
+                    __FUNCTION__);
+            return false;
+        }
+        uint8_t afState = entry.data.u8[0];
+        if (afState != ANDROID_CONTROL_AF_STATE_PASSIVE_FOCUSED &&
+                afState != ANDROID_CONTROL_AF_STATE_FOCUSED_LOCKED &&
+                afState != ANDROID_CONTROL_AF_STATE_NOT_FOCUSED_LOCKED) {
+            ALOGVV("%s: ZSL queue frame AF state is %d is not good for capture, skip it",
+                    __FUNCTION__, afState);
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void ZslProcessor3::onBufferAcquired(const BufferInfo& /*bufferInfo*/) {
     // Intentionally left empty
     // Although theoretically we could use this to get better dump info
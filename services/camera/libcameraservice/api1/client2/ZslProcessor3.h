@@ -20,6 +20,8 @@
 #include <utils/Thread.h>
 #include <utils/String16.h>
 #include <utils/Vector.h>
+#include <utils/KeyedVector.h>
+#include <utils/SortedVector.h>
 #include <utils/Mutex.h>
 #include <utils/Condition.h>
 #include <gui/BufferItemConsumer.h>
@@ -52,6 +54,7 @@ class ZslProcessor3 :
 
     // From FrameProcessor::FilteredListener
     virtual void onResultAvailable(const CaptureResult &result);
+    virtual void onSharedResultAvailable(const sp<const CaptureResult> &result);
 
     /**
      ****************************************
@@ -111,8 +114,13 @@ class ZslProcessor3 :
     static const int32_t kDefaultMaxPipelineDepth = 4;
     size_t mBufferQueueDepth;
     size_t mFrameListDepth;
-    Vector<CameraMetadata> mFrameList;
-    size_t mFrameListHead;
+    // Recent preview results, shared with the frame processor rather than
+    // copied, keyed by sensor timestamp. At most mFrameListDepth are kept;
+    // the oldest is dropped first.
+    KeyedVector<nsecs_t, sp<const CaptureResult> > mFrameList;
+    // Timestamps of the results in mFrameList whose 3A state is good enough
+    // for a ZSL capture, worked out once as each result arrives
+    SortedVector<nsecs_t> mGoodFrames;
 
     ZslPair mNextPair;
 
@@ -132,7 +140,11 @@ class ZslProcessor3 :
 
     void dumpZslQueue(int id) const;
 
-    nsecs_t getCandidateTimestampLocked(size_t* metadataIdx) const;
+    nsecs_t getCandidateTimestampLocked(
+            sp<const CaptureResult>* candidate) const;
+
+    // Whether the AE and AF state of a result allow reprocessing it
+    bool isGoodCandidate(const CameraMetadata& frame) const;
 
     bool isFixedFocusMode(uint8_t afMode) const;
 
@@ -226,6 +226,16 @@ class CameraDeviceBase : public virtual RefBase {
      */
     virtual status_t getNextResult(CaptureResult *frame) = 0;
 
+    /**
+     * Get next capture result from the result queue as a shared handle,
+     * without copying the metadata. Returns NOT_ENOUGH_DATA if the queue is
+     * empty. The result may be passed on to several consumers at once, so it
+     * must not be modified once dequeued.
+     * May be called concurrently to most methods, except for waitForNextFrame
+     * and the other getNextResult.
+     */
+    virtual status_t getNextResult(sp<CaptureResult> *result) = 0;
+
     /**
      * Trigger auto-focus. The latest ID used in a trigger autofocus or cancel
      * autofocus call will be returned by the HAL in all subsequent AF
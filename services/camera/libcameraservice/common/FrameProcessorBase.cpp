@@ -30,6 +30,7 @@ namespace camera2 {
 FrameProcessorBase::FrameProcessorBase(wp<CameraDeviceBase> device) :
     Thread(/*canCallJava*/false),
     mDevice(device),
+    mRangeListeners(new RangeListenerSet()),
     mNumPartialResults(1) {
     sp<CameraDeviceBase> cameraDevice = device.promote();
     if (cameraDevice != 0 &&
@@ -49,22 +50,25 @@ FrameProcessorBase::~FrameProcessorBase() {
 status_t FrameProcessorBase::registerListener(int32_t minId,
         int32_t maxId, wp<FilteredListener> listener, bool sendPartials) {
     Mutex::Autolock l(mInputMutex);
-    List<RangeListener>::iterator item = mRangeListeners.begin();
-    while (item != mRangeListeners.end()) {
-        if (item->minId == minId &&
-                item->maxId == maxId &&
-                item->listener == listener) {
+    const Vector<RangeListener> &items = mRangeListeners->items;
+    for (size_t i = 0; i < items.size(); i++) {
+        const RangeListener &item = items[i];
+        if (item.minId == minId &&
+                item.maxId == maxId &&
+                item.listener == listener) {
             // already registered, just return
             ALOGV("%s: Attempt to register the same client twice, ignoring",
                     __FUNCTION__);
             return OK;
         }
-        item++;
     }
     ALOGV("%s: Registering listener for frame id range %d - %d",
             __FUNCTION__, minId, maxId);
     RangeListener rListener = { minId, maxId, listener, sendPartials };
-    mRangeListeners.push_back(rListener);
+    sp<RangeListenerSet> updated = new RangeListenerSet();
+    updated->items = items;
+    updated->items.push(rListener);
+    mRangeListeners = updated;
     return OK;
 }
 
@@ -72,30 +76,45 @@ status_t FrameProcessorBase::removeListener(int32_t minId,
                                            int32_t maxId,
                                            wp<FilteredListener> listener) {
     Mutex::Autolock l(mInputMutex);
-    List<RangeListener>::iterator item = mRangeListeners.begin();
-    while (item != mRangeListeners.end()) {
-        if (item->minId == minId &&
-                item->maxId == maxId &&
-                item->listener == listener) {
-            item = mRangeListeners.erase(item);
-        } else {
-            item++;
+    sp<RangeListenerSet> updated = new RangeListenerSet();
+    const Vector<RangeListener> &items = mRangeListeners->items;
+    for (size_t i = 0; i < items.size(); i++) {
+        const RangeListener &item = items[i];
+        if (item.minId != minId ||
+                item.maxId != maxId ||
+                item.listener != listener) {
+            updated->items.push(item);
         }
     }
+    mRangeListeners = updated;
     return OK;
 }
 
+void FrameProcessorBase::removeDeadListenersLocked() {
+    sp<RangeListenerSet> updated = new RangeListenerSet();
+    const Vector<RangeListener> &items = mRangeListeners->items;
+    for (size_t i = 0; i < items.size(); i++) {
+        if (items[i].listener.promote() != 0) {
+            updated->items.push(items[i]);
+        }
+    }
+    mRangeListeners = updated;
+}
+
 void FrameProcessorBase::dump(int fd, const Vector<String16>& /*args*/) {
     String8 result("    Latest received frame:\n");
     write(fd, result.string(), result.size());
 
-    CameraMetadata lastFrame;
+    sp<const CaptureResult> lastFrame;
     {
-        // Don't race while dumping metadata
+        // Results are never modified once queued, so holding on to the
+        // latest one is enough to dump it safely
         Mutex::Autolock al(mLastFrameMutex);
-        lastFrame = CameraMetadata(mLastFrame);
+        lastFrame = mLastFrame;
+    }
+    if (lastFrame != NULL) {
+        lastFrame->mMetadata.dump(fd, 2, 6);
     }
-    lastFrame.dump(fd, 2, 6);
 }
 
 bool FrameProcessorBase::threadLoop() {
@@ -121,7 +140,7 @@ bool FrameProcessorBase::threadLoop() {
 void FrameProcessorBase::processNewFrames(const sp<CameraDeviceBase> &device) {
     status_t res;
     ATRACE_CALL();
-    CaptureResult result;
+    sp<CaptureResult> result;
 
     ALOGV("%s: Camera %d: Process new frames", __FUNCTION__, device->getId());
 
@@ -131,7 +150,7 @@ void FrameProcessorBase::processNewFrames(const sp<CameraDeviceBase> &device) {
         // this from result.mResultExtras when CameraDeviceBase interface is fixed.
         camera_metadata_entry_t entry;
 
-        entry = result.mMetadata.find(ANDROID_REQUEST_FRAME_COUNT);
+        entry = result->mMetadata.find(ANDROID_REQUEST_FRAME_COUNT);
         if (entry.count == 0) {
             ALOGE("%s: Camera %d: Error reading frame number",
                     __FUNCTION__, device->getId());
@@ -143,9 +162,9 @@ void FrameProcessorBase::processNewFrames(const sp<CameraDeviceBase> &device) {
             break;
         }
 
-        if (!result.mMetadata.isEmpty()) {
+        if (!result->mMetadata.isEmpty()) {
             Mutex::Autolock al(mLastFrameMutex);
-            mLastFrame.acquire(result.mMetadata);
+            mLastFrame = result;
         }
     }
     if (res != NOT_ENOUGH_DATA) {
@@ -157,14 +176,16 @@ void FrameProcessorBase::processNewFrames(const sp<CameraDeviceBase> &device) {
     return;
 }
 
-bool FrameProcessorBase::processSingleFrame(CaptureResult &result,
-                                            const sp<CameraDeviceBase> &device) {
+bool FrameProcessorBase::processSingleFrame(
+        const sp<const CaptureResult> &result,
+        const sp<CameraDeviceBase> &device) {
     ALOGV("%s: Camera %d: Process single frame (is empty? %d)",
-          __FUNCTION__, device->getId(), result.mMetadata.isEmpty());
+          __FUNCTION__, device->getId(), result->mMetadata.isEmpty());
     return processListeners(result, device) == OK;
 }
 
-status_t FrameProcessorBase::processListeners(const CaptureResult &result,
+status_t FrameProcessorBase::processListeners(
+        const sp<const CaptureResult> &result,
         const sp<CameraDeviceBase> &device) {
     ATRACE_CALL();
 
@@ -173,9 +194,9 @@ status_t FrameProcessorBase::processListeners(const CaptureResult &result,
     // Check if this result is partial.
     bool isPartialResult = false;
     if (device->getDeviceVersion() >= CAMERA_DEVICE_API_VERSION_3_2) {
-        isPartialResult = result.mResultExtras.partialResultCount < mNumPartialResults;
+        isPartialResult = result->mResultExtras.partialResultCount < mNumPartialResults;
     } else {
-        entry = result.mMetadata.find(ANDROID_QUIRKS_PARTIAL_RESULT);
+        entry = result->mMetadata.find(ANDROID_QUIRKS_PARTIAL_RESULT);
         if (entry.count != 0 &&
                 entry.data.u8[0] == ANDROID_QUIRKS_PARTIAL_RESULT_PARTIAL) {
             ALOGV("%s: Camera %d: This is a partial result",
@@ -188,39 +209,43 @@ status_t FrameProcessorBase::processListeners(const CaptureResult &result,
     // from CaptureResultExtras. This will require changing Camera2Device.
     // Currently Camera2Device uses MetadataQueue to store results, which does not
     // include CaptureResultExtras.
-    entry = result.mMetadata.find(ANDROID_REQUEST_ID);
+    entry = result->mMetadata.find(ANDROID_REQUEST_ID);
     if (entry.count == 0) {
         ALOGE("%s: Camera %d: Error reading frame id", __FUNCTION__, device->getId());
         return BAD_VALUE;
     }
     int32_t requestId = entry.data.i32[0];
 
-    List<sp<FilteredListener> > listeners;
+    sp<const RangeListenerSet> listeners;
     {
         Mutex::Autolock l(mInputMutex);
+        listeners = mRangeListeners;
+    }
 
-        List<RangeListener>::iterator item = mRangeListeners.begin();
+    // Every listener gets the same result, without a copy
+    size_t notified = 0;
+    bool sawDeadListener = false;
+    const Vector<RangeListener> &items = listeners->items;
+    for (size_t i = 0; i < items.size(); i++) {
+        const RangeListener &item = items[i];
         // Don't deliver partial results to listeners that don't want them
-        while (item != mRangeListeners.end()) {
-            if (requestId >= item->minId && requestId < item->maxId &&
-                    (!isPartialResult || item->sendPartials)) {
-                sp<FilteredListener> listener = item->listener.promote();
-                if (listener == 0) {
-                    item = mRangeListeners.erase(item);
-                    continue;
-                } else {
-                    listeners.push_back(listener);
-                }
+        if (requestId >= item.minId && requestId < item.maxId &&
+                (!isPartialResult || item.sendPartials)) {
+            sp<FilteredListener> listener = item.listener.promote();
+            if (listener == 0) {
+                sawDeadListener = true;
+                continue;
             }
-            item++;
+            listener->onSharedResultAvailable(result);
+            notified++;
         }
     }
-    ALOGV("%s: Camera %d: Got %zu range listeners out of %zu", __FUNCTION__,
-          device->getId(), listeners.size(), mRangeListeners.size());
+    ALOGV("%s: Camera %d: Notified %zu range listeners out of %zu",
+          __FUNCTION__, device->getId(), notified, items.size());
 
-    List<sp<FilteredListener> >::iterator item = listeners.begin();
-    for (; item != listeners.end(); item++) {
-        (*item)->onResultAvailable(result);
+    if (sawDeadListener) {
+        Mutex::Autolock l(mInputMutex);
+        removeDeadListenersLocked();
     }
     return OK;
 }
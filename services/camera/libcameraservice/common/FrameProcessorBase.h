@@ -41,6 +41,14 @@ class FrameProcessorBase: public Thread {
 
     struct FilteredListener: virtual public RefBase {
         virtual void onResultAvailable(const CaptureResult &result) = 0;
+
+        // Called for each result in place of the above, for listeners that
+        // want to hold on to results without copying them. The same result
+        // goes to every listener, so it must not be modified.
+        virtual void onSharedResultAvailable(
+                const sp<const CaptureResult> &result) {
+            onResultAvailable(*result);
+        }
     };
 
     // Register a listener for a range of IDs [minId, maxId). Multiple listeners
@@ -69,20 +77,30 @@ class FrameProcessorBase: public Thread {
         wp<FilteredListener> listener;
         bool sendPartials;
     };
-    List<RangeListener> mRangeListeners;
+
+    // The registered listeners. A published set is never modified; changes
+    // swap in an updated copy under mInputMutex, so that results can be
+    // dispatched from a snapshot without holding the lock.
+    struct RangeListenerSet: public LightRefBase<RangeListenerSet> {
+        Vector<RangeListener> items;
+    };
+    sp<const RangeListenerSet> mRangeListeners;
+
+    // Drops listeners that have gone away; mInputMutex must be held
+    void removeDeadListenersLocked();
 
     // Number of partial result the HAL will potentially send.
     int32_t mNumPartialResults;
 
     void processNewFrames(const sp<CameraDeviceBase> &device);
 
-    virtual bool processSingleFrame(CaptureResult &result,
+    virtual bool processSingleFrame(const sp<const CaptureResult> &result,
                                     const sp<CameraDeviceBase> &device);
 
-    status_t processListeners(const CaptureResult &result,
+    status_t processListeners(const sp<const CaptureResult> &result,
                               const sp<CameraDeviceBase> &device);
 
-    CameraMetadata mLastFrame;
+    sp<const CaptureResult> mLastFrame;
 };
 
 
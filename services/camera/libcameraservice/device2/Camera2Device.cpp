@@ -545,6 +545,19 @@ status_t Camera2Device::getNextResult(CaptureResult *result) {
     return res;
 }
 
+status_t Camera2Device::getNextResult(sp<CaptureResult> *result) {
+    if (result == NULL) {
+        ALOGE("%s: result pointer is NULL", __FUNCTION__);
+        return BAD_VALUE;
+    }
+    sp<CaptureResult> frame = new CaptureResult();
+    status_t res = getNextResult(frame.get());
+    if (res == OK) {
+        *result = frame;
+    }
+    return res;
+}
+
 status_t Camera2Device::triggerAutofocus(uint32_t id) {
     ATRACE_CALL();
     status_t res;
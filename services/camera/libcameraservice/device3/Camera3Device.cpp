@@ -39,6 +39,7 @@
 
 #include <inttypes.h>
 
+#include <cutils/atomic.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include <utils/Timers.h>
@@ -61,9 +62,18 @@ Camera3Device::Camera3Device(int id):
         mStatus(STATUS_UNINITIALIZED),
         mUsePartialResult(false),
         mNumPartialResults(1),
+        mInitializeStartTime(0),
+        mOpenDuration(0),
+        mHalInitializeDuration(0),
+        mInitializeDuration(0),
+        mFirstConfigureDuration(0),
+        mFirstConfigureDoneTime(0),
         mNextResultFrameNumber(0),
         mNextShutterFrameNumber(0),
-        mListener(NULL)
+        mListener(NULL),
+        mFirstResultTime(0),
+        mResultRingWrite(0),
+        mResultRingRead(0)
 {
     ATRACE_CALL();
     camera3_callback_ops::notify = &sNotify;
@@ -105,11 +115,13 @@ status_t Camera3Device::initialize(camera_module_t *module)
 
     camera3_device_t *device;
 
+    mInitializeStartTime = systemTime();
     ATRACE_BEGIN("camera3->open");
     res = CameraService::filterOpenErrorCode(module->common.methods->open(
         &module->common, deviceName.string(),
         reinterpret_cast<hw_device_t**>(&device)));
     ATRACE_END();
+    mOpenDuration = systemTime() - mInitializeStartTime;
 
     if (res != OK) {
         SET_ERR_L("Could not open camera: %s (%d)", strerror(-res), res);
@@ -141,9 +153,11 @@ status_t Camera3Device::initialize(camera_module_t *module)
 
     /** Initialize device with callback functions */
 
+    nsecs_t halInitializeStart = systemTime();
     ATRACE_BEGIN("camera3->initialize");
     res = device->ops->initialize(device, this);
     ATRACE_END();
+    mHalInitializeDuration = systemTime() - halInitializeStart;
 
     if (res != OK) {
         SET_ERR_L("Unable to initialize HAL device: %s (%d)",
@@ -202,6 +216,42 @@ status_t Camera3Device::initialize(camera_module_t *module)
         }
     }
 
+    // Size the in-flight ring for the HAL pipeline plus the frames on their
+    // way back, and give each slot room for the keys the HAL can send in
+    // partial results.
+    {
+        Mutex::Autolock l(mInFlightLock);
+        size_t slots = kMinInFlightSlots;
+        camera_metadata_entry pipelineDepth =
+                mDeviceInfo.find(ANDROID_REQUEST_PIPELINE_MAX_DEPTH);
+        if (pipelineDepth.count > 0 && pipelineDepth.data.u8[0] * 2u > slots) {
+            slots = pipelineDepth.data.u8[0] * 2u;
+        }
+        mInFlightRing.setCapacity(slots);
+
+        if (mUsePartialResult) {
+            camera_metadata_entry resultKeys =
+                    mDeviceInfo.find(ANDROID_REQUEST_AVAILABLE_RESULT_KEYS);
+            size_t dataCapacity = 0;
+            for (size_t i = 0; i < resultKeys.count; i++) {
+                int type = get_camera_metadata_tag_type(resultKeys.data.i32[i]);
+                if (type != -1) {
+                    dataCapacity +=
+                            calculate_camera_metadata_entry_data_size(type, 1);
+                }
+            }
+            if (resultKeys.count > 0) {
+                mInFlightRing.reservePartialResults(resultKeys.count,
+                        dataCapacity);
+            }
+        }
+    }
+
+    mInitializeDuration = systemTime() - mInitializeStartTime;
+    ALOGV("%s: Camera %d: Initialized in %" PRId64 " ms (HAL open %" PRId64
+            " ms)", __FUNCTION__, mId, mInitializeDuration / 1000000,
+            mOpenDuration / 1000000);
+
     return OK;
 }
 
@@ -406,6 +456,22 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
     if (mStatus == STATUS_ERROR) {
         lines.appendFormat("    Error cause: %s\n", mErrorCause.string());
     }
+    lines.appendFormat("    Startup: open %.2f ms, HAL initialize %.2f ms, "
+            "initialize %.2f ms\n", mOpenDuration / 1e6,
+            mHalInitializeDuration / 1e6, mInitializeDuration / 1e6);
+    if (mFirstConfigureDuration > 0) {
+        lines.appendFormat("      First configure %.2f ms, done at %.2f ms\n",
+                mFirstConfigureDuration / 1e6, mFirstConfigureDoneTime / 1e6);
+    }
+    nsecs_t firstResultTime;
+    {
+        Mutex::Autolock l(mOutputLock);
+        firstResultTime = mFirstResultTime;
+    }
+    if (firstResultTime > 0) {
+        lines.appendFormat("      First result at %.2f ms\n",
+                firstResultTime / 1e6);
+    }
     lines.appendFormat("    Stream configuration:\n");
 
     if (mInputStream != NULL) {
@@ -420,15 +486,17 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
     }
 
     lines = String8("    In-flight requests:\n");
-    if (mInFlightMap.size() == 0) {
+    if (mInFlightRing.size() == 0) {
         lines.append("      None\n");
     } else {
-        for (size_t i = 0; i < mInFlightMap.size(); i++) {
-            InFlightRequest r = mInFlightMap.valueAt(i);
+        for (size_t i = 0; i < mInFlightRing.capacity(); i++) {
+            uint32_t frameNumber;
+            const InFlightRequest *r = mInFlightRing.slotAt(i, &frameNumber);
+            if (r == NULL) continue;
             lines.appendFormat("      Frame %d |  Timestamp: %" PRId64 ", metadata"
-                    " arrived: %s, buffers left: %d\n", mInFlightMap.keyAt(i),
-                    r.captureTimestamp, r.haveResultMetadata ? "true" : "false",
-                    r.numBuffersLeft);
+                    " arrived: %s, buffers left: %d\n", frameNumber,
+                    r->captureTimestamp, r->haveResultMetadata ? "true" : "false",
+                    r->numBuffersLeft);
         }
     }
     write(fd, lines.string(), lines.size());
@@ -1178,7 +1246,7 @@ status_t Camera3Device::waitForNextFrame(nsecs_t timeout) {
     status_t res;
     Mutex::Autolock l(mOutputLock);
 
-    while (mResultQueue.empty()) {
+    while (resultQueueEmptyLocked()) {
         res = mResultSignal.waitRelative(mOutputLock, timeout);
         if (res == TIMED_OUT) {
             return res;
@@ -1193,25 +1261,85 @@ status_t Camera3Device::waitForNextFrame(nsecs_t timeout) {
 
 status_t Camera3Device::getNextResult(CaptureResult *frame) {
     ATRACE_CALL();
-    Mutex::Autolock l(mOutputLock);
 
-    if (mResultQueue.empty()) {
-        return NOT_ENOUGH_DATA;
+    if (frame == NULL) {
+        ALOGE("%s: argument cannot be NULL", __FUNCTION__);
+        return BAD_VALUE;
     }
 
-    if (frame == NULL) {
+    sp<CaptureResult> result;
+    status_t res = getNextResult(&result);
+    if (res != OK) {
+        return res;
+    }
+
+    // Nobody else has seen this result, so its metadata can be moved out
+    frame->mResultExtras = result->mResultExtras;
+    frame->mMetadata.acquire(result->mMetadata);
+
+    return OK;
+}
+
+status_t Camera3Device::getNextResult(sp<CaptureResult> *result) {
+    ATRACE_CALL();
+
+    if (result == NULL) {
         ALOGE("%s: argument cannot be NULL", __FUNCTION__);
         return BAD_VALUE;
     }
 
-    CaptureResult &result = *(mResultQueue.begin());
-    frame->mResultExtras = result.mResultExtras;
-    frame->mMetadata.acquire(result.mMetadata);
-    mResultQueue.erase(mResultQueue.begin());
+    uint32_t read = mResultRingRead;
+    uint32_t write = android_atomic_acquire_load(&mResultRingWrite);
+    if (read == write) {
+        // The ring is drained; anything left is waiting in the overflow list,
+        // unless it was just moved into the ring
+        Mutex::Autolock l(mOutputLock);
+        write = mResultRingWrite;
+        if (read == write) {
+            if (mResultOverflow.empty()) {
+                return NOT_ENOUGH_DATA;
+            }
+            *result = *mResultOverflow.begin();
+            mResultOverflow.erase(mResultOverflow.begin());
+            return OK;
+        }
+    }
+
+    sp<CaptureResult> &slot = mResultRing[read % kResultRingSize];
+    *result = slot;
+    slot.clear();
+    android_atomic_release_store(read + 1, &mResultRingRead);
 
     return OK;
 }
 
+void Camera3Device::queueResultLocked(const sp<CaptureResult> &result) {
+    uint32_t write = mResultRingWrite;
+    uint32_t read = android_atomic_acquire_load(&mResultRingRead);
+
+    // Results that didn't fit earlier go first, to keep the order
+    while (!mResultOverflow.empty() && write - read < kResultRingSize) {
+        mResultRing[write % kResultRingSize] = *mResultOverflow.begin();
+        mResultOverflow.erase(mResultOverflow.begin());
+        write++;
+    }
+
+    if (mResultOverflow.empty() && write - read < kResultRingSize) {
+        mResultRing[write % kResultRingSize] = result;
+        write++;
+    } else {
+        ALOGV("%s: Camera %d: Result ring full, %zu results waiting",
+                __FUNCTION__, mId, mResultOverflow.size() + 1);
+        mResultOverflow.push_back(result);
+    }
+
+    android_atomic_release_store(write, &mResultRingWrite);
+}
+
+bool Camera3Device::resultQueueEmptyLocked() const {
+    return mResultRingRead == mResultRingWrite && mResultOverflow.empty();
+}
+
 status_t Camera3Device::triggerAutofocus(uint32_t id) {
     ATRACE_CALL();
     Mutex::Autolock il(mInterfaceLock);
@@ -1421,6 +1549,26 @@ sp<Camera3Device::CaptureRequest> Camera3Device::createCaptureRequest(
     }
     newRequest->mSettings.erase(ANDROID_REQUEST_OUTPUT_STREAMS);
 
+    // Give the triggers a slot in the settings up front, so that mixing them
+    // in and taking them out again per frame only overwrites entries in
+    // place instead of growing the buffer and losing the sort order. IDLE is
+    // what the HAL assumes for a missing trigger anyway.
+    if (!newRequest->mSettings.exists(ANDROID_CONTROL_AF_TRIGGER)) {
+        static const uint8_t afTrigger = ANDROID_CONTROL_AF_TRIGGER_IDLE;
+        newRequest->mSettings.update(ANDROID_CONTROL_AF_TRIGGER,
+                &afTrigger, 1);
+    }
+    if (!newRequest->mSettings.exists(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER)) {
+        static const uint8_t precaptureTrigger =
+                ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_IDLE;
+        newRequest->mSettings.update(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER,
+                &precaptureTrigger, 1);
+    }
+
+    // Sort once here; the request thread sorts again before each submit,
+    // which is a no-op for a buffer that is still sorted.
+    newRequest->mSettings.sort();
+
     return newRequest;
 }
 
@@ -1438,6 +1586,8 @@ status_t Camera3Device::configureStreamsLocked() {
         return OK;
     }
 
+    nsecs_t configureStart = systemTime();
+
     // Workaround for device HALv3.2 or older spec bug - zero streams requires
     // adding a dummy stream instead.
     // TODO: Bug: 17321404 for fixing the HAL spec and removing this workaround.
@@ -1577,6 +1727,12 @@ status_t Camera3Device::configureStreamsLocked() {
 
     ALOGV("%s: Camera %d: Stream configuration complete", __FUNCTION__, mId);
 
+    if (mFirstConfigureDuration == 0) {
+        nsecs_t now = systemTime();
+        mFirstConfigureDuration = now - configureStart;
+        mFirstConfigureDoneTime = now - mInitializeStartTime;
+    }
+
     // tear down the deleted streams after configure streams.
     mDeletedStreams.clear();
 
@@ -1703,11 +1859,7 @@ status_t Camera3Device::registerInFlight(uint32_t frameNumber,
     ATRACE_CALL();
     Mutex::Autolock l(mInFlightLock);
 
-    ssize_t res;
-    res = mInFlightMap.add(frameNumber, InFlightRequest(numBuffers, resultExtras, hasInput));
-    if (res < 0) return res;
-
-    return OK;
+    return mInFlightRing.add(frameNumber, numBuffers, resultExtras, hasInput);
 }
 
 /**
@@ -1772,13 +1924,11 @@ bool Camera3Device::processPartial3AResult(
 
     Mutex::Autolock l(mOutputLock);
 
-    CaptureResult captureResult;
-    captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = CameraMetadata(kMinimal3AResultEntries, /*dataCapacity*/ 0);
-    // TODO: change this to sp<CaptureResult>. This will need other changes, including,
-    // but not limited to CameraDeviceBase::getNextResult
-    CaptureResult& min3AResult =
-            *mResultQueue.insert(mResultQueue.end(), captureResult);
+    sp<CaptureResult> min3AResultHandle = new CaptureResult();
+    CaptureResult& min3AResult = *min3AResultHandle;
+    min3AResult.mResultExtras = resultExtras;
+    CameraMetadata sized(kMinimal3AResultEntries, /*dataCapacity*/ 0);
+    min3AResult.mMetadata.acquire(sized);
 
     if (!insert3AResult(min3AResult.mMetadata, ANDROID_REQUEST_FRAME_COUNT,
             // TODO: This is problematic casting. Need to fix CameraMetadata.
@@ -1838,6 +1988,7 @@ bool Camera3Device::processPartial3AResult(
     // We only send the aggregated partial when all 3A related metadata are available
     // For both API1 and API2.
     // TODO: we probably should pass through all partials to API2 unconditionally.
+    queueResultLocked(min3AResultHandle);
     mResultSignal.signal();
 
     return true;
@@ -1872,7 +2023,6 @@ template<typename T>
 bool Camera3Device::insert3AResult(CameraMetadata& result, int32_t tag,
         const T* value, uint32_t frameNumber) {
     if (result.update(tag, value, 1) != NO_ERROR) {
-        mResultQueue.erase(--mResultQueue.end(), mResultQueue.end());
         SET_ERR("Frame %d: Failed to set %s in partial metadata",
                 frameNumber, get_camera_metadata_tag_name(tag));
         return false;
@@ -1910,7 +2060,7 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
     }
 
     bool isPartialResult = false;
-    CameraMetadata collectedPartialResult;
+    CameraMetadata resultMetadata;
     CaptureResultExtras resultExtras;
     bool hasInputBufferInRequest = false;
 
@@ -1921,13 +2071,13 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
     nsecs_t timestamp = 0;
     {
         Mutex::Autolock l(mInFlightLock);
-        ssize_t idx = mInFlightMap.indexOfKey(frameNumber);
-        if (idx == NAME_NOT_FOUND) {
+        InFlightRequest *inFlight = mInFlightRing.find(frameNumber);
+        if (inFlight == NULL) {
             SET_ERR("Unknown frame number for capture result: %d",
                     frameNumber);
             return;
         }
-        InFlightRequest &request = mInFlightMap.editValueAt(idx);
+        InFlightRequest &request = *inFlight;
         ALOGVV("%s: got InFlightRequest requestId = %" PRId32 ", frameNumber = %" PRId64
                 ", burstId = %" PRId32,
                 __FUNCTION__, request.resultExtras.requestId, request.resultExtras.frameNumber,
@@ -2001,10 +2151,34 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
                         frameNumber);
                 return;
             }
-            if (mUsePartialResult &&
-                    !request.partialResult.collectedResult.isEmpty()) {
-                collectedPartialResult.acquire(
-                    request.partialResult.collectedResult);
+
+            // Put together the complete result while the partial results
+            // collected in the slot are still around, with a single
+            // allocation for the copy that goes out to clients.
+            CameraMetadata &collected = request.partialResult.collectedResult;
+            if (mUsePartialResult && !collected.isEmpty()) {
+                res = collected.append(result->result);
+                if (res == OK) {
+                    res = collected.update(ANDROID_REQUEST_FRAME_COUNT,
+                            (int32_t*)&frameNumber, 1);
+                }
+                resultMetadata = collected;
+                collected.clearEntries();
+            } else {
+                CameraMetadata sized(
+                        get_camera_metadata_entry_count(result->result) + 1,
+                        get_camera_metadata_data_count(result->result));
+                resultMetadata.acquire(sized);
+                res = resultMetadata.append(result->result);
+                if (res == OK) {
+                    res = resultMetadata.update(ANDROID_REQUEST_FRAME_COUNT,
+                            (int32_t*)&frameNumber, 1);
+                }
+            }
+            if (res != OK) {
+                SET_ERR("Failed to set frame# in metadata (%d)",
+                        frameNumber);
+                resultMetadata.clear();
             }
             request.haveResultMetadata = true;
         }
@@ -2027,17 +2201,18 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
         }
 
         // Check if everything has arrived for this result (buffers and metadata), remove it from
-        // InFlightMap if both arrived or HAL reports error for this request (i.e. during flush).
+        // the in-flight ring if both arrived or HAL reports error for this request (i.e. during
+        // flush).
         if ((request.requestStatus != OK) ||
                 (request.haveResultMetadata && request.numBuffersLeft == 0)) {
             ATRACE_ASYNC_END("frame capture", frameNumber);
-            mInFlightMap.removeItemsAt(idx, 1);
+            mInFlightRing.remove(frameNumber);
         }
 
         // Sanity check - if we have too many in-flight frames, something has
         // likely gone wrong
-        if (mInFlightMap.size() > kInFlightWarnLimit) {
-            CLOGE("In-flight list too large: %zu", mInFlightMap.size());
+        if (mInFlightRing.size() > kInFlightWarnLimit) {
+            CLOGE("In-flight list too large: %zu", mInFlightRing.size());
         }
 
     }
@@ -2058,46 +2233,39 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
         }
         mNextResultFrameNumber = frameNumber + 1;
 
-        CaptureResult captureResult;
-        captureResult.mResultExtras = resultExtras;
-        captureResult.mMetadata = result->result;
-
-        if (captureResult.mMetadata.update(ANDROID_REQUEST_FRAME_COUNT,
-                (int32_t*)&frameNumber, 1) != OK) {
-            SET_ERR("Failed to set frame# in metadata (%d)",
-                    frameNumber);
+        // The frame number and any earlier partials were merged in above
+        if (resultMetadata.isEmpty()) {
             gotResult = false;
         } else {
-            ALOGVV("%s: Camera %d: Set frame# in metadata (%d)",
-                    __FUNCTION__, mId, frameNumber);
-        }
+            resultMetadata.sort();
 
-        // Append any previous partials to form a complete result
-        if (mUsePartialResult && !collectedPartialResult.isEmpty()) {
-            captureResult.mMetadata.append(collectedPartialResult);
-        }
-
-        captureResult.mMetadata.sort();
+            // Check that there's a timestamp in the result metadata
 
-        // Check that there's a timestamp in the result metadata
+            camera_metadata_entry entry =
+                    resultMetadata.find(ANDROID_SENSOR_TIMESTAMP);
+            if (entry.count == 0) {
+                SET_ERR("No timestamp provided by HAL for frame %d!",
+                        frameNumber);
+                gotResult = false;
+            } else if (timestamp != entry.data.i64[0]) {
+                SET_ERR("Timestamp mismatch between shutter notify and result"
+                        " metadata for frame %d (%" PRId64 " vs %" PRId64 " respectively)",
+                        frameNumber, timestamp, entry.data.i64[0]);
+                gotResult = false;
+            }
+        }
 
-        camera_metadata_entry entry =
-                captureResult.mMetadata.find(ANDROID_SENSOR_TIMESTAMP);
-        if (entry.count == 0) {
-            SET_ERR("No timestamp provided by HAL for frame %d!",
-                    frameNumber);
-            gotResult = false;
-        } else if (timestamp != entry.data.i64[0]) {
-            SET_ERR("Timestamp mismatch between shutter notify and result"
-                    " metadata for frame %d (%" PRId64 " vs %" PRId64 " respectively)",
-                    frameNumber, timestamp, entry.data.i64[0]);
-            gotResult = false;
+        if (gotResult && mFirstResultTime == 0) {
+            // mInitializeStartTime is set before the HAL can send results
+            mFirstResultTime = systemTime() - mInitializeStartTime;
         }
 
         if (gotResult) {
-            // Valid result, insert into queue
-            List<CaptureResult>::iterator queuedResult =
-                    mResultQueue.insert(mResultQueue.end(), CaptureResult(captureResult));
+            // Valid result, move it into the queue without copying
+            sp<CaptureResult> queuedResult = new CaptureResult();
+            queuedResult->mResultExtras = resultExtras;
+            queuedResult->mMetadata.acquire(resultMetadata);
+            queueResultLocked(queuedResult);
             ALOGVV("%s: result requestId = %" PRId32 ", frameNumber = %" PRId64
                    ", burstId = %" PRId32, __FUNCTION__,
                    queuedResult->mResultExtras.requestId,
@@ -2221,11 +2389,10 @@ void Camera3Device::notifyError(const camera3_error_msg_t &msg,
         case ICameraDeviceCallbacks::ERROR_CAMERA_BUFFER:
             {
                 Mutex::Autolock l(mInFlightLock);
-                ssize_t idx = mInFlightMap.indexOfKey(msg.frame_number);
-                if (idx >= 0) {
-                    InFlightRequest &r = mInFlightMap.editValueAt(idx);
-                    r.requestStatus = msg.error_code;
-                    resultExtras = r.resultExtras;
+                InFlightRequest *r = mInFlightRing.find(msg.frame_number);
+                if (r != NULL) {
+                    r->requestStatus = msg.error_code;
+                    resultExtras = r->resultExtras;
                 } else {
                     resultExtras.frameNumber = msg.frame_number;
                     ALOGE("Camera %d: %s: cannot find in-flight request on "
@@ -2248,7 +2415,7 @@ void Camera3Device::notifyError(const camera3_error_msg_t &msg,
 
 void Camera3Device::notifyShutter(const camera3_shutter_msg_t &msg,
         NotificationListener *listener) {
-    ssize_t idx;
+    bool found;
     // Verify ordering of shutter notifications
     {
         Mutex::Autolock l(mOutputLock);
@@ -2268,14 +2435,14 @@ void Camera3Device::notifyShutter(const camera3_shutter_msg_t &msg,
     // and get the request ID to send upstream
     {
         Mutex::Autolock l(mInFlightLock);
-        idx = mInFlightMap.indexOfKey(msg.frame_number);
-        if (idx >= 0) {
-            InFlightRequest &r = mInFlightMap.editValueAt(idx);
-            r.captureTimestamp = msg.timestamp;
-            resultExtras = r.resultExtras;
+        InFlightRequest *r = mInFlightRing.find(msg.frame_number);
+        found = (r != NULL);
+        if (found) {
+            r->captureTimestamp = msg.timestamp;
+            resultExtras = r->resultExtras;
         }
     }
-    if (idx < 0) {
+    if (!found) {
         SET_ERR("Shutter notification for non-existent frame number %d",
                 msg.frame_number);
         return;
@@ -2303,6 +2470,115 @@ CameraMetadata Camera3Device::getLatestRequestLocked() {
 }
 
 
+/**
+ * InFlightRing inner class methods
+ */
+
+Camera3Device::InFlightRing::InFlightRing() :
+        mMask(0),
+        mCount(0) {
+    setCapacity(kMinInFlightSlots);
+}
+
+void Camera3Device::InFlightRing::setCapacity(size_t capacity) {
+    size_t slots = 1;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+
+    mSlots.clear();
+    mSlots.insertAt(Slot(), 0, slots);
+    mMask = slots - 1;
+    mCount = 0;
+}
+
+status_t Camera3Device::InFlightRing::add(uint32_t frameNumber,
+        int numBuffers, const CaptureResultExtras &extras, bool hasInput) {
+    Slot *slot = &mSlots.editItemAt(frameNumber & mMask);
+    if (slot->used) {
+        if (slot->frameNumber == frameNumber) {
+            return ALREADY_EXISTS;
+        }
+        grow();
+        slot = &mSlots.editItemAt(frameNumber & mMask);
+    }
+
+    slot->used = true;
+    slot->frameNumber = frameNumber;
+    slot->request.reset(numBuffers, extras, hasInput);
+    mCount++;
+    return OK;
+}
+
+Camera3Device::InFlightRequest* Camera3Device::InFlightRing::find(
+        uint32_t frameNumber) {
+    Slot &slot = mSlots.editItemAt(frameNumber & mMask);
+    if (!slot.used || slot.frameNumber != frameNumber) {
+        return NULL;
+    }
+    return &slot.request;
+}
+
+void Camera3Device::InFlightRing::remove(uint32_t frameNumber) {
+    Slot &slot = mSlots.editItemAt(frameNumber & mMask);
+    if (slot.used && slot.frameNumber == frameNumber) {
+        slot.used = false;
+        mCount--;
+    }
+}
+
+const Camera3Device::InFlightRequest* Camera3Device::InFlightRing::slotAt(
+        size_t slot, uint32_t *frameNumber) const {
+    const Slot &s = mSlots[slot];
+    if (!s.used) {
+        return NULL;
+    }
+    *frameNumber = s.frameNumber;
+    return &s.request;
+}
+
+void Camera3Device::InFlightRing::reservePartialResults(size_t entryCapacity,
+        size_t dataCapacity) {
+    for (size_t i = 0; i < mSlots.size(); i++) {
+        // Assignment would clone the buffer down to its contents, so take
+        // over the freshly allocated one instead
+        CameraMetadata reserved(entryCapacity, dataCapacity);
+        mSlots.editItemAt(i).request.partialResult.collectedResult.acquire(
+                reserved);
+    }
+}
+
+void Camera3Device::InFlightRing::grow() {
+    // Double until every frame still in flight has a slot of its own
+    size_t slots = mSlots.size() * 2;
+    for (;;) {
+        Vector<Slot> grown;
+        grown.insertAt(Slot(), 0, slots);
+        size_t mask = slots - 1;
+
+        bool collision = false;
+        for (size_t i = 0; i < mSlots.size() && !collision; i++) {
+            const Slot &slot = mSlots[i];
+            if (!slot.used) continue;
+            Slot &target = grown.editItemAt(slot.frameNumber & mask);
+            if (target.used) {
+                collision = true;
+            } else {
+                target = slot;
+            }
+        }
+
+        if (!collision) {
+            ALOGV("%s: In-flight ring grown to %zu slots", __FUNCTION__, slots);
+            mSlots = grown;
+            mMask = mask;
+            return;
+        }
+        slots *= 2;
+    }
+}
+
+
 /**
  * RequestThread inner class methods
  */
@@ -2536,17 +2812,8 @@ bool Camera3Device::RequestThread::threadLoop() {
     request.frame_number = nextRequest->mResultExtras.frameNumber;
     Vector<camera3_stream_buffer_t> outputBuffers;
 
-    // Get the request ID, if any
-    int requestId;
-    camera_metadata_entry_t requestIdEntry =
-            nextRequest->mSettings.find(ANDROID_REQUEST_ID);
-    if (requestIdEntry.count > 0) {
-        requestId = requestIdEntry.data.i32[0];
-    } else {
-        ALOGW("%s: Did not have android.request.id set in the request",
-                __FUNCTION__);
-        requestId = NAME_NOT_FOUND;
-    }
+    // The request ID was checked and cached when the request was set up
+    int requestId = nextRequest->mResultExtras.requestId;
 
     // Insert any queued triggers (before metadata is locked)
     int32_t triggerCount;
@@ -2903,6 +3170,11 @@ status_t Camera3Device::RequestThread::insertTriggers(
 
     Mutex::Autolock al(mTriggerMutex);
 
+    size_t count = mTriggerMap.size();
+    if (count == 0) {
+        return 0;
+    }
+
     sp<Camera3Device> parent = mParent.promote();
     if (parent == NULL) {
         CLOGE("RequestThread: Parent is gone");
@@ -2910,7 +3182,6 @@ status_t Camera3Device::RequestThread::insertTriggers(
     }
 
     CameraMetadata &metadata = request->mSettings;
-    size_t count = mTriggerMap.size();
 
     for (size_t i = 0; i < count; ++i) {
         RequestTrigger trigger = mTriggerMap.valueAt(i);
@@ -2993,6 +3264,10 @@ status_t Camera3Device::RequestThread::removeTriggers(
         const sp<CaptureRequest> &request) {
     Mutex::Autolock al(mTriggerMutex);
 
+    if (mTriggerReplacedMap.isEmpty() && mTriggerRemovedMap.isEmpty()) {
+        return OK;
+    }
+
     CameraMetadata &metadata = request->mSettings;
 
     /**
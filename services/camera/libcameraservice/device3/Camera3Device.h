@@ -125,6 +125,7 @@ class Camera3Device :
     virtual bool     willNotify3A();
     virtual status_t waitForNextFrame(nsecs_t timeout);
     virtual status_t getNextResult(CaptureResult *frame);
+    virtual status_t getNextResult(sp<CaptureResult> *result);
 
     virtual status_t triggerAutofocus(uint32_t id);
     virtual status_t triggerCancelAutofocus(uint32_t id);
@@ -215,6 +216,15 @@ class Camera3Device :
     // Number of partial results that will be delivered by the HAL.
     uint32_t                   mNumPartialResults;
 
+    // Startup latency breakdown, for dump(). Durations are 0 until the
+    // phase has run.
+    nsecs_t                    mInitializeStartTime;
+    nsecs_t                    mOpenDuration;           // HAL open()
+    nsecs_t                    mHalInitializeDuration;  // HAL initialize()
+    nsecs_t                    mInitializeDuration;     // all of initialize()
+    nsecs_t                    mFirstConfigureDuration; // first configure_streams
+    nsecs_t                    mFirstConfigureDoneTime; // from initialize() start
+
     /**** End scope for mLock ****/
 
     class CaptureRequest : public LightRefBase<CaptureRequest> {
@@ -544,7 +554,7 @@ class Camera3Device :
             }
         } partialResult;
 
-        // Default constructor needed by KeyedVector
+        // Default constructor needed by Vector
         InFlightRequest() :
                 captureTimestamp(0),
                 requestStatus(OK),
@@ -553,37 +563,71 @@ class Camera3Device :
                 hasInputBuffer(false){
         }
 
-        InFlightRequest(int numBuffers) :
-                captureTimestamp(0),
-                requestStatus(OK),
-                haveResultMetadata(false),
-                numBuffersLeft(numBuffers),
-                hasInputBuffer(false){
+        // Starts tracking a new capture, keeping the storage of the
+        // collected partial result from the previous one
+        void reset(int numBuffers, const CaptureResultExtras &extras,
+                bool hasInput) {
+            captureTimestamp = 0;
+            requestStatus = OK;
+            haveResultMetadata = false;
+            numBuffersLeft = numBuffers;
+            resultExtras = extras;
+            hasInputBuffer = hasInput;
+            partialResult.haveSent3A = false;
+            partialResult.collectedResult.clearEntries();
         }
+    };
 
-        InFlightRequest(int numBuffers, CaptureResultExtras extras) :
-                captureTimestamp(0),
-                requestStatus(OK),
-                haveResultMetadata(false),
-                numBuffersLeft(numBuffers),
-                resultExtras(extras),
-                hasInputBuffer(false){
-        }
+    /**
+     * In-flight requests indexed by frame number modulo the number of slots.
+     * Frame numbers are sequential and only a pipeline's worth of them is
+     * in flight at once, so lookups and removals are a single index, and
+     * slots are reused along with the storage of their partial results. If
+     * a new frame lands on a slot that is still taken, the ring doubles.
+     */
+    class InFlightRing {
+      public:
+        InFlightRing();
 
-        InFlightRequest(int numBuffers, CaptureResultExtras extras, bool hasInput) :
-                captureTimestamp(0),
-                requestStatus(OK),
-                haveResultMetadata(false),
-                numBuffersLeft(numBuffers),
-                resultExtras(extras),
-                hasInputBuffer(hasInput){
-        }
-};
-    // Map from frame number to the in-flight request state
-    typedef KeyedVector<uint32_t, InFlightRequest> InFlightMap;
+        // Number of slots, rounded up to a power of two. Drops any
+        // in-flight requests.
+        void setCapacity(size_t capacity);
+        size_t capacity() const { return mSlots.size(); }
+        size_t size() const { return mCount; }
+
+        status_t add(uint32_t frameNumber, int numBuffers,
+                const CaptureResultExtras &extras, bool hasInput);
+        // Returns NULL if the frame is not in flight
+        InFlightRequest* find(uint32_t frameNumber);
+        void remove(uint32_t frameNumber);
+
+        // For iterating over the slots; returns NULL for a free slot
+        const InFlightRequest* slotAt(size_t slot,
+                uint32_t *frameNumber) const;
+
+        // Preallocates the collected partial result of every slot
+        void reservePartialResults(size_t entryCapacity, size_t dataCapacity);
+
+      private:
+        struct Slot {
+            bool used;
+            uint32_t frameNumber;
+            InFlightRequest request;
+
+            Slot() : used(false), frameNumber(0) {}
+        };
 
-    Mutex                  mInFlightLock; // Protects mInFlightMap
-    InFlightMap            mInFlightMap;
+        void grow();
+
+        Vector<Slot> mSlots;
+        size_t mMask;
+        size_t mCount;
+    };
+
+    static const size_t    kMinInFlightSlots = 8;
+
+    Mutex                  mInFlightLock; // Protects mInFlightRing
+    InFlightRing           mInFlightRing;
 
     status_t registerInFlight(uint32_t frameNumber,
             int32_t numBuffers, CaptureResultExtras resultExtras, bool hasInput);
@@ -620,12 +664,30 @@ class Camera3Device :
 
     uint32_t               mNextResultFrameNumber;
     uint32_t               mNextShutterFrameNumber;
-    List<CaptureResult>   mResultQueue;
     Condition              mResultSignal;
     NotificationListener  *mListener;
+    // Time of the first result after initialize(), from its start
+    nsecs_t                mFirstResultTime;
 
     /**** End scope for mOutputLock ****/
 
+    /**
+     * Completed results waiting for getNextResult(). Results are written into
+     * the ring with mOutputLock held, and read back by the single result
+     * reader without taking it. Results that don't fit in the ring wait in
+     * mResultOverflow, under mOutputLock, until the reader catches up.
+     */
+    static const uint32_t  kResultRingSize = 64;
+    sp<CaptureResult>      mResultRing[kResultRingSize];
+    volatile int32_t       mResultRingWrite;
+    volatile int32_t       mResultRingRead;
+    List<sp<CaptureResult> > mResultOverflow;
+
+    // Add a result to the end of the result queue. mOutputLock must be held
+    void queueResultLocked(const sp<CaptureResult> &result);
+    // Whether getNextResult() would find nothing. mOutputLock must be held
+    bool resultQueueEmptyLocked() const;
+
     /**
      * Callback functions from HAL device
      */
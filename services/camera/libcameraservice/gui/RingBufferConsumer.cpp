@@ -66,17 +66,15 @@ sp<PinnedBufferItem> RingBufferConsumer::pinSelectedBuffer(
     sp<PinnedBufferItem> pinnedBuffer;
 
     {
-        List<RingBufferItem>::iterator it, end, accIt;
         BufferInfo acc, cur;
         BufferInfo* accPtr = NULL;
+        size_t accIndex = 0;
 
         Mutex::Autolock _l(mMutex);
 
-        for (it = mBufferItemList.begin(), end = mBufferItemList.end();
-             it != end;
-             ++it) {
+        for (size_t i = 0; i < mBufferItems.size(); i++) {
 
-            const RingBufferItem& item = *it;
+            const RingBufferItem& item = mBufferItems.valueAt(i);
 
             cur.mCrop = item.mCrop;
             cur.mTransform = item.mTransform;
@@ -92,7 +90,7 @@ sp<PinnedBufferItem> RingBufferConsumer::pinSelectedBuffer(
             } else if (ret > 0) {
                 acc = cur;
                 accPtr = &acc;
-                accIt = it;
+                accIndex = i;
             } // else acc = acc
         }
 
@@ -100,23 +98,54 @@ sp<PinnedBufferItem> RingBufferConsumer::pinSelectedBuffer(
             return NULL;
         }
 
-        pinnedBuffer = new PinnedBufferItem(this, *accIt);
-        pinBufferLocked(pinnedBuffer->getBufferItem());
+        pinnedBuffer = pinBufferLocked(accIndex);
 
     } // end scope of mMutex autolock
 
     if (waitForFence) {
-        status_t err = pinnedBuffer->getBufferItem().mFence->waitForever(
+        waitForPinnedBuffer(pinnedBuffer,
                 "RingBufferConsumer::pinSelectedBuffer");
-        if (err != OK) {
-            BI_LOGE("Failed to wait for fence of acquired buffer: %s (%d)",
-                    strerror(-err), err);
+    }
+
+    return pinnedBuffer;
+}
+
+sp<PinnedBufferItem> RingBufferConsumer::pinBufferByTimestamp(
+        nsecs_t timestamp,
+        bool waitForFence) {
+
+    sp<PinnedBufferItem> pinnedBuffer;
+
+    {
+        Mutex::Autolock _l(mMutex);
+
+        ssize_t index = indexOfClosestBufferLocked(timestamp);
+        if (index < 0) {
+            return NULL;
         }
+
+        pinnedBuffer = pinBufferLocked(index);
+
+    } // end scope of mMutex autolock
+
+    if (waitForFence) {
+        waitForPinnedBuffer(pinnedBuffer,
+                "RingBufferConsumer::pinBufferByTimestamp");
     }
 
     return pinnedBuffer;
 }
 
+void RingBufferConsumer::waitForPinnedBuffer(
+        const sp<PinnedBufferItem>& pinnedBuffer,
+        const char* name) {
+    status_t err = pinnedBuffer->getBufferItem().mFence->waitForever(name);
+    if (err != OK) {
+        BI_LOGE("Failed to wait for fence of acquired buffer: %s (%d)",
+                strerror(-err), err);
+    }
+}
+
 status_t RingBufferConsumer::clear() {
 
     status_t err;
@@ -125,7 +154,7 @@ status_t RingBufferConsumer::clear() {
     BI_LOGV("%s", __FUNCTION__);
 
     // Avoid annoying log warnings by returning early
-    if (mBufferItemList.size() == 0) {
+    if (mBufferItems.size() == 0) {
         return OK;
     }
 
@@ -134,7 +163,7 @@ status_t RingBufferConsumer::clear() {
         err = releaseOldestBufferLocked(&pinnedFrames);
 
         if (err == NO_BUFFER_AVAILABLE) {
-            assert(pinnedFrames == mBufferItemList.size());
+            assert(pinnedFrames == mBufferItems.size());
             break;
         }
 
@@ -155,45 +184,56 @@ status_t RingBufferConsumer::clear() {
 
 nsecs_t RingBufferConsumer::getLatestTimestamp() {
     Mutex::Autolock _l(mMutex);
-    if (mBufferItemList.size() == 0) {
+    if (mBufferItems.size() == 0) {
         return 0;
     }
     return mLatestTimestamp;
 }
 
-void RingBufferConsumer::pinBufferLocked(const BufferItem& item) {
-    List<RingBufferItem>::iterator it, end;
+sp<PinnedBufferItem> RingBufferConsumer::pinBufferLocked(size_t index) {
+    RingBufferItem& item = mBufferItems.editValueAt(index);
+    item.mPinCount++;
 
-    for (it = mBufferItemList.begin(), end = mBufferItemList.end();
-         it != end;
-         ++it) {
+    BI_LOGV("Pinned buffer (frame %" PRIu64 ", timestamp %" PRId64 ")",
+            item.mFrameNumber, item.mTimestamp);
 
-        RingBufferItem& find = *it;
-        if (item.mGraphicBuffer == find.mGraphicBuffer) {
-            find.mPinCount++;
-            break;
-        }
+    return new PinnedBufferItem(this, item);
+}
+
+ssize_t RingBufferConsumer::indexOfBufferLocked(const BufferItem& item) const {
+    ssize_t index = mBufferItems.indexOfKey(item.mTimestamp);
+    if (index >= 0 &&
+            mBufferItems.valueAt(index).mGraphicBuffer != item.mGraphicBuffer) {
+        return NAME_NOT_FOUND;
+    }
+    return index;
+}
+
+ssize_t RingBufferConsumer::indexOfClosestBufferLocked(nsecs_t timestamp) const {
+    if (mBufferItems.isEmpty()) {
+        return NAME_NOT_FOUND;
     }
 
-    if (it == end) {
-        BI_LOGE("Failed to pin buffer (timestamp %" PRId64 ", framenumber %" PRIu64 ")",
-                 item.mTimestamp, item.mFrameNumber);
-    } else {
-        BI_LOGV("Pinned buffer (frame %" PRIu64 ", timestamp %" PRId64 ")",
-                item.mFrameNumber, item.mTimestamp);
+    // Find the first buffer newer than the timestamp; the one before it is
+    // either an exact match or the closest older buffer.
+    size_t lo = 0;
+    size_t hi = mBufferItems.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mBufferItems.keyAt(mid) <= timestamp) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
+
+    return lo > 0 ? lo - 1 : 0;
 }
 
 status_t RingBufferConsumer::releaseOldestBufferLocked(size_t* pinnedFrames) {
     status_t err = OK;
 
-    List<RingBufferItem>::iterator it, end, accIt;
-
-    it = mBufferItemList.begin();
-    end = mBufferItemList.end();
-    accIt = end;
-
-    if (it == end) {
+    if (mBufferItems.isEmpty()) {
         /**
          * This is fine. We really care about being able to acquire a buffer
          * successfully after this function completes, not about it releasing
@@ -204,24 +244,20 @@ status_t RingBufferConsumer::releaseOldestBufferLocked(size_t* pinnedFrames) {
         return NOT_ENOUGH_DATA;
     }
 
-    for (; it != end; ++it) {
-        RingBufferItem& find = *it;
-
-        if (find.mPinCount > 0) {
-            if (pinnedFrames != NULL) {
-                ++(*pinnedFrames);
-            }
-            // Filter out pinned frame when searching for buffer to release
-            continue;
+    // Buffers are sorted by timestamp, so the first one that isn't pinned is
+    // the oldest
+    size_t index = 0;
+    for (; index < mBufferItems.size(); ++index) {
+        if (mBufferItems.valueAt(index).mPinCount == 0) {
+            break;
         }
-
-        if (find.mTimestamp < accIt->mTimestamp || accIt == end) {
-            accIt = it;
+        if (pinnedFrames != NULL) {
+            ++(*pinnedFrames);
         }
     }
 
-    if (accIt != end) {
-        RingBufferItem& item = *accIt;
+    if (index < mBufferItems.size()) {
+        const RingBufferItem& item = mBufferItems.valueAt(index);
 
         // In case the object was never pinned, pass the acquire fence
         // back to the release fence. If the fence was already waited on,
@@ -256,9 +292,9 @@ status_t RingBufferConsumer::releaseOldestBufferLocked(size_t* pinnedFrames) {
         BI_LOGV("Buffer timestamp %" PRId64 ", frame %" PRIu64 " evicted",
                 item.mTimestamp, item.mFrameNumber);
 
-        size_t currentSize = mBufferItemList.size();
-        mBufferItemList.erase(accIt);
-        assert(mBufferItemList.size() == currentSize - 1);
+        size_t currentSize = mBufferItems.size();
+        mBufferItems.removeItemsAt(index);
+        assert(mBufferItems.size() == currentSize - 1);
     } else {
         BI_LOGW("All buffers pinned, could not find any to release");
         return NO_BUFFER_AVAILABLE;
@@ -277,7 +313,7 @@ void RingBufferConsumer::onFrameAvailable() {
         /**
          * Release oldest frame
          */
-        if (mBufferItemList.size() >= (size_t)mBufferCount) {
+        if (mBufferItems.size() >= (size_t)mBufferCount) {
             err = releaseOldestBufferLocked(/*pinnedFrames*/NULL);
             assert(err != NOT_ENOUGH_DATA);
 
@@ -290,8 +326,7 @@ void RingBufferConsumer::onFrameAvailable() {
             // we could've locked but didn't because there was no space
         }
 
-        RingBufferItem& item = *mBufferItemList.insert(mBufferItemList.end(),
-                                                       RingBufferItem());
+        RingBufferItem item;
 
         /**
          * Acquire new frame
@@ -302,14 +337,40 @@ void RingBufferConsumer::onFrameAvailable() {
                 BI_LOGE("Error acquiring buffer: %s (%d)", strerror(err), err);
             }
 
-            mBufferItemList.erase(--mBufferItemList.end());
             return;
         }
 
+        item.mGraphicBuffer = mSlots[item.mBuf].mGraphicBuffer;
+
+        /**
+         * Buffers are looked up by timestamp, so a second buffer with the
+         * same timestamp can't be told apart from the first; give it back.
+         */
+        if (mBufferItems.indexOfKey(item.mTimestamp) >= 0) {
+            BI_LOGE("Buffer with timestamp %" PRId64 " is already in the ring "
+                    "buffer, dropping frame %" PRIu64,
+                    item.mTimestamp, item.mFrameNumber);
+
+            err = addReleaseFenceLocked(item.mBuf,
+                    item.mGraphicBuffer, item.mFence);
+            if (err == OK) {
+                err = releaseBufferLocked(item.mBuf, item.mGraphicBuffer,
+                                          EGL_NO_DISPLAY,
+                                          EGL_NO_SYNC_KHR);
+            }
+            if (err != OK) {
+                BI_LOGE("Failed to release buffer: %s (%d)",
+                        strerror(-err), err);
+            }
+            return;
+        }
+
+        mBufferItems.add(item.mTimestamp, item);
+
         BI_LOGV("New buffer acquired (timestamp %" PRId64 "), "
                 "buffer items %zu out of %d",
                 item.mTimestamp,
-                mBufferItemList.size(), mBufferCount);
+                mBufferItems.size(), mBufferCount);
 
         if (item.mTimestamp < mLatestTimestamp) {
             BI_LOGE("Timestamp  decreases from %" PRId64 " to %" PRId64,
@@ -317,8 +378,6 @@ void RingBufferConsumer::onFrameAvailable() {
         }
 
         mLatestTimestamp = item.mTimestamp;
-
-        item.mGraphicBuffer = mSlots[item.mBuf].mGraphicBuffer;
     } // end of mMutex lock
 
     ConsumerBase::onFrameAvailable();
@@ -327,37 +386,29 @@ void RingBufferConsumer::onFrameAvailable() {
 void RingBufferConsumer::unpinBuffer(const BufferItem& item) {
     Mutex::Autolock _l(mMutex);
 
-    List<RingBufferItem>::iterator it, end, accIt;
+    ssize_t index = indexOfBufferLocked(item);
 
-    for (it = mBufferItemList.begin(), end = mBufferItemList.end();
-         it != end;
-         ++it) {
-
-        RingBufferItem& find = *it;
-        if (item.mGraphicBuffer == find.mGraphicBuffer) {
-            status_t res = addReleaseFenceLocked(item.mBuf,
-                    item.mGraphicBuffer, item.mFence);
-
-            if (res != OK) {
-                BI_LOGE("Failed to add release fence to buffer "
-                        "(timestamp %" PRId64 ", framenumber %" PRIu64,
-                        item.mTimestamp, item.mFrameNumber);
-                return;
-            }
-
-            find.mPinCount--;
-            break;
-        }
-    }
-
-    if (it == end) {
+    if (index < 0) {
         // This should never happen. If it happens, we have a bug.
         BI_LOGE("Failed to unpin buffer (timestamp %" PRId64 ", framenumber %" PRIu64 ")",
                  item.mTimestamp, item.mFrameNumber);
-    } else {
-        BI_LOGV("Unpinned buffer (timestamp %" PRId64 ", framenumber %" PRIu64 ")",
-                 item.mTimestamp, item.mFrameNumber);
+        return;
     }
+
+    status_t res = addReleaseFenceLocked(item.mBuf,
+            item.mGraphicBuffer, item.mFence);
+
+    if (res != OK) {
+        BI_LOGE("Failed to add release fence to buffer "
+                "(timestamp %" PRId64 ", framenumber %" PRIu64,
+                item.mTimestamp, item.mFrameNumber);
+        return;
+    }
+
+    mBufferItems.editValueAt(index).mPinCount--;
+
+    BI_LOGV("Unpinned buffer (timestamp %" PRId64 ", framenumber %" PRIu64 ")",
+             item.mTimestamp, item.mFrameNumber);
 }
 
 status_t RingBufferConsumer::setDefaultBufferSize(uint32_t w, uint32_t h) {
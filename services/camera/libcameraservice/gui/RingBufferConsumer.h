@@ -21,10 +21,10 @@
 
 #include <ui/GraphicBuffer.h>
 
+#include <utils/KeyedVector.h>
 #include <utils/String8.h>
 #include <utils/Vector.h>
 #include <utils/threads.h>
-#include <utils/List.h>
 
 #define ANDROID_GRAPHICS_RINGBUFFERCONSUMER_JNI_ID "mRingBufferConsumer"
 
@@ -42,6 +42,8 @@ namespace android {
  * that during its duration it will not be released back into the BufferQueue).
  *
  * Note that the 'oldest' buffer is the one with the smallest timestamp.
+ * The ring buffer is kept sorted by timestamp, so buffers can be looked up
+ * by timestamp without scanning it.
  *
  * Edge cases:
  *  - If ringbuffer is not full, no drops occur when a buffer is produced.
@@ -156,6 +158,15 @@ class RingBufferConsumer : public ConsumerBase,
     sp<PinnedBufferItem> pinSelectedBuffer(const RingBufferComparator& filter,
                                            bool waitForFence = true);
 
+    // Find the buffer with the given timestamp, then pin it before returning
+    // it. If there is no such buffer, the closest older one is picked, or the
+    // oldest buffer if they are all newer. Returns NULL only if the ring
+    // buffer is empty.
+    //
+    // Takes a binary search rather than a pass over the ring buffer.
+    sp<PinnedBufferItem> pinBufferByTimestamp(nsecs_t timestamp,
+                                              bool waitForFence = true);
+
     // Release all the non-pinned buffers in the ring buffer
     status_t clear();
 
@@ -167,9 +178,19 @@ class RingBufferConsumer : public ConsumerBase,
     // Override ConsumerBase::onFrameAvailable
     virtual void onFrameAvailable();
 
-    void pinBufferLocked(const BufferItem& item);
+    sp<PinnedBufferItem> pinBufferLocked(size_t index);
     void unpinBuffer(const BufferItem& item);
 
+    void waitForPinnedBuffer(const sp<PinnedBufferItem>& pinnedBuffer,
+                             const char* name);
+
+    // Index of the given buffer in the ring buffer, or NAME_NOT_FOUND
+    ssize_t indexOfBufferLocked(const BufferItem& item) const;
+
+    // Index of the newest buffer no newer than the timestamp, or of the
+    // oldest buffer if there is none. NAME_NOT_FOUND if the ring is empty.
+    ssize_t indexOfClosestBufferLocked(nsecs_t timestamp) const;
+
     // Releases oldest buffer. Returns NO_BUFFER_AVAILABLE
     // if all the buffers were pinned.
     // Returns NOT_ENOUGH_DATA if list was empty.
@@ -180,8 +201,8 @@ class RingBufferConsumer : public ConsumerBase,
         int mPinCount;
     };
 
-    // List of acquired buffers in our ring buffer
-    List<RingBufferItem>       mBufferItemList;
+    // Acquired buffers in our ring buffer, keyed and sorted by timestamp
+    KeyedVector<nsecs_t, RingBufferItem> mBufferItems;
     const int                  mBufferCount;
 
     // Timestamp of latest buffer
@@ -0,0 +1,105 @@
+# Copyright 2014 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH:= $(call my-dir)
+
+#
+# camera3_device_benchmark
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    FakeCamera3Hal.cpp \
+    Camera3DeviceBenchmark.cpp
+
+LOCAL_SHARED_LIBRARIES:= \
+    libcameraservice \
+    libcamera_client \
+    libcamera_metadata \
+    libgui \
+    libui \
+    libhardware \
+    libsync \
+    libutils \
+    libcutils \
+    liblog
+
+LOCAL_C_INCLUDES += \
+    system/media/camera/include \
+    system/media/private/camera/include \
+    frameworks/av/services/camera/libcameraservice
+
+LOCAL_CFLAGS += -Wall -Wextra
+
+LOCAL_MODULE:= camera3_device_benchmark
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
+
+#
+# ring_buffer_consumer_benchmark
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    RingBufferConsumerBenchmark.cpp
+
+LOCAL_SHARED_LIBRARIES:= \
+    libcameraservice \
+    libgui \
+    libui \
+    libhardware \
+    libutils \
+    libcutils \
+    liblog
+
+LOCAL_C_INCLUDES += \
+    frameworks/av/services/camera/libcameraservice
+
+LOCAL_CFLAGS += -Wall -Wextra
+
+LOCAL_MODULE:= ring_buffer_consumer_benchmark
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
+
+#
+# jpeg_compressor_benchmark
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    JpegCompressorBenchmark.cpp
+
+LOCAL_SHARED_LIBRARIES:= \
+    libcameraservice \
+    libgui \
+    libutils \
+    libcutils \
+    liblog \
+    libjpeg
+
+LOCAL_C_INCLUDES += \
+    external/jpeg \
+    frameworks/av/services/camera/libcameraservice
+
+LOCAL_CFLAGS += -Wall -Wextra
+
+LOCAL_MODULE:= jpeg_compressor_benchmark
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "Camera3DeviceBenchmark"
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <gui/BufferItemConsumer.h>
+#include <gui/BufferQueue.h>
+#include <gui/Surface.h>
+#include <hardware/gralloc.h>
+#include <utils/Vector.h>
+
+#include "device3/Camera3Device.h"
+#include "FakeCamera3Hal.h"
+
+// Streams a repeating request through Camera3Device on top of the fake
+// camera HAL at each of the given frame rates, and reports how long results
+// take from the HAL receiving the request to the client getting the result,
+// how long the framework takes to deliver a result once the HAL has sent it,
+// and how much CPU time the process spends per frame.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-r <frame rates, comma separated>]\n"
+                    "\t\t[-s <number of streams, 1-3>]\n"
+                    "\t\t[-n <frames per frame rate>]\n"
+                    "\t\t[-l <HAL result latency in ms>]\n"
+                    "\t\t[-d <HAL pipeline depth>]\n"
+                    "\t\t[-p <partial results per frame>]\n"
+                    "\t\t[-f(ill buffers)]\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+static const size_t kWarmupFrames = 10;
+static const nsecs_t kResultTimeout = 1000000000ll; // 1 s
+
+/**
+ * Releases every buffer as soon as it is queued, like a consumer that keeps
+ * up with the camera.
+ */
+class DrainingConsumer : public BufferItemConsumer::FrameAvailableListener {
+  public:
+    DrainingConsumer(const sp<BufferItemConsumer> &consumer) :
+            mConsumer(consumer) {}
+
+    virtual void onFrameAvailable() {
+        BufferItemConsumer::BufferItem item;
+        while (mConsumer->acquireBuffer(&item, 0) == OK) {
+            mConsumer->releaseBuffer(item);
+        }
+    }
+
+  private:
+    sp<BufferItemConsumer> mConsumer;
+};
+
+struct StreamInfo {
+    int format;
+    uint32_t usage;
+    int32_t sizeDivisor;
+    const char *name;
+};
+
+// Preview, an app-readable YUV stream and video recording
+static const StreamInfo kStreams[] = {
+    { HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED, GRALLOC_USAGE_HW_TEXTURE, 1,
+            "preview" },
+    { HAL_PIXEL_FORMAT_YCbCr_420_888, GRALLOC_USAGE_SW_READ_OFTEN, 2,
+            "yuv" },
+    { HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED, GRALLOC_USAGE_HW_VIDEO_ENCODER, 1,
+            "video" },
+};
+static const size_t kMaxStreams = sizeof(kStreams) / sizeof(kStreams[0]);
+
+struct BenchResult {
+    int64_t mElapsedTimeNs;
+    int64_t mCpuTimeNs;
+    Vector<int64_t> mLatenciesNs;
+    Vector<int64_t> mDeliveryTimesNs;
+};
+
+static nsecs_t cpuTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static status_t runBenchmark(
+        const FakeCamera3Config &config,
+        size_t numStreams,
+        size_t numFrames,
+        BenchResult *result) {
+    sp<Camera3Device> device = new Camera3Device(0);
+    status_t res = device->initialize(getFakeCamera3Module(config));
+    if (res != OK) {
+        fprintf(stderr, "unable to initialize the device (err=%d)\n", res);
+        return res;
+    }
+
+    Vector<sp<BufferItemConsumer> > consumers;
+    Vector<int32_t> streamIds;
+    for (size_t i = 0; i < numStreams; i++) {
+        const StreamInfo &info = kStreams[i];
+
+        sp<IGraphicBufferProducer> producer;
+        sp<IGraphicBufferConsumer> consumer;
+        BufferQueue::createBufferQueue(&producer, &consumer);
+        sp<BufferItemConsumer> itemConsumer =
+                new BufferItemConsumer(consumer, info.usage, 1);
+        itemConsumer->setName(String8::format("Camera3DeviceBenchmark-%s",
+                info.name));
+        itemConsumer->setFrameAvailableListener(
+                new DrainingConsumer(itemConsumer));
+        consumers.push(itemConsumer);
+
+        int streamId;
+        res = device->createStream(new Surface(producer),
+                config.width / info.sizeDivisor,
+                config.height / info.sizeDivisor,
+                info.format, &streamId);
+        if (res != OK) {
+            fprintf(stderr, "unable to create the %s stream (err=%d)\n",
+                    info.name, res);
+            device->disconnect();
+            return res;
+        }
+        streamIds.push(streamId);
+    }
+
+    CameraMetadata request;
+    res = device->createDefaultRequest(CAMERA3_TEMPLATE_PREVIEW, &request);
+    if (res == OK) {
+        const int32_t requestId = 1;
+        request.update(ANDROID_REQUEST_ID, &requestId, 1);
+        request.update(ANDROID_REQUEST_OUTPUT_STREAMS,
+                streamIds.array(), streamIds.size());
+        res = device->setStreamingRequest(request);
+    }
+    if (res != OK) {
+        fprintf(stderr, "unable to start streaming (err=%d)\n", res);
+        device->disconnect();
+        return res;
+    }
+
+    size_t numResults = 0;
+    nsecs_t startTimeNs = 0;
+    nsecs_t startCpuTimeNs = 0;
+
+    while (res == OK && numResults < kWarmupFrames + numFrames) {
+        res = device->waitForNextFrame(kResultTimeout);
+        if (res != OK) {
+            fprintf(stderr, "timed out waiting for results (err=%d)\n", res);
+            break;
+        }
+
+        sp<CaptureResult> captureResult;
+        while (device->getNextResult(&captureResult) == OK) {
+            nsecs_t now = systemTime();
+
+            // Skip the early 3A-only results
+            camera_metadata_entry_t entry =
+                    captureResult->mMetadata.find(ANDROID_SENSOR_TIMESTAMP);
+            if (entry.count == 0) continue;
+            nsecs_t timestamp = entry.data.i64[0];
+
+            entry = captureResult->mMetadata.find(ANDROID_REQUEST_FRAME_COUNT);
+            if (entry.count == 0) continue;
+            uint32_t frameNumber = entry.data.i32[0];
+
+            numResults++;
+            if (numResults == kWarmupFrames) {
+                startTimeNs = now;
+                startCpuTimeNs = cpuTime();
+            } else if (numResults > kWarmupFrames) {
+                nsecs_t requestTime = getFakeCamera3RequestTime(frameNumber);
+                if (requestTime >= 0) {
+                    result->mLatenciesNs.push(now - requestTime);
+                }
+                result->mDeliveryTimesNs.push(
+                        now - (timestamp + config.resultLatencyNs));
+            }
+        }
+    }
+
+    result->mElapsedTimeNs = systemTime() - startTimeNs;
+    result->mCpuTimeNs = cpuTime() - startCpuTimeNs;
+
+    device->clearStreamingRequest();
+    device->waitUntilDrained();
+    device->disconnect();
+
+    return res;
+}
+
+static int compareTimes(const int64_t *a, const int64_t *b) {
+    return *a < *b ? -1 : (*a > *b ? 1 : 0);
+}
+
+static void printTimes(const char *name, Vector<int64_t> &timesNs) {
+    size_t n = timesNs.size();
+    if (n == 0) {
+        printf("\t%s: no samples\n", name);
+        return;
+    }
+
+    timesNs.sort(compareTimes);
+
+    int64_t totalNs = 0ll;
+    for (size_t i = 0; i < n; ++i) {
+        totalNs += timesNs.itemAt(i);
+    }
+
+    printf("\t%s avg %.2f ms, median %.2f ms, 95%% %.2f ms, "
+           "99%% %.2f ms, max %.2f ms\n",
+           name,
+           totalNs / 1E6 / n,
+           timesNs.itemAt(n / 2) / 1E6,
+           timesNs.itemAt(n * 95 / 100) / 1E6,
+           timesNs.itemAt(n * 99 / 100) / 1E6,
+           timesNs.itemAt(n - 1) / 1E6);
+}
+
+static void printResult(int32_t frameRate, BenchResult *result) {
+    size_t numFrames = result->mDeliveryTimesNs.size();
+    if (numFrames == 0) {
+        printf("%d fps: no frames\n", frameRate);
+        return;
+    }
+
+    printf("%d fps: %zu frames at %.2f fps, cpu %.3f ms/frame\n",
+           frameRate, numFrames, numFrames * 1E9 / result->mElapsedTimeNs,
+           result->mCpuTimeNs / 1E6 / numFrames);
+    printTimes("request to result", result->mLatenciesNs);
+    printTimes("result delivery  ", result->mDeliveryTimesNs);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    const char *frameRateList = "30,60,120,240";
+    int numStreams = 2;
+    int numFrames = 600;
+    int latencyMs = 20;
+    int pipelineDepth = 8;
+    int partialResultCount = 2;
+    bool fillBuffers = false;
+
+    int res;
+    while ((res = getopt(argc, argv, "hr:s:n:l:d:p:f")) >= 0) {
+        switch (res) {
+            case 'r':
+                frameRateList = optarg;
+                break;
+
+            case 's':
+                numStreams = atoi(optarg);
+                break;
+
+            case 'n':
+                numFrames = atoi(optarg);
+                break;
+
+            case 'l':
+                latencyMs = atoi(optarg);
+                break;
+
+            case 'd':
+                pipelineDepth = atoi(optarg);
+                break;
+
+            case 'p':
+                partialResultCount = atoi(optarg);
+                break;
+
+            case 'f':
+                fillBuffers = true;
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    Vector<int32_t> frameRates;
+    for (const char *s = frameRateList; *s != '\0';) {
+        char *end;
+        long frameRate = strtol(s, &end, 10);
+        if (end == s || frameRate <= 0 || (*end != ',' && *end != '\0')) {
+            usage(me);
+        }
+        frameRates.push(frameRate);
+        s = (*end == ',') ? end + 1 : end;
+    }
+
+    if (frameRates.isEmpty() || numStreams < 1
+            || numStreams > (int)kMaxStreams || numFrames <= 0
+            || latencyMs < 0 || pipelineDepth < 1 || partialResultCount < 1
+            || partialResultCount > FakeCamera3Config::kMaxPartialResultCount) {
+        usage(me);
+    }
+
+    for (size_t i = 0; i < frameRates.size(); ++i) {
+        FakeCamera3Config config;
+        config.frameDurationNs = 1000000000ll / frameRates[i];
+        config.resultLatencyNs = latencyMs * 1000000ll;
+        config.pipelineDepth = pipelineDepth;
+        config.partialResultCount = partialResultCount;
+        config.fillBuffers = fillBuffers;
+
+        BenchResult result;
+        if (runBenchmark(config, numStreams, numFrames, &result) != OK) {
+            return 1;
+        }
+
+        printResult(frameRates[i], &result);
+    }
+
+    return 0;
+}
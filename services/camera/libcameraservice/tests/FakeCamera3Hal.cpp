@@ -0,0 +1,777 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FakeCamera3Hal"
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include "FakeCamera3Hal.h"
+
+#include <camera/CameraMetadata.h>
+#include <hardware/gralloc.h>
+#include <sync/sync.h>
+#include <ui/GraphicBufferMapper.h>
+#include <ui/Rect.h>
+#include <utils/Condition.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+#include <utils/Thread.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+FakeCamera3Config::FakeCamera3Config() :
+        width(1920),
+        height(1080),
+        frameDurationNs(33333333ll),
+        resultLatencyNs(50000000ll),
+        partialResultCount(2),
+        pipelineDepth(6),
+        fillBuffers(false) {
+}
+
+static Mutex sLock;
+static FakeCamera3Config sConfig;
+static camera_metadata_t *sStaticInfo = NULL;
+
+struct RequestTime {
+    uint32_t frameNumber;
+    nsecs_t time;
+};
+static RequestTime sRequestTimes[kRequestTimeHistory];
+
+static void setRequestTime(uint32_t frameNumber, nsecs_t time) {
+    Mutex::Autolock l(sLock);
+    RequestTime &entry = sRequestTimes[frameNumber % kRequestTimeHistory];
+    entry.frameNumber = frameNumber;
+    entry.time = time;
+}
+
+nsecs_t getFakeCamera3RequestTime(uint32_t frameNumber) {
+    Mutex::Autolock l(sLock);
+    const RequestTime &entry = sRequestTimes[frameNumber % kRequestTimeHistory];
+    if (entry.frameNumber != frameNumber || entry.time == 0) {
+        return -1;
+    }
+    return entry.time;
+}
+
+/**
+ * Builds the static characteristics for the given configuration: every
+ * format at the full size, half size, VGA and QVGA, all at the configured
+ * frame rate.
+ */
+static camera_metadata_t *buildStaticInfo(const FakeCamera3Config &config) {
+    CameraMetadata info;
+
+    const int32_t sizes[] = {
+        config.width, config.height,
+        config.width / 2, config.height / 2,
+        640, 480,
+        320, 240,
+    };
+    const int32_t formats[] = {
+        HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED,
+        HAL_PIXEL_FORMAT_YCbCr_420_888,
+        HAL_PIXEL_FORMAT_BLOB,
+    };
+    const size_t numSizes = sizeof(sizes) / sizeof(sizes[0]) / 2;
+    const size_t numFormats = sizeof(formats) / sizeof(formats[0]);
+
+    Vector<int32_t> streamConfigs;
+    Vector<int64_t> minFrameDurations;
+    for (size_t i = 0; i < numFormats; i++) {
+        for (size_t j = 0; j < numSizes; j++) {
+            streamConfigs.push(formats[i]);
+            streamConfigs.push(sizes[j * 2]);
+            streamConfigs.push(sizes[j * 2 + 1]);
+            streamConfigs.push(ANDROID_SCALER_AVAILABLE_STREAM_CONFIGURATIONS_OUTPUT);
+
+            minFrameDurations.push(formats[i]);
+            minFrameDurations.push(sizes[j * 2]);
+            minFrameDurations.push(sizes[j * 2 + 1]);
+            minFrameDurations.push(config.frameDurationNs);
+        }
+    }
+    info.update(ANDROID_SCALER_AVAILABLE_STREAM_CONFIGURATIONS,
+            streamConfigs.array(), streamConfigs.size());
+    info.update(ANDROID_SCALER_AVAILABLE_MIN_FRAME_DURATIONS,
+            minFrameDurations.array(), minFrameDurations.size());
+
+    const int32_t activeArray[] = { 0, 0, config.width, config.height };
+    info.update(ANDROID_SENSOR_INFO_ACTIVE_ARRAY_SIZE, activeArray, 4);
+
+    const int32_t jpegMaxSize = config.width * config.height * 3 / 2;
+    info.update(ANDROID_JPEG_MAX_SIZE, &jpegMaxSize, 1);
+
+    info.update(ANDROID_REQUEST_PARTIAL_RESULT_COUNT,
+            &config.partialResultCount, 1);
+
+    const uint8_t pipelineDepth = config.pipelineDepth;
+    info.update(ANDROID_REQUEST_PIPELINE_MAX_DEPTH, &pipelineDepth, 1);
+
+    const int32_t fps = s2ns(1) / config.frameDurationNs;
+    const int32_t fpsRanges[] = { fps, fps };
+    info.update(ANDROID_CONTROL_AE_AVAILABLE_TARGET_FPS_RANGES, fpsRanges, 2);
+
+    const uint8_t facing = ANDROID_LENS_FACING_BACK;
+    info.update(ANDROID_LENS_FACING, &facing, 1);
+
+    const int32_t orientation = 90;
+    info.update(ANDROID_SENSOR_ORIENTATION, &orientation, 1);
+
+    const uint8_t hardwareLevel = ANDROID_INFO_SUPPORTED_HARDWARE_LEVEL_LIMITED;
+    info.update(ANDROID_INFO_SUPPORTED_HARDWARE_LEVEL, &hardwareLevel, 1);
+
+    const uint8_t capabilities =
+            ANDROID_REQUEST_AVAILABLE_CAPABILITIES_BACKWARD_COMPATIBLE;
+    info.update(ANDROID_REQUEST_AVAILABLE_CAPABILITIES, &capabilities, 1);
+
+    info.sort();
+    return info.release();
+}
+
+/**
+ * Fake camera device
+ */
+
+class FakeCamera3Device : public camera3_device_t {
+  public:
+    FakeCamera3Device(const hw_module_t *module,
+            const FakeCamera3Config &config);
+    ~FakeCamera3Device();
+
+    int initialize(const camera3_callback_ops_t *callbackOps);
+    int configureStreams(camera3_stream_configuration_t *streamList);
+    const camera_metadata_t *constructDefaultRequestSettings(int type);
+    int processCaptureRequest(camera3_capture_request_t *request);
+    int flush();
+    int close();
+
+  private:
+    struct Capture {
+        uint32_t frameNumber;
+        int32_t requestId;
+        nsecs_t shutterTime;
+        bool shutterSent;
+        Vector<camera3_stream_buffer_t> buffers;
+    };
+
+    class ResultThread : public Thread {
+      public:
+        ResultThread(FakeCamera3Device *parent) :
+                Thread(false), mParent(parent) {}
+      private:
+        virtual bool threadLoop() { return mParent->threadLoop(); }
+        FakeCamera3Device *mParent;
+    };
+
+    bool threadLoop();
+
+    void sendShutter(const Capture &capture);
+    void sendPartialResults(const Capture &capture);
+    void sendFinalResult(Capture &capture);
+    void sendError(Capture &capture);
+    void fillBuffer(const camera3_stream_buffer_t &buffer, uint32_t frameNumber);
+
+    static const nsecs_t kWaitDuration = 50000000; // 50 ms
+    static const int kFenceTimeoutMs = 1000;
+
+    const FakeCamera3Config mConfig;
+    const camera3_callback_ops_t *mCallbackOps;
+
+    // Held while sending callbacks, to keep results in order with flush()
+    Mutex mCallbackLock;
+
+    Mutex mLock;
+    Condition mCaptureAdded;
+    Condition mCaptureDone;
+    List<Capture> mCaptures;
+    int32_t mRequestId;
+    bool mHaveSettings;
+    nsecs_t mNextShutterTime;
+    camera_metadata_t *mDefaultRequests[CAMERA3_TEMPLATE_COUNT];
+
+    sp<ResultThread> mResultThread;
+
+    static camera3_device_ops_t sOps;
+};
+
+static FakeCamera3Device *getDevice(const camera3_device *dev) {
+    return const_cast<FakeCamera3Device*>(
+            static_cast<const FakeCamera3Device*>(dev));
+}
+
+static int sInitialize(const camera3_device *dev,
+        const camera3_callback_ops_t *callbackOps) {
+    return getDevice(dev)->initialize(callbackOps);
+}
+
+static int sConfigureStreams(const camera3_device *dev,
+        camera3_stream_configuration_t *streamList) {
+    return getDevice(dev)->configureStreams(streamList);
+}
+
+static const camera_metadata_t *sConstructDefaultRequestSettings(
+        const camera3_device *dev, int type) {
+    return getDevice(dev)->constructDefaultRequestSettings(type);
+}
+
+static int sProcessCaptureRequest(const camera3_device *dev,
+        camera3_capture_request_t *request) {
+    return getDevice(dev)->processCaptureRequest(request);
+}
+
+static void sDump(const camera3_device * /*dev*/, int /*fd*/) {
+}
+
+static int sFlush(const camera3_device *dev) {
+    return getDevice(dev)->flush();
+}
+
+static int sClose(hw_device_t *device) {
+    FakeCamera3Device *dev = getDevice(
+            reinterpret_cast<camera3_device_t*>(device));
+    int res = dev->close();
+    delete dev;
+    return res;
+}
+
+camera3_device_ops_t FakeCamera3Device::sOps = {
+    sInitialize,                      // initialize
+    sConfigureStreams,                // configure_streams
+    NULL,                             // register_stream_buffers
+    sConstructDefaultRequestSettings, // construct_default_request_settings
+    sProcessCaptureRequest,           // process_capture_request
+    NULL,                             // get_metadata_vendor_tag_ops
+    sDump,                            // dump
+    sFlush,                           // flush
+    { NULL },                         // reserved
+};
+
+FakeCamera3Device::FakeCamera3Device(const hw_module_t *module,
+        const FakeCamera3Config &config) :
+        mConfig(config),
+        mCallbackOps(NULL),
+        mRequestId(0),
+        mHaveSettings(false),
+        mNextShutterTime(0) {
+    memset(static_cast<camera3_device_t*>(this), 0, sizeof(camera3_device_t));
+    common.tag = HARDWARE_DEVICE_TAG;
+    common.version = CAMERA_DEVICE_API_VERSION_3_2;
+    common.module = const_cast<hw_module_t*>(module);
+    common.close = sClose;
+    ops = &sOps;
+    priv = NULL;
+
+    for (size_t i = 0; i < CAMERA3_TEMPLATE_COUNT; i++) {
+        mDefaultRequests[i] = NULL;
+    }
+
+    mResultThread = new ResultThread(this);
+    mResultThread->run("FakeCamera3-Result");
+}
+
+FakeCamera3Device::~FakeCamera3Device() {
+    for (size_t i = 0; i < CAMERA3_TEMPLATE_COUNT; i++) {
+        if (mDefaultRequests[i] != NULL) {
+            free_camera_metadata(mDefaultRequests[i]);
+        }
+    }
+}
+
+int FakeCamera3Device::initialize(const camera3_callback_ops_t *callbackOps) {
+    Mutex::Autolock l(mLock);
+    mCallbackOps = callbackOps;
+    return OK;
+}
+
+int FakeCamera3Device::configureStreams(
+        camera3_stream_configuration_t *streamList) {
+    if (streamList == NULL || streamList->num_streams == 0) {
+        return BAD_VALUE;
+    }
+
+    Mutex::Autolock l(mLock);
+    if (!mCaptures.empty()) {
+        ALOGE("%s: Captures still in flight", __FUNCTION__);
+        return INVALID_OPERATION;
+    }
+
+    for (size_t i = 0; i < streamList->num_streams; i++) {
+        camera3_stream_t *stream = streamList->streams[i];
+        if (stream->stream_type != CAMERA3_STREAM_OUTPUT) {
+            ALOGE("%s: Only output streams are supported", __FUNCTION__);
+            return BAD_VALUE;
+        }
+        stream->usage = GRALLOC_USAGE_HW_CAMERA_WRITE;
+        if (mConfig.fillBuffers) {
+            stream->usage |= GRALLOC_USAGE_SW_WRITE_OFTEN;
+        }
+        stream->max_buffers = mConfig.pipelineDepth;
+    }
+
+    // Settings must be sent again with the first request after configuring
+    mHaveSettings = false;
+    return OK;
+}
+
+const camera_metadata_t *FakeCamera3Device::constructDefaultRequestSettings(
+        int type) {
+    if (type < CAMERA3_TEMPLATE_PREVIEW || type >= CAMERA3_TEMPLATE_COUNT) {
+        return NULL;
+    }
+
+    Mutex::Autolock l(mLock);
+    if (mDefaultRequests[type] != NULL) {
+        return mDefaultRequests[type];
+    }
+
+    CameraMetadata settings;
+
+    uint8_t intent;
+    switch (type) {
+        case CAMERA3_TEMPLATE_STILL_CAPTURE:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_STILL_CAPTURE;
+            break;
+        case CAMERA3_TEMPLATE_VIDEO_RECORD:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_VIDEO_RECORD;
+            break;
+        case CAMERA3_TEMPLATE_VIDEO_SNAPSHOT:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_VIDEO_SNAPSHOT;
+            break;
+        case CAMERA3_TEMPLATE_ZERO_SHUTTER_LAG:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_ZERO_SHUTTER_LAG;
+            break;
+        case CAMERA3_TEMPLATE_MANUAL:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_MANUAL;
+            break;
+        default:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_PREVIEW;
+            break;
+    }
+    settings.update(ANDROID_CONTROL_CAPTURE_INTENT, &intent, 1);
+
+    const uint8_t controlMode = ANDROID_CONTROL_MODE_AUTO;
+    settings.update(ANDROID_CONTROL_MODE, &controlMode, 1);
+    const uint8_t aeMode = ANDROID_CONTROL_AE_MODE_ON;
+    settings.update(ANDROID_CONTROL_AE_MODE, &aeMode, 1);
+    const uint8_t afMode = ANDROID_CONTROL_AF_MODE_CONTINUOUS_PICTURE;
+    settings.update(ANDROID_CONTROL_AF_MODE, &afMode, 1);
+    const uint8_t awbMode = ANDROID_CONTROL_AWB_MODE_AUTO;
+    settings.update(ANDROID_CONTROL_AWB_MODE, &awbMode, 1);
+
+    const int32_t fps = s2ns(1) / mConfig.frameDurationNs;
+    const int32_t fpsRange[] = { fps, fps };
+    settings.update(ANDROID_CONTROL_AE_TARGET_FPS_RANGE, fpsRange, 2);
+    settings.update(ANDROID_SENSOR_FRAME_DURATION, &mConfig.frameDurationNs, 1);
+
+    const uint8_t faceDetectMode = ANDROID_STATISTICS_FACE_DETECT_MODE_OFF;
+    settings.update(ANDROID_STATISTICS_FACE_DETECT_MODE, &faceDetectMode, 1);
+
+    const int32_t cropRegion[] = { 0, 0, mConfig.width, mConfig.height };
+    settings.update(ANDROID_SCALER_CROP_REGION, cropRegion, 4);
+
+    const uint8_t jpegQuality = 95;
+    settings.update(ANDROID_JPEG_QUALITY, &jpegQuality, 1);
+
+    settings.sort();
+    mDefaultRequests[type] = settings.release();
+    return mDefaultRequests[type];
+}
+
+int FakeCamera3Device::processCaptureRequest(
+        camera3_capture_request_t *request) {
+    if (request == NULL || request->num_output_buffers == 0 ||
+            request->input_buffer != NULL) {
+        return BAD_VALUE;
+    }
+
+    setRequestTime(request->frame_number, systemTime());
+
+    Capture capture;
+    capture.frameNumber = request->frame_number;
+    capture.shutterSent = false;
+    capture.buffers.appendArray(request->output_buffers,
+            request->num_output_buffers);
+
+    // Wait for the consumers to be done with the buffers; the HAL owns the
+    // acquire fences from here on.
+    for (size_t i = 0; i < capture.buffers.size(); i++) {
+        camera3_stream_buffer_t &buffer = capture.buffers.editItemAt(i);
+        if (buffer.acquire_fence != -1) {
+            int res = sync_wait(buffer.acquire_fence, kFenceTimeoutMs);
+            if (res != OK) {
+                ALOGE("%s: Timed out waiting on the acquire fence of frame %d",
+                        __FUNCTION__, request->frame_number);
+            }
+            ::close(buffer.acquire_fence);
+            buffer.acquire_fence = -1;
+        }
+        buffer.release_fence = -1;
+        buffer.status = CAMERA3_BUFFER_STATUS_OK;
+    }
+
+    Mutex::Autolock l(mLock);
+
+    if (request->settings != NULL) {
+        camera_metadata_ro_entry_t entry;
+        if (find_camera_metadata_ro_entry(request->settings,
+                ANDROID_REQUEST_ID, &entry) == OK && entry.count > 0) {
+            mRequestId = entry.data.i32[0];
+        }
+        mHaveSettings = true;
+    } else if (!mHaveSettings) {
+        ALOGE("%s: First request of frame %d has no settings", __FUNCTION__,
+                request->frame_number);
+        return BAD_VALUE;
+    }
+    capture.requestId = mRequestId;
+
+    // Like a real pipeline, block the caller until there is room
+    while (mCaptures.size() >= static_cast<size_t>(mConfig.pipelineDepth)) {
+        mCaptureDone.wait(mLock);
+    }
+
+    nsecs_t now = systemTime();
+    capture.shutterTime = (mNextShutterTime > now) ? mNextShutterTime : now;
+    mNextShutterTime = capture.shutterTime + mConfig.frameDurationNs;
+
+    mCaptures.push_back(capture);
+    mCaptureAdded.signal();
+    return OK;
+}
+
+int FakeCamera3Device::flush() {
+    Mutex::Autolock cl(mCallbackLock);
+
+    List<Capture> captures;
+    {
+        Mutex::Autolock l(mLock);
+        captures = mCaptures;
+        mCaptures.clear();
+        mNextShutterTime = 0;
+        mCaptureDone.broadcast();
+    }
+
+    // Captures whose shutter fired complete normally, the rest are dropped
+    for (List<Capture>::iterator it = captures.begin();
+            it != captures.end(); ++it) {
+        if (it->shutterSent) {
+            sendFinalResult(*it);
+        } else {
+            sendError(*it);
+        }
+    }
+    return OK;
+}
+
+int FakeCamera3Device::close() {
+    flush();
+
+    mResultThread->requestExit();
+    {
+        Mutex::Autolock l(mLock);
+        mCaptureAdded.signal();
+    }
+    mResultThread->join();
+    mResultThread.clear();
+    return OK;
+}
+
+bool FakeCamera3Device::threadLoop() {
+    {
+        Mutex::Autolock l(mLock);
+        if (mCaptures.empty()) {
+            mCaptureAdded.waitRelative(mLock, kWaitDuration);
+            return true;
+        }
+
+        // Captures complete in order, so the next event is either the first
+        // shutter not yet sent or the final result of the oldest capture
+        nsecs_t nextEventTime = -1;
+        for (List<Capture>::iterator it = mCaptures.begin();
+                it != mCaptures.end(); ++it) {
+            if (!it->shutterSent) {
+                nextEventTime = it->shutterTime;
+                break;
+            }
+        }
+        const Capture &oldest = *mCaptures.begin();
+        if (oldest.shutterSent) {
+            nsecs_t resultTime = oldest.shutterTime + mConfig.resultLatencyNs;
+            if (nextEventTime < 0 || resultTime < nextEventTime) {
+                nextEventTime = resultTime;
+            }
+        }
+
+        nsecs_t now = systemTime();
+        if (nextEventTime > now) {
+            mCaptureAdded.waitRelative(mLock, nextEventTime - now);
+            return true;
+        }
+    }
+
+    Mutex::Autolock cl(mCallbackLock);
+    Capture capture;
+    bool finalResult = false;
+    {
+        Mutex::Autolock l(mLock);
+        // flush() may have taken the captures meanwhile
+        if (mCaptures.empty()) return true;
+
+        nsecs_t now = systemTime();
+        List<Capture>::iterator oldest = mCaptures.begin();
+        if (oldest->shutterSent &&
+                oldest->shutterTime + mConfig.resultLatencyNs <= now) {
+            capture = *oldest;
+            mCaptures.erase(oldest);
+            mCaptureDone.broadcast();
+            finalResult = true;
+        } else {
+            List<Capture>::iterator it = mCaptures.begin();
+            while (it != mCaptures.end() && it->shutterSent) ++it;
+            if (it == mCaptures.end() || it->shutterTime > now) return true;
+            it->shutterSent = true;
+            capture.frameNumber = it->frameNumber;
+            capture.requestId = it->requestId;
+            capture.shutterTime = it->shutterTime;
+        }
+    }
+
+    if (finalResult) {
+        sendFinalResult(capture);
+    } else {
+        sendShutter(capture);
+        sendPartialResults(capture);
+    }
+    return true;
+}
+
+void FakeCamera3Device::sendShutter(const Capture &capture) {
+    camera3_notify_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = CAMERA3_MSG_SHUTTER;
+    msg.message.shutter.frame_number = capture.frameNumber;
+    msg.message.shutter.timestamp = capture.shutterTime;
+    mCallbackOps->notify(mCallbackOps, &msg);
+}
+
+void FakeCamera3Device::sendPartialResults(const Capture &capture) {
+    // Tags sent in the partial results between the 3A one and the final one
+    static const uint32_t kPartialTags[] = {
+        ANDROID_LENS_FOCUS_DISTANCE,
+        ANDROID_LENS_APERTURE,
+        ANDROID_LENS_FOCAL_LENGTH,
+        ANDROID_LENS_FILTER_DENSITY,
+    };
+
+    for (int32_t partial = 1; partial < mConfig.partialResultCount; partial++) {
+        CameraMetadata metadata;
+        if (partial == 1) {
+            const uint8_t afMode = ANDROID_CONTROL_AF_MODE_CONTINUOUS_PICTURE;
+            metadata.update(ANDROID_CONTROL_AF_MODE, &afMode, 1);
+            const uint8_t awbMode = ANDROID_CONTROL_AWB_MODE_AUTO;
+            metadata.update(ANDROID_CONTROL_AWB_MODE, &awbMode, 1);
+            const uint8_t aeState = ANDROID_CONTROL_AE_STATE_CONVERGED;
+            metadata.update(ANDROID_CONTROL_AE_STATE, &aeState, 1);
+            const uint8_t afState = ANDROID_CONTROL_AF_STATE_PASSIVE_FOCUSED;
+            metadata.update(ANDROID_CONTROL_AF_STATE, &afState, 1);
+            const uint8_t awbState = ANDROID_CONTROL_AWB_STATE_CONVERGED;
+            metadata.update(ANDROID_CONTROL_AWB_STATE, &awbState, 1);
+        } else {
+            const float value = 1.0f;
+            metadata.update(kPartialTags[partial - 2], &value, 1);
+        }
+
+        camera3_capture_result_t result;
+        memset(&result, 0, sizeof(result));
+        result.frame_number = capture.frameNumber;
+        result.result = metadata.getAndLock();
+        result.partial_result = partial;
+        mCallbackOps->process_capture_result(mCallbackOps, &result);
+        metadata.unlock(result.result);
+    }
+}
+
+void FakeCamera3Device::sendFinalResult(Capture &capture) {
+    CameraMetadata metadata;
+
+    metadata.update(ANDROID_SENSOR_TIMESTAMP, &capture.shutterTime, 1);
+    metadata.update(ANDROID_REQUEST_ID, &capture.requestId, 1);
+    const int64_t exposureTime = mConfig.frameDurationNs / 2;
+    metadata.update(ANDROID_SENSOR_EXPOSURE_TIME, &exposureTime, 1);
+    metadata.update(ANDROID_SENSOR_FRAME_DURATION, &mConfig.frameDurationNs, 1);
+    const int32_t sensitivity = 100;
+    metadata.update(ANDROID_SENSOR_SENSITIVITY, &sensitivity, 1);
+    const uint8_t pipelineDepth = mConfig.pipelineDepth;
+    metadata.update(ANDROID_REQUEST_PIPELINE_DEPTH, &pipelineDepth, 1);
+    const uint8_t lensState = ANDROID_LENS_STATE_STATIONARY;
+    metadata.update(ANDROID_LENS_STATE, &lensState, 1);
+    const uint8_t faceDetectMode = ANDROID_STATISTICS_FACE_DETECT_MODE_OFF;
+    metadata.update(ANDROID_STATISTICS_FACE_DETECT_MODE, &faceDetectMode, 1);
+    const int32_t cropRegion[] = { 0, 0, mConfig.width, mConfig.height };
+    metadata.update(ANDROID_SCALER_CROP_REGION, cropRegion, 4);
+
+    if (mConfig.partialResultCount == 1) {
+        // No partial results, so the 3A state goes here
+        const uint8_t aeState = ANDROID_CONTROL_AE_STATE_CONVERGED;
+        metadata.update(ANDROID_CONTROL_AE_STATE, &aeState, 1);
+        const uint8_t afState = ANDROID_CONTROL_AF_STATE_PASSIVE_FOCUSED;
+        metadata.update(ANDROID_CONTROL_AF_STATE, &afState, 1);
+        const uint8_t awbState = ANDROID_CONTROL_AWB_STATE_CONVERGED;
+        metadata.update(ANDROID_CONTROL_AWB_STATE, &awbState, 1);
+    }
+
+    if (mConfig.fillBuffers) {
+        for (size_t i = 0; i < capture.buffers.size(); i++) {
+            fillBuffer(capture.buffers[i], capture.frameNumber);
+        }
+    }
+
+    camera3_capture_result_t result;
+    memset(&result, 0, sizeof(result));
+    result.frame_number = capture.frameNumber;
+    result.result = metadata.getAndLock();
+    result.num_output_buffers = capture.buffers.size();
+    result.output_buffers = capture.buffers.array();
+    result.partial_result = mConfig.partialResultCount;
+    mCallbackOps->process_capture_result(mCallbackOps, &result);
+    metadata.unlock(result.result);
+}
+
+void FakeCamera3Device::sendError(Capture &capture) {
+    camera3_notify_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = CAMERA3_MSG_ERROR;
+    msg.message.error.frame_number = capture.frameNumber;
+    msg.message.error.error_code = CAMERA3_MSG_ERROR_REQUEST;
+    mCallbackOps->notify(mCallbackOps, &msg);
+
+    for (size_t i = 0; i < capture.buffers.size(); i++) {
+        capture.buffers.editItemAt(i).status = CAMERA3_BUFFER_STATUS_ERROR;
+    }
+
+    camera3_capture_result_t result;
+    memset(&result, 0, sizeof(result));
+    result.frame_number = capture.frameNumber;
+    result.num_output_buffers = capture.buffers.size();
+    result.output_buffers = capture.buffers.array();
+    mCallbackOps->process_capture_result(mCallbackOps, &result);
+}
+
+void FakeCamera3Device::fillBuffer(const camera3_stream_buffer_t &buffer,
+        uint32_t frameNumber) {
+    const camera3_stream_t *stream = buffer.stream;
+    // BLOB buffers are one row of bytes
+    uint32_t height = (stream->format == HAL_PIXEL_FORMAT_BLOB) ?
+            1 : stream->height;
+
+    void *data = NULL;
+    status_t res = GraphicBufferMapper::get().lock(*buffer.buffer,
+            GRALLOC_USAGE_SW_WRITE_OFTEN, Rect(stream->width, height), &data);
+    if (res != OK || data == NULL) {
+        ALOGV("%s: Unable to lock buffer of frame %d", __FUNCTION__,
+                frameNumber);
+        return;
+    }
+    // A single row is enough to touch the buffer without dominating the CPU
+    // time of the benchmark
+    memset(data, frameNumber & 0xFF, stream->width);
+    GraphicBufferMapper::get().unlock(*buffer.buffer);
+}
+
+/**
+ * Module methods
+ */
+
+static int sGetNumberOfCameras() {
+    return 1;
+}
+
+static int sGetCameraInfo(int cameraId, struct camera_info *info) {
+    if (cameraId != 0 || info == NULL) {
+        return -EINVAL;
+    }
+
+    Mutex::Autolock l(sLock);
+    if (sStaticInfo == NULL) {
+        sStaticInfo = buildStaticInfo(sConfig);
+    }
+    memset(info, 0, sizeof(*info));
+    info->facing = CAMERA_FACING_BACK;
+    info->orientation = 90;
+    info->device_version = CAMERA_DEVICE_API_VERSION_3_2;
+    info->static_camera_characteristics = sStaticInfo;
+    return OK;
+}
+
+static int sOpenDevice(const hw_module_t *module, const char *id,
+        hw_device_t **device) {
+    if (id == NULL || strcmp(id, "0") != 0 || device == NULL) {
+        return -EINVAL;
+    }
+
+    FakeCamera3Config config;
+    {
+        Mutex::Autolock l(sLock);
+        config = sConfig;
+    }
+    FakeCamera3Device *dev = new FakeCamera3Device(module, config);
+    *device = &dev->common;
+    return OK;
+}
+
+static hw_module_methods_t sModuleMethods = {
+    sOpenDevice, // open
+};
+
+static camera_module_t sModule;
+
+camera_module_t *getFakeCamera3Module(const FakeCamera3Config &config) {
+    Mutex::Autolock l(sLock);
+
+    sConfig = config;
+    if (sConfig.partialResultCount < 1) {
+        sConfig.partialResultCount = 1;
+    } else if (sConfig.partialResultCount >
+            FakeCamera3Config::kMaxPartialResultCount) {
+        sConfig.partialResultCount = FakeCamera3Config::kMaxPartialResultCount;
+    }
+    if (sConfig.pipelineDepth < 1) {
+        sConfig.pipelineDepth = 1;
+    }
+
+    // Rebuilt on the next get_camera_info. The old buffer is leaked on
+    // purpose, callers may still hold on to it.
+    sStaticInfo = NULL;
+
+    if (sModule.common.methods == NULL) {
+        sModule.common.tag = HARDWARE_MODULE_TAG;
+        sModule.common.module_api_version = CAMERA_MODULE_API_VERSION_2_2;
+        sModule.common.hal_api_version = HARDWARE_HAL_API_VERSION;
+        sModule.common.id = CAMERA_HARDWARE_MODULE_ID;
+        sModule.common.name = "Fake camera3 HAL";
+        sModule.common.author = "The Android Open Source Project";
+        sModule.common.methods = &sModuleMethods;
+        sModule.get_number_of_cameras = sGetNumberOfCameras;
+        sModule.get_camera_info = sGetCameraInfo;
+    }
+    return &sModule;
+}
+
+}; // namespace android
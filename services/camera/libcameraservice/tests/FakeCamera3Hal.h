@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SERVERS_CAMERA_TESTS_FAKECAMERA3HAL_H
+#define ANDROID_SERVERS_CAMERA_TESTS_FAKECAMERA3HAL_H
+
+#include <hardware/camera3.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/**
+ * A camera HAL module with a single back-facing HALv3.2 camera that needs no
+ * hardware, so that Camera3Device and the streams behind it can be exercised
+ * and timed anywhere. Captures complete on a worker thread in request order:
+ * the shutter fires at the configured frame interval, 3A state and the other
+ * partial results follow right away, and the final result and output buffers
+ * arrive once the configured latency has passed.
+ */
+struct FakeCamera3Config {
+    FakeCamera3Config();
+
+    // Largest output size; the other advertised sizes are derived from it
+    int32_t width;
+    int32_t height;
+    // Time between the shutters of consecutive captures
+    nsecs_t frameDurationNs;
+    // Time from the shutter of a capture to its final result
+    nsecs_t resultLatencyNs;
+    // Results sent per capture, the last one being the final result; at most
+    // kMaxPartialResultCount
+    int32_t partialResultCount;
+    // Captures in flight before process_capture_request blocks
+    int32_t pipelineDepth;
+    // Whether to write into each output buffer before returning it
+    bool fillBuffers;
+
+    static const int32_t kMaxPartialResultCount = 6;
+};
+
+/**
+ * Returns the fake module. The configuration applies to the camera opened
+ * next and to the static metadata returned from then on.
+ */
+camera_module_t *getFakeCamera3Module(const FakeCamera3Config &config);
+
+/**
+ * Returns the time process_capture_request was called for the given frame,
+ * or -1 if it is no longer known. The most recent kRequestTimeHistory frames
+ * are remembered.
+ */
+nsecs_t getFakeCamera3RequestTime(uint32_t frameNumber);
+
+static const uint32_t kRequestTimeHistory = 256;
+
+}; // namespace android
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "JpegCompressorBenchmark"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include "api1/client2/JpegCompressor.h"
+
+// Compresses a synthetic still of the given size with the software JPEG
+// compressor once per thread count, and reports the encode time, the speedup
+// over the first thread count and the size of the JPEG.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-s <width>x<height>]\n"
+                    "\t\t[-t <thread counts, comma separated>]\n"
+                    "\t\t[-n <encodes per thread count>]\n"
+                    "\t\t[-q <quality>]\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+using camera2::JpegCompressor;
+
+struct BenchResult {
+    Vector<int64_t> mEncodeTimesNs;
+    size_t mJpegSize;
+};
+
+// Smooth gradients with some texture, so the JPEG is neither trivially small
+// nor as large as pure noise
+static void fillImage(CpuConsumer::LockedBuffer *image) {
+    for (uint32_t y = 0; y < image->height; y++) {
+        uint8_t *row = image->data + y * image->stride;
+        for (uint32_t x = 0; x < image->width; x++) {
+            row[x] = (x / 4 + y / 8 + ((x ^ y) & 0x1F) + (rand() & 0x7)) & 0xFF;
+        }
+    }
+}
+
+static status_t runBenchmark(const CpuConsumer::LockedBuffer &image,
+        size_t threadCount, size_t numEncodes, int quality,
+        BenchResult *result) {
+    size_t dstSize = image.width * image.height * 2 + 4096;
+    uint8_t *dst = new uint8_t[dstSize];
+
+    status_t res = OK;
+    for (size_t i = 0; i < numEncodes && res == OK; i++) {
+        nsecs_t startNs = systemTime();
+        res = JpegCompressor::compress(image, dst, dstSize, quality,
+                threadCount, &result->mJpegSize);
+        result->mEncodeTimesNs.push(systemTime() - startNs);
+    }
+
+    delete[] dst;
+    if (res != OK) {
+        fprintf(stderr, "unable to compress (err=%d)\n", res);
+    }
+    return res;
+}
+
+static int compareTimes(const int64_t *a, const int64_t *b) {
+    return *a < *b ? -1 : (*a > *b ? 1 : 0);
+}
+
+static void printResult(size_t threadCount, const CpuConsumer::LockedBuffer &image,
+        BenchResult *result, double *baselineNs) {
+    Vector<int64_t> &timesNs = result->mEncodeTimesNs;
+    size_t n = timesNs.size();
+    timesNs.sort(compareTimes);
+
+    int64_t totalNs = 0ll;
+    for (size_t i = 0; i < n; ++i) {
+        totalNs += timesNs.itemAt(i);
+    }
+    double avgNs = (double)totalNs / n;
+    if (*baselineNs == 0) {
+        *baselineNs = avgNs;
+    }
+
+    printf("%zu thread(s): avg %.2f ms, median %.2f ms, min %.2f ms, "
+           "%.1f MP/s, speedup %.2fx, %zu bytes\n",
+           threadCount,
+           avgNs / 1E6,
+           timesNs.itemAt(n / 2) / 1E6,
+           timesNs.itemAt(0) / 1E6,
+           image.width * image.height / (avgNs / 1E3),
+           *baselineNs / avgNs,
+           result->mJpegSize);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    const char *threadCountList = "1,2,4,8";
+    int width = 4160;
+    int height = 3120;
+    int numEncodes = 10;
+    int quality = 90;
+
+    int res;
+    while ((res = getopt(argc, argv, "hs:t:n:q:")) >= 0) {
+        switch (res) {
+            case 's':
+                if (sscanf(optarg, "%dx%d", &width, &height) != 2) {
+                    usage(me);
+                }
+                break;
+
+            case 't':
+                threadCountList = optarg;
+                break;
+
+            case 'n':
+                numEncodes = atoi(optarg);
+                break;
+
+            case 'q':
+                quality = atoi(optarg);
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    Vector<int32_t> threadCounts;
+    for (const char *s = threadCountList; *s != '\0';) {
+        char *end;
+        long threadCount = strtol(s, &end, 10);
+        if (end == s || threadCount <= 0 || (*end != ',' && *end != '\0')) {
+            usage(me);
+        }
+        threadCounts.push(threadCount);
+        s = (*end == ',') ? end + 1 : end;
+    }
+
+    if (threadCounts.isEmpty() || width <= 0 || height <= 0
+            || numEncodes <= 0 || quality < 1 || quality > 100) {
+        usage(me);
+    }
+
+    CpuConsumer::LockedBuffer image;
+    memset(&image, 0, sizeof(image));
+    image.width = width;
+    image.height = height;
+    image.stride = width;
+    image.data = new uint8_t[width * height];
+    fillImage(&image);
+
+    printf("%dx%d, quality %d, %d encodes per thread count\n",
+           width, height, quality, numEncodes);
+
+    double baselineNs = 0;
+    for (size_t i = 0; i < threadCounts.size(); ++i) {
+        BenchResult result;
+        if (runBenchmark(image, threadCounts[i], numEncodes, quality,
+                &result) != OK) {
+            delete[] image.data;
+            return 1;
+        }
+
+        printResult(threadCounts[i], image, &result, &baselineNs);
+    }
+
+    delete[] image.data;
+    return 0;
+}
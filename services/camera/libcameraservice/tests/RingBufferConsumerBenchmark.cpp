@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "RingBufferConsumerBenchmark"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <gui/BufferQueue.h>
+#include <gui/RingBufferConsumer.h>
+#include <gui/Surface.h>
+#include <hardware/gralloc.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+// Fills a RingBufferConsumer of each of the given depths the way a ZSL stream
+// does, then reports the cost of queueing a frame into the full ring (which
+// evicts the oldest one) and of pinning a buffer by timestamp, both with a
+// comparator run over the whole ring and with the timestamp lookup.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-d <ring depths, comma separated>]\n"
+                    "\t\t[-n <lookups per depth>]\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+static const uint32_t kWidth = 64;
+static const uint32_t kHeight = 64;
+static const nsecs_t kFrameDurationNs = 33333333ll; // 30 fps
+// Extra buffers the producer can dequeue while the ring holds its own
+static const int kProducerBuffers = 2;
+
+typedef RingBufferConsumer::BufferInfo BufferInfo;
+typedef RingBufferConsumer::PinnedBufferItem PinnedBufferItem;
+
+/**
+ * Same selection as the ZSL stream used before the timestamp lookup: the
+ * exact match, else the closest older buffer, else the closest newer one.
+ */
+struct ClosestTimestampComparator :
+        public RingBufferConsumer::RingBufferComparator {
+    ClosestTimestampComparator(nsecs_t timestamp) : mTimestamp(timestamp) {}
+
+    virtual int compare(const BufferInfo *i1, const BufferInfo *i2) const {
+        if (i1 == NULL) return 1;
+        if (i2 == NULL) return -1;
+
+        if (i1->mTimestamp == mTimestamp) return -1;
+        if (i2->mTimestamp == mTimestamp) return 1;
+
+        const BufferInfo *older = i1;
+        const BufferInfo *newer = i2;
+        int selectOlder = -1;
+        int selectNewer = 1;
+        if (older->mTimestamp > newer->mTimestamp) {
+            older = i2;
+            newer = i1;
+            selectOlder = 1;
+            selectNewer = -1;
+        }
+
+        if (newer->mTimestamp < mTimestamp) return selectNewer;
+        return selectOlder;
+    }
+
+    const nsecs_t mTimestamp;
+};
+
+struct BenchResult {
+    nsecs_t mQueueTimeNs;
+    size_t mFramesQueued;
+    nsecs_t mComparatorTimeNs;
+    nsecs_t mLookupTimeNs;
+    size_t mLookups;
+    size_t mMismatches;
+};
+
+static status_t queueFrame(ANativeWindow *window, nsecs_t timestamp) {
+    status_t res = native_window_set_buffers_timestamp(window, timestamp);
+    if (res != OK) return res;
+
+    ANativeWindowBuffer *anb;
+    int fenceFd;
+    res = window->dequeueBuffer(window, &anb, &fenceFd);
+    if (res != OK) return res;
+    if (fenceFd >= 0) close(fenceFd);
+
+    return window->queueBuffer(window, anb, -1);
+}
+
+static status_t runBenchmark(int depth, size_t numLookups,
+        BenchResult *result) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<RingBufferConsumer> ring = new RingBufferConsumer(consumer,
+            GRALLOC_USAGE_SW_READ_OFTEN, depth);
+    ring->setName(String8::format("RingBufferConsumerBenchmark-%d", depth));
+
+    sp<Surface> surface = new Surface(producer);
+    ANativeWindow *window = surface.get();
+    status_t res = native_window_api_connect(window, NATIVE_WINDOW_API_CPU);
+    if (res == OK) {
+        res = native_window_set_usage(window, GRALLOC_USAGE_SW_WRITE_OFTEN);
+    }
+    if (res == OK) {
+        res = native_window_set_buffers_dimensions(window, kWidth, kHeight);
+    }
+    if (res == OK) {
+        res = native_window_set_buffers_format(window, HAL_PIXEL_FORMAT_RGBA_8888);
+    }
+    if (res == OK) {
+        res = native_window_set_buffer_count(window, depth + kProducerBuffers);
+    }
+    if (res != OK) {
+        fprintf(stderr, "unable to set up the producer (err=%d)\n", res);
+        return res;
+    }
+
+    // Fill the ring once so that every buffer is allocated, then time the
+    // steady state where each new frame evicts the oldest one.
+    nsecs_t timestamp = kFrameDurationNs;
+    for (int i = 0; i < depth + kProducerBuffers && res == OK; i++) {
+        res = queueFrame(window, timestamp);
+        timestamp += kFrameDurationNs;
+    }
+
+    result->mFramesQueued = depth * 4;
+    nsecs_t startNs = systemTime();
+    for (size_t i = 0; i < result->mFramesQueued && res == OK; i++) {
+        res = queueFrame(window, timestamp);
+        timestamp += kFrameDurationNs;
+    }
+    result->mQueueTimeNs = systemTime() - startNs;
+
+    if (res != OK) {
+        fprintf(stderr, "unable to queue frames (err=%d)\n", res);
+        native_window_api_disconnect(window, NATIVE_WINDOW_API_CPU);
+        return res;
+    }
+
+    // Ask for timestamps across the ring, half of them exact and the rest
+    // between two frames, the way results and buffers can disagree.
+    nsecs_t newest = timestamp - kFrameDurationNs;
+    nsecs_t oldest = newest - (depth - 1) * kFrameDurationNs;
+    Vector<nsecs_t> queries;
+    srand(depth);
+    for (size_t i = 0; i < numLookups; i++) {
+        nsecs_t query = oldest + (rand() % depth) * kFrameDurationNs;
+        if (i % 2) query += rand() % kFrameDurationNs;
+        queries.push(query);
+    }
+
+    Vector<nsecs_t> selected;
+    startNs = systemTime();
+    for (size_t i = 0; i < queries.size(); i++) {
+        sp<PinnedBufferItem> pinned = ring->pinSelectedBuffer(
+                ClosestTimestampComparator(queries[i]),
+                /*waitForFence*/false);
+        selected.push(pinned != NULL ? pinned->getBufferItem().mTimestamp : -1);
+    }
+    result->mComparatorTimeNs = systemTime() - startNs;
+
+    result->mMismatches = 0;
+    startNs = systemTime();
+    for (size_t i = 0; i < queries.size(); i++) {
+        sp<PinnedBufferItem> pinned = ring->pinBufferByTimestamp(queries[i],
+                /*waitForFence*/false);
+        nsecs_t actual = pinned != NULL ? pinned->getBufferItem().mTimestamp : -1;
+        if (actual != selected[i]) result->mMismatches++;
+    }
+    result->mLookupTimeNs = systemTime() - startNs;
+    result->mLookups = queries.size();
+
+    native_window_api_disconnect(window, NATIVE_WINDOW_API_CPU);
+    ring->clear();
+
+    return OK;
+}
+
+static void printResult(int depth, const BenchResult &result) {
+    printf("depth %d:\n", depth);
+    printf("\t%-24s %8.2f us/frame\n", "queue into full ring",
+           result.mQueueTimeNs / 1E3 / result.mFramesQueued);
+    printf("\t%-24s %8.2f us/pin\n", "pin with comparator",
+           result.mComparatorTimeNs / 1E3 / result.mLookups);
+    printf("\t%-24s %8.2f us/pin\n", "pin by timestamp",
+           result.mLookupTimeNs / 1E3 / result.mLookups);
+    if (result.mMismatches > 0) {
+        printf("\t%zu of %zu lookups picked a different buffer!\n",
+               result.mMismatches, result.mLookups);
+    }
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    const char *depthList = "8,16,32,48";
+    int numLookups = 10000;
+
+    int res;
+    while ((res = getopt(argc, argv, "hd:n:")) >= 0) {
+        switch (res) {
+            case 'd':
+                depthList = optarg;
+                break;
+
+            case 'n':
+                numLookups = atoi(optarg);
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    Vector<int> depths;
+    for (const char *s = depthList; *s != '\0';) {
+        char *end;
+        long depth = strtol(s, &end, 10);
+        if (end == s || depth <= 0 || (*end != ',' && *end != '\0')) {
+            usage(me);
+        }
+        depths.push(depth);
+        s = (*end == ',') ? end + 1 : end;
+    }
+
+    if (depths.isEmpty() || numLookups <= 0) {
+        usage(me);
+    }
+
+    for (size_t i = 0; i < depths.size(); ++i) {
+        BenchResult result;
+        if (runBenchmark(depths[i], numLookups, &result) != OK) {
+            return 1;
+        }
+
+        printResult(depths[i], result);
+    }
+
+    return 0;
+}